@@ -15,6 +15,7 @@ public:
         benchmark_read();
         benchmark_mixed();
         benchmark_scan();
+        benchmark_sync_modes();
         
         std::cout << std::endl << "=== Benchmark completed ===" << std::endl;
     }
@@ -180,6 +181,39 @@ private:
         
         engine.close();
     }
+    
+    void benchmark_sync_modes() {
+        std::cout << "Benchmark: WAL Sync Modes" << std::endl;
+        
+        const WALSyncMode modes[] = {WALSyncMode::ALWAYS, WALSyncMode::INTERVAL, WALSyncMode::OS};
+        const char* names[] = {"always", "interval", "os"};
+        
+        for (int m = 0; m < 3; ++m) {
+            Options options;
+            options.wal_sync_mode = modes[m];
+            KvEngine engine(std::string("./bench_sync_") + names[m], options);
+            engine.open();
+            
+            const int NUM_OPS = 2000;
+            auto start = std::chrono::high_resolution_clock::now();
+            
+            for (int i = 0; i < NUM_OPS; ++i) {
+                engine.put("sync" + std::to_string(i), "value" + std::to_string(i));
+            }
+            
+            auto end = std::chrono::high_resolution_clock::now();
+            auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+            Statistics stats = engine.get_statistics();
+            
+            std::cout << "  [" << names[m] << "] Throughput: " << std::fixed << std::setprecision(2)
+                      << (NUM_OPS * 1000000.0) / duration.count() << " ops/sec, "
+                      << "fdatasync: " << stats.wal_syncs << " calls / "
+                      << stats.wal_sync_time_us / 1000 << " ms" << std::endl;
+            
+            engine.close();
+        }
+        std::cout << std::endl;
+    }
 };
 
 int main() {
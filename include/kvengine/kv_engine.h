@@ -8,7 +8,9 @@
 #define KVENGINE_KV_ENGINE_H
 
 #include "types.h"
+#include "options.h"
 #include "iterator.h"
+#include "replication.h"
 #include <string>
 #include <map>
 #include <memory>
@@ -16,8 +18,7 @@
 namespace kvengine {
 
 // 前向聲明
-class StorageEngine;
-class HashIndex;
+class StorageBackend;
 class MemoryManager;
 
 /**
@@ -35,8 +36,9 @@ public:
     /**
      * @brief 構造函數
      * @param data_dir 數據存儲目錄路徑
+     * @param options 引擎配置（如 WAL 持久化策略）
      */
-    explicit KvEngine(const std::string& data_dir);
+    explicit KvEngine(const std::string& data_dir, const Options& options = Options());
     
     /**
      * @brief 析構函數
@@ -51,7 +53,10 @@ public:
     /**
      * @brief 打開引擎
      * @return 成功返回 true，失敗返回 false
-     * @details 初始化存儲引擎，加載已有數據，構建索引
+     * @details 初始化存儲引擎，加載已有數據，構建索引。
+     *          Options::recovery_lazy 時不等待日誌重放：索引重建與重放在後台進行，
+     *          單鍵操作在應答之前重放該鍵的待重放寫入，掃描、檢查點等全局操作等待恢復完成；
+     *          進度見 Statistics 的 recovery_* 字段
      */
     bool open();
     
@@ -146,6 +151,43 @@ public:
      */
     bool verify_integrity();
     
+    // ===== 複製 =====
+    
+    /**
+     * @brief 執行檢查點並讀取數據文件（主節點向從節點發送全量快照）
+     * @param contents 輸出數據文件內容
+     * @param snapshot_lsn 輸出快照 LSN：從它開始跟隨日誌即可得到一致的數據
+     * @return 成功返回 true
+     */
+    bool read_snapshot(std::string& contents, uint64_t& snapshot_lsn);
+    
+    /**
+     * @brief 創建跟隨日誌尾部的游標
+     * @param start_lsn 第一條要讀取的記錄
+     * @return 游標；引擎未打開時返回空指針
+     */
+    std::unique_ptr<LogTailer> tail_log(uint64_t start_lsn);
+    
+    /**
+     * @brief 獲取已分配的最大 LSN
+     */
+    uint64_t get_last_lsn() const;
+    
+    /**
+     * @brief 以主節點的快照替換全部數據（從節點全量同步）
+     * @param contents 主節點 read_snapshot 的輸出
+     * @param snapshot_lsn 輸出快照 LSN
+     * @return 成功返回 true
+     */
+    bool load_snapshot(const std::string& contents, uint64_t& snapshot_lsn);
+    
+    /**
+     * @brief 應用主節點的一批寫入（從節點增量同步）
+     * @details 直接寫入存儲引擎，不寫本地日誌
+     * @return 成功返回 true
+     */
+    bool apply_replicated(const ReplicationBatch& batch);
+    
 private:
     class Impl;                      // 前向聲明內部實現類
     std::unique_ptr<Impl> impl_;     // Pimpl 模式的實現指針
@@ -10,22 +10,51 @@
 #include <kvengine/kv_engine.h>
 #include <kvengine/network/tcp_server.h>
 #include <kvengine/network/command_dispatcher.h>
+#include <kvengine/network/replica_client.h>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace kvengine {
 namespace network {
 
 class KvServer {
 public:
-    KvServer(const std::string& data_dir, uint16_t port, const std::string& host = "0.0.0.0");
+    KvServer(const std::string& data_dir, uint16_t port, const std::string& host = "0.0.0.0",
+             const Options& options = Options());
     ~KvServer();
 
     bool start();
     void stop();
     void run(); // blocking
 
+    /**
+     * @brief 成為指定主節點的只讀從節點（REPLICAOF host port）
+     * @details 停止之前的複製，從主節點全量同步後持續跟隨其日誌；從節點拒絕寫命令
+     */
+    void replicaof(const std::string& host, uint16_t port);
+
+    /**
+     * @brief 停止複製並恢復為可寫的主節點（REPLICAOF NO ONE），保留已複製的數據
+     * @details 複製來的寫入沒有寫入本地日誌，恢復可寫之前先寫出檢查點使它們持久化
+     * @return 成功返回 true；檢查點失敗時複製已停止但仍保持只讀，可以重試
+     */
+    bool replicaof_no_one();
+
 private:
+    /**
+     * @brief 處理服務器級命令（REPLICAOF / ROLE、從節點的只讀檢查），其餘交給 dispatcher
+     */
+    std::string handle_command(const std::vector<std::string>& command);
+
+    /**
+     * @brief 處理 PSYNC：向從節點發送快照並持續發送日誌，直到連接斷開或服務器停止
+     */
+    void serve_replica(Socket& client, const std::vector<std::string>& command);
+
     std::string data_dir_;
     uint16_t port_;
     std::string host_;
@@ -33,6 +62,14 @@ private:
     std::unique_ptr<KvEngine> engine_;
     std::unique_ptr<TcpServer> server_;
     std::unique_ptr<CommandDispatcher> dispatcher_;
+
+    std::mutex replica_mutex_;
+    std::unique_ptr<ReplicaClient> replica_;    // 作為從節點時的複製線程（主節點為空）
+
+    std::atomic<bool> stopping_;
+    std::mutex streams_mutex_;
+    std::condition_variable streams_cv_;
+    size_t streams_;                            // 正在向從節點發送日誌的連接數（停止時等待歸零）
 };
 
 } // namespace network
@@ -0,0 +1,127 @@
+/**
+ * @file replica_client.h
+ * @brief 複製從節點
+ * @details 連接主節點，先接收數據文件的全量快照，再跟隨主節點的 WAL 把生效的寫入應用到本地引擎。
+ *
+ *          複製協議沿用 RESP 數組：
+ *          - 從節點發送 PSYNC <resume_lsn> <applied_lsn>，resume_lsn 為 0 時請求全量同步
+ *          - 主節點回覆 FULLRESYNC <數據文件> 或 CONTINUE
+ *          - 之後持續發送 REPL <position> <resume_lsn> <master_lsn> [SET|DEL key value]...，
+ *            沒有新寫入時定期發送不帶寫操作的心跳
+ *          - 需要的日誌已被截斷時發送 LOST 並斷開，從節點下次連接時重新全量同步
+ */
+
+#ifndef KVENGINE_NETWORK_REPLICA_CLIENT_H
+#define KVENGINE_NETWORK_REPLICA_CLIENT_H
+
+#include <kvengine/kv_engine.h>
+#include <kvengine/network/socket.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kvengine {
+namespace network {
+
+/**
+ * @class ReplicaClient
+ * @brief 從節點的複製線程
+ * @details 連接斷開後自動重連，並從上次的位置增量同步
+ */
+class ReplicaClient {
+public:
+    /**
+     * @enum State
+     * @brief 與主節點的連接狀態（對應 Redis ROLE 命令的狀態名）
+     */
+    enum class State {
+        CONNECT,        // 等待重連
+        CONNECTING,     // 正在連接
+        SYNC,           // 已發送 PSYNC，等待主節點回覆
+        CONNECTED       // 正在跟隨主節點的日誌
+    };
+
+    /**
+     * @brief 構造函數
+     * @param engine 已打開的本地引擎
+     * @param host 主節點 IP（"localhost" 視為 127.0.0.1）
+     * @param port 主節點端口
+     */
+    ReplicaClient(KvEngine* engine, const std::string& host, uint16_t port);
+    ~ReplicaClient();
+
+    ReplicaClient(const ReplicaClient&) = delete;
+    ReplicaClient& operator=(const ReplicaClient&) = delete;
+
+    /**
+     * @brief 啟動複製線程
+     */
+    void start();
+
+    /**
+     * @brief 斷開連接並等待複製線程退出；已應用的數據保留在引擎中
+     */
+    void stop();
+
+    const std::string& get_host() const { return host_; }
+    uint16_t get_port() const { return port_; }
+    State get_state() const { return state_; }
+
+    /**
+     * @brief 狀態名：connect / connecting / sync / connected
+     */
+    std::string get_state_name() const;
+
+    /**
+     * @brief 已應用到的主節點 LSN
+     */
+    uint64_t get_applied_lsn() const { return applied_lsn_; }
+
+    /**
+     * @brief 主節點最近報告的最大 LSN
+     */
+    uint64_t get_master_lsn() const { return master_lsn_; }
+
+    /**
+     * @brief 複製延遲（落後主節點的 LSN 數）
+     */
+    uint64_t get_lag() const;
+
+private:
+    /**
+     * @brief 複製線程：連接、同步，斷開後等待重連
+     */
+    void run();
+
+    /**
+     * @brief 建立一次連接並持續接收，直到連接斷開或停止
+     */
+    void stream();
+
+    /**
+     * @brief 處理主節點發來的一幀
+     * @return 需要斷開連接時返回 false
+     */
+    bool handle_frame(const std::vector<std::string>& frame);
+
+    KvEngine* engine_;                     // 本地引擎
+    std::string host_;                     // 主節點 IP
+    uint16_t port_;                        // 主節點端口
+    std::thread thread_;                   // 複製線程
+    std::mutex mutex_;                     // 保護 stop_ 與 socket_ 的創建、關閉
+    std::condition_variable cv_;           // 重連等待
+    bool stop_;                            // 通知複製線程退出
+    Socket socket_;                        // 到主節點的連接
+    std::atomic<State> state_;             // 連接狀態
+    std::atomic<uint64_t> applied_lsn_;    // 已應用到的 LSN
+    std::atomic<uint64_t> resume_lsn_;     // 重連時請求的起始 LSN（0 表示全量同步）
+    std::atomic<uint64_t> master_lsn_;     // 主節點的最大 LSN
+};
+
+} // namespace network
+} // namespace kvengine
+
+#endif // KVENGINE_NETWORK_REPLICA_CLIENT_H
@@ -113,6 +113,15 @@ public:
      */
     int send(const char* data, size_t len);
 
+    /**
+     * @brief 發送全部數據
+     * @details 循環發送直到寫完；對端已關閉時返回 false 而不觸發 SIGPIPE
+     * @param data 數據指針
+     * @param len 數據長度
+     * @return 全部發送返回 true
+     */
+    bool send_all(const char* data, size_t len);
+
     /**
      * @brief 接收數據
      * @param buffer 緩衝區
@@ -121,6 +130,12 @@ public:
      */
     int recv(char* buffer, size_t len);
 
+    /**
+     * @brief 關閉讀寫方向
+     * @details 喚醒阻塞在 recv / accept 上的其他線程，句柄保持有效，仍需調用 close
+     */
+    void shutdown();
+
     /**
      * @brief 關閉 Socket
      */
@@ -0,0 +1,72 @@
+/**
+ * @file options.h
+ * @brief KvEngine 配置選項
+ * @details 定義引擎在打開時使用的可調參數
+ */
+
+#ifndef KVENGINE_OPTIONS_H
+#define KVENGINE_OPTIONS_H
+
+#include <cstdint>
+
+namespace kvengine {
+
+/**
+ * @enum WALSyncMode
+ * @brief WAL 持久化策略（對應 Redis 的 appendfsync）
+ */
+enum class WALSyncMode {
+    ALWAYS,      // 每次提交都 fdatasync，提交返回即已落盤
+    INTERVAL,    // 後台線程每隔 wal_sync_interval_ms 執行一次 fdatasync
+    OS           // 只寫入內核，由操作系統決定何時落盤
+};
+
+/**
+ * @enum StorageBackendType
+ * @brief 數據的存儲方式
+ */
+enum class StorageBackendType {
+    MEMORY,      // 全部數據常駐內存 std::map，檢查點時整體寫出 kvengine.dat
+    LSM,         // LSM 樹：內存表加分層合併的表文件，數據量不受內存限制
+    BPLUS_TREE   // B+ 樹：數據存放在磁盤頁面中，只有緩衝池中的熱點頁面常駐內存
+};
+
+/**
+ * @struct Options
+ * @brief 引擎配置
+ */
+struct Options {
+    StorageBackendType storage_backend = StorageBackendType::MEMORY;  // 存儲後端
+    
+    WALSyncMode wal_sync_mode = WALSyncMode::ALWAYS;  // WAL 持久化策略
+    uint32_t wal_sync_interval_ms = 1000;             // INTERVAL 模式下的同步間隔（毫秒）
+    uint64_t wal_segment_size = 64ull << 20;          // WAL 段文件大小上限（字節）
+    bool wal_preallocate = true;                      // 創建段時用 fallocate 預分配整個段，追加不再擴展文件
+    bool wal_direct_io = false;                       // 段文件以 O_DIRECT | O_DSYNC 打開，寫入即持久化（僅 Linux）
+    bool wal_io_uring = false;                        // 寫入與 fdatasync 通過 io_uring 鏈接提交（不可用時回退）
+    uint32_t recovery_threads = 0;                    // 恢復重做的並行線程數（0 表示 CPU 核數）
+    bool recovery_lazy = false;                       // 即時打開：後台重放日誌，請求訪問的鍵按需提前重放
+    
+    // 自動檢查點：任一條件滿足（且距上次檢查點不少於最小間隔）時由後台線程執行檢查點
+    uint64_t checkpoint_wal_bytes = 64ull << 20;      // 自上次檢查點起寫入的日誌字節數（0 關閉）
+    uint32_t checkpoint_interval_ms = 0;              // 距上次檢查點的時間（0 關閉）
+    uint32_t checkpoint_jitter_ms = 0;                // 時間觸發附加的隨機延遲上限，錯開多個實例
+    uint32_t checkpoint_min_interval_ms = 1000;       // 兩次自動檢查點之間的最小間隔
+    
+    // LSM 存儲：內存表刷寫成不可變的表文件，後台分層合併
+    uint64_t lsm_memtable_bytes = 4ull << 20;         // 內存表達到該大小後凍結，由後台線程刷寫成 L0 表文件
+    uint32_t lsm_level0_compaction_trigger = 4;       // L0 表文件數達到該值時合併到 L1
+    uint32_t lsm_level0_stop_writes = 12;             // L0 表文件數達到該值時寫入等待合併
+    uint64_t lsm_level1_bytes = 16ull << 20;          // L1 的大小上限，之後每層乘以 lsm_level_multiplier
+    uint32_t lsm_level_multiplier = 10;               // 相鄰兩層的大小比例
+    uint64_t lsm_table_bytes = 2ull << 20;            // 合併輸出的單個表文件大小上限
+    uint32_t lsm_block_bytes = 4096;                  // 表文件數據塊大小
+    uint32_t lsm_bloom_bits_per_key = 10;             // 布隆過濾器每鍵位數（0 關閉）
+    
+    // B+ 樹存儲：內存佔用由緩衝池大小決定
+    uint32_t btree_buffer_pool_pages = 4096;          // 緩衝池頁數（每頁 4KB）
+};
+
+} // namespace kvengine
+
+#endif // KVENGINE_OPTIONS_H
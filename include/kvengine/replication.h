@@ -0,0 +1,80 @@
+/**
+ * @file replication.h
+ * @brief 日誌複製接口
+ * @details 主節點以 LogTailer 跟隨自己的 WAL，把已生效的寫入按日誌順序發給從節點；
+ *          從節點把它們直接應用到存儲引擎
+ */
+
+#ifndef KVENGINE_REPLICATION_H
+#define KVENGINE_REPLICATION_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace kvengine {
+
+/**
+ * @struct ReplicationWrite
+ * @brief 一次複製的寫操作
+ */
+struct ReplicationWrite {
+    std::string key;         // 鍵
+    std::string value;       // 值（刪除時為空）
+    bool is_delete;          // 是否為刪除
+
+    ReplicationWrite() : is_delete(false) {}
+};
+
+/**
+ * @struct ReplicationBatch
+ * @brief 日誌中一次生效的寫入
+ * @details 自動提交操作為單條寫入；事務在 COMMIT 記錄處整體生效，
+ *          在 ROLLBACK 記錄處按運行時的回滾語義刪除它寫過的鍵
+ */
+struct ReplicationBatch {
+    uint64_t lsn;                            // 生效記錄的 LSN
+    std::vector<ReplicationWrite> writes;    // 按日誌順序的寫操作
+
+    ReplicationBatch() : lsn(0) {}
+};
+
+/**
+ * @class LogTailer
+ * @brief 跟隨 WAL 尾部的游標
+ * @details 讀到日誌末尾後再次調用 next 會繼續讀取之後追加的記錄，不重新掃描已讀部分。
+ *          游標必須在創建它的引擎關閉之前銷毀
+ */
+class LogTailer {
+public:
+    virtual ~LogTailer() {}
+
+    /**
+     * @brief 讀取下一批生效的寫入
+     * @param batch 輸出批次
+     * @return 有新批次返回 true；暫時沒有新記錄或日誌已丟失返回 false
+     */
+    virtual bool next(ReplicationBatch& batch) = 0;
+
+    /**
+     * @brief 已處理到的 LSN（包括不產生寫入的記錄）
+     */
+    virtual uint64_t get_position() const = 0;
+
+    /**
+     * @brief 斷線後重新開始跟隨的 LSN
+     * @details 尚未結束的事務中最早的記錄；沒有時為下一條記錄。
+     *          從它重新開始時跳過 LSN 不大於 get_position() 的批次即可無縫銜接
+     */
+    virtual uint64_t get_resume_lsn() const = 0;
+
+    /**
+     * @brief 需要的日誌是否已被檢查點截斷
+     * @return true 時無法增量跟隨，從節點需要重新全量同步
+     */
+    virtual bool is_lost() const = 0;
+};
+
+} // namespace kvengine
+
+#endif // KVENGINE_REPLICATION_H
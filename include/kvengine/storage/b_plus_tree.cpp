@@ -1,5 +1,6 @@
 #include "kvengine/storage/b_plus_tree.h"
 #include <iostream>
+#include <thread>
 
 namespace kvengine {
 
@@ -14,20 +15,40 @@ BPlusTree<KeyType, ValueType, KeyComparator>::BPlusTree(std::string index_name,
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool BPlusTree<KeyType, ValueType, KeyComparator>::is_empty() const {
+    SharedLatchGuard guard(root_latch_);
     return root_page_id_ == INVALID_PAGE_ID;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-Page *BPlusTree<KeyType, ValueType, KeyComparator>::find_leaf_page(const KeyType &key, bool left_most) {
-    if (is_empty()) return nullptr;
-    
+page_id_t BPlusTree<KeyType, ValueType, KeyComparator>::get_root_page_id() {
+    SharedLatchGuard guard(root_latch_);
+    return root_page_id_;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void BPlusTree<KeyType, ValueType, KeyComparator>::set_root_page_id(page_id_t root_page_id) {
+    std::lock_guard<ReaderWriterLatch> guard(root_latch_);
+    root_page_id_ = root_page_id;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+Page *BPlusTree<KeyType, ValueType, KeyComparator>::find_leaf_read(const KeyType &key, bool left_most) {
+    root_latch_.lock_shared();
+    if (root_page_id_ == INVALID_PAGE_ID) {
+        root_latch_.unlock_shared();
+        return nullptr;
+    }
     Page *page = buffer_pool_manager_->fetch_page(root_page_id_);
+    if (page != nullptr) {
+        page->r_latch();
+    }
+    root_latch_.unlock_shared();
     if (page == nullptr) return nullptr;
     
     BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->get_data());
     
     while (!node->is_leaf_page()) {
-        auto *internal = static_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(node);
+        auto *internal = static_cast<InternalPage *>(node);
         page_id_t next_page_id;
         
         if (left_most) {
@@ -36,27 +57,120 @@ Page *BPlusTree<KeyType, ValueType, KeyComparator>::find_leaf_page(const KeyType
            next_page_id = internal->lookup(key, comparator_);
         }
         
+        // Latch the child before releasing the parent
+        Page *child = buffer_pool_manager_->fetch_page(next_page_id);
+        if (child != nullptr) {
+            child->r_latch();
+        }
+        page->r_unlatch();
         buffer_pool_manager_->unpin_page(page->get_page_id(), false);
-        page = buffer_pool_manager_->fetch_page(next_page_id);
-        if (page == nullptr) return nullptr;
+        if (child == nullptr) return nullptr;
+        page = child;
         node = reinterpret_cast<BPlusTreePage *>(page->get_data());
     }
     return page;
 }
 
+template <typename KeyType, typename ValueType, typename KeyComparator>
+Page *BPlusTree<KeyType, ValueType, KeyComparator>::find_leaf_write(const KeyType &key) {
+    // The page type never changes while the page is reachable, so it can be read before
+    // latching; the parent latch (root_latch_ for the root) keeps the page reachable
+    root_latch_.lock_shared();
+    if (root_page_id_ == INVALID_PAGE_ID) {
+        root_latch_.unlock_shared();
+        return nullptr;
+    }
+    Page *page = buffer_pool_manager_->fetch_page(root_page_id_);
+    bool is_leaf = false;
+    if (page != nullptr) {
+        is_leaf = reinterpret_cast<BPlusTreePage *>(page->get_data())->is_leaf_page();
+        is_leaf ? page->w_latch() : page->r_latch();
+    }
+    root_latch_.unlock_shared();
+    if (page == nullptr) return nullptr;
+
+    while (!is_leaf) {
+        auto *internal = reinterpret_cast<InternalPage *>(page->get_data());
+        Page *child = buffer_pool_manager_->fetch_page(internal->lookup(key, comparator_));
+        if (child != nullptr) {
+            is_leaf = reinterpret_cast<BPlusTreePage *>(child->get_data())->is_leaf_page();
+            is_leaf ? child->w_latch() : child->r_latch();
+        }
+        page->r_unlatch();
+        buffer_pool_manager_->unpin_page(page->get_page_id(), false);
+        if (child == nullptr) return nullptr;
+        page = child;
+    }
+    return page;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool BPlusTree<KeyType, ValueType, KeyComparator>::find_leaf_pessimistic(const KeyType &key, const ValueType &value, Operation op, WriteSet &ws) {
+    root_latch_.lock();
+    ws.root_latched = true;
+    if (root_page_id_ == INVALID_PAGE_ID) return false;
+
+    page_id_t page_id = root_page_id_;
+    while (true) {
+        Page *page = buffer_pool_manager_->fetch_page(page_id);
+        if (page == nullptr) {
+            release_ancestors(ws, 0, false);
+            return false;
+        }
+        page->w_latch();
+        ws.pages.push_back(page);
+
+        auto *node = reinterpret_cast<BPlusTreeSlottedPage *>(page->get_data());
+        bool safe;
+        if (op == Operation::REMOVE) {
+            // The root only changes when it is left with a single child (or no entry)
+            if (node->is_root_page()) {
+                safe = node->get_size() > (node->is_leaf_page() ? 1 : 2);
+            } else {
+                safe = node->has_spare_record();
+            }
+        } else if (node->is_leaf_page()) {
+            safe = static_cast<LeafPage *>(node)->has_room(key, value);
+        } else {
+            safe = static_cast<InternalPage *>(node)->has_room_for_any_key();
+        }
+        // A safe page absorbs any split or merge below it, so its ancestors stay unchanged
+        if (safe) {
+            release_ancestors(ws, 1, false);
+        }
+        if (node->is_leaf_page()) return true;
+        page_id = static_cast<InternalPage *>(node)->lookup(key, comparator_);
+    }
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void BPlusTree<KeyType, ValueType, KeyComparator>::release_ancestors(WriteSet &ws, size_t keep_last, bool is_dirty) {
+    size_t count = ws.pages.size() - keep_last;
+    for (size_t i = 0; i < count; ++i) {
+        if (ws.pages[i] == nullptr) continue; // Deleted by a merge
+        ws.pages[i]->w_unlatch();
+        buffer_pool_manager_->unpin_page(ws.pages[i]->get_page_id(), is_dirty);
+    }
+    ws.pages.erase(ws.pages.begin(), ws.pages.begin() + count);
+    if (ws.root_latched) {
+        root_latch_.unlock();
+        ws.root_latched = false;
+    }
+}
+
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool BPlusTree<KeyType, ValueType, KeyComparator>::get_value(const KeyType &key, std::vector<ValueType> &result) {
-    std::lock_guard<std::mutex> lock(latch_);
-    Page *page = find_leaf_page(key);
+    Page *page = find_leaf_read(key);
     if (page == nullptr) return false;
 
-    auto *leaf = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(page->get_data());
+    auto *leaf = reinterpret_cast<LeafPage *>(page->get_data());
     ValueType val;
     bool found = leaf->lookup(key, val, comparator_);
     if (found) {
         result.push_back(val);
     }
     
+    page->r_unlatch();
     buffer_pool_manager_->unpin_page(page->get_page_id(), false);
     return found;
 }
@@ -64,93 +178,43 @@ bool BPlusTree<KeyType, ValueType, KeyComparator>::get_value(const KeyType &key,
 template <typename KeyType, typename ValueType, typename KeyComparator>
 typename BPlusTree<KeyType, ValueType, KeyComparator>::Iterator 
 BPlusTree<KeyType, ValueType, KeyComparator>::begin() {
-    // Get root_page_id atomically without holding lock during BufferPool ops
-    page_id_t root_id;
-    {
-        std::lock_guard<std::mutex> lock(latch_);
-        root_id = root_page_id_;
-    }
-    
-    if (root_id == INVALID_PAGE_ID) {
-        return Iterator(buffer_pool_manager_, INVALID_PAGE_ID);
-    }
-    
-    // Now traverse without holding tree lock
-    Page *page = buffer_pool_manager_->fetch_page(root_id);
-    if (page == nullptr) return Iterator(buffer_pool_manager_, INVALID_PAGE_ID);
-    
-    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->get_data());
-    
-    // Traverse to leftmost leaf
-    while (!node->is_leaf_page()) {
-        auto *internal = static_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(node);
-        page_id_t next_page_id = internal->value_at(0); // Leftmost child
-        
-        buffer_pool_manager_->unpin_page(page->get_page_id(), false);
-        page = buffer_pool_manager_->fetch_page(next_page_id);
-        if (page == nullptr) return Iterator(buffer_pool_manager_, INVALID_PAGE_ID);
-        node = reinterpret_cast<BPlusTreePage *>(page->get_data());
-    }
-    
-    page_id_t leaf_id = page->get_page_id();
-    buffer_pool_manager_->unpin_page(leaf_id, false);
-    
-    return Iterator(buffer_pool_manager_, leaf_id, 0);
+    // The leftmost leaf stays latched and pinned by the iterator
+    return Iterator(buffer_pool_manager_, find_leaf_read(KeyType(), true), 0);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 typename BPlusTree<KeyType, ValueType, KeyComparator>::Iterator 
 BPlusTree<KeyType, ValueType, KeyComparator>::begin(const KeyType &key) {
-    // Get root_page_id atomically
-    page_id_t root_id;
-    {
-        std::lock_guard<std::mutex> lock(latch_);
-        root_id = root_page_id_;
-    }
-    
-    if (root_id == INVALID_PAGE_ID) {
-        return Iterator(buffer_pool_manager_, INVALID_PAGE_ID);
-    }
-    
-    // Traverse without holding tree lock
-    Page *page = buffer_pool_manager_->fetch_page(root_id);
-    if (page == nullptr) return Iterator(buffer_pool_manager_, INVALID_PAGE_ID);
-    
-    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->get_data());
-    
-    while (!node->is_leaf_page()) {
-        auto *internal = static_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(node);
-        page_id_t next_page_id = internal->lookup(key, comparator_);
-        
-        buffer_pool_manager_->unpin_page(page->get_page_id(), false);
-        page = buffer_pool_manager_->fetch_page(next_page_id);
-        if (page == nullptr) return Iterator(buffer_pool_manager_, INVALID_PAGE_ID);
-        node = reinterpret_cast<BPlusTreePage *>(page->get_data());
-    }
-    
-    auto *leaf = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(page->get_data());
+    Page *page = find_leaf_read(key);
+    if (page == nullptr) return Iterator(buffer_pool_manager_, nullptr);
     
     // Find index >= key
-    int index = 0;
-    for (; index < leaf->get_size(); ++index) {
-        if (comparator_(leaf->key_at(index), key) >= 0) break;
-    }
-    
-    page_id_t leaf_id = page->get_page_id();
-    buffer_pool_manager_->unpin_page(leaf_id, false);
-    
-    return Iterator(buffer_pool_manager_, leaf_id, index);
+    auto *leaf = reinterpret_cast<LeafPage *>(page->get_data());
+    int index = leaf->key_index(key, comparator_);
+    return Iterator(buffer_pool_manager_, page, index);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 bool BPlusTree<KeyType, ValueType, KeyComparator>::insert(const KeyType &key, const ValueType &value) {
-    std::lock_guard<std::mutex> lock(latch_);
-    if (is_empty()) {
-        start_new_tree(key, value);
-        return true;
+    if (!LeafPage::fits(key, value)) {
+        return false;
     }
-    
-    return insert_into_leaf(key, value);
+
+    // Optimistic pass: only the leaf is write-latched
+    Page *page = find_leaf_write(key);
+    if (page != nullptr) {
+        auto *leaf = reinterpret_cast<LeafPage *>(page->get_data());
+        ValueType existing;
+        bool duplicate = leaf->lookup(key, existing, comparator_);
+        bool inserted = !duplicate && leaf->has_room(key, value) && leaf->insert(key, value, comparator_);
+        page->w_unlatch();
+        buffer_pool_manager_->unpin_page(page->get_page_id(), inserted);
+        if (duplicate) return false;
+        if (inserted) return true;
+    }
+
+    // The leaf has to split (or the tree is empty)
+    return insert_pessimistic(key, value, false);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
@@ -158,34 +222,50 @@ void BPlusTree<KeyType, ValueType, KeyComparator>::start_new_tree(const KeyType
     page_id_t page_id;
     Page *page = buffer_pool_manager_->new_page(&page_id);
     root_page_id_ = page_id;
-    auto *root = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(page->get_data());
+    auto *root = reinterpret_cast<LeafPage *>(page->get_data());
     root->init(root_page_id_, INVALID_PAGE_ID, leaf_max_size_);
     root->insert(key, value, comparator_);
     buffer_pool_manager_->unpin_page(page_id, true);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-bool BPlusTree<KeyType, ValueType, KeyComparator>::insert_into_leaf(const KeyType &key, const ValueType &value) {
-    Page *page = buffer_pool_manager_->fetch_page(root_page_id_);
-    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->get_data());
-    
-    while (!node->is_leaf_page()) {
-        auto *internal = static_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(node);
-        page_id_t next_page_id = internal->lookup(key, comparator_);
-        
-        buffer_pool_manager_->unpin_page(page->get_page_id(), false);
-        page = buffer_pool_manager_->fetch_page(next_page_id);
-        node = reinterpret_cast<BPlusTreePage *>(page->get_data());
+bool BPlusTree<KeyType, ValueType, KeyComparator>::insert_pessimistic(const KeyType &key, const ValueType &value, bool replace) {
+    WriteSet ws;
+    if (!find_leaf_pessimistic(key, value, Operation::INSERT, ws)) {
+        bool created = false;
+        if (ws.root_latched && root_page_id_ == INVALID_PAGE_ID && !replace) {
+            start_new_tree(key, value);
+            created = true;
+        }
+        release_ancestors(ws, 0, false);
+        return created;
     }
-    
-    auto *leaf = static_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(node);
-    
-    if (leaf->get_size() < leaf->get_max_size()) {
+
+    auto *leaf = reinterpret_cast<LeafPage *>(ws.pages.back()->get_data());
+    ValueType existing;
+    if (leaf->lookup(key, existing, comparator_) != replace) {
+        release_ancestors(ws, 0, false);
+        return false;
+    }
+    if (replace && !leaf->update(key, value, comparator_)) {
+        // The larger value does not fit in this leaf: re-insert it, splitting the leaf
+        leaf->remove(key, comparator_);
+        insert_into_leaf(leaf, key, value);
+    } else if (!replace) {
+        insert_into_leaf(leaf, key, value);
+    }
+    release_ancestors(ws, 0, true);
+    return true;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void BPlusTree<KeyType, ValueType, KeyComparator>::insert_into_leaf(LeafPage *leaf, const KeyType &key, const ValueType &value) {
+    if (leaf->has_room(key, value)) {
         leaf->insert(key, value, comparator_);
-        buffer_pool_manager_->unpin_page(page->get_page_id(), true);
-        return true;
+        return;
     }
     
+    // The new leaf is reachable only through pages latched by this thread until they are released
     auto *new_leaf = split_leaf(leaf);
     
     if (comparator_(key, new_leaf->key_at(0)) < 0) {
@@ -196,9 +276,7 @@ bool BPlusTree<KeyType, ValueType, KeyComparator>::insert_into_leaf(const KeyTyp
     
     insert_into_parent(leaf, new_leaf->key_at(0), new_leaf);
     
-    buffer_pool_manager_->unpin_page(leaf->get_page_id(), true);
     buffer_pool_manager_->unpin_page(new_leaf->get_page_id(), true);
-    return true;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
@@ -253,7 +331,7 @@ void BPlusTree<KeyType, ValueType, KeyComparator>::insert_into_parent(BPlusTreeP
     Page *parent_page = buffer_pool_manager_->fetch_page(parent_id);
     auto *parent = reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(parent_page->get_data());
     
-    if (parent->get_size() < parent->get_max_size()) {
+    if (parent->has_room(key)) {
         parent->insert_node_after(old_node->get_page_id(), key, new_node->get_page_id());
         buffer_pool_manager_->unpin_page(parent_id, true);
         return;
@@ -284,8 +362,239 @@ void BPlusTree<KeyType, ValueType, KeyComparator>::insert_into_parent(BPlusTreeP
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-void BPlusTree<KeyType, ValueType, KeyComparator>::remove(const KeyType &key) {
-    (void)key;
+bool BPlusTree<KeyType, ValueType, KeyComparator>::update(const KeyType &key, const ValueType &value) {
+    if (!LeafPage::fits(key, value)) {
+        return false;
+    }
+    Page *page = find_leaf_write(key);
+    if (page == nullptr) return false;
+
+    auto *leaf = reinterpret_cast<LeafPage *>(page->get_data());
+    ValueType existing;
+    bool found = leaf->lookup(key, existing, comparator_);
+    bool updated = found && leaf->update(key, value, comparator_);
+    page->w_unlatch();
+    buffer_pool_manager_->unpin_page(page->get_page_id(), updated);
+    if (!found) return false;
+    if (updated) return true;
+
+    // The larger value needs a split: retry with the path latched
+    return insert_pessimistic(key, value, true);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool BPlusTree<KeyType, ValueType, KeyComparator>::remove(const KeyType &key) {
+    // Optimistic pass: a leaf with a spare record cannot underflow, so only it is write-latched
+    Page *page = find_leaf_write(key);
+    if (page == nullptr) return false;
+
+    auto *leaf = reinterpret_cast<LeafPage *>(page->get_data());
+    ValueType existing;
+    bool found = leaf->lookup(key, existing, comparator_);
+    bool safe = leaf->has_spare_record();
+    bool removed = found && safe && leaf->remove(key, comparator_);
+    page->w_unlatch();
+    buffer_pool_manager_->unpin_page(page->get_page_id(), removed);
+    if (!found) return false;
+    if (removed) return true;
+
+    // The leaf may underflow: retry with the path latched
+    return remove_pessimistic(key);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool BPlusTree<KeyType, ValueType, KeyComparator>::remove_pessimistic(const KeyType &key) {
+    WriteSet ws;
+    if (!find_leaf_pessimistic(key, ValueType(), Operation::REMOVE, ws)) {
+        release_ancestors(ws, 0, false);
+        return false;
+    }
+
+    auto *leaf = reinterpret_cast<LeafPage *>(ws.pages.back()->get_data());
+    if (!leaf->remove(key, comparator_)) {
+        release_ancestors(ws, 0, false);
+        return false;
+    }
+
+    std::vector<page_id_t> deleted;
+    rebalance(ws, deleted);
+    release_ancestors(ws, 0, true);
+    for (page_id_t page_id : deleted) {
+        delete_unlinked_page(page_id);
+    }
+    return true;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void BPlusTree<KeyType, ValueType, KeyComparator>::rebalance(WriteSet &ws, std::vector<page_id_t> &deleted) {
+    for (size_t i = ws.pages.size(); i-- > 0;) {
+        auto *node = reinterpret_cast<BPlusTreeSlottedPage *>(ws.pages[i]->get_data());
+        if (node->is_root_page()) {
+            adjust_root(ws, i, deleted);
+            return;
+        }
+        if (!node->is_underflow()) return;
+
+        // A page that may underflow was not safe, so its parent is still latched
+        auto *parent = reinterpret_cast<InternalPage *>(ws.pages[i - 1]->get_data());
+        if (!coalesce_or_redistribute(ws, i, parent, deleted)) return;
+    }
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool BPlusTree<KeyType, ValueType, KeyComparator>::coalesce_or_redistribute(WriteSet &ws, size_t index, InternalPage *parent,
+                                                                        std::vector<page_id_t> &deleted) {
+    Page *page = ws.pages[index];
+    int node_index = parent->value_index(page->get_page_id());
+    bool node_is_left = node_index + 1 < parent->get_size();
+    if (!node_is_left && node_index == 0) return false; // No sibling
+
+    Page *sibling_page;
+    if (node_is_left) {
+        sibling_page = buffer_pool_manager_->fetch_page(parent->value_at(node_index + 1));
+        if (sibling_page == nullptr) return false;
+        sibling_page->w_latch();
+    } else {
+        // Pages of a level are latched left to right, so the node is latched again after its
+        // left sibling. Other writers cannot reach it meanwhile: the parent is still latched.
+        page->w_unlatch();
+        sibling_page = buffer_pool_manager_->fetch_page(parent->value_at(node_index - 1));
+        if (sibling_page != nullptr) {
+            sibling_page->w_latch();
+        }
+        page->w_latch();
+        if (sibling_page == nullptr) return false;
+    }
+
+    Page *left_page = node_is_left ? page : sibling_page;
+    Page *right_page = node_is_left ? sibling_page : page;
+    int right_index = node_is_left ? node_index + 1 : node_index;
+    bool merged;
+    if (reinterpret_cast<BPlusTreePage *>(page->get_data())->is_leaf_page()) {
+        merged = coalesce_or_redistribute_leaves(reinterpret_cast<LeafPage *>(left_page->get_data()),
+                                                 reinterpret_cast<LeafPage *>(right_page->get_data()),
+                                                 parent, right_index, node_is_left);
+    } else {
+        merged = coalesce_or_redistribute_internals(reinterpret_cast<InternalPage *>(left_page->get_data()),
+                                                    reinterpret_cast<InternalPage *>(right_page->get_data()),
+                                                    parent, right_index, node_is_left);
+    }
+
+    if (merged) {
+        // The right page is empty and no longer linked from its parent or the leaf chain
+        page_id_t right_id = right_page->get_page_id();
+        right_page->w_unlatch();
+        buffer_pool_manager_->unpin_page(right_id, false);
+        deleted.push_back(right_id);
+        if (right_page == page) {
+            ws.pages[index] = nullptr;
+            left_page->w_unlatch();
+            buffer_pool_manager_->unpin_page(left_page->get_page_id(), true);
+        }
+    } else {
+        sibling_page->w_unlatch();
+        buffer_pool_manager_->unpin_page(sibling_page->get_page_id(), true);
+    }
+    return merged;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool BPlusTree<KeyType, ValueType, KeyComparator>::coalesce_or_redistribute_leaves(LeafPage *left, LeafPage *right, InternalPage *parent,
+                                                                               int right_index, bool node_is_left) {
+    if (left->can_absorb(*right, 0)) {
+        right->move_all_to(left);
+        parent->remove_at(right_index);
+        return true;
+    }
+
+    // Borrow records until the node is no longer underfull. A separator that does not fit
+    // in the parent ends the borrowing; the node then stays underfull until a later removal.
+    if (node_is_left) {
+        while (left->is_underflow() && right->has_spare_record()) {
+            if (!right->move_first_to_end_of(left)) break;
+            if (!parent->set_key_at(right_index, right->key_at(0))) {
+                left->move_last_to_front_of(right);
+                break;
+            }
+        }
+    } else {
+        while (right->is_underflow() && left->has_spare_record()) {
+            if (!left->move_last_to_front_of(right)) break;
+            if (!parent->set_key_at(right_index, right->key_at(0))) {
+                right->move_first_to_end_of(left);
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+bool BPlusTree<KeyType, ValueType, KeyComparator>::coalesce_or_redistribute_internals(InternalPage *left, InternalPage *right, InternalPage *parent,
+                                                                                  int right_index, bool node_is_left) {
+    // The separator in the parent moves down as the key of the right page's first child
+    KeyType middle_key = parent->key_at(right_index);
+    if (left->can_absorb(*right, BPlusTreeCodec<KeyType>::size(middle_key)) &&
+        right->move_all_to(left, middle_key, buffer_pool_manager_)) {
+        parent->remove_at(right_index);
+        return true;
+    }
+
+    KeyType new_middle_key;
+    if (node_is_left) {
+        while (left->is_underflow() && right->has_spare_record()) {
+            if (!parent->set_key_at(right_index, right->key_at(1))) break;
+            if (!right->move_first_to_end_of(left, middle_key, new_middle_key, buffer_pool_manager_)) {
+                parent->set_key_at(right_index, middle_key);
+                break;
+            }
+            middle_key = new_middle_key;
+        }
+    } else {
+        while (right->is_underflow() && left->has_spare_record()) {
+            if (!parent->set_key_at(right_index, left->key_at(left->get_size() - 1))) break;
+            if (!left->move_last_to_front_of(right, middle_key, new_middle_key, buffer_pool_manager_)) {
+                parent->set_key_at(right_index, middle_key);
+                break;
+            }
+            middle_key = new_middle_key;
+        }
+    }
+    return false;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void BPlusTree<KeyType, ValueType, KeyComparator>::adjust_root(WriteSet &ws, size_t index, std::vector<page_id_t> &deleted) {
+    // The root can only shrink when it was unsafe, so root_latch_ is still held
+    Page *page = ws.pages[index];
+    auto *root = reinterpret_cast<BPlusTreePage *>(page->get_data());
+    if (root->is_leaf_page()) {
+        if (root->get_size() > 0) return;
+        root_page_id_ = INVALID_PAGE_ID;
+    } else {
+        if (root->get_size() > 1) return;
+        page_id_t child_id = reinterpret_cast<InternalPage *>(root)->value_at(0);
+        Page *child_page = buffer_pool_manager_->fetch_page(child_id);
+        if (child_page == nullptr) return;
+        reinterpret_cast<BPlusTreePage *>(child_page->get_data())->set_parent_page_id(INVALID_PAGE_ID);
+        buffer_pool_manager_->unpin_page(child_id, true);
+        root_page_id_ = child_id;
+    }
+
+    page_id_t root_id = page->get_page_id();
+    page->w_unlatch();
+    buffer_pool_manager_->unpin_page(root_id, false);
+    ws.pages[index] = nullptr;
+    deleted.push_back(root_id);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void BPlusTree<KeyType, ValueType, KeyComparator>::delete_unlinked_page(page_id_t page_id) {
+    // Threads that fetched the page before it was unlinked hold their pin only until they
+    // release its latch, and no thread can fetch it again
+    while (!buffer_pool_manager_->delete_page(page_id)) {
+        std::this_thread::yield();
+    }
 }
 
 } // namespace kvengine
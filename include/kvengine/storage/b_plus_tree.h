@@ -3,6 +3,7 @@
 #include "kvengine/storage/buffer_pool_manager.h"
 #include "kvengine/storage/b_plus_tree_leaf_page.h"
 #include "kvengine/storage/b_plus_tree_internal_page.h"
+#include "kvengine/storage/rw_latch.h"
 #include <string>
 #include <vector>
 
@@ -15,38 +16,26 @@ class BPlusTree;
 /**
  * BPlusTreeIterator
  * Supports forward traversal of the B+ Tree leaf pages.
+ * The iterator holds a read latch on its current leaf, so writers to that leaf wait
+ * until it moves on or is destroyed. Leaves are latched left to right only.
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class BPlusTreeIterator {
 public:
-    BPlusTreeIterator(BufferPoolManager *bpm, page_id_t page_id, int index = 0) 
-        : buffer_pool_manager_(bpm), page_id_(page_id), index_(index), leaf_(nullptr) {
-        if (page_id_ != INVALID_PAGE_ID) {
-            Page *page = buffer_pool_manager_->fetch_page(page_id_);
-            if (page != nullptr) {
-                leaf_ = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(page->get_data());
-                // If index is at or past end, move to next page
-                if (index_ >= leaf_->get_size()) {
-                    page_id_t next_id = leaf_->get_next_page_id();
-                    buffer_pool_manager_->unpin_page(page_id_, false);
-                    page_id_ = next_id;
-                    index_ = 0;
-                    leaf_ = nullptr;
-                    if (page_id_ != INVALID_PAGE_ID) {
-                        page = buffer_pool_manager_->fetch_page(page_id_);
-                        if (page != nullptr) {
-                            leaf_ = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(page->get_data());
-                        }
-                    }
-                }
-            } else {
-                page_id_ = INVALID_PAGE_ID;
-            }
+    // page must be pinned and read-latched; the iterator takes over both (nullptr is the end)
+    BPlusTreeIterator(BufferPoolManager *bpm, Page *page, int index = 0)
+        : buffer_pool_manager_(bpm), page_(page), page_id_(INVALID_PAGE_ID), index_(index), leaf_(nullptr) {
+        if (page_ != nullptr) {
+            page_id_ = page_->get_page_id();
+            leaf_ = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(page_->get_data());
+            // If index is at or past end, move to next page
+            skip_exhausted_leaves();
         }
     }
 
     ~BPlusTreeIterator() {
-        if (leaf_ != nullptr) {
+        if (page_ != nullptr) {
+            page_->r_unlatch();
             buffer_pool_manager_->unpin_page(page_id_, false);
         }
     }
@@ -59,9 +48,11 @@ public:
     // Allow move
     BPlusTreeIterator(BPlusTreeIterator&& other) noexcept 
         : buffer_pool_manager_(other.buffer_pool_manager_), 
+          page_(other.page_),
           page_id_(other.page_id_), 
           index_(other.index_), 
           leaf_(other.leaf_) {
+        other.page_ = nullptr;
         other.leaf_ = nullptr;
         other.page_id_ = INVALID_PAGE_ID;
     }
@@ -82,64 +73,115 @@ public:
         if (is_end()) return *this;
         
         index_++;
-        if (index_ >= leaf_->get_size()) {
+        skip_exhausted_leaves();
+        return *this;
+    }
+
+    // Follow the leaf chain until index_ is inside a leaf (leaves emptied by removals are skipped).
+    // The next leaf is latched before the current one is released.
+    void skip_exhausted_leaves() {
+        while (leaf_ != nullptr && index_ >= leaf_->get_size()) {
             page_id_t next_id = leaf_->get_next_page_id();
-            
-            // Unpin current
+            Page *next = nullptr;
+            if (next_id != INVALID_PAGE_ID) {
+                next = buffer_pool_manager_->fetch_page(next_id);
+                if (next != nullptr) {
+                    next->r_latch();
+                }
+            }
+
+            // Release current
+            page_->r_unlatch();
             buffer_pool_manager_->unpin_page(page_id_, false);
-            leaf_ = nullptr;
-            
-            page_id_ = next_id;
+
+            page_ = next;
             index_ = 0;
-            
-            if (page_id_ != INVALID_PAGE_ID) {
-                Page *page = buffer_pool_manager_->fetch_page(page_id_);
-                if (page != nullptr) {
-                    leaf_ = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(page->get_data());
-                } else {
-                    page_id_ = INVALID_PAGE_ID;
-                }
+            if (page_ != nullptr) {
+                page_id_ = next_id;
+                leaf_ = reinterpret_cast<BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *>(page_->get_data());
+            } else {
+                page_id_ = INVALID_PAGE_ID;
+                leaf_ = nullptr;
             }
         }
-        return *this;
     }
 
     BufferPoolManager *buffer_pool_manager_;
+    Page *page_;
     page_id_t page_id_;
     int index_;
     BPlusTreeLeafPage<KeyType, ValueType, KeyComparator> *leaf_;
 };
 
-// Index Tree
+/**
+ * Index Tree
+ *
+ * Concurrency uses latch crabbing on the page latches instead of a tree-wide lock:
+ * - root_latch_ guards root_page_id_ and is taken before the root page.
+ * - Lookups and iterators read-latch a child and then release its parent, so they
+ *   only ever hold one or two pages and run in parallel.
+ * - Writers first descend optimistically with read latches and write-latch only the
+ *   leaf. If the leaf would split, they restart and write-latch the path top-down,
+ *   releasing every ancestor (and root_latch_) as soon as a child is safe, i.e. cannot
+ *   split. A split therefore blocks only the subtree above the first safe page.
+ * - Latches are taken top-down, and left to right within a level, so there are no cycles.
+ * Parent page ids are only read or changed by a writer holding the parent's write latch.
+ */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class BPlusTree {
 public:
     using Iterator = BPlusTreeIterator<KeyType, ValueType, KeyComparator>;
 
+    // A max size of 0 limits pages only by their bytes; a positive max size also caps the entry count
     explicit BPlusTree(std::string index_name, BufferPoolManager *bm, KeyComparator comparator,
                        int leaf_max_size = 0, int internal_max_size = 0);
 
     // Returns true if this B+ tree has no keys and values.
     bool is_empty() const;
 
-    // Insert a key-value pair into this B+ tree.
+    // Root page, persisted by the owner to reopen the tree
+    page_id_t get_root_page_id();
+    void set_root_page_id(page_id_t root_page_id);
+
+    // Insert a key-value pair into this B+ tree; returns false if the key exists or the
+    // record is larger than BPlusTreeSlottedPage::max_record_size().
     bool insert(const KeyType &key, const ValueType &value);
 
-    // Remove a key and its value from this B+ tree.
-    void remove(const KeyType &key);
+    // Replace the value of an existing key; returns false if the key does not exist or
+    // the new value does not fit in the leaf.
+    bool update(const KeyType &key, const ValueType &value);
+
+    // Remove a key and its value from this B+ tree; returns false if the key does not exist.
+    // An underfull page borrows from or merges with a sibling, the root shrinks when it is
+    // left with a single child, and emptied pages are returned to the page manager.
+    bool remove(const KeyType &key);
 
     // Return the value associated with a given key
     bool get_value(const KeyType &key, std::vector<ValueType> &result);
 
-    // Iterator access
+    // Iterator access; an iterator must not outlive the tree or be held while the same
+    // thread modifies the tree
     Iterator begin();
     Iterator begin(const KeyType &key);
 
 private:
+    using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
+    using InternalPage = BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator>;
+
+    enum class Operation { INSERT, REMOVE };
+
+    // Pages write-latched by a pessimistic descent, root first; root_latched is true
+    // while root_latch_ is still held
+    struct WriteSet {
+        std::vector<Page *> pages;
+        bool root_latched = false;
+    };
+
     void start_new_tree(const KeyType &key, const ValueType &value);
     
     // Split operations
-    bool  insert_into_leaf(const KeyType &key, const ValueType &value);
+    bool  insert_pessimistic(const KeyType &key, const ValueType &value, bool replace);
+    void  insert_into_leaf(LeafPage *leaf, const KeyType &key, const ValueType &value);
     void  insert_into_parent(BPlusTreePage *old_node, const KeyType &key, BPlusTreePage *new_node);
 
     // Helpers
@@ -147,8 +189,39 @@ private:
     
     BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *split_internal(BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *node);
 
-    // Find leaf for a key
-    Page *find_leaf_page(const KeyType &key, bool left_most = false);
+    // Descend with read latches; returns the leaf pinned and read-latched, or nullptr if empty
+    Page *find_leaf_read(const KeyType &key, bool left_most = false);
+
+    // Descend with read latches on internal pages; returns the leaf pinned and write-latched
+    Page *find_leaf_write(const KeyType &key);
+
+    // Descend write-latching the path; ancestors of a page that op cannot make split (or
+    // underflow) are released on the way. Leaves ws.pages.back() as the leaf; returns false
+    // (holding root_latch_) if the tree is empty.
+    bool find_leaf_pessimistic(const KeyType &key, const ValueType &value, Operation op, WriteSet &ws);
+
+    // Unlatch and unpin the pages of ws (all but the last keep_last of them) and root_latch_
+    void release_ancestors(WriteSet &ws, size_t keep_last, bool is_dirty);
+
+    // Delete operations
+    bool remove_pessimistic(const KeyType &key);
+
+    // Fix underflow from the leaf of ws upwards; pages emptied by merges are added to deleted
+    void rebalance(WriteSet &ws, std::vector<page_id_t> &deleted);
+
+    // Merge ws.pages[index] with a sibling, or borrow from it; returns true if the parent lost an entry
+    bool coalesce_or_redistribute(WriteSet &ws, size_t index, InternalPage *parent, std::vector<page_id_t> &deleted);
+
+    bool coalesce_or_redistribute_leaves(LeafPage *left, LeafPage *right, InternalPage *parent,
+                                         int right_index, bool node_is_left);
+    bool coalesce_or_redistribute_internals(InternalPage *left, InternalPage *right, InternalPage *parent,
+                                            int right_index, bool node_is_left);
+
+    // Drop an empty root leaf, or replace a root with a single child by that child
+    void adjust_root(WriteSet &ws, size_t index, std::vector<page_id_t> &deleted);
+
+    // Return an unlinked page to the page manager once other threads have unpinned it
+    void delete_unlinked_page(page_id_t page_id);
 
     std::string index_name_;
     page_id_t root_page_id_;
@@ -156,7 +229,7 @@ private:
     KeyComparator comparator_;
     int leaf_max_size_;
     int internal_max_size_;
-    std::mutex latch_; // Tree latch
+    mutable ReaderWriterLatch root_latch_; // Guards root_page_id_
 };
 
 } // namespace kvengine
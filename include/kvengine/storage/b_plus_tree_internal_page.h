@@ -1,104 +1,187 @@
 #pragma once
 
-#include "kvengine/storage/b_plus_tree_page.h"
+#include "kvengine/storage/b_plus_tree_slotted_page.h"
+#include "kvengine/storage/buffer_pool_manager.h"
 #include <cstring>
 #include <algorithm>
+#include <string>
 
 namespace kvengine {
 
 #define B_PLUS_TREE_INTERNAL_PAGE_TYPE BPlusTreeInternalPage<KeyType, ValueType, KeyComparator>
 
+/**
+ * BPlusTreeInternalPage stores (separator key, child page id) records in the slotted
+ * layout. The key of record 0 is not used for lookups.
+ */
 template <typename KeyType, typename ValueType, typename KeyComparator>
-class BPlusTreeInternalPage : public BPlusTreePage {
+class BPlusTreeInternalPage : public BPlusTreeSlottedPage {
 public:
+    using KeyCodec = BPlusTreeCodec<KeyType>;
+    using ValueCodec = BPlusTreeCodec<ValueType>;
+
     void init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = 0) {
         set_page_type(IndexPageType::INTERNAL_PAGE);
         set_size(0);
         set_max_size(max_size);
         set_parent_page_id(parent_id);
         set_page_id(page_id);
+        init_slots();
     }
-    
+
     KeyType key_at(int index) const {
-        return array_[index].first;
+        return KeyCodec::decode(key_data(index), key_size(index));
     }
-    
-    void set_key_at(int index, const KeyType &key) {
-        array_[index].first = key;
+
+    // Replace the key at index; false if the longer key does not fit
+    bool set_key_at(int index, const KeyType &key) {
+        std::string record;
+        encode(key, value_at(index), record);
+        return replace_slot(index, record.data(), KeyCodec::size(key),
+                            record.data() + KeyCodec::size(key), value_size(index));
     }
-    
+
     ValueType value_at(int index) const {
-        return array_[index].second;
+        return ValueCodec::decode(value_data(index), value_size(index));
     }
-    
+
     void set_value_at(int index, const ValueType &value) {
-        array_[index].second = value;
+        std::string record;
+        encode(key_at(index), value, record);
+        replace_slot(index, record.data(), key_size(index), record.data() + key_size(index), ValueCodec::size(value));
+    }
+
+    // Index of the record pointing to value, or get_size() if there is none
+    int value_index(const ValueType &value) const {
+        for (int i = 0; i < get_size(); ++i) {
+            if (value_at(i) == value) return i;
+        }
+        return get_size();
     }
-    
+
+    // Whether a separator key can be added without a split
+    bool has_room(const KeyType &key) const {
+        return has_room_for(KeyCodec::size(key), sizeof(ValueType));
+    }
+
+    // Whether any separator pushed up by a child split fits without a split
+    bool has_room_for_any_key() const {
+        return has_room_for(max_record_size(), sizeof(ValueType));
+    }
+
     ValueType lookup(const KeyType &key, const KeyComparator &comparator) const {
         int l = 1, r = get_size() - 1;
         int target = 0; // Default to index 0
         while (l <= r) {
             int mid = l + (r - l) / 2;
-            if (comparator(array_[mid].first, key) <= 0) { // key >= array[mid].first
+            if (comparator(key_at(mid), key) <= 0) { // key >= array[mid].first
                 target = mid;
                 l = mid + 1;
             } else {
                 r = mid - 1;
             }
         }
-        return array_[target].second;
+        return value_at(target);
     }
 
     void populate_new_root(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value) {
-        array_[0].second = old_value;
-        array_[1].first = new_key;
-        array_[1].second = new_value;
-        set_size(2);
-    }
-    
-    int insert_node_after(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value) {
-        // Find index of old_value
-        int idx = 0;
-        for (; idx < get_size(); ++idx) {
-            if (value_at(idx) == old_value) break;
+        insert_record(0, KeyType(), old_value);
+        insert_record(1, new_key, new_value);
+    }
+
+    // Insert (new_key, new_value) right after the record pointing to old_value; false if it does not fit
+    bool insert_node_after(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value) {
+        int idx = value_index(old_value);
+        return insert_record(idx + 1, new_key, new_value);
+    }
+
+    // Move the upper half (by bytes) to recipient; its first key is the separator to push up
+    void move_half_to(BPlusTreeInternalPage *recipient, BufferPoolManager *buffer_pool_manager) {
+        int start_idx = split_index();
+        int first = recipient->get_size();
+        move_slots_to(start_idx, recipient);
+        recipient->adopt_children(first, buffer_pool_manager);
+    }
+
+    // Remove the record at index
+    void remove_at(int index) {
+        remove_slot(index);
+    }
+
+    // Merge Helpers: append every record to recipient, the left sibling. middle_key is the
+    // separator of this page in the parent and becomes the key of the first moved record.
+    bool move_all_to(BPlusTreeInternalPage *recipient, const KeyType &middle_key, BufferPoolManager *buffer_pool_manager) {
+        int first = recipient->get_size();
+        if (!recipient->insert_record(first, middle_key, value_at(0))) return false;
+        move_slots_to(1, recipient);
+        remove_slot(0);
+        recipient->adopt_children(first, buffer_pool_manager);
+        return true;
+    }
+
+    // Redistribute Helpers: move the first child to the end of recipient, the left sibling,
+    // under middle_key (the separator of this page). new_middle receives the separator to
+    // install in the parent; false if recipient has no room.
+    bool move_first_to_end_of(BPlusTreeInternalPage *recipient, const KeyType &middle_key, KeyType &new_middle,
+                              BufferPoolManager *buffer_pool_manager) {
+        int index = recipient->get_size();
+        if (!recipient->insert_record(index, middle_key, value_at(0))) return false;
+        recipient->adopt_child(index, buffer_pool_manager);
+        new_middle = key_at(1);
+        remove_slot(0);
+        set_key_at(0, KeyType());
+        return true;
+    }
+
+    // Move the last child to the front of recipient, the right sibling, whose separator is
+    // middle_key. new_middle receives the separator to install in the parent; false if
+    // recipient has no room.
+    bool move_last_to_front_of(BPlusTreeInternalPage *recipient, const KeyType &middle_key, KeyType &new_middle,
+                               BufferPoolManager *buffer_pool_manager) {
+        int last = get_size() - 1;
+        if (!recipient->set_key_at(0, middle_key)) return false;
+        if (!recipient->insert_record(0, KeyType(), value_at(last))) {
+            recipient->set_key_at(0, KeyType());
+            return false;
         }
-        
-        // Shift right
-        for (int i = get_size(); i > idx + 1; --i) {
-            array_[i] = array_[i - 1];
+        recipient->adopt_child(0, buffer_pool_manager);
+        new_middle = key_at(last);
+        remove_slot(last);
+        return true;
+    }
+
+protected:
+    bool insert_record(int index, const KeyType &key, const ValueType &value) {
+        std::string record;
+        encode(key, value, record);
+        return insert_slot(index, record.data(), KeyCodec::size(key),
+                           record.data() + KeyCodec::size(key), ValueCodec::size(value));
+    }
+
+    // Update parent pointers of the children from index first onwards
+    void adopt_children(int first, BufferPoolManager *buffer_pool_manager) {
+        for (int i = first; i < get_size(); ++i) {
+            adopt_child(i, buffer_pool_manager);
         }
-        
-        array_[idx + 1] = {new_key, new_value};
-        increase_size(1);
-        return get_size();
     }
-    
-    // Move half to recipient
-    void move_half_to(BPlusTreeInternalPage *recipient, BufferPoolManager *buffer_pool_manager) {
-        int start_idx = get_min_size(); // Usually split at mid
-        int move_count = get_size() - start_idx;
-        recipient->copy_n_from(array_ + start_idx, move_count, buffer_pool_manager);
-        set_size(start_idx);
-    }
-    
-    void copy_n_from(std::pair<KeyType, ValueType> *items, int size, BufferPoolManager *buffer_pool_manager) {
-        // Update parent pointers of children being moved!
-        for (int i = 0; i < size; ++i) {
-             array_[i] = items[i];
-             // The child pages now belong to this new internal page
-             Page *child_raw = buffer_pool_manager->fetch_page(items[i].second);
-             if (child_raw != nullptr) {
-                 auto *child = reinterpret_cast<BPlusTreePage *>(child_raw->get_data());
-                 child->set_parent_page_id(get_page_id());
-                 buffer_pool_manager->unpin_page(child->get_page_id(), true);
-             }
+
+    // The child page at index now belongs to this internal page
+    void adopt_child(int index, BufferPoolManager *buffer_pool_manager) {
+        Page *child_raw = buffer_pool_manager->fetch_page(value_at(index));
+        if (child_raw != nullptr) {
+            auto *child = reinterpret_cast<BPlusTreePage *>(child_raw->get_data());
+            child->set_parent_page_id(get_page_id());
+            buffer_pool_manager->unpin_page(child->get_page_id(), true);
         }
-        set_size(size);
     }
 
 private:
-    std::pair<KeyType, ValueType> array_[1]; 
+    static void encode(const KeyType &key, const ValueType &value, std::string &record) {
+        size_t key_size = KeyCodec::size(key);
+        record.resize(key_size + ValueCodec::size(value));
+        KeyCodec::encode(key, &record[0]);
+        ValueCodec::encode(value, &record[0] + key_size);
+    }
 };
 
 } // namespace kvengine
@@ -1,95 +1,148 @@
 #pragma once
 
-#include "kvengine/storage/b_plus_tree_page.h"
+#include "kvengine/storage/b_plus_tree_slotted_page.h"
+#include <string>
 
 namespace kvengine {
 
 #define B_PLUS_TREE_LEAF_PAGE_TYPE BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>
 
+/**
+ * BPlusTreeLeafPage stores sorted key/value records in the slotted layout, so keys and
+ * values may be of any length supported by BPlusTreeCodec.
+ */
 template <typename KeyType, typename ValueType, typename KeyComparator>
-class BPlusTreeLeafPage : public BPlusTreePage {
+class BPlusTreeLeafPage : public BPlusTreeSlottedPage {
 public:
+    using KeyCodec = BPlusTreeCodec<KeyType>;
+    using ValueCodec = BPlusTreeCodec<ValueType>;
+
     void init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = 0) {
         set_page_type(IndexPageType::LEAF_PAGE);
         set_size(0);
         set_max_size(max_size);
         set_parent_page_id(parent_id);
         set_page_id(page_id);
-        next_page_id_ = INVALID_PAGE_ID;
+        init_slots();
     }
 
-    page_id_t get_next_page_id() const { return next_page_id_; }
-    void set_next_page_id(page_id_t next_page_id) { next_page_id_ = next_page_id; }
+    // Whether a record is small enough to be stored in a leaf at all
+    static bool fits(const KeyType &key, const ValueType &value) {
+        return KeyCodec::size(key) + ValueCodec::size(value) + sizeof(Slot) <= max_record_size();
+    }
 
     KeyType key_at(int index) const {
-        return array_[index].first;
+        return KeyCodec::decode(key_data(index), key_size(index));
     }
-    
+
     ValueType value_at(int index) const {
-        return array_[index].second;
+        return ValueCodec::decode(value_data(index), value_size(index));
     }
-    
-    bool insert(const KeyType &key, const ValueType &value, const KeyComparator &comparator) {
-        // Find insertion point
+
+    // Whether the record can be inserted without a split
+    bool has_room(const KeyType &key, const ValueType &value) const {
+        return has_room_for(KeyCodec::size(key), ValueCodec::size(value));
+    }
+
+    // Index of the first entry whose key is not less than key (may equal get_size())
+    int key_index(const KeyType &key, const KeyComparator &comparator) const {
         int l = 0, r = get_size();
         while (l < r) {
             int mid = l + (r - l) / 2;
-            if (comparator(array_[mid].first, key) < 0) {
+            if (comparator(key_at(mid), key) < 0) {
                 l = mid + 1;
             } else {
                 r = mid;
             }
         }
-        int target = l;
-        
-        if (target < get_size() && comparator(array_[target].first, key) == 0) {
+        return l;
+    }
+
+    // Returns false for a duplicate key or if the record does not fit
+    bool insert(const KeyType &key, const ValueType &value, const KeyComparator &comparator) {
+        // Find insertion point
+        int target = key_index(key, comparator);
+
+        if (target < get_size() && comparator(key_at(target), key) == 0) {
             return false; // Duplicate
         }
-        
-        for (int i = get_size(); i > target; --i) {
-            array_[i] = array_[i - 1];
-        }
-        array_[target] = {key, value};
-        increase_size(1);
-        return true;
+
+        std::string record;
+        encode(key, value, record);
+        return insert_slot(target, record.data(), KeyCodec::size(key),
+                           record.data() + KeyCodec::size(key), ValueCodec::size(value));
     }
-    
+
     bool lookup(const KeyType &key, ValueType &value, const KeyComparator &comparator) const {
-        int l = 0, r = get_size();
-        while (l < r) {
-            int mid = l + (r - l) / 2;
-            if (comparator(array_[mid].first, key) < 0) {
-                l = mid + 1;
-            } else {
-                r = mid;
-            }
-        }
-        if (l < get_size() && comparator(array_[l].first, key) == 0) {
-            value = array_[l].second;
+        int l = key_index(key, comparator);
+        if (l < get_size() && comparator(key_at(l), key) == 0) {
+            value = value_at(l);
             return true;
         }
         return false;
     }
 
-    // Split Helpers
+    // Replace the value of an existing key; false if the key is missing or the new value does not fit
+    bool update(const KeyType &key, const ValueType &value, const KeyComparator &comparator) {
+        int index = key_index(key, comparator);
+        if (index < get_size() && comparator(key_at(index), key) == 0) {
+            std::string record;
+            encode(key, value, record);
+            return replace_slot(index, record.data(), KeyCodec::size(key),
+                                record.data() + KeyCodec::size(key), ValueCodec::size(value));
+        }
+        return false;
+    }
+
+    // Remove a key; the slot directory closes the gap and the record bytes become fragmented space
+    bool remove(const KeyType &key, const KeyComparator &comparator) {
+        int index = key_index(key, comparator);
+        if (index >= get_size() || comparator(key_at(index), key) != 0) {
+            return false;
+        }
+        remove_slot(index);
+        return true;
+    }
+
+    // Split Helpers: move the upper half (by bytes) to recipient
     void move_half_to(BPlusTreeLeafPage *recipient) {
-        int start_idx = get_min_size(); 
-        int move_count = get_size() - start_idx;
-        recipient->copy_n_from(array_ + start_idx, move_count);
-        
-        set_size(start_idx);
+        move_slots_to(split_index(), recipient);
+    }
+
+    // Merge Helpers: append every record to recipient, the left sibling, and unlink this leaf
+    void move_all_to(BPlusTreeLeafPage *recipient) {
+        move_slots_to(0, recipient);
+        recipient->set_next_page_id(get_next_page_id());
+    }
+
+    // Redistribute Helpers: move the first record to the end of recipient, the left sibling;
+    // false if it does not fit
+    bool move_first_to_end_of(BPlusTreeLeafPage *recipient) {
+        if (!recipient->insert_slot(recipient->get_size(), key_data(0), key_size(0), value_data(0), value_size(0))) {
+            return false;
+        }
+        remove_slot(0);
+        return true;
     }
-    
-    void copy_n_from(std::pair<KeyType, ValueType> *items, int size) {
-        for (int i = 0; i < size; ++i) {
-            array_[i] = items[i];
+
+    // Move the last record to the front of recipient, the right sibling; false if it does not fit
+    bool move_last_to_front_of(BPlusTreeLeafPage *recipient) {
+        int last = get_size() - 1;
+        if (!recipient->insert_slot(0, key_data(last), key_size(last), value_data(last), value_size(last))) {
+            return false;
         }
-        set_size(size);
+        remove_slot(last);
+        return true;
     }
 
 private:
-    page_id_t next_page_id_;
-    std::pair<KeyType, ValueType> array_[1];
+    static void encode(const KeyType &key, const ValueType &value, std::string &record) {
+        size_t key_size = KeyCodec::size(key);
+        record.resize(key_size + ValueCodec::size(value));
+        if (record.empty()) return;
+        KeyCodec::encode(key, &record[0]);
+        ValueCodec::encode(value, &record[0] + key_size);
+    }
 };
 
 } // namespace kvengine
@@ -5,23 +5,8 @@
 
 namespace kvengine {
 
-// We need a fixed key type and value type for simplicity first. 
-// For a general KV store, we usually support variable length keys, 
-// but implementing B+Tree with variable length keys inside pages is complex (Slotted Page).
-// Let's start with Fixed Size Keys (e.g., int64_t) and Values (Fixed Size) 
-// OR implement a basic structure that can be extended.
-
-// Let's assume Key = int64_t for now to get the logic right, 
-// creating a B+Tree<int64_t, int64_t>. 
-// Later we can wrap strings into this or use a separate index.
-
-// Wait, the user wants "StorageEngine" replacement. The current engine uses std::string keys.
-// Implementing variable-length B+Tree is hard. 
-// A common simplification is:
-// 1. Key is string, max length 64 bytes?
-// 2. Value is string, stored in separate Heap File if large?
-
-// Let's stick to a generic BPlusTreePage header first.
+// Keys and values are variable-length: leaf and internal pages store them in the
+// slotted layout of BPlusTreeSlottedPage (b_plus_tree_slotted_page.h).
 
 enum class IndexPageType { INVALID_INDEX_PAGE = 0, LEAF_PAGE = 1, INTERNAL_PAGE = 2 };
 
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "kvengine/storage/b_plus_tree_page.h"
+#include <cstring>
+#include <string>
+
+namespace kvengine {
+
+/**
+ * BPlusTreeCodec converts keys and values to the bytes stored in a slotted page.
+ * The default copies trivially copyable types; std::string is stored without padding.
+ */
+template <typename T>
+struct BPlusTreeCodec {
+    static size_t size(const T &) { return sizeof(T); }
+    static void encode(const T &value, char *dst) { memcpy(dst, &value, sizeof(T)); }
+    static T decode(const char *src, size_t size) {
+        T value = T();
+        if (size >= sizeof(T)) {
+            memcpy(&value, src, sizeof(T));
+        }
+        return value;
+    }
+};
+
+template <>
+struct BPlusTreeCodec<std::string> {
+    static size_t size(const std::string &value) { return value.size(); }
+    static void encode(const std::string &value, char *dst) { memcpy(dst, value.data(), value.size()); }
+    static std::string decode(const char *src, size_t size) { return std::string(src, size); }
+};
+
+// Byte-wise ordering of std::string keys
+struct StringComparator {
+    int operator()(const std::string &lhs, const std::string &rhs) const { return lhs.compare(rhs); }
+};
+
+/**
+ * BPlusTreeSlottedPage is the common layout of leaf and internal pages.
+ *
+ * Page Format:
+ * ------------------------------------------------------------------------------
+ * | BPlusTreePage header | FreeEnd (2) | Fragmented (2) | NextPageId (4) |
+ * ------------------------------------------------------------------------------
+ * | Slot 0 | Slot 1 | ... | Slot n-1 | free space | ... record 1 | record 0 |
+ * ------------------------------------------------------------------------------
+ *
+ * Each slot holds the offset and the key/value lengths of one record; records
+ * (key bytes followed by value bytes) are packed from the end of the page towards
+ * the slot directory. Removing or shrinking a record leaves a hole that is counted in
+ * Fragmented and reclaimed by compact() when an insert needs contiguous space.
+ * NextPageId links leaves; internal pages leave it unused.
+ */
+class BPlusTreeSlottedPage : public BPlusTreePage {
+public:
+    struct Slot {
+        uint16_t offset;
+        uint16_t key_size;
+        uint16_t value_size;
+    };
+
+    inline page_id_t get_next_page_id() const { return next_page_id_; }
+    inline void set_next_page_id(page_id_t next_page_id) { next_page_id_ = next_page_id; }
+
+    // Largest record (key + value + slot) accepted, so that any split leaves room for it
+    static size_t max_record_size() {
+        return (PAGE_SIZE - sizeof(BPlusTreeSlottedPage)) / 4;
+    }
+
+    // Bytes in use by the header, the slot directory and live records
+    size_t used_bytes() const {
+        return slots_end() + (PAGE_SIZE - free_end_ - fragmented_);
+    }
+
+    // Bytes an insert may use, including fragmented space
+    size_t free_bytes() const {
+        return free_end_ - slots_end() + fragmented_;
+    }
+
+    // Whether a record with these sizes can be inserted (a max size of 0 means no entry limit)
+    bool has_room_for(size_t key_size, size_t value_size) const {
+        if (get_max_size() > 0 && get_size() >= get_max_size()) return false;
+        return key_size + value_size + sizeof(Slot) <= free_bytes();
+    }
+
+    // Whether the page should be rebalanced with a sibling: its records fill less than a
+    // quarter of the page, or less than half of the max size when the entry count is capped
+    bool is_underflow() const {
+        if (get_max_size() > 0) return get_size() < (get_max_size() + 1) / 2;
+        return record_bytes() < max_record_size();
+    }
+
+    // Whether removing any single record leaves the page without underflow
+    bool has_spare_record() const {
+        if (get_max_size() > 0) return get_size() - 1 >= (get_max_size() + 1) / 2;
+        return record_bytes() >= 2 * max_record_size();
+    }
+
+    // Whether all records of other, with extra_bytes more key bytes, fit into this page
+    bool can_absorb(const BPlusTreeSlottedPage &other, size_t extra_bytes) const {
+        if (get_max_size() > 0 && get_size() + other.get_size() > get_max_size()) return false;
+        return other.record_bytes() + extra_bytes <= free_bytes();
+    }
+
+    // Rewrite the records contiguously at the end of the page
+    void compact() {
+        char buffer[PAGE_SIZE];
+        size_t end = PAGE_SIZE;
+        for (int i = 0; i < get_size(); ++i) {
+            size_t record_size = slots_[i].key_size + slots_[i].value_size;
+            end -= record_size;
+            memcpy(buffer + end, page_bytes() + slots_[i].offset, record_size);
+            slots_[i].offset = static_cast<uint16_t>(end);
+        }
+        memcpy(page_bytes() + end, buffer + end, PAGE_SIZE - end);
+        free_end_ = static_cast<uint16_t>(end);
+        fragmented_ = 0;
+    }
+
+protected:
+    void init_slots() {
+        free_end_ = PAGE_SIZE;
+        fragmented_ = 0;
+        next_page_id_ = INVALID_PAGE_ID;
+    }
+
+    const char *key_data(int index) const { return page_bytes() + slots_[index].offset; }
+    size_t key_size(int index) const { return slots_[index].key_size; }
+    const char *value_data(int index) const { return key_data(index) + slots_[index].key_size; }
+    size_t value_size(int index) const { return slots_[index].value_size; }
+
+    // Insert a record at index, shifting the following slots; false if it does not fit
+    bool insert_slot(int index, const char *key, size_t key_size, const char *value, size_t value_size) {
+        size_t record_size = key_size + value_size;
+        if (record_size + sizeof(Slot) > free_bytes()) return false;
+        if (slots_end() + sizeof(Slot) + record_size > free_end_) {
+            compact();
+        }
+        free_end_ = static_cast<uint16_t>(free_end_ - record_size);
+        memcpy(page_bytes() + free_end_, key, key_size);
+        memcpy(page_bytes() + free_end_ + key_size, value, value_size);
+
+        memmove(slots_ + index + 1, slots_ + index, (get_size() - index) * sizeof(Slot));
+        slots_[index].offset = free_end_;
+        slots_[index].key_size = static_cast<uint16_t>(key_size);
+        slots_[index].value_size = static_cast<uint16_t>(value_size);
+        increase_size(1);
+        return true;
+    }
+
+    // Remove the record at index; its bytes become fragmented space
+    void remove_slot(int index) {
+        size_t record_size = slots_[index].key_size + slots_[index].value_size;
+        if (slots_[index].offset == free_end_) {
+            free_end_ = static_cast<uint16_t>(free_end_ + record_size);
+        } else {
+            fragmented_ = static_cast<uint16_t>(fragmented_ + record_size);
+        }
+        memmove(slots_ + index, slots_ + index + 1, (get_size() - index - 1) * sizeof(Slot));
+        increase_size(-1);
+        if (get_size() == 0) {
+            free_end_ = PAGE_SIZE;
+            fragmented_ = 0;
+        }
+    }
+
+    // Replace the key and value of the record at index; false (record unchanged) if it does not fit
+    bool replace_slot(int index, const char *key, size_t key_size, const char *value, size_t value_size) {
+        size_t old_key_size = slots_[index].key_size;
+        size_t old_value_size = slots_[index].value_size;
+        if (key_size + value_size <= old_key_size + old_value_size) {
+            // Shrinking in place: the tail of the old record becomes fragmented space
+            char *record = page_bytes() + slots_[index].offset;
+            memmove(record, key, key_size);
+            memmove(record + key_size, value, value_size);
+            fragmented_ = static_cast<uint16_t>(fragmented_ + old_key_size + old_value_size - key_size - value_size);
+            slots_[index].key_size = static_cast<uint16_t>(key_size);
+            slots_[index].value_size = static_cast<uint16_t>(value_size);
+            return true;
+        }
+        if (key_size + value_size > free_bytes() + old_key_size + old_value_size) return false;
+
+        // The new record may be placed over the old one by compaction, so copy the inputs first
+        std::string bytes(key, key_size);
+        bytes.append(value, value_size);
+        remove_slot(index);
+        bool inserted = insert_slot(index, bytes.data(), key_size, bytes.data() + key_size, value_size);
+        (void)inserted;
+        return true;
+    }
+
+    // Index at which to split so that both halves hold about the same number of bytes
+    int split_index() const {
+        size_t total = 0;
+        for (int i = 0; i < get_size(); ++i) {
+            total += sizeof(Slot) + slots_[i].key_size + slots_[i].value_size;
+        }
+        size_t left = 0;
+        int index = 0;
+        while (index < get_size() - 1 && left * 2 < total) {
+            left += sizeof(Slot) + slots_[index].key_size + slots_[index].value_size;
+            index++;
+        }
+        return index > 0 ? index : 1;
+    }
+
+    // Append the records from start onwards to recipient and drop them here
+    void move_slots_to(int start, BPlusTreeSlottedPage *recipient) {
+        for (int i = start; i < get_size(); ++i) {
+            recipient->insert_slot(recipient->get_size(), key_data(i), key_size(i), value_data(i), value_size(i));
+        }
+        for (int i = get_size() - 1; i >= start; --i) {
+            remove_slot(i);
+        }
+    }
+
+private:
+    char *page_bytes() { return reinterpret_cast<char *>(this); }
+    const char *page_bytes() const { return reinterpret_cast<const char *>(this); }
+    // Bytes used by the slots and records, excluding the fixed header
+    size_t record_bytes() const {
+        return used_bytes() - static_cast<size_t>(reinterpret_cast<const char *>(slots_) - page_bytes());
+    }
+    size_t slots_end() const {
+        return static_cast<size_t>(reinterpret_cast<const char *>(slots_ + get_size()) - page_bytes());
+    }
+
+    uint16_t free_end_;      // Offset of the lowest record byte
+    uint16_t fragmented_;    // Bytes of removed records between free_end_ and the page end
+    page_id_t next_page_id_;
+    Slot slots_[1];
+};
+
+} // namespace kvengine
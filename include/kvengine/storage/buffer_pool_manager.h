@@ -40,13 +40,36 @@ public:
     bool delete_page(page_id_t page_id);
 
     // Flush all dirty pages to disk.
+    // flush_page and flush_all_pages do nothing while a checkpoint is in progress.
     void flush_all_pages();
 
+    // Copy-on-write checkpoint, in three steps:
+    //  - begin_checkpoint copies every dirty page into a private snapshot and marks the frames
+    //    clean. The caller must make sure no page is being modified while it runs.
+    //  - write_checkpoint writes the snapshot to the file; it may run while other threads keep
+    //    using the pool. Until end_checkpoint the pool writes nothing else to the file: dirty
+    //    victims are parked in memory and deleted pages are freed later, so the file holds
+    //    exactly the snapshot and can be committed.
+    //  - end_checkpoint writes the parked pages and frees the deleted ones.
+    // Checkpoints must not overlap. Returns the number of pages in the snapshot.
+    size_t begin_checkpoint();
+    void write_checkpoint();
+    void end_checkpoint();
+
 private:
     // Helper to find a victim frame to replace.
     // Returns true if a victim is found, false otherwise (all pinned).
     bool find_victim(frame_id_t* frame_id);
 
+    // Write a dirty victim back, or park it while a checkpoint is in progress (latch_ held)
+    void write_back(Page* page);
+
+    // Fill a frame with the latest image of its page: parked, snapshot, then disk (latch_ held)
+    void load_page(Page* page);
+
+    // Free a page on disk, or defer it while a checkpoint is in progress (latch_ held)
+    void free_page(page_id_t page_id);
+
     size_t pool_size_;
     PageManager* page_manager_;
     std::vector<Page*> pages_; // The frames
@@ -61,6 +84,13 @@ private:
     std::unordered_map<frame_id_t, std::list<frame_id_t>::iterator> lru_map_;
 
     std::mutex latch_;
+
+    // Checkpoint state (latch_ held). checkpoint_pages_ is not modified between begin_checkpoint
+    // and end_checkpoint, so write_checkpoint reads it without the latch.
+    bool checkpointing_ = false;
+    std::unordered_map<page_id_t, std::vector<char>> checkpoint_pages_; // Snapshot being written
+    std::unordered_map<page_id_t, std::vector<char>> parked_pages_;     // Dirty victims evicted meanwhile
+    std::vector<page_id_t> deferred_frees_;                              // Pages deleted meanwhile
 };
 
 } // namespace kvengine
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <cstring>
 #include <iostream>
+#include "kvengine/storage/rw_latch.h"
 
 namespace kvengine {
 
@@ -59,6 +60,12 @@ public:
 
     void reset_memory() { memset(data_, 0, PAGE_SIZE); }
 
+    // Page latch, taken by index code while the page is pinned to protect its contents
+    inline void w_latch() { latch_.lock(); }
+    inline void w_unlatch() { latch_.unlock(); }
+    inline void r_latch() { latch_.lock_shared(); }
+    inline void r_unlatch() { latch_.unlock_shared(); }
+
 private:
     // Page Header offsets within data_
     static constexpr size_t OFFSET_LSN = 0;   // 0-8: LSN
@@ -70,6 +77,7 @@ private:
     page_id_t page_id_ = INVALID_PAGE_ID;
     int pin_count_ = 0;
     bool is_dirty_ = false;
+    ReaderWriterLatch latch_;
 };
 
 } // namespace kvengine
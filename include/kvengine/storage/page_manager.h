@@ -4,43 +4,102 @@
 #include <fstream>
 #include <mutex>
 #include <atomic>
+#include <memory>
+#include <vector>
 #include "kvengine/storage/page.h"
 
 namespace kvengine {
 
+class IoRing;
+
 /**
  * PageManager is responsible for reading and writing pages to disk.
  * It manages the underlying file and page allocation.
+ * With use_io_uring, page I/O is submitted through an io_uring instance so a batch of
+ * pages costs one system call; if io_uring is unavailable it falls back to stdio.
+ *
+ * With a journal file set, the file can be rolled back to its last commit(): the first
+ * overwrite of a page that existed at the last commit copies the original image into the
+ * journal (synced before the overwrite), and open() restores those images and truncates
+ * pages added since. Freed pages form a linked list through the pages themselves; the
+ * owner persists the list head next to its other metadata.
  */
 class PageManager {
 public:
-    explicit PageManager(const std::string& db_file);
+    explicit PageManager(const std::string& db_file, bool use_io_uring = false);
     ~PageManager();
 
-    // Open/Create the database file
+    // Enable the rollback journal; must be called before open()
+    void set_journal_file(const std::string& journal_file) { journal_name_ = journal_file; }
+
+    // Open/Create the database file; with a journal, roll back to the last commit first
     bool open();
     void close();
 
+    // Make all page writes durable and start a new journal epoch: after this returns,
+    // a crash rolls back to the current file contents
+    bool commit();
+
+    // fsync the database file
+    bool sync();
+
     // Write a page to disk
     void write_page(page_id_t page_id, const char* data);
 
     // Read a page from disk
     void read_page(page_id_t page_id, char* data);
 
-    // Allocate a new page ID (safely increments counter)
+    // Write a batch of pages; with io_uring all writes are in flight at once
+    void write_pages(const page_id_t* page_ids, const char* const* data, size_t count);
+
+    // Read a batch of pages; pages past the end of the file read as zeros
+    void read_pages(const page_id_t* page_ids, char* const* data, size_t count);
+
+    // Whether page I/O goes through io_uring
+    bool is_io_uring_enabled() const { return ring_ != nullptr; }
+
+    // Allocate a page ID: reuse the most recently freed page, else extend the file
     page_id_t allocate_page();
 
-    // Deallocate page (for future free list management)
+    // Return a page to the free list; the page must no longer be cached by a buffer pool
     void deallocate_page(page_id_t page_id);
 
+    // Head of the free list (INVALID_PAGE_ID when empty), persisted by the owner
+    page_id_t get_free_list_head() const;
+    void set_free_list_head(page_id_t page_id);
+
     // Get current file size in pages
     int get_num_pages() const;
 
 private:
+    // Submit one request per page and wait for all of them (io_mutex_ held)
+    void run_ring(bool write, const page_id_t* page_ids, char* const* data, size_t count);
+
+    // Copy the committed images of pages about to be overwritten into the journal (io_mutex_ held)
+    bool journal_pages(const page_id_t* page_ids, size_t count);
+
+    // Read a page straight from the file (io_mutex_ held)
+    void read_raw(page_id_t page_id, char* data);
+    void write_raw(page_id_t page_id, const char* data);
+
+    // Restore the journal left by a crash, then start a new epoch
+    bool rollback();
+
+    // Create an empty journal recording the current size (io_mutex_ held)
+    bool start_journal();
+
     std::string file_name_;
     FILE* db_file_ = nullptr;
-    std::mutex io_mutex_;
+    bool use_io_uring_;
+    std::unique_ptr<IoRing> ring_;   // Set when io_uring is in use; stdio is then bypassed
+    mutable std::mutex io_mutex_;
     std::atomic<page_id_t> next_page_id_;
+
+    std::string journal_name_;
+    FILE* journal_file_ = nullptr;
+    page_id_t journal_base_pages_ = 0;       // File size in pages at the last commit
+    std::vector<bool> journaled_;            // Pages below the base already copied this epoch
+    page_id_t free_list_head_ = INVALID_PAGE_ID;
 };
 
 } // namespace kvengine
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+namespace kvengine {
+
+/**
+ * ReaderWriterLatch lets many readers or a single writer hold it.
+ * A waiting writer stops new readers from entering, so a steady stream of lookups
+ * cannot starve it. The latch is not reentrant: a thread must not take it twice.
+ * lock()/unlock() make it usable with std::lock_guard for exclusive access.
+ */
+class ReaderWriterLatch {
+public:
+    ReaderWriterLatch() = default;
+    ReaderWriterLatch(const ReaderWriterLatch&) = delete;
+    ReaderWriterLatch& operator=(const ReaderWriterLatch&) = delete;
+
+    void lock() {
+        std::unique_lock<std::mutex> guard(mutex_);
+        waiting_writers_++;
+        cv_.wait(guard, [this] { return !writer_ && readers_ == 0; });
+        waiting_writers_--;
+        writer_ = true;
+    }
+
+    void unlock() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        writer_ = false;
+        cv_.notify_all();
+    }
+
+    void lock_shared() {
+        std::unique_lock<std::mutex> guard(mutex_);
+        cv_.wait(guard, [this] { return !writer_ && waiting_writers_ == 0; });
+        readers_++;
+    }
+
+    void unlock_shared() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (--readers_ == 0 && waiting_writers_ > 0) {
+            cv_.notify_all();
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int readers_ = 0;
+    int waiting_writers_ = 0;
+    bool writer_ = false;
+};
+
+// Holds a ReaderWriterLatch in shared mode for the lifetime of the guard
+class SharedLatchGuard {
+public:
+    explicit SharedLatchGuard(ReaderWriterLatch &latch) : latch_(latch) { latch_.lock_shared(); }
+    ~SharedLatchGuard() { latch_.unlock_shared(); }
+
+    SharedLatchGuard(const SharedLatchGuard&) = delete;
+    SharedLatchGuard& operator=(const SharedLatchGuard&) = delete;
+
+private:
+    ReaderWriterLatch &latch_;
+};
+
+} // namespace kvengine
@@ -143,6 +143,17 @@ struct Statistics {
     uint64_t cache_hit_rate = 0;  // 緩存命中率（百分比）
     uint64_t total_reads = 0;     // 總讀取次數
     uint64_t total_writes = 0;    // 總寫入次數
+    uint64_t wal_group_commits = 0;  // 經由組提交持久化的事務數
+    uint64_t wal_group_flushes = 0;  // 組提交實際刷新次數（提交數/刷新數 = 批量程度）
+    uint64_t wal_syncs = 0;          // WAL fdatasync 次數（含後台同步）
+    uint64_t wal_sync_time_us = 0;   // WAL fdatasync 累計耗時（微秒）
+    uint64_t checkpoints = 0;                  // 已完成的檢查點次數（含自動檢查點）
+    uint64_t last_checkpoint_time_ms = 0;      // 上次檢查點完成的時間（Unix 毫秒，0 表示沒有）
+    uint64_t last_checkpoint_duration_us = 0;  // 上次檢查點耗時（微秒）
+    bool recovery_in_progress = false;         // 後台恢復是否仍在進行（recovery_lazy）
+    uint64_t recovery_scanned_records = 0;     // 後台恢復已掃描的日誌記錄數
+    uint64_t recovery_pending_keys = 0;        // 後台恢復尚待重放的鍵數
+    uint64_t recovery_replayed_keys = 0;       // 後台恢復已重放的鍵數（含請求觸發的按需重放）
 };
 
 /**
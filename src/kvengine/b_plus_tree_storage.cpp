@@ -0,0 +1,512 @@
+#include "b_plus_tree_storage.h"
+#include "../include/kvengine/storage/b_plus_tree.cpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/types.h>
+#endif
+
+namespace kvengine {
+
+namespace {
+
+// 元數據頁（頁面 0）的格式
+struct MetaPage {
+    uint32_t magic;
+    uint32_t version;
+    page_id_t root_page_id;
+    page_id_t free_list_head;
+    uint64_t num_keys;
+    uint64_t snapshot_lsn;
+};
+
+const uint32_t META_MAGIC = 0x5442564B;  // "KVBT"
+const uint32_t META_VERSION = 2;
+const page_id_t META_PAGE_ID = 0;
+
+// 溢出頁：頁頭之後是值的一段
+struct OverflowHeader {
+    page_id_t next;   // 下一個溢出頁；最後一頁為 INVALID_PAGE_ID
+    uint32_t used;    // 本頁存放的字節數
+};
+
+const size_t OVERFLOW_CAPACITY = PAGE_SIZE - sizeof(OverflowHeader);
+
+// 值記錄：標記(1) + 內聯的值，或標記(1) + 值長度(4) + 第一個溢出頁(4)
+const char VALUE_INLINE = 0;
+const char VALUE_OVERFLOW = 1;
+const size_t OVERFLOW_RECORD_SIZE = 1 + sizeof(uint32_t) + sizeof(page_id_t);
+
+// 緩衝池至少要容納一次插入沿路分裂時固定的頁面
+const size_t MIN_POOL_PAGES = 32;
+
+// 迭代器每次從樹中取出的條目數
+const size_t SCAN_BATCH = 256;
+
+} // namespace
+
+const size_t BPlusTreeStorage::MAX_KEY_SIZE;
+const size_t BPlusTreeStorage::INLINE_VALUE_SIZE;
+
+/**
+ * @class BPlusTreeStorageIterator
+ * @brief 分批取數的迭代器
+ */
+class BPlusTreeStorageIterator : public Iterator {
+public:
+    BPlusTreeStorageIterator(const BPlusTreeStorage* storage, const std::string& prefix)
+        : storage_(storage), prefix_(prefix), pos_(0), more_(false) {
+        seek_to_first();
+    }
+
+    bool valid() const override {
+        return pos_ < entries_.size();
+    }
+
+    void next() override {
+        if (pos_ >= entries_.size()) return;
+        ++pos_;
+        if (pos_ == entries_.size() && more_) {
+            // 從本批最後一個鍵之後重新定位
+            fill(entries_.back().first, false);
+        }
+    }
+
+    std::string key() const override {
+        return valid() ? entries_[pos_].first : "";
+    }
+
+    std::string value() const override {
+        return valid() ? entries_[pos_].second : "";
+    }
+
+    void seek(const std::string& target) override {
+        fill(std::max(target, prefix_), true);
+    }
+
+    void seek_to_first() override {
+        fill(prefix_, true);
+    }
+
+private:
+    void fill(std::string start, bool inclusive) {
+        more_ = storage_->scan(start, inclusive, prefix_, entries_);
+        pos_ = 0;
+    }
+
+    const BPlusTreeStorage* storage_;
+    std::string prefix_;
+    std::vector<std::pair<std::string, std::string>> entries_;
+    size_t pos_;
+    bool more_;
+};
+
+BPlusTreeStorage::BPlusTreeStorage(const std::string& data_dir, const Options& options)
+    : data_dir_(data_dir),
+      data_file_(data_dir + "/kvengine.btree"),
+      pool_pages_(std::max<size_t>(options.btree_buffer_pool_pages, MIN_POOL_PAGES)),
+      num_keys_(0),
+      snapshot_lsn_(0),
+      initialized_(false) {
+}
+
+BPlusTreeStorage::~BPlusTreeStorage() {
+    std::lock_guard<ReaderWriterLatch> guard(latch_);
+    tree_.reset();
+    bpm_.reset();
+    if (page_manager_) {
+        page_manager_->close();
+    }
+}
+
+bool BPlusTreeStorage::initialize() {
+    std::lock_guard<ReaderWriterLatch> guard(latch_);
+    if (initialized_) {
+        return true;
+    }
+
+    struct stat info;
+    if (stat(data_dir_.c_str(), &info) != 0 && mkdir(data_dir_.c_str(), 0755) != 0) {
+        std::cerr << "Failed to create data directory: " << data_dir_ << std::endl;
+        return false;
+    }
+
+    page_manager_.reset(new PageManager(data_file_));
+    page_manager_->set_journal_file(data_file_ + "-journal");
+    if (!page_manager_->open()) {
+        std::cerr << "Failed to open B+ tree data file " << data_file_ << std::endl;
+        return false;
+    }
+    bpm_.reset(new BufferPoolManager(pool_pages_, page_manager_.get()));
+    tree_.reset(new Tree("kvengine", bpm_.get(), StringComparator()));
+
+    if (page_manager_->get_num_pages() == 0) {
+        // 新文件：創建元數據頁並提交，使文件從一開始就是完整的
+        page_id_t meta_id = INVALID_PAGE_ID;
+        Page* page = bpm_->new_page(&meta_id);
+        if (page == nullptr || meta_id != META_PAGE_ID) {
+            std::cerr << "Failed to create B+ tree meta page" << std::endl;
+            return false;
+        }
+        bpm_->unpin_page(meta_id, true);
+        num_keys_ = 0;
+        snapshot_lsn_ = 0;
+        if (!write_meta(0)) {
+            return false;
+        }
+        bpm_->flush_all_pages();
+        if (!page_manager_->commit()) {
+            return false;
+        }
+    } else {
+        Page* page = bpm_->fetch_page(META_PAGE_ID);
+        if (page == nullptr) {
+            std::cerr << "Failed to read B+ tree meta page" << std::endl;
+            return false;
+        }
+        MetaPage meta;
+        memcpy(&meta, page->get_data(), sizeof(meta));
+        bpm_->unpin_page(META_PAGE_ID, false);
+
+        if (meta.magic != META_MAGIC || meta.version != META_VERSION) {
+            std::cerr << "Invalid B+ tree data file " << data_file_ << std::endl;
+            return false;
+        }
+        tree_->set_root_page_id(meta.root_page_id);
+        page_manager_->set_free_list_head(meta.free_list_head);
+        num_keys_ = meta.num_keys;
+        snapshot_lsn_ = meta.snapshot_lsn;
+    }
+
+    initialized_ = true;
+    return true;
+}
+
+bool BPlusTreeStorage::put(const std::string& key, const std::string& value) {
+    std::lock_guard<ReaderWriterLatch> guard(latch_);
+    return put_locked(key, value);
+}
+
+bool BPlusTreeStorage::get(const std::string& key, std::string& value) const {
+    SharedLatchGuard guard(latch_);
+    std::string record;
+    return find(key, record) && load_value(record, value);
+}
+
+bool BPlusTreeStorage::remove(const std::string& key) {
+    std::lock_guard<ReaderWriterLatch> guard(latch_);
+    return remove_locked(key);
+}
+
+void BPlusTreeStorage::apply_batch(const std::vector<WriteOp>& ops) {
+    std::lock_guard<ReaderWriterLatch> guard(latch_);
+    for (const auto& op : ops) {
+        if (op.is_delete) {
+            remove_locked(op.key);
+        } else {
+            put_locked(op.key, op.value);
+        }
+    }
+}
+
+bool BPlusTreeStorage::exists(const std::string& key) const {
+    SharedLatchGuard guard(latch_);
+    std::string record;
+    return find(key, record);
+}
+
+std::unique_ptr<Iterator> BPlusTreeStorage::new_iterator(const std::string& prefix) const {
+    return std::unique_ptr<Iterator>(new BPlusTreeStorageIterator(this, prefix));
+}
+
+bool BPlusTreeStorage::flush() {
+    std::lock_guard<std::mutex> checkpoint_guard(checkpoint_mutex_);
+    uint64_t snapshot_lsn = 0;
+    std::function<bool()> before_install;
+    {
+        SharedLatchGuard guard(latch_);
+        if (!initialized_) {
+            return true;
+        }
+        snapshot_lsn = snapshot_lsn_;
+        before_install = before_install_;
+    }
+    return checkpoint(snapshot_lsn, before_install);
+}
+
+bool BPlusTreeStorage::write_snapshot(uint64_t snapshot_lsn, const std::function<bool()>& before_install) {
+    std::lock_guard<std::mutex> checkpoint_guard(checkpoint_mutex_);
+    return checkpoint(snapshot_lsn, before_install);
+}
+
+uint64_t BPlusTreeStorage::get_snapshot_lsn() const {
+    SharedLatchGuard guard(latch_);
+    return snapshot_lsn_;
+}
+
+void BPlusTreeStorage::set_before_install(const std::function<bool()>& before_install) {
+    std::lock_guard<ReaderWriterLatch> guard(latch_);
+    before_install_ = before_install;
+}
+
+bool BPlusTreeStorage::read_data_file(std::string& contents, uint64_t& snapshot_lsn) {
+    // 先取快照 LSN 再遍歷：之後的寫入可能可見，從快照 LSN 重放日誌時冪等地覆蓋
+    snapshot_lsn = get_snapshot_lsn();
+    BPlusTreeStorageIterator iter(this, "");
+    serialize(iter, snapshot_lsn, 0, contents);
+    return true;
+}
+
+bool BPlusTreeStorage::load_snapshot(const std::string& contents, uint64_t& snapshot_lsn) {
+    return load_snapshot_batched(contents, snapshot_lsn, SNAPSHOT_BATCH_SIZE, SNAPSHOT_BATCH_BYTES);
+}
+
+size_t BPlusTreeStorage::size() const {
+    SharedLatchGuard guard(latch_);
+    return static_cast<size_t>(num_keys_);
+}
+
+size_t BPlusTreeStorage::memory_usage() const {
+    return pool_pages_ * PAGE_SIZE;
+}
+
+int BPlusTreeStorage::get_num_pages() const {
+    SharedLatchGuard guard(latch_);
+    return page_manager_ ? page_manager_->get_num_pages() : 0;
+}
+
+bool BPlusTreeStorage::put_locked(const std::string& key, const std::string& value) {
+    if (!initialized_) {
+        return false;
+    }
+    if (key.size() > MAX_KEY_SIZE) {
+        std::cerr << "Key too long for B+ tree storage: " << key.size()
+                  << " bytes (max " << MAX_KEY_SIZE << ")" << std::endl;
+        return false;
+    }
+
+    std::string old_record;
+    bool existed = find(key, old_record);
+
+    std::string record;
+    if (!store_value(value, record)) {
+        return false;
+    }
+    if (existed) {
+        if (!tree_->update(key, record)) {
+            free_value(record);
+            return false;
+        }
+        free_value(old_record);
+    } else {
+        if (!tree_->insert(key, record)) {
+            free_value(record);
+            return false;
+        }
+        num_keys_++;
+    }
+    return true;
+}
+
+bool BPlusTreeStorage::remove_locked(const std::string& key) {
+    std::string record;
+    if (!find(key, record)) {
+        return false;
+    }
+    if (!tree_->remove(key)) {
+        return false;
+    }
+    free_value(record);
+    num_keys_--;
+    return true;
+}
+
+bool BPlusTreeStorage::find(const std::string& key, std::string& record) const {
+    if (!initialized_ || key.size() > MAX_KEY_SIZE) {
+        return false;
+    }
+    std::vector<std::string> result;
+    if (!tree_->get_value(key, result) || result.empty()) {
+        return false;
+    }
+    record.swap(result.front());
+    return true;
+}
+
+bool BPlusTreeStorage::store_value(const std::string& value, std::string& record) {
+    if (value.size() <= INLINE_VALUE_SIZE) {
+        record.assign(1, VALUE_INLINE);
+        record.append(value);
+        return true;
+    }
+
+    // 從最後一段開始寫，每一頁創建時已經知道下一頁
+    size_t chunks = (value.size() + OVERFLOW_CAPACITY - 1) / OVERFLOW_CAPACITY;
+    page_id_t next = INVALID_PAGE_ID;
+    for (size_t i = chunks; i-- > 0;) {
+        page_id_t page_id = INVALID_PAGE_ID;
+        Page* page = bpm_->new_page(&page_id);
+        if (page == nullptr) {
+            std::cerr << "Buffer pool exhausted while writing overflow pages" << std::endl;
+            free_overflow(next);
+            return false;
+        }
+        size_t offset = i * OVERFLOW_CAPACITY;
+        OverflowHeader header;
+        header.next = next;
+        header.used = static_cast<uint32_t>(std::min(OVERFLOW_CAPACITY, value.size() - offset));
+        memcpy(page->get_data(), &header, sizeof(header));
+        memcpy(page->get_data() + sizeof(header), value.data() + offset, header.used);
+        bpm_->unpin_page(page_id, true);
+        next = page_id;
+    }
+
+    uint32_t size = static_cast<uint32_t>(value.size());
+    record.assign(1, VALUE_OVERFLOW);
+    record.append(reinterpret_cast<const char*>(&size), sizeof(size));
+    record.append(reinterpret_cast<const char*>(&next), sizeof(next));
+    return true;
+}
+
+bool BPlusTreeStorage::load_value(const std::string& record, std::string& value) const {
+    if (!record.empty() && record[0] == VALUE_INLINE) {
+        value.assign(record, 1, std::string::npos);
+        return true;
+    }
+    if (record.size() != OVERFLOW_RECORD_SIZE || record[0] != VALUE_OVERFLOW) {
+        std::cerr << "Corrupted value record" << std::endl;
+        return false;
+    }
+    uint32_t size;
+    page_id_t page_id;
+    memcpy(&size, record.data() + 1, sizeof(size));
+    memcpy(&page_id, record.data() + 1 + sizeof(size), sizeof(page_id));
+
+    value.clear();
+    value.reserve(size);
+    while (page_id != INVALID_PAGE_ID && value.size() < size) {
+        Page* page = bpm_->fetch_page(page_id);
+        if (page == nullptr) {
+            std::cerr << "Failed to read overflow page " << page_id << std::endl;
+            return false;
+        }
+        OverflowHeader header;
+        memcpy(&header, page->get_data(), sizeof(header));
+        size_t used = std::min<size_t>(header.used, OVERFLOW_CAPACITY);
+        value.append(page->get_data() + sizeof(header), used);
+        bpm_->unpin_page(page_id, false);
+        page_id = header.next;
+    }
+    if (value.size() != size) {
+        std::cerr << "Corrupted overflow chain: expected " << size
+                  << " bytes, read " << value.size() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void BPlusTreeStorage::free_value(const std::string& record) {
+    if (record.size() != OVERFLOW_RECORD_SIZE || record[0] != VALUE_OVERFLOW) {
+        return;
+    }
+    page_id_t page_id;
+    memcpy(&page_id, record.data() + 1 + sizeof(uint32_t), sizeof(page_id));
+    free_overflow(page_id);
+}
+
+void BPlusTreeStorage::free_overflow(page_id_t page_id) {
+    while (page_id != INVALID_PAGE_ID) {
+        Page* page = bpm_->fetch_page(page_id);
+        if (page == nullptr) {
+            std::cerr << "Failed to read overflow page " << page_id << std::endl;
+            return;
+        }
+        OverflowHeader header;
+        memcpy(&header, page->get_data(), sizeof(header));
+        bpm_->unpin_page(page_id, false);
+        bpm_->delete_page(page_id);
+        page_id = header.next;
+    }
+}
+
+bool BPlusTreeStorage::write_meta(uint64_t snapshot_lsn) {
+    Page* page = bpm_->fetch_page(META_PAGE_ID);
+    if (page == nullptr) {
+        std::cerr << "Failed to fetch B+ tree meta page" << std::endl;
+        return false;
+    }
+    MetaPage meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.magic = META_MAGIC;
+    meta.version = META_VERSION;
+    meta.root_page_id = tree_->get_root_page_id();
+    meta.free_list_head = page_manager_->get_free_list_head();
+    meta.num_keys = num_keys_;
+    meta.snapshot_lsn = snapshot_lsn;
+    memcpy(page->get_data(), &meta, sizeof(meta));
+    bpm_->unpin_page(META_PAGE_ID, true);
+    return true;
+}
+
+bool BPlusTreeStorage::checkpoint(uint64_t snapshot_lsn, const std::function<bool()>& before_install) {
+    {
+        // 獨佔鎖內沒有進行中的樹操作：此刻的元數據和髒頁構成一致的快照
+        std::lock_guard<ReaderWriterLatch> guard(latch_);
+        if (!initialized_ || !write_meta(snapshot_lsn)) {
+            return false;
+        }
+        bpm_->begin_checkpoint();
+    }
+
+    // 之後的修改只進入緩衝池，文件中只有快照頁面，直到 end_checkpoint
+    bpm_->write_checkpoint();
+
+    // 頁面中的每個寫入在日誌中都要有記錄，否則崩潰後無法重放到一致的狀態
+    bool committed = (!before_install || before_install()) && page_manager_->commit();
+    bpm_->end_checkpoint();
+
+    std::lock_guard<ReaderWriterLatch> guard(latch_);
+    if (committed) {
+        snapshot_lsn_ = snapshot_lsn;
+    } else {
+        // 未提交的元數據頁在崩潰後回滾；不崩潰時在下一次檢查點覆蓋
+        write_meta(snapshot_lsn_);
+    }
+    return committed;
+}
+
+bool BPlusTreeStorage::scan(const std::string& start, bool inclusive, const std::string& prefix,
+                            std::vector<std::pair<std::string, std::string>>& entries) const {
+    SharedLatchGuard guard(latch_);
+    entries.clear();
+    if (!initialized_) {
+        return false;
+    }
+
+    for (auto iter = tree_->begin(start); !iter.is_end(); ++iter) {
+        std::string key = iter.key();
+        if (!inclusive && key == start) {
+            continue;
+        }
+        if (!prefix.empty() && key.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        if (entries.size() >= SCAN_BATCH) {
+            return true;
+        }
+        std::string value;
+        if (!load_value(iter.value(), value)) {
+            return false;
+        }
+        entries.emplace_back(std::move(key), std::move(value));
+    }
+    return false;
+}
+
+} // namespace kvengine
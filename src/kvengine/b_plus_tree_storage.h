@@ -0,0 +1,240 @@
+/**
+ * @file b_plus_tree_storage.h
+ * @brief B+ 樹存儲後端
+ * @details 鍵值對存放在數據文件 kvengine.btree 的 B+ 樹頁面中，緩衝池只保留熱點頁面，
+ *          內存佔用由緩衝池大小決定，與數據量無關。
+ *
+ *          頁面 0 是元數據頁（根頁面、空閒頁鏈表頭、鍵數和快照 LSN）。鍵按實際長度存放在
+ *          槽頁中；值不超過 INLINE_VALUE_SIZE 字節時與鍵存放在同一條記錄中，否則存放在溢出頁鏈中，
+ *          記錄中只保存長度和第一個溢出頁。刪除使頁面不足時與兄弟頁合併或借用記錄，
+ *          騰空的頁面回到空閒頁鏈表，因此鍵不斷換名重寫時文件大小保持穩定。
+ *
+ *          髒頁可以隨時被換出寫回，但第一次覆蓋上次提交時已存在的頁面之前，PageManager
+ *          會先把原始頁面寫入回滾日誌（kvengine.btree-journal）。檢查點寫回全部髒頁並提交，
+ *          崩潰後打開時數據文件回滾到最近一次檢查點，之後的寫入由引擎的 WAL 從快照 LSN
+ *          開始重放恢復。
+ *
+ *          檢查點在獨佔鎖內只寫元數據頁並複製髒頁（緩衝池的寫時複製快照），寫出頁面和提交
+ *          在鎖外進行；期間的寫操作照常執行，換出的髒頁暫存在內存中，提交之後才寫入文件
+ */
+
+#ifndef KVENGINE_B_PLUS_TREE_STORAGE_H
+#define KVENGINE_B_PLUS_TREE_STORAGE_H
+
+#include "../include/kvengine/iterator.h"
+#include "../include/kvengine/options.h"
+#include "../include/kvengine/storage/b_plus_tree.h"
+#include "../include/kvengine/storage/b_plus_tree_slotted_page.h"
+#include "../include/kvengine/storage/buffer_pool_manager.h"
+#include "../include/kvengine/storage/page_manager.h"
+#include "../include/kvengine/storage/rw_latch.h"
+#include "storage_backend.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kvengine {
+
+/**
+ * @class BPlusTreeStorage
+ * @brief 基於 BPlusTree 和 BufferPoolManager 的磁盤存儲後端
+ * @details 線程安全：讀操作（get、exists、迭代）共享讀寫鎖並發執行，由 B+ 樹的頁面鎖保護；
+ *          寫操作獨佔該鎖，檢查點只在複製髒頁時獨佔。鍵的長度不能超過 MAX_KEY_SIZE
+ */
+class BPlusTreeStorage : public StorageBackend {
+public:
+    static const size_t MAX_KEY_SIZE = 512;        // 鍵的最大長度（字節）
+    static const size_t INLINE_VALUE_SIZE = 256;   // 不超過該長度的值存放在葉子記錄中
+
+    typedef BPlusTree<std::string, std::string, StringComparator> Tree;
+
+    /**
+     * @brief 構造函數
+     * @param data_dir 數據目錄
+     * @param options 配置（btree_buffer_pool_pages 決定緩衝池大小）
+     */
+    explicit BPlusTreeStorage(const std::string& data_dir, const Options& options = Options());
+
+    /**
+     * @brief 析構函數
+     * @details 不提交：上次檢查點之後的修改在下次打開時回滾，由 WAL 重放恢復
+     */
+    ~BPlusTreeStorage() override;
+
+    BPlusTreeStorage(const BPlusTreeStorage&) = delete;
+    BPlusTreeStorage& operator=(const BPlusTreeStorage&) = delete;
+
+    /**
+     * @brief 打開數據文件：回滾未提交的修改並讀取元數據頁；文件不存在時創建
+     * @return 成功返回 true
+     */
+    bool initialize() override;
+
+    /**
+     * @brief 插入或更新鍵值對
+     * @return 成功返回 true；鍵過長時返回 false
+     */
+    bool put(const std::string& key, const std::string& value) override;
+
+    /**
+     * @brief 獲取鍵對應的值
+     * @return 找到返回 true
+     */
+    bool get(const std::string& key, std::string& value) const override;
+
+    /**
+     * @brief 刪除鍵值對並釋放其溢出頁
+     * @return 鍵存在並已刪除返回 true
+     */
+    bool remove(const std::string& key) override;
+
+    /**
+     * @brief 按順序應用一批寫操作（整批只獲取一次鎖）
+     */
+    void apply_batch(const std::vector<WriteOp>& ops) override;
+
+    /**
+     * @brief 檢查鍵是否存在
+     */
+    bool exists(const std::string& key) const override;
+
+    /**
+     * @brief 創建有序迭代器
+     * @param prefix 可選的前綴過濾
+     * @details 迭代器每次在共享鎖內從樹中取出一批條目，取完後從最後一個鍵之後重新定位，
+     *          不會長時間持有鎖或固定頁面；之後的寫入可能可見。迭代器不能比後端活得更久
+     */
+    std::unique_ptr<Iterator> new_iterator(const std::string& prefix = "") const override;
+
+    /**
+     * @brief 以當前的快照 LSN 提交全部修改
+     * @details 提交之前調用 set_before_install 設置的回調持久化 WAL
+     * @return 成功返回 true
+     */
+    bool flush() override;
+
+    /**
+     * @brief 寫出檢查點：寫回全部髒頁並提交
+     * @param snapshot_lsn 快照 LSN，與元數據頁一起提交
+     * @param before_install 頁面落盤之後、提交之前調用；返回 false 時放棄，數據文件保持上次提交的狀態
+     * @return 成功返回 true
+     * @details 代價與檢查點之間修改的頁面數成正比，與數據總量無關。獨佔鎖只在寫元數據頁和
+     *          複製髒頁時持有；寫出頁面、before_install 和提交期間讀寫操作繼續執行，
+     *          它們的修改不進入本次檢查點。檢查點之間串行
+     */
+    bool write_snapshot(uint64_t snapshot_lsn, const std::function<bool()>& before_install = nullptr) override;
+
+    /**
+     * @brief 最近一次提交的快照 LSN
+     */
+    uint64_t get_snapshot_lsn() const override;
+
+    /**
+     * @brief 設置 flush 提交之前調用的回調（例如持久化 WAL）
+     */
+    void set_before_install(const std::function<bool()>& before_install) override;
+
+    /**
+     * @brief 導出全部數據（數據文件格式）
+     * @details 通過分批取數的迭代器沿葉子順序讀出，條目直接寫入 contents；
+     *          每批之間釋放共享鎖，導出期間寫操作不會被長時間阻塞
+     */
+    bool read_data_file(std::string& contents, uint64_t& snapshot_lsn) override;
+
+    /**
+     * @brief 以數據文件格式的內容替換全部數據
+     * @details 與當前數據歸併，只寫入變化的鍵；每批最多 SNAPSHOT_BATCH_SIZE 個操作，
+     *          獨佔鎖只在應用一批時持有，緩衝池按需換出髒頁
+     */
+    bool load_snapshot(const std::string& contents, uint64_t& snapshot_lsn) override;
+
+    /**
+     * @brief 鍵值對數量（記錄在元數據頁中，不需要遍歷）
+     */
+    size_t size() const override;
+
+    /**
+     * @brief 緩衝池佔用的內存
+     */
+    size_t memory_usage() const override;
+
+    /**
+     * @brief 數據文件的頁數
+     */
+    int get_num_pages() const;
+
+private:
+    friend class BPlusTreeStorageIterator;
+
+    bool put_locked(const std::string& key, const std::string& value);
+    bool remove_locked(const std::string& key);
+
+    /**
+     * @brief 查找鍵對應的值記錄（latch_ 持有，共享即可）
+     */
+    bool find(const std::string& key, std::string& record) const;
+
+    /**
+     * @brief 編碼值記錄：短值內聯，長值寫入新的溢出頁鏈（latch_ 持有）
+     */
+    bool store_value(const std::string& value, std::string& record);
+
+    /**
+     * @brief 從值記錄讀取值（latch_ 持有，共享即可）
+     */
+    bool load_value(const std::string& record, std::string& value) const;
+
+    /**
+     * @brief 釋放值記錄引用的溢出頁（latch_ 持有）
+     */
+    void free_value(const std::string& record);
+
+    /**
+     * @brief 釋放從 page_id 開始的溢出頁鏈（latch_ 持有）
+     */
+    void free_overflow(page_id_t page_id);
+
+    /**
+     * @brief 把內存中的元數據和給定的快照 LSN 寫入元數據頁（latch_ 持有）
+     */
+    bool write_meta(uint64_t snapshot_lsn);
+
+    /**
+     * @brief 在獨佔鎖內複製髒頁，在鎖外寫出並提交（checkpoint_mutex_ 持有，latch_ 不持有）
+     */
+    bool checkpoint(uint64_t snapshot_lsn, const std::function<bool()>& before_install);
+
+    /**
+     * @brief 取出從 start 開始的一批條目，供迭代器使用
+     * @param start 起始鍵
+     * @param inclusive 是否包含等於 start 的鍵
+     * @param prefix 只取帶該前綴的鍵；遇到第一個不匹配的鍵即停止
+     * @param entries 輸出條目
+     * @return 樹中還可能有更多條目返回 true
+     */
+    bool scan(const std::string& start, bool inclusive, const std::string& prefix,
+              std::vector<std::pair<std::string, std::string>>& entries) const;
+
+    std::string data_dir_;
+    std::string data_file_;
+    size_t pool_pages_;
+
+    mutable ReaderWriterLatch latch_;   // 讀操作共享，寫操作獨佔
+    std::mutex checkpoint_mutex_;       // 串行化檢查點
+    std::unique_ptr<PageManager> page_manager_;
+    std::unique_ptr<BufferPoolManager> bpm_;
+    std::unique_ptr<Tree> tree_;
+
+    uint64_t num_keys_;
+    uint64_t snapshot_lsn_;
+    std::function<bool()> before_install_;
+    bool initialized_;
+};
+
+} // namespace kvengine
+
+#endif // KVENGINE_B_PLUS_TREE_STORAGE_H
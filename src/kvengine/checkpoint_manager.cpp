@@ -6,11 +6,13 @@
 #include "checkpoint_manager.h"
 #include <iostream>
 #include <sstream>
+#include <chrono>
 
 namespace kvengine {
 
-CheckpointManager::CheckpointManager(WAL* wal, TransactionManager* txn_mgr, StorageEngine* storage)
-    : wal_(wal), txn_mgr_(txn_mgr), storage_(storage) {
+CheckpointManager::CheckpointManager(WAL* wal, TransactionManager* txn_mgr, StorageBackend* storage)
+    : wal_(wal), txn_mgr_(txn_mgr), storage_(storage),
+      checkpoint_count_(0), last_time_ms_(0), last_duration_us_(0), last_wal_bytes_(0) {
 }
 
 bool CheckpointManager::create_checkpoint() {
@@ -19,45 +21,54 @@ bool CheckpointManager::create_checkpoint() {
     if (!wal_ || !txn_mgr_ || !storage_) return false;
     
     std::cout << "Starting checkpoint..." << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t wal_bytes = wal_->get_bytes_written();
     
-    // 0. 將數據刷盤 (確保檢查點之前的數據已持久化)
-    // 這是關鍵步驟，必須在截斷 WAL 之前執行
-    if (!storage_->flush()) {
-        std::cerr << "Checkpoint failed: storage flush error" << std::endl;
+    // 模糊檢查點：寫快照期間不阻塞讀寫，恢復時從快照 LSN 開始重放日誌修正快照中的不一致
+    // 快照之前捕獲快照 LSN：小於它的日誌（包括已提交的自動提交操作）的效果都已在存儲中
+    uint64_t snapshot_lsn = txn_mgr_->get_min_active_lsn();
+    
+    // 1. 寫入 CHECKPOINT_BEGIN 日誌記錄
+    LogRecord begin_record(LogRecordType::CHECKPOINT_BEGIN, 0, "", std::to_string(snapshot_lsn));
+    uint64_t begin_lsn = wal_->append(begin_record);
+    
+    // 2. 寫出快照，寫操作照常進行
+    // 快照可能包含尚未落盤的日誌的效果，替換數據文件之前先持久化日誌（先寫日誌原則）
+    WAL* wal = wal_;
+    if (!storage_->write_snapshot(snapshot_lsn, [wal]() { return wal->flush(); })) {
+        std::cerr << "Checkpoint failed: snapshot write error" << std::endl;
         return false;
     }
     
-    // 1. 獲取當前所有活躍事務
+    // 3. 獲取當前所有活躍事務
     std::vector<Transaction*> active_txns = txn_mgr_->get_active_transactions();
-    
-    // 2. 構造活躍事務列表字符串（簡單序列化）
     std::stringstream ss;
     for (size_t i = 0; i < active_txns.size(); ++i) {
         ss << active_txns[i]->get_id();
         if (i < active_txns.size() - 1) ss << ",";
     }
     
-    // 3. 寫入 CHECKPOINT 日誌記錄
-    LogRecord record(LogRecordType::CHECKPOINT, 0, ss.str());
-    uint64_t cp_lsn = wal_->append(record);
+    // 4. 寫入 CHECKPOINT 結束記錄：恢復需要覆蓋從快照 LSN 開始的日誌
+    LogRecord end_record(LogRecordType::CHECKPOINT, 0, ss.str(),
+                         std::to_string(snapshot_lsn) + "-" + std::to_string(begin_lsn));
+    uint64_t end_lsn = wal_->append(end_record);
     wal_->flush();
     
-    // 4. 截斷 WAL
-    // 找出活躍事務中最老的 LSN
-    uint64_t min_lsn = cp_lsn;
-    for (auto txn : active_txns) {
-        if (txn->get_start_lsn() < min_lsn && txn->get_start_lsn() > 0) {
-            min_lsn = txn->get_start_lsn();
-        }
-    }
-    
-    std::cout << "Checkpoint created at LSN " << cp_lsn << ", min active LSN " << min_lsn << std::endl;
+    std::cout << "Checkpoint created at LSN " << begin_lsn << "-" << end_lsn
+              << ", snapshot LSN " << snapshot_lsn << std::endl;
     
-    // 截斷 min_lsn 之前的日誌
-    if (min_lsn > 1) {
-        wal_->truncate(min_lsn);
+    // 5. 截斷 WAL：快照 LSN 不大於開始記錄的 LSN，只刪除它之前的日誌
+    if (snapshot_lsn > 1) {
+        wal_->truncate(snapshot_lsn);
     }
     
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    last_duration_us_ = static_cast<uint64_t>(elapsed.count());
+    last_time_ms_ = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    last_wal_bytes_ = wal_bytes;
+    checkpoint_count_++;
     return true;
 }
 
@@ -10,9 +10,10 @@
 #include <string>
 #include <mutex>
 #include <vector>
+#include <atomic>
 #include "wal.h"
 #include "transaction_manager.h"
-#include "storage_engine.h"
+#include "storage_backend.h"
 
 namespace kvengine {
 
@@ -28,20 +29,46 @@ public:
      * @param txn_mgr 事務管理器指針
      * @param storage 存儲引擎指針
      */
-    CheckpointManager(WAL* wal, TransactionManager* txn_mgr, StorageEngine* storage);
+    CheckpointManager(WAL* wal, TransactionManager* txn_mgr, StorageBackend* storage);
     
     /**
-     * @brief 執行檢查點
-     * @details 將內存數據刷盤，記錄活躍事務，並截斷 WAL
+     * @brief 執行模糊檢查點
+     * @details 寫入 CHECKPOINT_BEGIN，在不阻塞寫操作的情況下寫出快照，
+     *          寫入帶有快照 LSN 的 CHECKPOINT 結束記錄，並把 WAL 截斷到快照 LSN
      * @return 成功返回 true
      */
     bool create_checkpoint();
     
+    /**
+     * @brief 獲取已完成的檢查點次數
+     */
+    uint64_t get_checkpoint_count() const { return checkpoint_count_; }
+    
+    /**
+     * @brief 獲取上次檢查點完成的時間（Unix 毫秒，沒有檢查點時為 0）
+     */
+    uint64_t get_last_checkpoint_time_ms() const { return last_time_ms_; }
+    
+    /**
+     * @brief 獲取上次檢查點的耗時（微秒）
+     */
+    uint64_t get_last_checkpoint_duration_us() const { return last_duration_us_; }
+    
+    /**
+     * @brief 獲取上次檢查點開始時 WAL 已寫入的字節數
+     * @details 與 WAL::get_bytes_written 相減即為檢查點之後新增的日誌量
+     */
+    uint64_t get_last_checkpoint_wal_bytes() const { return last_wal_bytes_; }
+    
 private:
     WAL* wal_;
     TransactionManager* txn_mgr_;
-    StorageEngine* storage_;
+    StorageBackend* storage_;
     std::mutex mutex_;
+    std::atomic<uint64_t> checkpoint_count_;   // 已完成的檢查點次數
+    std::atomic<uint64_t> last_time_ms_;       // 上次完成時間（Unix 毫秒）
+    std::atomic<uint64_t> last_duration_us_;   // 上次耗時（微秒）
+    std::atomic<uint64_t> last_wal_bytes_;     // 上次開始時的 WAL 寫入字節數
 };
 
 } // namespace kvengine
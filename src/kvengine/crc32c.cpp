@@ -0,0 +1,192 @@
+/**
+ * @file crc32c.cpp
+ * @brief CRC32C 實現文件
+ */
+
+#include "crc32c.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define KVENGINE_CRC32C_X86 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define KVENGINE_TARGET_SSE42
+#else
+#define KVENGINE_TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+#elif defined(__aarch64__) && (defined(__linux__) || defined(__APPLE__))
+#define KVENGINE_CRC32C_ARM64 1
+#include <arm_acle.h>
+#ifdef __linux__
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+#ifdef __clang__
+#define KVENGINE_TARGET_CRC __attribute__((target("crc")))
+#else
+#define KVENGINE_TARGET_CRC __attribute__((target("+crc")))
+#endif
+#endif
+
+namespace kvengine {
+
+// 反射多項式 0x1EDC6F41
+static const uint32_t CRC32C_POLY = 0x82F63B78;
+
+// ===== 可移植實現：slicing-by-8 =====
+
+struct Crc32cTables {
+    uint32_t table[8][256];
+
+    Crc32cTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+            }
+            table[0][i] = crc;
+        }
+        // table[k][i]：字節 i 之後再經過 k 個零字節的 CRC
+        for (int k = 1; k < 8; ++k) {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t prev = table[k - 1][i];
+                table[k][i] = (prev >> 8) ^ table[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+static const Crc32cTables& tables() {
+    static const Crc32cTables instance;
+    return instance;
+}
+
+static inline uint32_t load_le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) |
+           (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint32_t crc32c_extend_portable(uint32_t crc, const uint8_t* data, size_t length) {
+    const auto& t = tables().table;
+    uint32_t c = ~crc;
+
+    while (length >= 8) {
+        uint32_t lo = load_le32(data) ^ c;
+        uint32_t hi = load_le32(data + 4);
+        c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^
+            t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+            t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        c = t[0][(c ^ *data++) & 0xFF] ^ (c >> 8);
+    }
+    return ~c;
+}
+
+// ===== 硬件實現 =====
+
+#if defined(KVENGINE_CRC32C_X86)
+
+KVENGINE_TARGET_SSE42
+static uint32_t crc32c_extend_hardware(uint32_t crc, const uint8_t* data, size_t length) {
+    uint64_t c = ~crc;
+
+    // 先處理到 8 字節對齊，再每次處理 8 字節
+    while (length > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+        c = _mm_crc32_u8(static_cast<uint32_t>(c), *data++);
+        --length;
+    }
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        c = _mm_crc32_u8(static_cast<uint32_t>(c), *data++);
+    }
+    return ~static_cast<uint32_t>(c);
+}
+
+static bool detect_hardware() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;  // ECX.SSE4_2
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") != 0;
+#endif
+}
+
+#elif defined(KVENGINE_CRC32C_ARM64)
+
+KVENGINE_TARGET_CRC
+static uint32_t crc32c_extend_hardware(uint32_t crc, const uint8_t* data, size_t length) {
+    uint32_t c = ~crc;
+
+    while (length > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+        c = __crc32cb(c, *data++);
+        --length;
+    }
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        c = __crc32cd(c, word);
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        c = __crc32cb(c, *data++);
+    }
+    return ~c;
+}
+
+static bool detect_hardware() {
+#ifdef __APPLE__
+    return true;  // 所有 Apple arm64 處理器都支持 CRC 指令
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+}
+
+#else
+
+static uint32_t crc32c_extend_hardware(uint32_t crc, const uint8_t* data, size_t length) {
+    return crc32c_extend_portable(crc, data, length);
+}
+
+static bool detect_hardware() {
+    return false;
+}
+
+#endif
+
+// ===== 運行時分派 =====
+
+typedef uint32_t (*Crc32cFunction)(uint32_t, const uint8_t*, size_t);
+
+static Crc32cFunction select_function() {
+    return detect_hardware() ? crc32c_extend_hardware : crc32c_extend_portable;
+}
+
+uint32_t crc32c_extend(uint32_t crc, const uint8_t* data, size_t length) {
+    static const Crc32cFunction function = select_function();
+    return function(crc, data, length);
+}
+
+bool crc32c_hardware_accelerated() {
+    static const bool accelerated = detect_hardware();
+    return accelerated;
+}
+
+} // namespace kvengine
@@ -0,0 +1,50 @@
+/**
+ * @file crc32c.h
+ * @brief CRC32C（Castagnoli）校驗和
+ * @details 運行時檢測 CPU：x86-64 使用 SSE4.2 crc32 指令，AArch64 使用 ARMv8 CRC 指令，
+ *          其他平台使用可移植的 slicing-by-8 查表實現
+ */
+
+#ifndef KVENGINE_CRC32C_H
+#define KVENGINE_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kvengine {
+
+/**
+ * @brief 在已有校驗和之後繼續計算 CRC32C
+ * @details crc32c_extend(crc32c_value(a), b) == crc32c_value(a + b)，
+ *          可用於分段計算而無需拼接數據
+ * @param crc 前一段數據的 CRC32C（首段傳 0）
+ * @param data 數據
+ * @param length 數據長度
+ * @return 累計的 CRC32C
+ */
+uint32_t crc32c_extend(uint32_t crc, const uint8_t* data, size_t length);
+
+/**
+ * @brief 計算一段數據的 CRC32C
+ * @param data 數據
+ * @param length 數據長度
+ * @return CRC32C
+ */
+inline uint32_t crc32c_value(const uint8_t* data, size_t length) {
+    return crc32c_extend(0, data, length);
+}
+
+/**
+ * @brief 可移植的 slicing-by-8 實現（不使用硬件指令）
+ * @details 與 crc32c_extend 結果相同，供沒有硬件支持的平台及測試使用
+ */
+uint32_t crc32c_extend_portable(uint32_t crc, const uint8_t* data, size_t length);
+
+/**
+ * @brief 當前 CPU 是否使用硬件 CRC32C 指令
+ */
+bool crc32c_hardware_accelerated();
+
+} // namespace kvengine
+
+#endif // KVENGINE_CRC32C_H
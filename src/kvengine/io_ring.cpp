@@ -0,0 +1,394 @@
+/**
+ * @file io_ring.cpp
+ * @brief io_uring 批量 I/O 實現文件
+ */
+
+#include "io_ring.h"
+#include <cerrno>
+#include <cstring>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define KVENGINE_IO_URING 1
+#endif
+
+namespace kvengine {
+
+#if defined(KVENGINE_IO_URING)
+
+// ===== 內核 ABI（與 <linux/io_uring.h> 一致，自行定義以免依賴較新的內核頭文件）=====
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+struct SqringOffsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t flags;
+    uint32_t dropped;
+    uint32_t array;
+    uint32_t resv1;
+    uint64_t resv2;
+};
+
+struct CqringOffsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t overflow;
+    uint32_t cqes;
+    uint32_t flags;
+    uint32_t resv1;
+    uint64_t resv2;
+};
+
+struct UringParams {
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t flags;
+    uint32_t sq_thread_cpu;
+    uint32_t sq_thread_idle;
+    uint32_t features;
+    uint32_t wq_fd;
+    uint32_t resv[3];
+    SqringOffsets sq_off;
+    CqringOffsets cq_off;
+};
+
+struct UringSqe {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t ioprio;
+    int32_t fd;
+    uint64_t off;
+    uint64_t addr;
+    uint32_t len;
+    uint32_t op_flags;
+    uint64_t user_data;
+    uint16_t buf_index;
+    uint16_t personality;
+    int32_t splice_fd_in;
+    uint64_t addr3;
+    uint64_t pad;
+};
+
+struct UringCqe {
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+};
+
+static_assert(sizeof(UringParams) == 120, "io_uring_params layout");
+static_assert(sizeof(UringSqe) == 64, "io_uring_sqe layout");
+static_assert(sizeof(UringCqe) == 16, "io_uring_cqe layout");
+
+static const uint8_t IORING_OP_FSYNC_ = 3;
+static const uint8_t IORING_OP_READ_ = 22;
+static const uint8_t IORING_OP_WRITE_ = 23;
+static const uint8_t IOSQE_IO_LINK_ = 1 << 2;
+static const uint32_t IORING_FSYNC_DATASYNC_ = 1;
+static const uint32_t IORING_ENTER_GETEVENTS_ = 1;
+static const uint32_t IORING_FEAT_SINGLE_MMAP_ = 1 << 0;
+static const uint32_t IORING_FEAT_RW_CUR_POS_ = 1 << 3;   // 5.6 起提供，同時引入了 READ/WRITE 操作碼
+static const uint64_t IORING_OFF_SQ_RING_ = 0;
+static const uint64_t IORING_OFF_CQ_RING_ = 0x8000000ULL;
+static const uint64_t IORING_OFF_SQES_ = 0x10000000ULL;
+
+static int uring_setup(unsigned entries, UringParams* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static void* map_ring(int fd, size_t size, uint64_t offset) {
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                   static_cast<off_t>(offset));
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+static uint32_t* ring_field(void* ring, uint32_t offset) {
+    return reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+#endif
+
+// 同步補完一個請求（短讀寫、被取消或被中斷）；讀到文件末尾時用零填充
+static bool complete_sync(IoRing::Request& request) {
+#if defined(KVENGINE_IO_URING)
+    if (request.op == IoRing::Op::FSYNC) {
+        return fdatasync(request.fd) == 0;
+    }
+    size_t done = request.result > 0 ? static_cast<size_t>(request.result) : 0;
+    uint8_t* buffer = static_cast<uint8_t*>(request.buffer);
+    while (done < request.length) {
+        ssize_t n = request.op == IoRing::Op::READ
+            ? ::pread(request.fd, buffer + done, request.length - done, static_cast<off_t>(request.offset + done))
+            : ::pwrite(request.fd, buffer + done, request.length - done, static_cast<off_t>(request.offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0 && request.op == IoRing::Op::READ) {
+            memset(buffer + done, 0, request.length - done);
+            break;
+        }
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    request.result = static_cast<int64_t>(request.length);
+    return true;
+#else
+    (void)request;
+    return false;
+#endif
+}
+
+IoRing::IoRing()
+    : fd_(-1),
+      sq_entries_(0),
+      cq_entries_(0),
+      in_flight_(0),
+      sq_ring_(nullptr),
+      sq_ring_size_(0),
+      cq_ring_(nullptr),
+      cq_ring_size_(0),
+      sqes_(nullptr),
+      sqes_size_(0),
+      sq_head_(nullptr),
+      sq_tail_(nullptr),
+      sq_mask_(nullptr),
+      sq_array_(nullptr),
+      cq_head_(nullptr),
+      cq_tail_(nullptr),
+      cq_mask_(nullptr),
+      cqes_(nullptr) {
+}
+
+IoRing::~IoRing() {
+    close();
+}
+
+bool IoRing::initialize(unsigned depth) {
+#if defined(KVENGINE_IO_URING)
+    close();
+    UringParams params;
+    memset(&params, 0, sizeof(params));
+    int fd = uring_setup(depth, &params);
+    if (fd < 0) {
+        // ENOSYS（內核過舊）、EPERM（被 seccomp 或 io_uring_disabled 禁用）等
+        return false;
+    }
+    fd_ = fd;
+    if ((params.features & IORING_FEAT_RW_CUR_POS_) == 0) {
+        close();
+        return false;
+    }
+
+    sq_entries_ = params.sq_entries;
+    cq_entries_ = params.cq_entries;
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(UringCqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP_) != 0;
+    if (single_mmap && cq_ring_size_ > sq_ring_size_) {
+        sq_ring_size_ = cq_ring_size_;
+    }
+    sq_ring_ = map_ring(fd_, sq_ring_size_, IORING_OFF_SQ_RING_);
+    if (sq_ring_ && single_mmap) {
+        cq_ring_ = sq_ring_;
+        cq_ring_size_ = 0;
+    } else if (sq_ring_) {
+        cq_ring_ = map_ring(fd_, cq_ring_size_, IORING_OFF_CQ_RING_);
+    }
+    sqes_size_ = params.sq_entries * sizeof(UringSqe);
+    sqes_ = map_ring(fd_, sqes_size_, IORING_OFF_SQES_);
+    if (!sq_ring_ || !cq_ring_ || !sqes_) {
+        close();
+        return false;
+    }
+
+    sq_head_ = ring_field(sq_ring_, params.sq_off.head);
+    sq_tail_ = ring_field(sq_ring_, params.sq_off.tail);
+    sq_mask_ = ring_field(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = ring_field(sq_ring_, params.sq_off.array);
+    cq_head_ = ring_field(cq_ring_, params.cq_off.head);
+    cq_tail_ = ring_field(cq_ring_, params.cq_off.tail);
+    cq_mask_ = ring_field(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = static_cast<uint8_t*>(cq_ring_) + params.cq_off.cqes;
+    in_flight_ = 0;
+    return true;
+#else
+    (void)depth;
+    return false;
+#endif
+}
+
+void IoRing::close() {
+#if defined(KVENGINE_IO_URING)
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+#endif
+    sq_ring_ = nullptr;
+    cq_ring_ = nullptr;
+    sqes_ = nullptr;
+    fd_ = -1;
+    in_flight_ = 0;
+}
+
+size_t IoRing::submit(Request* requests, size_t count) {
+#if defined(KVENGINE_IO_URING)
+    if (fd_ < 0) {
+        return 0;
+    }
+    // 完成隊列至少是提交隊列的兩倍，在途請求不超過提交隊列長度就不會溢出
+    size_t room = sq_entries_ - in_flight_;
+    if (count > room) {
+        // 不拆開鏈接組：退回到最後一個不帶 link 的請求之後
+        while (room > 0 && requests[room - 1].link) {
+            --room;
+        }
+        count = room;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    uint32_t tail = *sq_tail_;
+    uint32_t mask = *sq_mask_;
+    UringSqe* sqes = static_cast<UringSqe*>(sqes_);
+    for (size_t i = 0; i < count; ++i) {
+        Request& request = requests[i];
+        uint32_t index = (tail + static_cast<uint32_t>(i)) & mask;
+        UringSqe& sqe = sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.fd = request.fd;
+        sqe.user_data = reinterpret_cast<uint64_t>(&request);
+        sqe.flags = request.link ? IOSQE_IO_LINK_ : 0;
+        if (request.op == Op::FSYNC) {
+            sqe.opcode = IORING_OP_FSYNC_;
+            sqe.op_flags = IORING_FSYNC_DATASYNC_;
+        } else {
+            sqe.opcode = request.op == Op::READ ? IORING_OP_READ_ : IORING_OP_WRITE_;
+            sqe.addr = reinterpret_cast<uint64_t>(request.buffer);
+            sqe.len = static_cast<uint32_t>(request.length);
+            sqe.off = request.offset;
+        }
+        sq_array_[index] = index;
+        request.result = 0;
+    }
+    // 內核在看到新的 tail 之前必須能看到 SQE 的內容
+    __atomic_store_n(sq_tail_, tail + static_cast<uint32_t>(count), __ATOMIC_RELEASE);
+
+    size_t submitted = 0;
+    while (submitted < count) {
+        int n = uring_enter(fd_, static_cast<unsigned>(count - submitted), 0, 0);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            // 內核只在 io_uring_enter 中讀取 tail：收回未被消費的 SQE，以免下次提交時重複執行
+            __atomic_store_n(sq_tail_, tail + static_cast<uint32_t>(submitted), __ATOMIC_RELEASE);
+            break;
+        }
+        submitted += static_cast<size_t>(n);
+    }
+    in_flight_ += submitted;
+    return submitted;
+#else
+    (void)requests;
+    (void)count;
+    return 0;
+#endif
+}
+
+size_t IoRing::reap(size_t min_complete) {
+#if defined(KVENGINE_IO_URING)
+    if (fd_ < 0) {
+        return 0;
+    }
+    if (min_complete > in_flight_) {
+        min_complete = in_flight_;
+    }
+    size_t reaped = 0;
+    for (;;) {
+        uint32_t head = *cq_head_;
+        uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        uint32_t mask = *cq_mask_;
+        const UringCqe* cqes = static_cast<const UringCqe*>(cqes_);
+        for (; head != tail; ++head) {
+            const UringCqe& cqe = cqes[head & mask];
+            Request* request = reinterpret_cast<Request*>(cqe.user_data);
+            request->result = cqe.res;
+            ++reaped;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        if (reaped >= min_complete) {
+            break;
+        }
+        int n = uring_enter(fd_, 0, static_cast<unsigned>(min_complete - reaped), IORING_ENTER_GETEVENTS_);
+        if (n < 0 && errno != EINTR && errno != EAGAIN) {
+            break;
+        }
+    }
+    in_flight_ -= reaped;
+    return reaped;
+#else
+    (void)min_complete;
+    return 0;
+#endif
+}
+
+bool IoRing::run(Request* requests, size_t count) {
+    size_t next = 0;
+    size_t done = 0;
+    while (done < count) {
+        if (next < count) {
+            size_t submitted = submit(requests + next, count - next);
+            if (submitted == 0 && in_flight_ == 0) {
+                // 提交失敗：剩餘請求全部同步執行
+                for (size_t i = next; i < count; ++i) {
+                    requests[i].result = -ECANCELED;
+                }
+                done += count - next;
+                next = count;
+                break;
+            }
+            next += submitted;
+        }
+        done += reap(1);
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < count; ++i) {
+        Request& request = requests[i];
+        bool complete = request.op == Op::FSYNC ? request.result == 0
+                                                : request.result == static_cast<int64_t>(request.length);
+        if (complete) {
+            continue;
+        }
+        // 短讀寫、鏈中被取消或被中斷的請求同步補完；其他錯誤（如 EIO）直接失敗
+        bool retry = request.result >= 0 || request.result == -ECANCELED ||
+                     request.result == -EINTR || request.result == -EAGAIN;
+        if (!retry || !complete_sync(request)) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+} // namespace kvengine
@@ -1,28 +1,41 @@
 #include "../include/kvengine/kv_engine.h"
-#include "storage_engine.h"
-#include "hash_index.h"
+#include "storage_backend.h"
 #include "memory_manager.h"
 #include "wal.h"
 #include "lock_manager.h"
 #include "transaction_manager.h"
 #include "checkpoint_manager.h"
 #include "recovery_manager.h"
+#include "log_tailer.h"
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <algorithm>
 
 namespace kvengine {
 
+// 自動檢查點線程檢查觸發條件的週期上限（毫秒）
+static const uint32_t CHECKPOINT_POLL_MS = 100;
+
 // Private implementation (Pimpl idiom)
 class KvEngine::Impl {
 public:
-    explicit Impl(const std::string& data_dir)
+    Impl(const std::string& data_dir, const Options& options)
         : data_dir_(data_dir),
-          storage_(data_dir),
-          wal_(data_dir),
+          storage_(create_storage_backend(data_dir, options)),
+          wal_(data_dir, options),
           lock_mgr_(),
-          txn_mgr_(&wal_, &lock_mgr_, &storage_),
-          checkpoint_mgr_(&wal_, &txn_mgr_, &storage_),
-          recovery_mgr_(&wal_, &storage_),
+          txn_mgr_(&wal_, &lock_mgr_, storage_.get()),
+          checkpoint_mgr_(&wal_, &txn_mgr_, storage_.get()),
+          recovery_mgr_(&wal_, storage_.get(), options),
+          options_(options),
+          stop_checkpoint_(false),
           is_open_(false) {
+        // 後端自行寫盤之前先持久化日誌，磁盤上的數據總能由日誌解釋
+        storage_->set_before_install([this]() { return wal_.flush(); });
     }
     
     ~Impl() {
@@ -36,7 +49,7 @@ public:
             return true;
         }
         
-        if (!storage_.initialize()) {
+        if (!storage_->initialize()) {
             std::cerr << "Failed to initialize storage engine" << std::endl;
             return false;
         }
@@ -46,14 +59,22 @@ public:
             return false;
         }
         
-        // Perform recovery
-        if (!recovery_mgr_.recover()) {
-            std::cerr << "Recovery failed" << std::endl;
-            return false;
+        if (options_.recovery_lazy) {
+            // 即時打開：後台線程重放日誌，請求訪問的鍵在應答之前按需重放
+            recovery_mgr_.start_lazy(wal_.get_last_lsn(), nullptr, nullptr);
+        } else {
+            // Perform recovery
+            if (!recovery_mgr_.recover()) {
+                std::cerr << "Recovery failed" << std::endl;
+                return false;
+            }
         }
         
-        // Build index from loaded data
-        rebuild_index();
+        // 啟動自動檢查點線程
+        if (options_.checkpoint_wal_bytes > 0 || options_.checkpoint_interval_ms > 0) {
+            stop_checkpoint_ = false;
+            checkpoint_thread_ = std::thread(&Impl::checkpoint_loop, this);
+        }
         
         is_open_ = true;
         return true;
@@ -64,11 +85,18 @@ public:
             return;
         }
         
-        // Create checkpoint before closing
-        checkpoint_mgr_.create_checkpoint();
+        // 先停止自動檢查點線程
+        if (checkpoint_thread_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+                stop_checkpoint_ = true;
+            }
+            checkpoint_cv_.notify_all();
+            checkpoint_thread_.join();
+        }
         
-        // Flush data to disk
-        storage_.flush();
+        // 關閉前寫出檢查點：數據落盤並持久化日誌，不需要再單獨刷新存儲
+        checkpoint();
         wal_.close();
         is_open_ = false;
     }
@@ -82,25 +110,13 @@ public:
             return false;
         }
         
-        // 使用事務進行更新
-        Transaction* txn = txn_mgr_.begin();
-        if (!txn) {
-            return false;
-        }
+        recovery_mgr_.ensure_key(key);
         
-        if (!txn_mgr_.put(txn, key, value)) {
-            txn_mgr_.rollback(txn);
+        // 單鍵更新使用自動提交：只寫一條日誌記錄
+        if (!txn_mgr_.put_autocommit(key, value)) {
             return false;
         }
         
-        if (!txn_mgr_.commit(txn)) {
-            txn_mgr_.rollback(txn);
-            return false;
-        }
-        
-        // Update index (in memory structure)
-        index_.insert(key, 0); 
-        
         // Update statistics
         stats_.total_writes++;
         
@@ -119,8 +135,9 @@ public:
         }
         
         stats_.total_reads++;
+        recovery_mgr_.ensure_key(key);
         
-        if (storage_.get(key, value)) {
+        if (storage_->get(key, value)) {
             return Status::OK();
         }
         
@@ -132,26 +149,10 @@ public:
             return false;
         }
         
-        // 使用事務進行刪除
-        Transaction* txn = txn_mgr_.begin();
-        if (!txn) {
-            return false;
-        }
-        
-        if (!txn_mgr_.remove(txn, key)) {
-            txn_mgr_.rollback(txn);
-            return false;
-        }
-        
-        if (!txn_mgr_.commit(txn)) {
-            txn_mgr_.rollback(txn);
-            return false;
-        }
-        
-        // Remove from index
-        index_.remove(key);
+        recovery_mgr_.ensure_key(key);
         
-        return true;
+        // 單鍵刪除使用自動提交：只寫一條日誌記錄
+        return txn_mgr_.remove_autocommit(key);
     }
     
     bool exists(const std::string& key) {
@@ -159,7 +160,8 @@ public:
             return false;
         }
         
-        return index_.exists(key);
+        recovery_mgr_.ensure_key(key);
+        return storage_->exists(key);
     }
     
     bool batch_put(const std::map<std::string, std::string>& batch) {
@@ -167,6 +169,10 @@ public:
             return false;
         }
         
+        for (const auto& pair : batch) {
+            recovery_mgr_.ensure_key(pair.first);
+        }
+        
         // 開啟一個新事務處理所有批量操作
         Transaction* txn = txn_mgr_.begin();
         if (!txn) {
@@ -189,15 +195,26 @@ public:
             return nullptr;
         }
         
-        return std::unique_ptr<Iterator>(
-            new MapIterator(storage_.get_all_data(), prefix)
-        );
+        // 掃描覆蓋所有鍵，等待後台恢復完成
+        recovery_mgr_.wait();
+        return storage_->new_iterator(prefix);
     }
     
     Statistics get_statistics() const {
         Statistics stats = stats_;
-        stats.total_keys = index_.size();
-        stats.memory_used = storage_.memory_usage();
+        stats.total_keys = storage_->size();
+        stats.memory_used = storage_->memory_usage();
+        stats.wal_group_commits = wal_.get_group_commit_count();
+        stats.wal_group_flushes = wal_.get_group_flush_count();
+        stats.wal_syncs = wal_.get_sync_count();
+        stats.wal_sync_time_us = wal_.get_sync_time_us();
+        stats.checkpoints = checkpoint_mgr_.get_checkpoint_count();
+        stats.last_checkpoint_time_ms = checkpoint_mgr_.get_last_checkpoint_time_ms();
+        stats.last_checkpoint_duration_us = checkpoint_mgr_.get_last_checkpoint_duration_us();
+        stats.recovery_in_progress = recovery_mgr_.is_recovering();
+        stats.recovery_scanned_records = recovery_mgr_.get_scanned_records();
+        stats.recovery_pending_keys = recovery_mgr_.get_pending_keys();
+        stats.recovery_replayed_keys = recovery_mgr_.get_replayed_keys();
         return stats;
     }
     
@@ -206,8 +223,8 @@ public:
             return false;
         }
         
-        checkpoint_mgr_.create_checkpoint();
-        return storage_.flush();
+        // 檢查點寫出模糊快照，不阻塞並發的讀寫
+        return checkpoint();
     }
     
     bool verify_integrity() {
@@ -215,12 +232,14 @@ public:
             return false;
         }
         
-        // Simple integrity check: verify index matches storage
-        auto keys = index_.get_all_keys();
-        for (const auto& key : keys) {
-            if (!storage_.exists(key)) {
-                std::cerr << "Integrity error: key in index but not in storage: " 
-                         << key << std::endl;
+        recovery_mgr_.wait();
+        
+        // 遍歷與點查必須一致：遍歷到的每個鍵都能查到相同的值
+        for (auto iter = storage_->new_iterator(); iter->valid(); iter->next()) {
+            std::string value;
+            if (!storage_->get(iter->key(), value) || value != iter->value()) {
+                std::cerr << "Integrity error: scanned key not readable: " 
+                         << iter->key() << std::endl;
                 return false;
             }
         }
@@ -228,24 +247,145 @@ public:
         return true;
     }
     
+    bool read_snapshot(std::string& contents, uint64_t& snapshot_lsn) {
+        if (!is_open_) {
+            return false;
+        }
+        
+        // 檢查點把當前數據寫入數據文件，並保證快照 LSN 之後的日誌仍然保留
+        if (!checkpoint()) {
+            return false;
+        }
+        return storage_->read_data_file(contents, snapshot_lsn);
+    }
+    
+    std::unique_ptr<LogTailer> tail_log(uint64_t start_lsn) {
+        if (!is_open_) {
+            return nullptr;
+        }
+        
+        return std::unique_ptr<LogTailer>(new WALTailer(&wal_, start_lsn));
+    }
+    
+    uint64_t get_last_lsn() const {
+        return wal_.get_last_lsn();
+    }
+    
+    bool load_snapshot(const std::string& contents, uint64_t& snapshot_lsn) {
+        if (!is_open_) {
+            return false;
+        }
+        
+        recovery_mgr_.wait();
+        return storage_->load_snapshot(contents, snapshot_lsn);
+    }
+    
+    bool apply_replicated(const ReplicationBatch& batch) {
+        if (!is_open_) {
+            return false;
+        }
+        
+        recovery_mgr_.wait();
+        std::vector<WriteOp> ops(batch.writes.size());
+        for (size_t i = 0; i < batch.writes.size(); ++i) {
+            ops[i].key = batch.writes[i].key;
+            ops[i].value = batch.writes[i].value;
+            ops[i].is_delete = batch.writes[i].is_delete;
+        }
+        storage_->apply_batch(ops);
+        stats_.total_writes += batch.writes.size();
+        return true;
+    }
+    
 private:
-    void rebuild_index() {
-        index_.clear();
-        const auto& data = storage_.get_all_data();
-        for (const auto& pair : data) {
-            index_.insert(pair.first, 0);
+    /**
+     * @brief 執行檢查點
+     * @details 快照必須包含所有已提交的寫入，後台恢復完成之前等待
+     */
+    bool checkpoint() {
+        recovery_mgr_.wait();
+        return checkpoint_mgr_.create_checkpoint();
+    }
+    
+    /**
+     * @brief 自動檢查點線程
+     * @details 定期檢查：距上次檢查點（含手動觸發的）不少於最小間隔，且新增的 WAL
+     *          達到字節閾值或經過的時間達到間隔加隨機抖動時，執行一次檢查點
+     */
+    void checkpoint_loop() {
+        std::mt19937 rng(std::random_device{}());
+        auto sample_jitter = [&]() {
+            if (options_.checkpoint_jitter_ms == 0) {
+                return std::chrono::milliseconds(0);
+            }
+            std::uniform_int_distribution<uint32_t> dist(0, options_.checkpoint_jitter_ms);
+            return std::chrono::milliseconds(dist(rng));
+        };
+        
+        const auto poll = std::chrono::milliseconds(
+            std::max<uint32_t>(1, std::min(CHECKPOINT_POLL_MS, options_.checkpoint_min_interval_ms)));
+        const auto min_interval = std::chrono::milliseconds(options_.checkpoint_min_interval_ms);
+        const auto interval = std::chrono::milliseconds(options_.checkpoint_interval_ms);
+        
+        auto last = std::chrono::steady_clock::now();
+        uint64_t seen = checkpoint_mgr_.get_checkpoint_count();
+        auto jitter = sample_jitter();
+        
+        std::unique_lock<std::mutex> lock(checkpoint_mutex_);
+        while (!stop_checkpoint_) {
+            checkpoint_cv_.wait_for(lock, poll, [this]() { return stop_checkpoint_; });
+            if (stop_checkpoint_) {
+                break;
+            }
+            
+            // 手動檢查點同樣重置計時
+            auto now = std::chrono::steady_clock::now();
+            uint64_t count = checkpoint_mgr_.get_checkpoint_count();
+            if (count != seen) {
+                seen = count;
+                last = now;
+            }
+            if (now - last < min_interval) {
+                continue;
+            }
+            
+            bool due = false;
+            if (options_.checkpoint_wal_bytes > 0 &&
+                wal_.get_bytes_written() - checkpoint_mgr_.get_last_checkpoint_wal_bytes() >=
+                    options_.checkpoint_wal_bytes) {
+                due = true;
+            }
+            if (options_.checkpoint_interval_ms > 0 && now - last >= interval + jitter) {
+                due = true;
+            }
+            if (!due) {
+                continue;
+            }
+            
+            lock.unlock();
+            if (!checkpoint()) {
+                std::cerr << "Automatic checkpoint failed" << std::endl;
+            }
+            lock.lock();
+            
+            seen = checkpoint_mgr_.get_checkpoint_count();
+            last = std::chrono::steady_clock::now();
+            jitter = sample_jitter();
         }
-        stats_.total_keys = index_.size();
     }
     
     std::string data_dir_;
-    StorageEngine storage_;
+    std::unique_ptr<StorageBackend> storage_;  // 按配置選擇的存儲後端
     WAL wal_;
     LockManager lock_mgr_;
     TransactionManager txn_mgr_;
     CheckpointManager checkpoint_mgr_;
     RecoveryManager recovery_mgr_;
-    HashIndex index_;
+    Options options_;
+    std::thread checkpoint_thread_;            // 自動檢查點線程
+    std::mutex checkpoint_mutex_;
+    std::condition_variable checkpoint_cv_;
+    bool stop_checkpoint_;
     MemoryManager memory_;
     Statistics stats_;
     bool is_open_;
@@ -253,8 +393,8 @@ private:
 
 // KvEngine implementation
 
-KvEngine::KvEngine(const std::string& data_dir)
-    : impl_(new Impl(data_dir)) {
+KvEngine::KvEngine(const std::string& data_dir, const Options& options)
+    : impl_(new Impl(data_dir, options)) {
 }
 
 KvEngine::~KvEngine() {
@@ -312,4 +452,24 @@ bool KvEngine::verify_integrity() {
     return impl_->verify_integrity();
 }
 
+bool KvEngine::read_snapshot(std::string& contents, uint64_t& snapshot_lsn) {
+    return impl_->read_snapshot(contents, snapshot_lsn);
+}
+
+std::unique_ptr<LogTailer> KvEngine::tail_log(uint64_t start_lsn) {
+    return impl_->tail_log(start_lsn);
+}
+
+uint64_t KvEngine::get_last_lsn() const {
+    return impl_->get_last_lsn();
+}
+
+bool KvEngine::load_snapshot(const std::string& contents, uint64_t& snapshot_lsn) {
+    return impl_->load_snapshot(contents, snapshot_lsn);
+}
+
+bool KvEngine::apply_replicated(const ReplicationBatch& batch) {
+    return impl_->apply_replicated(batch);
+}
+
 } // namespace kvengine
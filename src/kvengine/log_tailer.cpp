@@ -0,0 +1,153 @@
+/**
+ * @file log_tailer.cpp
+ * @brief 基於 WAL 的日誌跟隨游標實現
+ */
+
+#include "log_tailer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <sstream>
+
+namespace kvengine {
+
+WALTailer::WALTailer(WAL* wal, uint64_t start_lsn)
+    : wal_(wal), next_lsn_(start_lsn > 0 ? start_lsn : 1), lost_(false) {
+}
+
+bool WALTailer::next(ReplicationBatch& batch) {
+    while (read_record()) {
+        const LogRecord& record = record_;
+        switch (record.type) {
+        case LogRecordType::AUTOCOMMIT_PUT:
+        case LogRecordType::AUTOCOMMIT_DELETE: {
+            batch.lsn = record.lsn;
+            batch.writes.assign(1, ReplicationWrite());
+            batch.writes[0].key = record.key;
+            batch.writes[0].is_delete = record.type == LogRecordType::AUTOCOMMIT_DELETE;
+            if (!batch.writes[0].is_delete) {
+                batch.writes[0].value = record.value;
+            }
+            return true;
+        }
+        case LogRecordType::BEGIN:
+        case LogRecordType::PUT:
+        case LogRecordType::DELETE: {
+            auto it = pending_.find(record.txn_id);
+            if (it == pending_.end()) {
+                PendingTxn txn;
+                txn.first_lsn = record.lsn;
+                it = pending_.insert(std::make_pair(record.txn_id, std::move(txn))).first;
+            }
+            if (record.type != LogRecordType::BEGIN) {
+                it->second.writes.push_back(ReplicationWrite());
+                ReplicationWrite& write = it->second.writes.back();
+                write.key = record.key;
+                write.is_delete = record.type == LogRecordType::DELETE;
+                if (!write.is_delete) {
+                    write.value = record.value;
+                }
+            }
+            break;
+        }
+        case LogRecordType::COMMIT:
+        case LogRecordType::ROLLBACK: {
+            auto it = pending_.find(record.txn_id);
+            if (it == pending_.end() || it->second.writes.empty()) {
+                if (it != pending_.end()) {
+                    pending_.erase(it);
+                }
+                break;
+            }
+            batch.lsn = record.lsn;
+            batch.writes = std::move(it->second.writes);
+            pending_.erase(it);
+            if (record.type == LogRecordType::ROLLBACK) {
+                // 運行時的回滾刪除事務寫過的鍵
+                for (auto& write : batch.writes) {
+                    write.value.clear();
+                    write.is_delete = true;
+                }
+            }
+            return true;
+        }
+        case LogRecordType::CHECKPOINT:
+            prune_pending();
+            break;
+        default:
+            break;
+        }
+    }
+    return false;
+}
+
+uint64_t WALTailer::get_resume_lsn() const {
+    uint64_t lsn = next_lsn_;
+    for (const auto& pair : pending_) {
+        lsn = std::min(lsn, pair.second.first_lsn);
+    }
+    return lsn;
+}
+
+bool WALTailer::read_record() {
+    if (lost_) {
+        return false;
+    }
+    if (next_lsn_ > wal_->get_flushed_lsn()) {
+        // 尚未落盤的記錄在主節點崩潰後可能丟失，不發送；請求同步，下一次輪詢再讀
+        uint64_t last_lsn = wal_->get_last_lsn();
+        if (last_lsn >= next_lsn_) {
+            wal_->request_sync(last_lsn);
+        }
+        return false;
+    }
+    if (!reader_) {
+        reader_ = wal_->new_reader(next_lsn_);
+    }
+    if (!reader_->next(record_)) {
+        // 只在有新記錄時重新打開游標
+        if (wal_->get_last_lsn() < next_lsn_) {
+            return false;
+        }
+        if (!wal_->follow(*reader_)) {
+            reader_ = wal_->new_reader(next_lsn_);
+        }
+        if (!reader_->next(record_)) {
+            return false;
+        }
+    }
+    if (record_.lsn != next_lsn_) {
+        lost_ = true;
+        return false;
+    }
+    next_lsn_ = record_.lsn + 1;
+    return true;
+}
+
+void WALTailer::prune_pending() {
+    // CHECKPOINT 記錄：鍵為活躍事務 ID 列表，值為 "快照LSN-開始記錄LSN"
+    size_t dash = record_.value.find('-');
+    if (dash == std::string::npos) {
+        return;
+    }
+    uint64_t begin_lsn = std::strtoull(record_.value.c_str() + dash + 1, nullptr, 10);
+
+    std::set<uint64_t> active;
+    std::stringstream ss(record_.key);
+    std::string id;
+    while (std::getline(ss, id, ',')) {
+        if (!id.empty()) {
+            active.insert(std::strtoull(id.c_str(), nullptr, 10));
+        }
+    }
+
+    for (auto it = pending_.begin(); it != pending_.end();) {
+        if (it->second.first_lsn < begin_lsn && active.count(it->first) == 0) {
+            it = pending_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace kvengine
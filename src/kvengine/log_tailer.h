@@ -0,0 +1,70 @@
+/**
+ * @file log_tailer.h
+ * @brief 基於 WAL 的日誌跟隨游標
+ */
+
+#ifndef KVENGINE_LOG_TAILER_H
+#define KVENGINE_LOG_TAILER_H
+
+#include "../include/kvengine/replication.h"
+#include "wal.h"
+#include <map>
+#include <memory>
+
+namespace kvengine {
+
+/**
+ * @class WALTailer
+ * @brief 按日誌順序把記錄折疊為生效的寫入批次
+ * @details 事務的寫操作緩存到 COMMIT 或 ROLLBACK 記錄；日誌讀完後以 WAL::follow 繼續，
+ *          段被截斷時從下一條 LSN 重新創建游標。LSN 是連續分配的，讀到的 LSN 跳過了
+ *          期望值即說明需要的日誌已被截斷。
+ *          只讀取已持久化（不超過 WAL::get_flushed_lsn）的記錄：從節點不會應用主節點崩潰後
+ *          可能丟失的寫入。追上持久化水位線而日誌中還有更新的記錄時請求寫線程同步
+ */
+class WALTailer : public LogTailer {
+public:
+    /**
+     * @brief 構造函數
+     * @param wal WAL 指針
+     * @param start_lsn 第一條要讀取的記錄
+     */
+    WALTailer(WAL* wal, uint64_t start_lsn);
+
+    bool next(ReplicationBatch& batch) override;
+    uint64_t get_position() const override { return next_lsn_ - 1; }
+    uint64_t get_resume_lsn() const override;
+    bool is_lost() const override { return lost_; }
+
+private:
+    /**
+     * @struct PendingTxn
+     * @brief 尚未結束的事務
+     */
+    struct PendingTxn {
+        uint64_t first_lsn;                      // 讀到的第一條記錄
+        std::vector<ReplicationWrite> writes;    // 按順序的寫操作
+    };
+
+    /**
+     * @brief 讀取下一條已持久化的記錄，必要時跟隨日誌尾部
+     * @return 暫時沒有新的已持久化記錄或日誌已丟失返回 false
+     */
+    bool read_record();
+
+    /**
+     * @brief 丟棄檢查點時已不再活躍的事務（崩潰前未結束、恢復時被撤銷的事務不會有結束記錄）
+     */
+    void prune_pending();
+
+    WAL* wal_;                                   // WAL 指針
+    std::unique_ptr<WAL::Reader> reader_;        // 讀取游標
+    uint64_t next_lsn_;                          // 下一條期望的 LSN
+    bool lost_;                                  // 日誌已被截斷
+    std::map<uint64_t, PendingTxn> pending_;     // 按事務 ID 索引的未結束事務
+    LogRecord record_;                           // 當前記錄（重用字符串容量）
+};
+
+} // namespace kvengine
+
+#endif // KVENGINE_LOG_TAILER_H
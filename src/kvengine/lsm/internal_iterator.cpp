@@ -0,0 +1,66 @@
+/**
+ * @file internal_iterator.cpp
+ * @brief 合併游標實現
+ */
+
+#include "internal_iterator.h"
+
+namespace kvengine {
+namespace lsm {
+
+MergingIterator::MergingIterator(std::vector<std::unique_ptr<InternalIterator>> children)
+    : children_(std::move(children)), current_(-1) {
+}
+
+void MergingIterator::seek_to_first() {
+    for (auto& child : children_) {
+        child->seek_to_first();
+    }
+    find_smallest();
+}
+
+void MergingIterator::seek(const std::string& target) {
+    for (auto& child : children_) {
+        child->seek(target);
+    }
+    find_smallest();
+}
+
+void MergingIterator::next() {
+    if (current_ < 0) {
+        return;
+    }
+    // 跳過所有子游標中的當前鍵，較舊的版本被最新的條目遮蔽
+    std::string key = children_[current_]->key();
+    for (auto& child : children_) {
+        if (child->valid() && child->key() == key) {
+            child->next();
+        }
+    }
+    find_smallest();
+}
+
+bool MergingIterator::corrupted() const {
+    for (const auto& child : children_) {
+        if (child->corrupted()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MergingIterator::find_smallest() {
+    current_ = -1;
+    for (size_t i = 0; i < children_.size(); ++i) {
+        if (!children_[i]->valid()) {
+            continue;
+        }
+        // 嚴格小於：相同的鍵保留排在前面（更新）的子游標
+        if (current_ < 0 || children_[i]->key() < children_[current_]->key()) {
+            current_ = static_cast<int>(i);
+        }
+    }
+}
+
+} // namespace lsm
+} // namespace kvengine
@@ -0,0 +1,78 @@
+/**
+ * @file internal_iterator.h
+ * @brief LSM 內部迭代器
+ * @details 內存表、表文件和層的有序游標，墓碑作為普通條目返回，由上層決定是否跳過
+ */
+
+#ifndef KVENGINE_LSM_INTERNAL_ITERATOR_H
+#define KVENGINE_LSM_INTERNAL_ITERATOR_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kvengine {
+namespace lsm {
+
+/**
+ * @class InternalIterator
+ * @brief 按鍵升序的內部游標，每個鍵最多出現一次
+ */
+class InternalIterator {
+public:
+    virtual ~InternalIterator() = default;
+
+    virtual bool valid() const = 0;
+    virtual void seek_to_first() = 0;
+
+    /**
+     * @brief 定位到第一個不小於 target 的鍵
+     */
+    virtual void seek(const std::string& target) = 0;
+    virtual void next() = 0;
+    virtual const std::string& key() const = 0;
+    virtual const std::string& value() const = 0;
+
+    /**
+     * @brief 當前條目是否為墓碑
+     */
+    virtual bool is_deleted() const = 0;
+
+    /**
+     * @brief 讀取過程中是否遇到損壞的數據
+     */
+    virtual bool corrupted() const { return false; }
+};
+
+/**
+ * @class MergingIterator
+ * @brief 合併多個內部游標
+ * @details 子游標按從新到舊排列；同一個鍵出現在多個子游標中時只返回最新的條目
+ */
+class MergingIterator : public InternalIterator {
+public:
+    explicit MergingIterator(std::vector<std::unique_ptr<InternalIterator>> children);
+
+    bool valid() const override { return current_ >= 0; }
+    void seek_to_first() override;
+    void seek(const std::string& target) override;
+    void next() override;
+    const std::string& key() const override { return children_[current_]->key(); }
+    const std::string& value() const override { return children_[current_]->value(); }
+    bool is_deleted() const override { return children_[current_]->is_deleted(); }
+    bool corrupted() const override;
+
+private:
+    /**
+     * @brief 選出鍵最小的子游標（相同鍵取最新的）
+     */
+    void find_smallest();
+
+    std::vector<std::unique_ptr<InternalIterator>> children_;
+    int current_;    // 當前子游標，-1 表示結束
+};
+
+} // namespace lsm
+} // namespace kvengine
+
+#endif // KVENGINE_LSM_INTERNAL_ITERATOR_H
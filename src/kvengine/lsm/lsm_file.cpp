@@ -0,0 +1,215 @@
+/**
+ * @file lsm_file.cpp
+ * @brief LSM 存儲使用的文件操作實現
+ */
+
+#include "lsm_file.h"
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+namespace kvengine {
+namespace lsm {
+
+// 順序寫緩衝區大小
+static const size_t WRITE_BUFFER_SIZE = 64 * 1024;
+
+WritableFile::WritableFile() : fd_(-1), size_(0) {
+}
+
+WritableFile::~WritableFile() {
+    close();
+}
+
+bool WritableFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    fd_ = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    size_ = 0;
+    buffer_.clear();
+    buffer_.reserve(WRITE_BUFFER_SIZE);
+    return fd_ >= 0;
+}
+
+bool WritableFile::append(const char* data, size_t size) {
+    if (fd_ < 0) {
+        return false;
+    }
+    size_ += size;
+    if (buffer_.size() + size > WRITE_BUFFER_SIZE) {
+        if (!flush_buffer()) {
+            return false;
+        }
+    }
+    buffer_.append(data, size);
+    return true;
+}
+
+bool WritableFile::flush_buffer() {
+    const char* p = buffer_.data();
+    size_t left = buffer_.size();
+    while (left > 0) {
+#ifdef _WIN32
+        int n = _write(fd_, p, static_cast<unsigned int>(left));
+#else
+        ssize_t n = ::write(fd_, p, left);
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    buffer_.clear();
+    return true;
+}
+
+bool WritableFile::sync() {
+    if (fd_ < 0 || !flush_buffer()) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(fd_) == 0;
+#else
+    return ::fsync(fd_) == 0;
+#endif
+}
+
+bool WritableFile::close() {
+    if (fd_ < 0) {
+        return true;
+    }
+    bool ok = flush_buffer();
+#ifdef _WIN32
+    _close(fd_);
+#else
+    ::close(fd_);
+#endif
+    fd_ = -1;
+    return ok;
+}
+
+RandomAccessFile::RandomAccessFile() : fd_(-1), size_(0) {
+}
+
+RandomAccessFile::~RandomAccessFile() {
+    if (fd_ >= 0) {
+#ifdef _WIN32
+        _close(fd_);
+#else
+        ::close(fd_);
+#endif
+    }
+}
+
+bool RandomAccessFile::open(const std::string& path) {
+#ifdef _WIN32
+    fd_ = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+    struct _stat64 st;
+    if (fd_ < 0 || _fstat64(fd_, &st) != 0) return false;
+#else
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd_ < 0 || fstat(fd_, &st) != 0) return false;
+#endif
+    size_ = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+bool RandomAccessFile::read(uint64_t offset, size_t size, std::string& out) const {
+    if (fd_ < 0 || offset + size > size_) {
+        return false;
+    }
+    out.resize(size);
+    char* p = &out[0];
+    while (size > 0) {
+#ifdef _WIN32
+        // Windows 沒有 pread：按偏移重新定位後讀取
+        if (_lseeki64(fd_, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+        int n = _read(fd_, p, static_cast<unsigned int>(size));
+#else
+        ssize_t n = ::pread(fd_, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool create_directory(const std::string& dir) {
+    struct stat info;
+    if (stat(dir.c_str(), &info) == 0) {
+        return true;
+    }
+#ifdef _WIN32
+    return _mkdir(dir.c_str()) == 0;
+#else
+    return mkdir(dir.c_str(), 0755) == 0;
+#endif
+}
+
+std::vector<std::string> list_directory(const std::string& dir) {
+    std::vector<std::string> names;
+#ifdef _WIN32
+    struct _finddata_t info;
+    intptr_t handle = _findfirst((dir + "\\*").c_str(), &info);
+    if (handle == -1) return names;
+    do {
+        names.push_back(info.name);
+    } while (_findnext(handle, &info) == 0);
+    _findclose(handle);
+#else
+    DIR* d = opendir(dir.c_str());
+    if (!d) return names;
+    while (struct dirent* entry = readdir(d)) {
+        names.push_back(entry->d_name);
+    }
+    closedir(d);
+#endif
+    return names;
+}
+
+void sync_directory(const std::string& dir) {
+#ifndef _WIN32
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)dir;
+#endif
+}
+
+bool rename_file(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    std::remove(to.c_str());
+#endif
+    return std::rename(from.c_str(), to.c_str()) == 0;
+}
+
+void remove_file(const std::string& path) {
+    std::remove(path.c_str());
+}
+
+} // namespace lsm
+} // namespace kvengine
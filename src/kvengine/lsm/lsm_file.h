@@ -0,0 +1,132 @@
+/**
+ * @file lsm_file.h
+ * @brief LSM 存儲使用的文件操作
+ * @details 表文件順序寫入、按偏移隨機讀取，以及目錄操作的平台封裝
+ */
+
+#ifndef KVENGINE_LSM_FILE_H
+#define KVENGINE_LSM_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kvengine {
+namespace lsm {
+
+/**
+ * @class WritableFile
+ * @brief 帶緩衝的順序寫文件
+ */
+class WritableFile {
+public:
+    WritableFile();
+    ~WritableFile();
+
+    WritableFile(const WritableFile&) = delete;
+    WritableFile& operator=(const WritableFile&) = delete;
+
+    /**
+     * @brief 創建（截斷）文件
+     * @param path 文件路徑
+     * @return 成功返回 true
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief 追加數據
+     * @return 成功返回 true
+     */
+    bool append(const char* data, size_t size);
+
+    bool append(const std::string& data) { return append(data.data(), data.size()); }
+
+    /**
+     * @brief 寫出緩衝區並落盤
+     * @return 成功返回 true
+     */
+    bool sync();
+
+    /**
+     * @brief 寫出緩衝區並關閉文件（不落盤）
+     * @return 成功返回 true
+     */
+    bool close();
+
+    /**
+     * @brief 已追加的字節數
+     */
+    uint64_t size() const { return size_; }
+
+private:
+    bool flush_buffer();
+
+    int fd_;
+    std::string buffer_;
+    uint64_t size_;
+};
+
+/**
+ * @class RandomAccessFile
+ * @brief 只讀文件，支持多線程按偏移讀取
+ */
+class RandomAccessFile {
+public:
+    RandomAccessFile();
+    ~RandomAccessFile();
+
+    RandomAccessFile(const RandomAccessFile&) = delete;
+    RandomAccessFile& operator=(const RandomAccessFile&) = delete;
+
+    /**
+     * @brief 打開文件
+     * @return 成功返回 true
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief 從 offset 讀取 size 字節
+     * @return 讀滿返回 true
+     */
+    bool read(uint64_t offset, size_t size, std::string& out) const;
+
+    /**
+     * @brief 文件大小
+     */
+    uint64_t size() const { return size_; }
+
+private:
+    int fd_;
+    uint64_t size_;
+};
+
+/**
+ * @brief 創建目錄（已存在時成功）
+ */
+bool create_directory(const std::string& dir);
+
+/**
+ * @brief 列出目錄中的文件名
+ */
+std::vector<std::string> list_directory(const std::string& dir);
+
+/**
+ * @brief 將目錄項落盤，使創建、重命名和刪除持久化
+ */
+void sync_directory(const std::string& dir);
+
+/**
+ * @brief 重命名文件（覆蓋目標）
+ * @return 成功返回 true
+ */
+bool rename_file(const std::string& from, const std::string& to);
+
+/**
+ * @brief 刪除文件
+ */
+void remove_file(const std::string& path);
+
+} // namespace lsm
+} // namespace kvengine
+
+#endif // KVENGINE_LSM_FILE_H
@@ -0,0 +1,947 @@
+/**
+ * @file lsm_tree.cpp
+ * @brief LSM 樹存儲引擎實現
+ */
+
+#include "lsm_tree.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace kvengine {
+namespace lsm {
+
+// MANIFEST 文本格式：
+//   KVLSM 1
+//   snapshot_lsn <LSN>
+//   next_file <編號>
+//   live_keys <鍵數>     （舊文件沒有這一行，打開時遍歷表文件計算）
+//   table <層> <編號>    （每個表文件一行；L0 按從新到舊排列）
+static const char* MANIFEST_HEADER = "KVLSM 1";
+static const char* MANIFEST_FILE = "MANIFEST";
+static const char* TABLE_SUFFIX = ".sst";
+
+// 凍結但尚未刷寫的內存表上限，超過時寫入等待刷寫線程
+static const size_t MAX_IMMUTABLE_MEMTABLES = 2;
+
+namespace {
+
+/**
+ * 串聯一層中互不重疊、按鍵排序的表文件
+ */
+class LevelIterator : public InternalIterator {
+public:
+    explicit LevelIterator(const std::vector<std::shared_ptr<Table>>& tables)
+        : tables_(tables), index_(0), corrupted_(false) {
+    }
+
+    bool valid() const override { return iter_ && iter_->valid(); }
+
+    void seek_to_first() override {
+        open_table(0);
+        if (iter_) iter_->seek_to_first();
+        skip_exhausted();
+    }
+
+    void seek(const std::string& target) override {
+        // 第一個最大鍵不小於 target 的表文件
+        size_t lo = 0;
+        size_t hi = tables_.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (tables_[mid]->get_largest() < target) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        open_table(lo);
+        if (iter_) iter_->seek(target);
+        skip_exhausted();
+    }
+
+    void next() override {
+        iter_->next();
+        skip_exhausted();
+    }
+
+    const std::string& key() const override { return iter_->key(); }
+    const std::string& value() const override { return iter_->value(); }
+    bool is_deleted() const override { return iter_->is_deleted(); }
+    bool corrupted() const override { return corrupted_ || (iter_ && iter_->corrupted()); }
+
+private:
+    void open_table(size_t index) {
+        if (iter_ && iter_->corrupted()) {
+            corrupted_ = true;
+        }
+        index_ = index;
+        iter_.reset();
+        if (index_ < tables_.size()) {
+            iter_ = tables_[index_]->new_iterator();
+        }
+    }
+
+    // 當前表文件讀完時轉到下一個
+    void skip_exhausted() {
+        while (iter_ && !iter_->valid()) {
+            open_table(index_ + 1);
+            if (iter_) iter_->seek_to_first();
+        }
+    }
+
+    std::vector<std::shared_ptr<Table>> tables_;
+    size_t index_;
+    std::unique_ptr<InternalIterator> iter_;
+    bool corrupted_;
+};
+
+/**
+ * 對外的迭代器：跳過墓碑並按前綴過濾
+ */
+class LSMIterator : public Iterator {
+public:
+    LSMIterator(std::unique_ptr<InternalIterator> iter, const std::string& prefix)
+        : iter_(std::move(iter)), prefix_(prefix) {
+        seek_to_first();
+    }
+
+    bool valid() const override {
+        if (!iter_->valid()) {
+            return false;
+        }
+        const std::string& key = iter_->key();
+        return prefix_.empty() ||
+               (key.size() >= prefix_.size() && key.compare(0, prefix_.size(), prefix_) == 0);
+    }
+
+    void next() override {
+        if (iter_->valid()) {
+            iter_->next();
+            skip_deleted();
+        }
+    }
+
+    std::string key() const override { return valid() ? iter_->key() : std::string(); }
+    std::string value() const override { return valid() ? iter_->value() : std::string(); }
+
+    void seek(const std::string& target) override {
+        iter_->seek(target < prefix_ ? prefix_ : target);
+        skip_deleted();
+    }
+
+    void seek_to_first() override {
+        if (prefix_.empty()) {
+            iter_->seek_to_first();
+        } else {
+            iter_->seek(prefix_);
+        }
+        skip_deleted();
+    }
+
+private:
+    void skip_deleted() {
+        while (iter_->valid() && iter_->is_deleted()) {
+            iter_->next();
+        }
+        if (iter_->corrupted()) {
+            std::cerr << "LSM iterator stopped at corrupted table data" << std::endl;
+        }
+    }
+
+    std::unique_ptr<InternalIterator> iter_;
+    std::string prefix_;
+};
+
+bool by_smallest(const std::shared_ptr<Table>& a, const std::shared_ptr<Table>& b) {
+    return a->get_smallest() < b->get_smallest();
+}
+
+} // namespace
+
+LSMTree::LSMTree(const std::string& data_dir, const Options& options)
+    : data_dir_(data_dir),
+      options_(options),
+      mem_(std::make_shared<MemTable>()),
+      current_(std::make_shared<Version>()),
+      frozen_count_(0),
+      flushed_count_(0),
+      compacting_(false),
+      stop_(false),
+      bg_error_(false),
+      snapshot_lsn_(0),
+      next_file_(1),
+      compactions_(0),
+      open_(false) {
+}
+
+LSMTree::~LSMTree() {
+    close();
+}
+
+bool LSMTree::initialize() {
+    if (open_) {
+        return true;
+    }
+    if (!create_directory(data_dir_)) {
+        std::cerr << "Failed to create LSM directory: " << data_dir_ << std::endl;
+        return false;
+    }
+    if (!load_manifest()) {
+        return false;
+    }
+    remove_orphans();
+
+    stop_ = false;
+    bg_error_ = false;
+    flush_thread_ = std::thread(&LSMTree::flush_loop, this);
+    compaction_thread_ = std::thread(&LSMTree::compaction_loop, this);
+    open_ = true;
+    return true;
+}
+
+void LSMTree::close() {
+    if (!open_) {
+        return;
+    }
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    flush_thread_.join();
+    compaction_thread_.join();
+    open_ = false;
+}
+
+void LSMTree::set_before_install(const std::function<bool()>& before_install) {
+    std::lock_guard<std::mutex> lock(manifest_mutex_);
+    before_install_ = before_install;
+}
+
+// ===== 讀寫 =====
+
+bool LSMTree::make_room(std::unique_lock<std::mutex>& lock) {
+    for (;;) {
+        if (bg_error_) {
+            return false;
+        }
+        if (current_->levels[0].size() >= options_.lsm_level0_stop_writes) {
+            // L0 文件過多時每次讀取都要查找所有 L0 文件，等待合併線程追上
+            cv_.wait(lock);
+        } else if (mem_->approximate_bytes() < options_.lsm_memtable_bytes) {
+            return true;
+        } else if (imm_.size() >= MAX_IMMUTABLE_MEMTABLES) {
+            cv_.wait(lock);
+        } else {
+            freeze_memtable();
+            return true;
+        }
+    }
+}
+
+void LSMTree::freeze_memtable() {
+    if (mem_->empty()) {
+        return;
+    }
+    imm_.push_front(mem_);
+    mem_ = std::make_shared<MemTable>();
+    frozen_count_++;
+    cv_.notify_all();
+}
+
+bool LSMTree::put(const std::string& key, const std::string& value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!make_room(lock)) {
+        return false;
+    }
+    mem_->put(key, value);
+    return true;
+}
+
+bool LSMTree::get(const std::string& key, std::string& value) const {
+    std::shared_ptr<Version> version;
+    bool deleted = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (mem_->get(key, value, deleted)) {
+            return !deleted;
+        }
+        for (const auto& imm : imm_) {
+            if (imm->get(key, value, deleted)) {
+                return !deleted;
+            }
+        }
+        version = current_;
+    }
+    // 表文件只讀，查找時不持有鎖
+    if (get_from_tables(*version, key, value, deleted)) {
+        return !deleted;
+    }
+    return false;
+}
+
+bool LSMTree::get_from_tables(const Version& version, const std::string& key,
+                              std::string& value, bool& deleted) {
+    for (const auto& table : version.levels[0]) {
+        if (table->get(key, value, deleted)) {
+            return true;
+        }
+    }
+    for (int level = 1; level < NUM_LEVELS; ++level) {
+        const TableList& tables = version.levels[level];
+        auto it = std::lower_bound(tables.begin(), tables.end(), key,
+                                   [](const std::shared_ptr<Table>& table, const std::string& k) {
+                                       return table->get_largest() < k;
+                                   });
+        if (it != tables.end() && (*it)->get(key, value, deleted)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LSMTree::remove(const std::string& key) {
+    std::string value;
+    if (!get(key, value)) {
+        return false;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!make_room(lock)) {
+        return false;
+    }
+    mem_->remove(key);
+    return true;
+}
+
+void LSMTree::apply_batch(const std::vector<WriteOp>& ops) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!make_room(lock)) {
+        std::cerr << "LSM tree rejected a write batch after a background error" << std::endl;
+        return;
+    }
+    for (const auto& op : ops) {
+        if (op.is_delete) {
+            mem_->remove(op.key);
+        } else {
+            mem_->put(op.key, op.value);
+        }
+    }
+}
+
+bool LSMTree::exists(const std::string& key) const {
+    std::string value;
+    return get(key, value);
+}
+
+std::unique_ptr<Iterator> LSMTree::new_iterator(const std::string& prefix) const {
+    std::vector<std::unique_ptr<InternalIterator>> children;
+    std::shared_ptr<Version> version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 活躍內存表會繼續變化，複製一份；凍結的內存表和表文件不可變，直接引用
+        if (!mem_->empty()) {
+            children.push_back(MemTable::new_iterator(std::make_shared<MemTable>(*mem_)));
+        }
+        for (const auto& imm : imm_) {
+            children.push_back(MemTable::new_iterator(imm));
+        }
+        version = current_;
+    }
+    for (const auto& table : version->levels[0]) {
+        children.push_back(table->new_iterator());
+    }
+    for (int level = 1; level < NUM_LEVELS; ++level) {
+        if (!version->levels[level].empty()) {
+            children.push_back(std::unique_ptr<InternalIterator>(new LevelIterator(version->levels[level])));
+        }
+    }
+    std::unique_ptr<InternalIterator> merged(new MergingIterator(std::move(children)));
+    return std::unique_ptr<Iterator>(new LSMIterator(std::move(merged), prefix));
+}
+
+size_t LSMTree::size() const {
+    // 內存表從新到舊：活躍內存表會繼續變化，複製一份
+    std::vector<std::shared_ptr<const MemTable>> memtables;
+    std::shared_ptr<Version> version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!mem_->empty()) {
+            memtables.push_back(std::make_shared<MemTable>(*mem_));
+        }
+        memtables.insert(memtables.end(), imm_.begin(), imm_.end());
+        version = current_;
+    }
+
+    int64_t count = static_cast<int64_t>(version->live_keys);
+    std::vector<std::shared_ptr<const MemTable>> newer;
+    for (const auto& memtable : memtables) {
+        count += live_keys_delta(*memtable, *version, newer);
+        newer.push_back(memtable);
+    }
+    return count > 0 ? static_cast<size_t>(count) : 0;
+}
+
+int64_t LSMTree::live_keys_delta(const MemTable& memtable, const Version& version,
+                                 const std::vector<std::shared_ptr<const MemTable>>& newer) {
+    int64_t delta = 0;
+    std::string value;
+    for (const auto& entry : memtable.entries()) {
+        bool shadowed = false;
+        for (const auto& other : newer) {
+            if (other->entries().count(entry.first) > 0) {
+                shadowed = true;
+                break;
+            }
+        }
+        if (shadowed) {
+            continue;
+        }
+        bool deleted = false;
+        bool was_live = get_from_tables(version, entry.first, value, deleted) && !deleted;
+        if (entry.second.deleted && was_live) {
+            delta--;
+        } else if (!entry.second.deleted && !was_live) {
+            delta++;
+        }
+    }
+    return delta;
+}
+
+size_t LSMTree::memory_usage() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t total = mem_->approximate_bytes();
+    for (const auto& imm : imm_) {
+        total += imm->approximate_bytes();
+    }
+    for (int level = 0; level < NUM_LEVELS; ++level) {
+        for (const auto& table : current_->levels[level]) {
+            total += table->memory_usage();
+        }
+    }
+    return total;
+}
+
+// ===== 刷寫與快照 =====
+
+bool LSMTree::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    freeze_memtable();
+    uint64_t target = frozen_count_;
+    cv_.wait(lock, [&]() { return flushed_count_ >= target || bg_error_; });
+    return !bg_error_;
+}
+
+bool LSMTree::write_snapshot(uint64_t snapshot_lsn, const std::function<bool()>& before_install) {
+    // 調用者保證 LSN 小於 snapshot_lsn 的寫入都已應用：它們都在當前內存表或更早的表文件中
+    if (!flush()) {
+        return false;
+    }
+    if (before_install && !before_install()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> manifest_lock(manifest_mutex_);
+    std::shared_ptr<Version> version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        version = current_;
+    }
+    if (!write_manifest(*version, snapshot_lsn, next_file_)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot_lsn_ = snapshot_lsn;
+    return true;
+}
+
+uint64_t LSMTree::get_snapshot_lsn() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snapshot_lsn_;
+}
+
+bool LSMTree::read_data_file(std::string& contents, uint64_t& snapshot_lsn) {
+    // 先取快照 LSN 再創建迭代器：迭代器看到的數據不早於快照
+    size_t estimate = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshot_lsn = snapshot_lsn_;
+        estimate = mem_->approximate_bytes();
+        for (const auto& imm : imm_) {
+            estimate += imm->approximate_bytes();
+        }
+        for (int level = 0; level < NUM_LEVELS; ++level) {
+            estimate += level_bytes(*current_, level);
+        }
+    }
+    auto iter = new_iterator();
+    serialize(*iter, snapshot_lsn, estimate, contents);
+    return true;
+}
+
+bool LSMTree::load_snapshot(const std::string& contents, uint64_t& snapshot_lsn) {
+    size_t batch_bytes = std::min<size_t>(options_.lsm_memtable_bytes, SNAPSHOT_BATCH_BYTES);
+    return load_snapshot_batched(contents, snapshot_lsn, SNAPSHOT_BATCH_SIZE, batch_bytes);
+}
+
+void LSMTree::flush_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cv_.wait(lock, [this]() { return stop_ || (!imm_.empty() && !bg_error_); });
+        if (imm_.empty() || bg_error_) {
+            break;
+        }
+        std::shared_ptr<const MemTable> memtable = imm_.back();
+        lock.unlock();
+        bool ok = flush_immutable(memtable);
+        lock.lock();
+        if (!ok) {
+            std::cerr << "LSM tree: failed to flush memtable, rejecting further writes" << std::endl;
+            bg_error_ = true;
+            cv_.notify_all();
+        }
+    }
+}
+
+bool LSMTree::flush_immutable(const std::shared_ptr<const MemTable>& memtable) {
+    // 刷寫線程按從舊到新的順序刷寫，比這個內存表舊的數據都在當前的表文件中；
+    // 合併不改變表文件的內容，安裝時這個變化量仍然成立
+    std::shared_ptr<Version> base;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        base = current_;
+    }
+    int64_t delta = live_keys_delta(*memtable, *base, std::vector<std::shared_ptr<const MemTable>>());
+
+    // L0 保留墓碑：更舊的值可能在任何一層
+    TableList outputs;
+    std::unique_ptr<InternalIterator> iter = MemTable::new_iterator(memtable);
+    iter->seek_to_first();
+    if (!write_tables(iter.get(), nullptr, 0, false, outputs)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> manifest_lock(manifest_mutex_);
+    if (before_install_ && !before_install_()) {
+        for (auto& table : outputs) {
+            table->mark_obsolete();
+        }
+        return false;
+    }
+
+    std::shared_ptr<Version> version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        version = std::make_shared<Version>(*current_);
+    }
+    version->levels[0].insert(version->levels[0].begin(), outputs.begin(), outputs.end());
+    version->live_keys = static_cast<uint64_t>(static_cast<int64_t>(version->live_keys) + delta);
+    if (!write_manifest(*version, snapshot_lsn_, next_file_)) {
+        for (auto& table : outputs) {
+            table->mark_obsolete();
+        }
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_ = version;
+    imm_.pop_back();
+    flushed_count_++;
+    cv_.notify_all();
+    return true;
+}
+
+bool LSMTree::write_tables(InternalIterator* iter, const std::function<bool(const std::string&)>& drop_delete,
+                           uint64_t max_table_bytes, bool abortable, TableList& outputs) {
+    std::unique_ptr<TableBuilder> builder;
+    uint64_t number = 0;
+    bool ok = true;
+
+    auto finish_table = [&]() {
+        bool finished = builder->finish();
+        builder.reset();
+        std::shared_ptr<Table> table = finished ? Table::open(table_path(number), number) : nullptr;
+        if (!table) {
+            return false;
+        }
+        outputs.push_back(table);
+        return true;
+    };
+
+    for (; ok && iter->valid(); iter->next()) {
+        if (abortable && stop_) {
+            ok = false;
+            break;
+        }
+        if (iter->is_deleted() && drop_delete && drop_delete(iter->key())) {
+            continue;
+        }
+        if (!builder) {
+            number = next_file_++;
+            builder.reset(new TableBuilder(table_path(number), options_.lsm_block_bytes,
+                                           options_.lsm_bloom_bits_per_key));
+            ok = builder->open();
+        }
+        ok = ok && builder->add(iter->key(), iter->value(), iter->is_deleted());
+        if (ok && max_table_bytes > 0 && builder->file_size() >= max_table_bytes) {
+            ok = finish_table();
+        }
+    }
+    if (ok && builder) {
+        ok = finish_table();
+    }
+    if (ok && iter->corrupted()) {
+        std::cerr << "LSM tree: input table data is corrupted" << std::endl;
+        ok = false;
+    }
+    if (!ok) {
+        // 未完成的表文件由 TableBuilder 析構時刪除，已完成的在釋放時刪除
+        builder.reset();
+        for (auto& table : outputs) {
+            table->mark_obsolete();
+        }
+        outputs.clear();
+    }
+    return ok;
+}
+
+// ===== 合併 =====
+
+uint64_t LSMTree::level_bytes(const Version& version, int level) const {
+    uint64_t total = 0;
+    for (const auto& table : version.levels[level]) {
+        total += table->get_file_size();
+    }
+    return total;
+}
+
+uint64_t LSMTree::level_limit(int level) const {
+    uint64_t limit = options_.lsm_level1_bytes;
+    for (int i = 1; i < level; ++i) {
+        limit *= options_.lsm_level_multiplier;
+    }
+    return limit;
+}
+
+bool LSMTree::pick_compaction(Compaction& compaction) const {
+    const Version& version = *current_;
+    std::string smallest;
+    std::string largest;
+
+    if (version.levels[0].size() >= options_.lsm_level0_compaction_trigger) {
+        // L0 的文件相互重疊，一次全部合併
+        compaction.level = 0;
+        compaction.inputs = version.levels[0];
+    } else {
+        // 選擇超出大小上限比例最大的層，從上次合併的位置之後輪轉選取一個文件
+        int best = -1;
+        double best_score = 1.0;
+        for (int level = 1; level < NUM_LEVELS - 1; ++level) {
+            double score = static_cast<double>(level_bytes(version, level)) / level_limit(level);
+            if (score > best_score) {
+                best_score = score;
+                best = level;
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+        const TableList& tables = version.levels[best];
+        std::shared_ptr<Table> picked = tables.front();
+        for (const auto& table : tables) {
+            if (table->get_smallest() > compact_pointer_[best]) {
+                picked = table;
+                break;
+            }
+        }
+        compaction.level = best;
+        compaction.inputs.assign(1, picked);
+    }
+
+    smallest = compaction.inputs.front()->get_smallest();
+    largest = compaction.inputs.front()->get_largest();
+    for (const auto& table : compaction.inputs) {
+        smallest = std::min(smallest, table->get_smallest());
+        largest = std::max(largest, table->get_largest());
+    }
+    compaction.next_inputs.clear();
+    for (const auto& table : version.levels[compaction.level + 1]) {
+        if (table->overlaps(smallest, largest)) {
+            compaction.next_inputs.push_back(table);
+        }
+    }
+    return true;
+}
+
+void LSMTree::compaction_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        Compaction compaction;
+        if (bg_error_ || !pick_compaction(compaction)) {
+            cv_.wait(lock);
+            continue;
+        }
+        compacting_ = true;
+        lock.unlock();
+        bool ok = run_compaction(compaction);
+        lock.lock();
+        compacting_ = false;
+        if (!ok && !stop_) {
+            std::cerr << "LSM tree: compaction failed, rejecting further writes" << std::endl;
+            bg_error_ = true;
+        }
+        cv_.notify_all();
+    }
+}
+
+bool LSMTree::run_compaction(const Compaction& compaction) {
+    const int output_level = compaction.level + 1;
+    std::shared_ptr<Version> base;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        base = current_;
+    }
+
+    TableList outputs;
+    if (compaction.level > 0 && compaction.inputs.size() == 1 && compaction.next_inputs.empty()) {
+        // 下一層沒有重疊的文件：直接移動，不重寫數據
+        outputs = compaction.inputs;
+    } else {
+        // 子游標從新到舊：輸入層（L0 本身從新到舊）在前，下一層在後
+        std::vector<std::unique_ptr<InternalIterator>> children;
+        for (const auto& table : compaction.inputs) {
+            children.push_back(table->new_iterator());
+        }
+        if (!compaction.next_inputs.empty()) {
+            children.push_back(std::unique_ptr<InternalIterator>(new LevelIterator(compaction.next_inputs)));
+        }
+        MergingIterator merged(std::move(children));
+        merged.seek_to_first();
+
+        // 更深的層沒有這個鍵時，墓碑已經沒有需要遮蔽的舊值
+        auto drop_delete = [&base, output_level](const std::string& key) {
+            for (int level = output_level + 1; level < NUM_LEVELS; ++level) {
+                for (const auto& table : base->levels[level]) {
+                    if (table->overlaps(key, key)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        };
+        if (!write_tables(&merged, drop_delete, options_.lsm_table_bytes, true, outputs)) {
+            return false;
+        }
+    }
+
+    std::lock_guard<std::mutex> manifest_lock(manifest_mutex_);
+    std::shared_ptr<Version> version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        version = std::make_shared<Version>(*current_);
+    }
+
+    std::set<uint64_t> removed;
+    for (const auto& table : compaction.inputs) {
+        removed.insert(table->get_file_number());
+    }
+    for (const auto& table : compaction.next_inputs) {
+        removed.insert(table->get_file_number());
+    }
+    for (int level : {compaction.level, output_level}) {
+        TableList& tables = version->levels[level];
+        tables.erase(std::remove_if(tables.begin(), tables.end(),
+                                    [&removed](const std::shared_ptr<Table>& table) {
+                                        return removed.count(table->get_file_number()) > 0;
+                                    }),
+                     tables.end());
+    }
+    TableList& target = version->levels[output_level];
+    target.insert(target.end(), outputs.begin(), outputs.end());
+    std::sort(target.begin(), target.end(), by_smallest);
+
+    if (!write_manifest(*version, snapshot_lsn_, next_file_)) {
+        if (outputs != compaction.inputs) {
+            for (auto& table : outputs) {
+                table->mark_obsolete();
+            }
+        }
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_ = version;
+        if (compaction.level > 0) {
+            compact_pointer_[compaction.level] = compaction.inputs.back()->get_largest();
+        }
+    }
+    if (outputs != compaction.inputs) {
+        // 輸入文件在最後一個讀者釋放後刪除
+        for (const auto& table : compaction.inputs) {
+            table->mark_obsolete();
+        }
+        for (const auto& table : compaction.next_inputs) {
+            table->mark_obsolete();
+        }
+    }
+    compactions_++;
+    return true;
+}
+
+void LSMTree::wait_for_background() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() {
+        Compaction compaction;
+        return bg_error_ || stop_ || (imm_.empty() && !compacting_ && !pick_compaction(compaction));
+    });
+}
+
+size_t LSMTree::get_level_files(int level) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_->levels[level].size();
+}
+
+uint64_t LSMTree::get_total_table_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t total = 0;
+    for (int level = 0; level < NUM_LEVELS; ++level) {
+        total += level_bytes(*current_, level);
+    }
+    return total;
+}
+
+// ===== MANIFEST =====
+
+std::string LSMTree::table_path(uint64_t file_number) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%06llu%s", static_cast<unsigned long long>(file_number), TABLE_SUFFIX);
+#ifdef _WIN32
+    return data_dir_ + "\\" + name;
+#else
+    return data_dir_ + "/" + name;
+#endif
+}
+
+bool LSMTree::write_manifest(const Version& version, uint64_t snapshot_lsn, uint64_t next_file) {
+    std::ostringstream oss;
+    oss << MANIFEST_HEADER << "\n";
+    oss << "snapshot_lsn " << snapshot_lsn << "\n";
+    oss << "next_file " << next_file << "\n";
+    oss << "live_keys " << version.live_keys << "\n";
+    for (int level = 0; level < NUM_LEVELS; ++level) {
+        for (const auto& table : version.levels[level]) {
+            oss << "table " << level << " " << table->get_file_number() << "\n";
+        }
+    }
+
+    // 先寫臨時文件並落盤，再原子地替換
+    std::string path = data_dir_ + "/" + MANIFEST_FILE;
+    std::string temp = path + ".tmp";
+    WritableFile file;
+    if (!file.open(temp) || !file.append(oss.str()) || !file.sync() || !file.close() ||
+        !rename_file(temp, path)) {
+        std::cerr << "Failed to write LSM manifest: " << path << std::endl;
+        remove_file(temp);
+        return false;
+    }
+    sync_directory(data_dir_);
+    return true;
+}
+
+bool LSMTree::load_manifest() {
+    std::string path = data_dir_ + "/" + MANIFEST_FILE;
+    std::ifstream ifs(path);
+    if (!ifs.is_open()) {
+        // 新目錄
+        return true;
+    }
+
+    std::string line;
+    if (!std::getline(ifs, line) || line != MANIFEST_HEADER) {
+        std::cerr << "Unsupported LSM manifest: " << path << std::endl;
+        return false;
+    }
+
+    std::shared_ptr<Version> version = std::make_shared<Version>();
+    uint64_t snapshot_lsn = 0;
+    uint64_t next_file = 1;
+    bool has_live_keys = false;
+    while (std::getline(ifs, line)) {
+        std::istringstream iss(line);
+        std::string tag;
+        iss >> tag;
+        if (tag == "snapshot_lsn") {
+            iss >> snapshot_lsn;
+        } else if (tag == "next_file") {
+            iss >> next_file;
+        } else if (tag == "live_keys") {
+            iss >> version->live_keys;
+            has_live_keys = true;
+        } else if (tag == "table") {
+            int level = -1;
+            uint64_t number = 0;
+            iss >> level >> number;
+            if (iss.fail() || level < 0 || level >= NUM_LEVELS) {
+                std::cerr << "Corrupted LSM manifest line: " << line << std::endl;
+                return false;
+            }
+            std::shared_ptr<Table> table = Table::open(table_path(number), number);
+            if (!table) {
+                return false;
+            }
+            version->levels[level].push_back(table);
+            next_file = std::max(next_file, number + 1);
+        } else if (!tag.empty()) {
+            std::cerr << "Corrupted LSM manifest line: " << line << std::endl;
+            return false;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        current_ = version;
+        snapshot_lsn_ = snapshot_lsn;
+        next_file_ = next_file;
+    }
+    if (!has_live_keys) {
+        // 沒有記錄鍵數的舊 MANIFEST：內存表為空，遍歷一次表文件
+        uint64_t count = 0;
+        for (auto iter = new_iterator(); iter->valid(); iter->next()) {
+            count++;
+        }
+        version->live_keys = count;
+    }
+    return true;
+}
+
+void LSMTree::remove_orphans() {
+    // 刷寫或合併中途崩潰留下的表文件不在 MANIFEST 中
+    std::set<uint64_t> live;
+    for (int level = 0; level < NUM_LEVELS; ++level) {
+        for (const auto& table : current_->levels[level]) {
+            live.insert(table->get_file_number());
+        }
+    }
+    const std::string suffix = TABLE_SUFFIX;
+    for (const auto& name : list_directory(data_dir_)) {
+        if (name.size() > suffix.size() &&
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            uint64_t number = std::strtoull(name.c_str(), nullptr, 10);
+            if (live.count(number) == 0) {
+                remove_file(data_dir_ + "/" + name);
+            }
+        } else if (name == std::string(MANIFEST_FILE) + ".tmp") {
+            remove_file(data_dir_ + "/" + name);
+        }
+    }
+}
+
+} // namespace lsm
+} // namespace kvengine
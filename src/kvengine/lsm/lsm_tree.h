@@ -0,0 +1,301 @@
+/**
+ * @file lsm_tree.h
+ * @brief LSM 樹存儲引擎
+ * @details 寫入進入內存表；內存表達到大小上限後凍結，由刷寫線程寫成 L0 表文件；
+ *          合併線程把 L0 合併到 L1，並在某層超過大小上限時把其中一個表文件與下一層
+ *          重疊的表文件歸併（分層合併）。讀取依次查找活躍內存表、凍結的內存表、
+ *          L0（從新到舊）和各層，第一個命中的條目（含刪除墓碑）即為結果。
+ *
+ *          表文件集合記錄在 MANIFEST 中，每次變化時原子地重寫；MANIFEST 同時保存
+ *          最近一次快照的 LSN 和表文件中有效的鍵數。寫入本身不記日誌，崩潰時內存表的內容由引擎的 WAL
+ *          從快照 LSN 開始重放恢復
+ */
+
+#ifndef KVENGINE_LSM_TREE_H
+#define KVENGINE_LSM_TREE_H
+
+#include "../../../include/kvengine/iterator.h"
+#include "../../../include/kvengine/options.h"
+#include "../storage_backend.h"
+#include "memtable.h"
+#include "sstable.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kvengine {
+namespace lsm {
+
+/**
+ * @class LSMTree
+ * @brief LSM 樹
+ * @details 存儲後端之一，數據量不受內存限制；線程安全。表文件的讀取不持有全局鎖
+ */
+class LSMTree : public StorageBackend {
+public:
+    /**
+     * @brief 構造函數
+     * @param data_dir 表文件和 MANIFEST 所在的目錄
+     * @param options 內存表大小、各層大小和合併觸發條件等配置
+     */
+    explicit LSMTree(const std::string& data_dir, const Options& options = Options());
+
+    /**
+     * @brief 析構函數
+     * @details 刷寫內存表並停止後台線程
+     */
+    ~LSMTree() override;
+
+    LSMTree(const LSMTree&) = delete;
+    LSMTree& operator=(const LSMTree&) = delete;
+
+    /**
+     * @brief 打開：讀取 MANIFEST、打開表文件、刪除殘留文件並啟動後台線程
+     * @return 成功返回 true
+     */
+    bool initialize() override;
+
+    /**
+     * @brief 刷寫內存表並停止後台線程
+     */
+    void close();
+
+    /**
+     * @brief 設置表文件安裝之前調用的回調
+     * @details 刷寫線程在新表文件寫入 MANIFEST 之前調用（例如先持久化 WAL），
+     *          保證表文件中的寫入在日誌中都有記錄；返回 false 時推遲安裝
+     */
+    void set_before_install(const std::function<bool()>& before_install) override;
+
+    /**
+     * @brief 插入或更新鍵值對
+     * @return 成功返回 true；後台寫出失敗後返回 false
+     */
+    bool put(const std::string& key, const std::string& value) override;
+
+    /**
+     * @brief 獲取鍵對應的值
+     * @return 找到返回 true
+     */
+    bool get(const std::string& key, std::string& value) const override;
+
+    /**
+     * @brief 刪除鍵值對
+     * @return 鍵存在並已刪除返回 true
+     */
+    bool remove(const std::string& key) override;
+
+    /**
+     * @brief 按順序應用一批寫操作
+     * @details 刪除無條件寫入墓碑；整批只獲取一次鎖，供恢復重做使用
+     */
+    void apply_batch(const std::vector<WriteOp>& ops) override;
+
+    /**
+     * @brief 檢查鍵是否存在
+     */
+    bool exists(const std::string& key) const override;
+
+    /**
+     * @brief 創建有序迭代器
+     * @param prefix 可選的前綴過濾
+     * @details 迭代器看到創建時刻的內存表副本和表文件集合，之後的寫入不可見
+     */
+    std::unique_ptr<Iterator> new_iterator(const std::string& prefix = "") const override;
+
+    /**
+     * @brief 把內存表中的寫入全部刷寫成表文件
+     * @return 成功返回 true
+     */
+    bool flush() override;
+
+    /**
+     * @brief 寫出快照
+     * @param snapshot_lsn 快照 LSN：LSN 小於它的日誌記錄的效果都已包含在存儲中
+     * @param before_install 表文件落盤之後、MANIFEST 更新快照 LSN 之前調用；返回 false 時放棄
+     * @return 成功返回 true
+     * @details 凍結並刷寫當前內存表，寫操作只在凍結時短暫等待；代價與內存表大小成正比，
+     *          與數據總量無關
+     */
+    bool write_snapshot(uint64_t snapshot_lsn, const std::function<bool()>& before_install = nullptr) override;
+
+    /**
+     * @brief MANIFEST 中的快照 LSN
+     */
+    uint64_t get_snapshot_lsn() const override;
+
+    /**
+     * @brief 導出全部數據（數據文件格式）
+     * @details 迭代器引用凍結的內存表和表文件，條目直接寫入 contents；
+     *          按表文件和內存表的大小預留輸出，避免擴容時複製
+     */
+    bool read_data_file(std::string& contents, uint64_t& snapshot_lsn) override;
+
+    /**
+     * @brief 以數據文件格式的內容替換全部數據
+     * @details 與當前數據歸併，只寫入變化的鍵；每批不超過一個內存表的大小，
+     *          apply_batch 在批次之間凍結寫滿的內存表，由刷寫線程寫出
+     */
+    bool load_snapshot(const std::string& contents, uint64_t& snapshot_lsn) override;
+
+    /**
+     * @brief 有效的鍵數
+     * @details 表文件中的鍵數隨版本維護（刷寫時更新，合併不改變）；內存表中的每個鍵在表文件中
+     *          查找一次以確定它改變了哪個鍵的狀態，代價與內存表大小成正比，與數據總量無關
+     */
+    size_t size() const override;
+
+    /**
+     * @brief 內存表以及表文件索引與過濾器佔用的內存
+     */
+    size_t memory_usage() const override;
+
+    /**
+     * @brief 等待沒有待刷寫的內存表、也沒有需要執行的合併
+     */
+    void wait_for_background();
+
+    /**
+     * @brief 某一層的表文件數
+     */
+    size_t get_level_files(int level) const;
+
+    /**
+     * @brief 所有表文件的總字節數
+     */
+    uint64_t get_total_table_bytes() const;
+
+    /**
+     * @brief 已完成的合併次數
+     */
+    uint64_t get_compaction_count() const { return compactions_; }
+
+    static const int NUM_LEVELS = 7;
+
+private:
+    typedef std::vector<std::shared_ptr<Table>> TableList;
+
+    /**
+     * @struct Version
+     * @brief 某一時刻的表文件集合（不可變，寫時複製）
+     * @details levels[0] 按從新到舊排列，可以相互重疊；其他層按最小鍵排序，互不重疊
+     */
+    struct Version {
+        TableList levels[NUM_LEVELS];
+        uint64_t live_keys;      // 表文件中最新條目不是墓碑的鍵數
+
+        Version() : live_keys(0) {}
+    };
+
+    /**
+     * @struct Compaction
+     * @brief 一次合併的輸入
+     */
+    struct Compaction {
+        int level;               // 輸入層，輸出到 level + 1
+        TableList inputs;        // 輸入層的表文件（L0 從新到舊）
+        TableList next_inputs;   // 下一層重疊的表文件
+    };
+
+    void flush_loop();
+    void compaction_loop();
+
+    /**
+     * @brief 把最舊的凍結內存表寫成 L0 表文件
+     */
+    bool flush_immutable(const std::shared_ptr<const MemTable>& memtable);
+
+    /**
+     * @brief 選擇需要的合併；沒有時返回 false（mutex_ 持有）
+     */
+    bool pick_compaction(Compaction& compaction) const;
+
+    /**
+     * @brief 執行合併並安裝結果
+     */
+    bool run_compaction(const Compaction& compaction);
+
+    /**
+     * @brief 把游標剩餘的條目寫成若干表文件
+     * @param iter 輸入游標（已定位）
+     * @param drop_delete 判斷某個鍵的墓碑能否丟棄（可為空，表示全部保留）
+     * @param max_table_bytes 單個表文件的大小上限（0 表示不拆分）
+     * @param abortable 關閉時是否放棄
+     * @param outputs 輸出的表文件
+     * @return 成功返回 true；失敗時已寫出的文件被刪除
+     */
+    bool write_tables(InternalIterator* iter, const std::function<bool(const std::string&)>& drop_delete,
+                      uint64_t max_table_bytes, bool abortable, TableList& outputs);
+
+    /**
+     * @brief 凍結活躍內存表（mutex_ 持有）
+     */
+    void freeze_memtable();
+
+    /**
+     * @brief 為寫入騰出空間（mutex_ 持有）
+     * @details 活躍內存表寫滿時凍結它；凍結的內存表或 L0 文件過多時等待後台線程
+     * @return 後台出錯時返回 false
+     */
+    bool make_room(std::unique_lock<std::mutex>& lock);
+
+    bool write_manifest(const Version& version, uint64_t snapshot_lsn, uint64_t next_file);
+    bool load_manifest();
+    void remove_orphans();
+
+    uint64_t level_bytes(const Version& version, int level) const;
+    uint64_t level_limit(int level) const;
+    std::string table_path(uint64_t file_number) const;
+
+    /**
+     * @brief 查找表文件（不持有 mutex_）
+     */
+    static bool get_from_tables(const Version& version, const std::string& key,
+                                std::string& value, bool& deleted);
+
+    /**
+     * @brief 內存表寫入表文件之後有效鍵數的變化（不持有 mutex_）
+     * @param memtable 內存表
+     * @param version 比內存表舊的表文件集合
+     * @param newer 比內存表新的內存表（其中的鍵以更新的為準，跳過）
+     */
+    static int64_t live_keys_delta(const MemTable& memtable, const Version& version,
+                                   const std::vector<std::shared_ptr<const MemTable>>& newer);
+
+    std::string data_dir_;
+    Options options_;
+    std::function<bool()> before_install_;
+
+    mutable std::mutex mutex_;                              // 保護內存表、凍結列表和當前版本
+    std::condition_variable cv_;                            // 後台工作與寫入等待
+    std::shared_ptr<MemTable> mem_;                         // 活躍內存表
+    std::deque<std::shared_ptr<const MemTable>> imm_;       // 凍結的內存表（從新到舊）
+    std::shared_ptr<Version> current_;                      // 當前表文件集合
+    uint64_t frozen_count_;                                 // 已凍結的內存表數
+    uint64_t flushed_count_;                                // 已刷寫的內存表數
+    bool compacting_;                                       // 合併線程正在工作
+    std::atomic<bool> stop_;                                // 通知後台線程退出
+    bool bg_error_;                                         // 後台寫出失敗，拒絕寫入
+
+    std::mutex manifest_mutex_;                             // 串行化版本安裝與 MANIFEST 寫入
+    uint64_t snapshot_lsn_;                                 // MANIFEST 中的快照 LSN
+    std::atomic<uint64_t> next_file_;                       // 下一個表文件編號
+    std::string compact_pointer_[NUM_LEVELS];               // 各層下一次合併的起始鍵（輪轉）
+    std::atomic<uint64_t> compactions_;
+
+    std::thread flush_thread_;
+    std::thread compaction_thread_;
+    bool open_;
+};
+
+} // namespace lsm
+} // namespace kvengine
+
+#endif // KVENGINE_LSM_TREE_H
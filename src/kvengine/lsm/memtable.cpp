@@ -0,0 +1,78 @@
+/**
+ * @file memtable.cpp
+ * @brief LSM 內存表實現
+ */
+
+#include "memtable.h"
+
+namespace kvengine {
+namespace lsm {
+
+// 每個條目的 map 節點與字符串對象開銷估計
+static const size_t ENTRY_OVERHEAD = 96;
+
+namespace {
+
+class MemTableIterator : public InternalIterator {
+public:
+    explicit MemTableIterator(const std::shared_ptr<const MemTable>& table)
+        : table_(table), it_(table->entries().end()) {
+    }
+
+    bool valid() const override { return it_ != table_->entries().end(); }
+    void seek_to_first() override { it_ = table_->entries().begin(); }
+    void seek(const std::string& target) override { it_ = table_->entries().lower_bound(target); }
+    void next() override { ++it_; }
+    const std::string& key() const override { return it_->first; }
+    const std::string& value() const override { return it_->second.value; }
+    bool is_deleted() const override { return it_->second.deleted; }
+
+private:
+    std::shared_ptr<const MemTable> table_;
+    MemTable::EntryMap::const_iterator it_;
+};
+
+} // namespace
+
+MemTable::MemTable() : bytes_(0) {
+}
+
+void MemTable::put(const std::string& key, const std::string& value) {
+    set(key, value, false);
+}
+
+void MemTable::remove(const std::string& key) {
+    set(key, std::string(), true);
+}
+
+void MemTable::set(const std::string& key, const std::string& value, bool deleted) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        it = entries_.insert(std::make_pair(key, MemEntry())).first;
+        bytes_ += key.size() + ENTRY_OVERHEAD;
+    } else {
+        bytes_ -= it->second.value.size();
+    }
+    it->second.value = value;
+    it->second.deleted = deleted;
+    bytes_ += value.size();
+}
+
+bool MemTable::get(const std::string& key, std::string& value, bool& deleted) const {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return false;
+    }
+    deleted = it->second.deleted;
+    if (!deleted) {
+        value = it->second.value;
+    }
+    return true;
+}
+
+std::unique_ptr<InternalIterator> MemTable::new_iterator(const std::shared_ptr<const MemTable>& owner) {
+    return std::unique_ptr<InternalIterator>(new MemTableIterator(owner));
+}
+
+} // namespace lsm
+} // namespace kvengine
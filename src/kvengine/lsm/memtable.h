@@ -0,0 +1,85 @@
+/**
+ * @file memtable.h
+ * @brief LSM 內存表
+ * @details 最近的寫入（含刪除墓碑）保存在有序 map 中，達到大小上限後凍結為只讀，
+ *          由後台線程寫成 L0 表文件
+ */
+
+#ifndef KVENGINE_LSM_MEMTABLE_H
+#define KVENGINE_LSM_MEMTABLE_H
+
+#include "internal_iterator.h"
+#include <map>
+#include <memory>
+#include <string>
+
+namespace kvengine {
+namespace lsm {
+
+/**
+ * @struct MemEntry
+ * @brief 內存表中一個鍵的最新寫入
+ */
+struct MemEntry {
+    std::string value;    // 值（墓碑時為空）
+    bool deleted;         // 是否為刪除墓碑
+
+    MemEntry() : deleted(false) {}
+};
+
+/**
+ * @class MemTable
+ * @brief 內存表
+ * @details 自身不加鎖：活躍內存表由 LSMTree 的鎖保護，凍結後只讀，可以並發讀取
+ */
+class MemTable {
+public:
+    typedef std::map<std::string, MemEntry> EntryMap;
+
+    MemTable();
+
+    /**
+     * @brief 寫入鍵值對
+     */
+    void put(const std::string& key, const std::string& value);
+
+    /**
+     * @brief 寫入刪除墓碑，遮蔽表文件中更舊的值
+     */
+    void remove(const std::string& key);
+
+    /**
+     * @brief 查找鍵
+     * @param key 鍵
+     * @param value 輸出值
+     * @param deleted 輸出是否為墓碑
+     * @return 內存表中有該鍵（含墓碑）返回 true
+     */
+    bool get(const std::string& key, std::string& value, bool& deleted) const;
+
+    /**
+     * @brief 鍵、值與節點開銷的估計字節數
+     */
+    size_t approximate_bytes() const { return bytes_; }
+
+    bool empty() const { return entries_.empty(); }
+    size_t size() const { return entries_.size(); }
+    const EntryMap& entries() const { return entries_; }
+
+    /**
+     * @brief 創建遍歷內存表的游標
+     * @param owner 持有內存表的共享指針，游標存活期間保持內存表有效
+     */
+    static std::unique_ptr<InternalIterator> new_iterator(const std::shared_ptr<const MemTable>& owner);
+
+private:
+    void set(const std::string& key, const std::string& value, bool deleted);
+
+    EntryMap entries_;
+    size_t bytes_;
+};
+
+} // namespace lsm
+} // namespace kvengine
+
+#endif // KVENGINE_LSM_MEMTABLE_H
@@ -0,0 +1,486 @@
+/**
+ * @file sstable.cpp
+ * @brief LSM 表文件的寫出與讀取
+ */
+
+#include "sstable.h"
+#include "../crc32c.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace kvengine {
+namespace lsm {
+
+// 文件尾: | MetaOffset (8) | MetaSize (8) | IndexOffset (8) | IndexSize (8) |
+//         | FilterOffset (8) | FilterSize (8) | Magic (8) |
+static const uint64_t TABLE_MAGIC = 0x314C42545353564Bull;  // "KVSSTBL1"
+static const size_t FOOTER_SIZE = 56;
+static const size_t BLOCK_TRAILER_SIZE = 4;                 // 塊之後的 CRC32C
+
+// ===== 編碼 =====
+
+static void put_varint64(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+// 解碼 varint，越界或過長時返回 false
+static bool get_varint64(const std::string& in, size_t& pos, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift <= 63 && pos < in.size(); shift += 7) {
+        uint64_t byte = static_cast<uint8_t>(in[pos++]);
+        v |= (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool get_length_prefixed(const std::string& in, size_t& pos, std::string& out) {
+    uint64_t len = 0;
+    if (!get_varint64(in, pos, len) || len > in.size() - pos) {
+        return false;
+    }
+    out.assign(in, pos, static_cast<size_t>(len));
+    pos += static_cast<size_t>(len);
+    return true;
+}
+
+static void put_fixed64(std::string& out, uint64_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+static uint64_t get_fixed64(const char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 解碼數據塊中從 pos 開始的一個條目；key 輸入前一個鍵，輸出當前鍵
+static bool decode_entry(const std::string& block, size_t& pos, std::string& key,
+                         std::string& value, bool& deleted) {
+    uint64_t shared = 0;
+    uint64_t unshared = 0;
+    if (!get_varint64(block, pos, shared) || !get_varint64(block, pos, unshared) ||
+        shared > key.size() || unshared > block.size() - pos) {
+        return false;
+    }
+    key.resize(static_cast<size_t>(shared));
+    key.append(block, pos, static_cast<size_t>(unshared));
+    pos += static_cast<size_t>(unshared);
+    if (pos >= block.size()) {
+        return false;
+    }
+    deleted = block[pos++] != 0;
+    return get_length_prefixed(block, pos, value);
+}
+
+// ===== 布隆過濾器 =====
+
+// 64 位 FNV-1a，高低兩半用於雙重哈希
+static uint64_t bloom_hash64(const char* data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 0x100000001b3ull;
+    }
+    // 最終混合，使高位也充分依賴每個字節
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint32_t bloom_hash(const std::string& key) {
+    uint64_t h = bloom_hash64(key.data(), key.size());
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+// 每個鍵探測 probes 個位：h, h + delta, h + 2 * delta, ...
+static void build_filter(const std::vector<uint32_t>& hashes, uint32_t bits_per_key, std::string& filter) {
+    uint32_t probes = static_cast<uint32_t>(bits_per_key * 69 / 100);  // bits_per_key * ln 2
+    if (probes < 1) probes = 1;
+    if (probes > 30) probes = 30;
+
+    size_t bits = hashes.size() * bits_per_key;
+    if (bits < 64) bits = 64;
+    size_t bytes = (bits + 7) / 8;
+    bits = bytes * 8;
+
+    filter.assign(bytes, '\0');
+    for (uint32_t h : hashes) {
+        uint32_t delta = (h >> 17) | (h << 15);
+        for (uint32_t j = 0; j < probes; ++j) {
+            uint32_t bit = h % bits;
+            filter[bit / 8] |= static_cast<char>(1 << (bit % 8));
+            h += delta;
+        }
+    }
+    filter.push_back(static_cast<char>(probes));
+}
+
+// ===== TableBuilder =====
+
+TableBuilder::TableBuilder(const std::string& path, uint32_t block_bytes, uint32_t bloom_bits_per_key)
+    : path_(path),
+      block_bytes_(block_bytes > 0 ? block_bytes : 4096),
+      bloom_bits_per_key_(bloom_bits_per_key),
+      num_entries_(0),
+      done_(false) {
+}
+
+TableBuilder::~TableBuilder() {
+    if (!done_) {
+        abandon();
+    }
+}
+
+bool TableBuilder::open() {
+    if (!file_.open(path_)) {
+        std::cerr << "Failed to create table file: " << path_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TableBuilder::add(const std::string& key, const std::string& value, bool deleted) {
+    // 與前一個鍵共享的前綴；每個數據塊的第一個鍵完整存儲
+    size_t shared = 0;
+    if (!block_.empty()) {
+        size_t limit = std::min(last_key_.size(), key.size());
+        while (shared < limit && last_key_[shared] == key[shared]) {
+            shared++;
+        }
+    }
+    put_varint64(block_, shared);
+    put_varint64(block_, key.size() - shared);
+    block_.append(key, shared, std::string::npos);
+    block_.push_back(deleted ? 1 : 0);
+    put_varint64(block_, value.size());
+    block_.append(value);
+
+    if (num_entries_ == 0) {
+        smallest_ = key;
+    }
+    last_key_ = key;
+    num_entries_++;
+    if (bloom_bits_per_key_ > 0) {
+        key_hashes_.push_back(bloom_hash(key));
+    }
+
+    if (block_.size() >= block_bytes_) {
+        return flush_block();
+    }
+    return true;
+}
+
+bool TableBuilder::flush_block() {
+    if (block_.empty()) {
+        return true;
+    }
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    if (!write_block(block_, offset, size)) {
+        return false;
+    }
+    put_varint64(index_, last_key_.size());
+    index_.append(last_key_);
+    put_varint64(index_, offset);
+    put_varint64(index_, size);
+    block_.clear();
+    return true;
+}
+
+bool TableBuilder::write_block(const std::string& contents, uint64_t& offset, uint64_t& size) {
+    offset = file_.size();
+    size = contents.size();
+    uint32_t crc = crc32c_value(reinterpret_cast<const uint8_t*>(contents.data()), contents.size());
+    return file_.append(contents) &&
+           file_.append(reinterpret_cast<const char*>(&crc), sizeof(crc));
+}
+
+bool TableBuilder::finish() {
+    if (!flush_block()) {
+        std::cerr << "Failed to write table file: " << path_ << std::endl;
+        return false;
+    }
+
+    std::string filter;
+    if (bloom_bits_per_key_ > 0 && !key_hashes_.empty()) {
+        build_filter(key_hashes_, bloom_bits_per_key_, filter);
+    }
+
+    std::string meta;
+    put_varint64(meta, smallest_.size());
+    meta.append(smallest_);
+    put_varint64(meta, last_key_.size());
+    meta.append(last_key_);
+    put_varint64(meta, num_entries_);
+
+    uint64_t filter_offset = 0, filter_size = 0;
+    uint64_t meta_offset = 0, meta_size = 0;
+    uint64_t index_offset = 0, index_size = 0;
+    std::string footer;
+    bool ok = write_block(filter, filter_offset, filter_size) &&
+              write_block(meta, meta_offset, meta_size) &&
+              write_block(index_, index_offset, index_size);
+    if (ok) {
+        put_fixed64(footer, meta_offset);
+        put_fixed64(footer, meta_size);
+        put_fixed64(footer, index_offset);
+        put_fixed64(footer, index_size);
+        put_fixed64(footer, filter_offset);
+        put_fixed64(footer, filter_size);
+        put_fixed64(footer, TABLE_MAGIC);
+        ok = file_.append(footer) && file_.sync() && file_.close();
+    }
+    if (!ok) {
+        std::cerr << "Failed to write table file: " << path_ << std::endl;
+        return false;
+    }
+    done_ = true;
+    return true;
+}
+
+void TableBuilder::abandon() {
+    file_.close();
+    remove_file(path_);
+    done_ = true;
+}
+
+// ===== Table =====
+
+namespace {
+
+class TableIterator : public InternalIterator {
+public:
+    explicit TableIterator(const std::shared_ptr<const Table>& table)
+        : table_(table), block_index_(0), pos_(0), valid_(false), deleted_(false), corrupted_(false) {
+    }
+
+    bool valid() const override { return valid_; }
+
+    void seek_to_first() override {
+        load_block(0);
+        advance();
+    }
+
+    void seek(const std::string& target) override {
+        load_block(table_->find_block(target));
+        advance();
+        while (valid_ && key_ < target) {
+            advance();
+        }
+    }
+
+    void next() override { advance(); }
+    const std::string& key() const override { return key_; }
+    const std::string& value() const override { return value_; }
+    bool is_deleted() const override { return deleted_; }
+    bool corrupted() const override { return corrupted_; }
+
+private:
+    void load_block(size_t index) {
+        block_index_ = index;
+        block_.clear();
+        pos_ = 0;
+        key_.clear();
+        if (index < table_->num_blocks() && !table_->read_block(index, block_)) {
+            corrupted_ = true;
+            block_index_ = table_->num_blocks();
+        }
+    }
+
+    // 解碼下一個條目，當前塊讀完時加載下一個塊
+    void advance() {
+        while (pos_ >= block_.size()) {
+            if (block_index_ + 1 >= table_->num_blocks() || block_.empty()) {
+                valid_ = false;
+                return;
+            }
+            load_block(block_index_ + 1);
+        }
+        valid_ = decode_entry(block_, pos_, key_, value_, deleted_);
+        if (!valid_) {
+            corrupted_ = true;
+        }
+    }
+
+    std::shared_ptr<const Table> table_;
+    size_t block_index_;
+    std::string block_;
+    size_t pos_;
+    std::string key_;
+    std::string value_;
+    bool valid_;
+    bool deleted_;
+    bool corrupted_;
+};
+
+} // namespace
+
+Table::Table(const std::string& path, uint64_t file_number)
+    : path_(path), file_number_(file_number), num_entries_(0), obsolete_(false) {
+}
+
+Table::~Table() {
+    if (obsolete_) {
+        remove_file(path_);
+    }
+}
+
+std::shared_ptr<Table> Table::open(const std::string& path, uint64_t file_number) {
+    std::shared_ptr<Table> table(new Table(path, file_number));
+    if (!table->load()) {
+        return nullptr;
+    }
+    return table;
+}
+
+bool Table::read_checked(uint64_t offset, uint64_t size, std::string& contents) const {
+    if (!file_.read(offset, static_cast<size_t>(size + BLOCK_TRAILER_SIZE), contents)) {
+        return false;
+    }
+    uint32_t stored = 0;
+    memcpy(&stored, contents.data() + size, sizeof(stored));
+    contents.resize(static_cast<size_t>(size));
+    return crc32c_value(reinterpret_cast<const uint8_t*>(contents.data()), contents.size()) == stored;
+}
+
+bool Table::load() {
+    if (!file_.open(path_)) {
+        std::cerr << "Failed to open table file: " << path_ << std::endl;
+        return false;
+    }
+    std::string footer;
+    if (file_.size() < FOOTER_SIZE || !file_.read(file_.size() - FOOTER_SIZE, FOOTER_SIZE, footer) ||
+        get_fixed64(footer.data() + 48) != TABLE_MAGIC) {
+        std::cerr << "Invalid table file: " << path_ << std::endl;
+        return false;
+    }
+    uint64_t meta_offset = get_fixed64(footer.data());
+    uint64_t meta_size = get_fixed64(footer.data() + 8);
+    uint64_t index_offset = get_fixed64(footer.data() + 16);
+    uint64_t index_size = get_fixed64(footer.data() + 24);
+    uint64_t filter_offset = get_fixed64(footer.data() + 32);
+    uint64_t filter_size = get_fixed64(footer.data() + 40);
+
+    std::string meta;
+    std::string index;
+    if (!read_checked(meta_offset, meta_size, meta) || !read_checked(index_offset, index_size, index) ||
+        !read_checked(filter_offset, filter_size, filter_)) {
+        std::cerr << "Corrupted table metadata: " << path_ << std::endl;
+        return false;
+    }
+
+    size_t pos = 0;
+    if (!get_length_prefixed(meta, pos, smallest_) || !get_length_prefixed(meta, pos, largest_) ||
+        !get_varint64(meta, pos, num_entries_)) {
+        std::cerr << "Corrupted table metadata: " << path_ << std::endl;
+        return false;
+    }
+
+    pos = 0;
+    while (pos < index.size()) {
+        BlockHandle handle;
+        if (!get_length_prefixed(index, pos, handle.last_key) || !get_varint64(index, pos, handle.offset) ||
+            !get_varint64(index, pos, handle.size)) {
+            std::cerr << "Corrupted table index: " << path_ << std::endl;
+            return false;
+        }
+        index_.push_back(std::move(handle));
+    }
+    return true;
+}
+
+bool Table::may_contain(const std::string& key) const {
+    if (filter_.size() < 2) {
+        return true;
+    }
+    size_t bits = (filter_.size() - 1) * 8;
+    uint32_t probes = static_cast<uint8_t>(filter_.back());
+    uint32_t h = bloom_hash(key);
+    uint32_t delta = (h >> 17) | (h << 15);
+    for (uint32_t j = 0; j < probes; ++j) {
+        uint32_t bit = h % bits;
+        if ((filter_[bit / 8] & (1 << (bit % 8))) == 0) {
+            return false;
+        }
+        h += delta;
+    }
+    return true;
+}
+
+size_t Table::find_block(const std::string& key) const {
+    size_t lo = 0;
+    size_t hi = index_.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index_[mid].last_key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool Table::read_block(size_t index, std::string& contents) const {
+    const BlockHandle& handle = index_[index];
+    if (!read_checked(handle.offset, handle.size, contents)) {
+        std::cerr << "Corrupted block " << index << " in table file: " << path_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Table::get(const std::string& key, std::string& value, bool& deleted) const {
+    if (key < smallest_ || largest_ < key || !may_contain(key)) {
+        return false;
+    }
+    size_t index = find_block(key);
+    std::string block;
+    if (index >= index_.size() || !read_block(index, block)) {
+        return false;
+    }
+
+    size_t pos = 0;
+    std::string current;
+    std::string current_value;
+    bool current_deleted = false;
+    while (pos < block.size()) {
+        if (!decode_entry(block, pos, current, current_value, current_deleted)) {
+            std::cerr << "Corrupted block " << index << " in table file: " << path_ << std::endl;
+            return false;
+        }
+        if (current >= key) {
+            if (current != key) {
+                return false;
+            }
+            value.swap(current_value);
+            deleted = current_deleted;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::unique_ptr<InternalIterator> Table::new_iterator() const {
+    return std::unique_ptr<InternalIterator>(new TableIterator(shared_from_this()));
+}
+
+size_t Table::memory_usage() const {
+    size_t total = sizeof(Table) + filter_.size() + smallest_.size() + largest_.size();
+    for (const auto& handle : index_) {
+        total += sizeof(BlockHandle) + handle.last_key.size();
+    }
+    return total;
+}
+
+} // namespace lsm
+} // namespace kvengine
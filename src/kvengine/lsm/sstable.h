@@ -0,0 +1,195 @@
+/**
+ * @file sstable.h
+ * @brief LSM 不可變的有序表文件
+ * @details 文件格式：
+ *          | 數據塊... | 過濾塊 | 元數據塊 | 索引塊 | 文件尾 (56) |
+ *          每個塊之後跟 4 字節 CRC32C。數據塊內的條目按鍵升序，鍵與前一個鍵共享前綴：
+ *          | Shared (varint) | Unshared (varint) | 鍵的非共享部分 | Deleted (1) | ValueLen (varint) | Value |
+ *          索引塊為每個數據塊記錄最後一個鍵和位置；過濾塊是全部鍵的布隆過濾器；
+ *          元數據塊記錄最小鍵、最大鍵和條目數；文件尾記錄三個塊的位置和魔數
+ */
+
+#ifndef KVENGINE_LSM_SSTABLE_H
+#define KVENGINE_LSM_SSTABLE_H
+
+#include "internal_iterator.h"
+#include "lsm_file.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kvengine {
+namespace lsm {
+
+/**
+ * @class TableBuilder
+ * @brief 按鍵升序寫出一個表文件
+ */
+class TableBuilder {
+public:
+    /**
+     * @brief 構造函數
+     * @param path 表文件路徑
+     * @param block_bytes 數據塊的目標大小
+     * @param bloom_bits_per_key 布隆過濾器每鍵位數（0 表示不寫過濾器）
+     */
+    TableBuilder(const std::string& path, uint32_t block_bytes, uint32_t bloom_bits_per_key);
+
+    /**
+     * @brief 析構函數
+     * @details 沒有調用 finish 時刪除未完成的文件
+     */
+    ~TableBuilder();
+
+    /**
+     * @brief 創建文件
+     * @return 成功返回 true
+     */
+    bool open();
+
+    /**
+     * @brief 追加一個條目，鍵必須嚴格遞增
+     * @return 成功返回 true
+     */
+    bool add(const std::string& key, const std::string& value, bool deleted);
+
+    /**
+     * @brief 寫出過濾塊、元數據塊、索引塊和文件尾並落盤
+     * @return 成功返回 true
+     */
+    bool finish();
+
+    /**
+     * @brief 放棄並刪除文件
+     */
+    void abandon();
+
+    /**
+     * @brief 已寫出的字節數（含當前數據塊）
+     */
+    uint64_t file_size() const { return file_.size() + block_.size(); }
+
+    uint64_t num_entries() const { return num_entries_; }
+
+private:
+    bool flush_block();
+    bool write_block(const std::string& contents, uint64_t& offset, uint64_t& size);
+
+    std::string path_;
+    WritableFile file_;
+    uint32_t block_bytes_;
+    uint32_t bloom_bits_per_key_;
+    std::string block_;                  // 當前數據塊
+    std::string index_;                  // 索引塊
+    std::vector<uint32_t> key_hashes_;   // 構造過濾器用的鍵哈希
+    std::string last_key_;
+    std::string smallest_;
+    uint64_t num_entries_;
+    bool done_;
+};
+
+/**
+ * @class Table
+ * @brief 打開的只讀表文件
+ * @details 索引、過濾器和鍵範圍常駐內存，數據塊按需讀取；
+ *          被合併替換後標記為過時，最後一個引用釋放時刪除文件
+ */
+class Table : public std::enable_shared_from_this<Table> {
+public:
+    /**
+     * @brief 打開表文件並加載索引與過濾器
+     * @param path 表文件路徑
+     * @param file_number 文件編號
+     * @return 失敗（文件缺失或損壞）時返回空指針
+     */
+    static std::shared_ptr<Table> open(const std::string& path, uint64_t file_number);
+
+    ~Table();
+
+    Table(const Table&) = delete;
+    Table& operator=(const Table&) = delete;
+
+    /**
+     * @brief 查找鍵
+     * @param key 鍵
+     * @param value 輸出值
+     * @param deleted 輸出是否為墓碑
+     * @return 表中有該鍵（含墓碑）返回 true
+     */
+    bool get(const std::string& key, std::string& value, bool& deleted) const;
+
+    /**
+     * @brief 創建遍歷整個表的游標（游標持有表的引用）
+     */
+    std::unique_ptr<InternalIterator> new_iterator() const;
+
+    /**
+     * @brief 鍵範圍是否與 [smallest, largest] 相交
+     */
+    bool overlaps(const std::string& smallest, const std::string& largest) const {
+        return !(largest_ < smallest || largest < smallest_);
+    }
+
+    /**
+     * @brief 標記為過時：最後一個引用釋放時刪除文件
+     */
+    void mark_obsolete() { obsolete_ = true; }
+
+    uint64_t get_file_number() const { return file_number_; }
+    uint64_t get_file_size() const { return file_.size(); }
+    uint64_t get_num_entries() const { return num_entries_; }
+    const std::string& get_smallest() const { return smallest_; }
+    const std::string& get_largest() const { return largest_; }
+
+    /**
+     * @brief 常駐內存的索引與過濾器字節數
+     */
+    size_t memory_usage() const;
+
+    size_t num_blocks() const { return index_.size(); }
+
+    /**
+     * @brief 第一個最後鍵不小於 key 的數據塊（可能等於 num_blocks()）
+     */
+    size_t find_block(const std::string& key) const;
+
+    /**
+     * @brief 讀取並校驗一個數據塊
+     * @return 讀取失敗或校驗和不符時返回 false
+     */
+    bool read_block(size_t index, std::string& contents) const;
+
+private:
+    /**
+     * @struct BlockHandle
+     * @brief 索引項
+     */
+    struct BlockHandle {
+        std::string last_key;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    Table(const std::string& path, uint64_t file_number);
+
+    bool read_checked(uint64_t offset, uint64_t size, std::string& contents) const;
+    bool load();
+    bool may_contain(const std::string& key) const;
+
+    std::string path_;
+    uint64_t file_number_;
+    RandomAccessFile file_;
+    std::vector<BlockHandle> index_;
+    std::string filter_;          // 布隆過濾器位數組，最後一個字節為哈希次數
+    std::string smallest_;
+    std::string largest_;
+    uint64_t num_entries_;
+    std::atomic<bool> obsolete_;
+};
+
+} // namespace lsm
+} // namespace kvengine
+
+#endif // KVENGINE_LSM_SSTABLE_H
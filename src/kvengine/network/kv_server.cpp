@@ -1,16 +1,31 @@
 #include "kvengine/network/kv_server.h"
 #include "kvengine/network/resp_parser.h"
+#include "kvengine/network/resp_builder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <thread>
 
 namespace kvengine {
 namespace network {
 
 const size_t BUFFER_SIZE = 8192;
 
-KvServer::KvServer(const std::string& data_dir, uint16_t port, const std::string& host)
-    : data_dir_(data_dir), port_(port), host_(host) {
+// 向從節點發送日誌時輪詢新記錄的間隔，以及沒有新記錄時的心跳間隔
+const uint32_t REPLICATION_POLL_MS = 10;
+const uint32_t REPLICATION_HEARTBEAT_MS = 1000;
+
+static std::string to_upper(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(), ::toupper);
+    return str;
+}
+
+KvServer::KvServer(const std::string& data_dir, uint16_t port, const std::string& host,
+                   const Options& options)
+    : data_dir_(data_dir), port_(port), host_(host), stopping_(false), streams_(0) {
     
-    engine_ = std::make_unique<KvEngine>(data_dir_);
+    engine_ = std::make_unique<KvEngine>(data_dir_, options);
     server_ = std::make_unique<TcpServer>(port_, host_);
     // CommandDispatcher requires valid engine pointer, initialized later in start() or here?
     // Engine is not open yet. But pointer is valid.
@@ -50,7 +65,13 @@ bool KvServer::start() {
                                           command, consumed);
                 
                 if (status == RespParser::Status::OK) {
-                    std::string response = dispatcher_->dispatch(command);
+                    if (!command.empty() && to_upper(command[0]) == "PSYNC") {
+                        // 連接轉為複製流，直到從節點斷開
+                        serve_replica(client, command);
+                        client.close();
+                        return;
+                    }
+                    std::string response = handle_command(command);
                     client.send(response.c_str(), response.size());
                     total_consumed += consumed;
                 } else if (status == RespParser::Status::INCOMPLETE) {
@@ -76,11 +97,29 @@ bool KvServer::start() {
          return false;
     }
 
+    stopping_ = false;
     return true;
 }
 
 void KvServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        stopping_ = true;
+    }
+    {
+        // 關閉引擎時的檢查點寫出複製來的數據，不需要經過提升
+        std::lock_guard<std::mutex> lock(replica_mutex_);
+        if (replica_) {
+            replica_->stop();
+            replica_.reset();
+        }
+    }
     server_->stop();
+    {
+        // 複製流持有引擎的日誌游標，關閉引擎前等待它們退出
+        std::unique_lock<std::mutex> lock(streams_mutex_);
+        streams_cv_.wait(lock, [this]() { return streams_ == 0; });
+    }
     engine_->close();
 }
 
@@ -88,5 +127,175 @@ void KvServer::run() {
     server_->run();
 }
 
+void KvServer::replicaof(const std::string& host, uint16_t port) {
+    std::lock_guard<std::mutex> lock(replica_mutex_);
+    if (replica_) {
+        replica_->stop();
+    }
+    replica_.reset(new ReplicaClient(engine_.get(), host, port));
+    replica_->start();
+}
+
+bool KvServer::replicaof_no_one() {
+    std::lock_guard<std::mutex> lock(replica_mutex_);
+    if (!replica_) {
+        return true;
+    }
+    replica_->stop();
+    // 複製來的寫入只應用到了存儲，本地日誌中沒有它們：接受寫入之前寫出檢查點，
+    // 否則提升之後崩潰會丟失所有尚未進入檢查點的複製數據
+    if (!engine_->flush()) {
+        std::cerr << "KvServer: checkpoint before promotion failed" << std::endl;
+        return false;
+    }
+    replica_.reset();
+    return true;
+}
+
+std::string KvServer::handle_command(const std::vector<std::string>& command) {
+    if (command.empty()) {
+        return dispatcher_->dispatch(command);
+    }
+    std::string cmd_name = to_upper(command[0]);
+
+    if (cmd_name == "REPLICAOF" || cmd_name == "SLAVEOF") {
+        if (command.size() != 3) {
+            return RespBuilder::error("ERR wrong number of arguments for 'replicaof' command");
+        }
+        if (to_upper(command[1]) == "NO" && to_upper(command[2]) == "ONE") {
+            if (!replicaof_no_one()) {
+                return RespBuilder::error("ERR failed to persist replicated data before promotion");
+            }
+            return RespBuilder::simple_string("OK");
+        }
+        char* end = nullptr;
+        unsigned long port = std::strtoul(command[2].c_str(), &end, 10);
+        if (command[2].empty() || *end != '\0' || port == 0 || port > 65535) {
+            return RespBuilder::error("ERR Invalid master port");
+        }
+        replicaof(command[1], static_cast<uint16_t>(port));
+        return RespBuilder::simple_string("OK");
+    }
+
+    std::lock_guard<std::mutex> lock(replica_mutex_);
+    if (cmd_name == "ROLE") {
+        std::vector<std::string> role;
+        if (replica_) {
+            role.push_back("slave");
+            role.push_back(replica_->get_host());
+            role.push_back(std::to_string(replica_->get_port()));
+            role.push_back(replica_->get_state_name());
+            role.push_back(std::to_string(replica_->get_applied_lsn()));
+            role.push_back(std::to_string(replica_->get_master_lsn()));
+            role.push_back(std::to_string(replica_->get_lag()));
+        } else {
+            role.push_back("master");
+            role.push_back(std::to_string(engine_->get_last_lsn()));
+        }
+        return RespBuilder::array(role);
+    }
+    if (replica_ && (cmd_name == "SET" || cmd_name == "DEL")) {
+        return RespBuilder::error("READONLY You can't write against a read only replica.");
+    }
+    return dispatcher_->dispatch(command);
+}
+
+void KvServer::serve_replica(Socket& client, const std::vector<std::string>& command) {
+    if (command.size() != 3) {
+        std::string response = RespBuilder::error("ERR wrong number of arguments for 'psync' command");
+        client.send_all(response.c_str(), response.size());
+        return;
+    }
+    {
+        // 從節點的日誌不包含複製來的寫入，不能再作為主節點
+        std::lock_guard<std::mutex> lock(replica_mutex_);
+        if (replica_) {
+            std::string response = RespBuilder::error("ERR PSYNC is not supported on a replica");
+            client.send_all(response.c_str(), response.size());
+            return;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        if (stopping_) {
+            return;
+        }
+        streams_++;
+    }
+
+    uint64_t resume_lsn = std::strtoull(command[1].c_str(), nullptr, 10);
+    uint64_t applied_lsn = std::strtoull(command[2].c_str(), nullptr, 10);
+    bool ok = true;
+
+    if (resume_lsn == 0) {
+        std::string contents;
+        uint64_t snapshot_lsn = 0;
+        ok = engine_->read_snapshot(contents, snapshot_lsn);
+        if (ok) {
+            std::string frame = RespBuilder::array({"FULLRESYNC", contents});
+            ok = client.send_all(frame.c_str(), frame.size());
+            resume_lsn = snapshot_lsn;
+            applied_lsn = snapshot_lsn - 1;
+        } else {
+            std::cerr << "KvServer: failed to create snapshot for replica" << std::endl;
+        }
+    } else {
+        std::string frame = RespBuilder::array({"CONTINUE"});
+        ok = client.send_all(frame.c_str(), frame.size());
+    }
+
+    std::unique_ptr<LogTailer> tailer;
+    if (ok) {
+        tailer = engine_->tail_log(resume_lsn);
+    }
+    uint64_t sent_position = applied_lsn;
+    auto last_frame = std::chrono::steady_clock::now();
+
+    while (tailer && ok && !stopping_) {
+        ReplicationBatch batch;
+        bool has_batch = tailer->next(batch);
+        // 重新連接時跳過從節點已經應用過的批次
+        if (has_batch && batch.lsn <= applied_lsn) {
+            continue;
+        }
+        if (!has_batch && tailer->is_lost()) {
+            std::string frame = RespBuilder::array({"LOST"});
+            client.send_all(frame.c_str(), frame.size());
+            break;
+        }
+
+        uint64_t position = std::max(tailer->get_position(), applied_lsn);
+        auto now = std::chrono::steady_clock::now();
+        if (has_batch || position != sent_position ||
+            now - last_frame >= std::chrono::milliseconds(REPLICATION_HEARTBEAT_MS)) {
+            std::vector<std::string> frame;
+            frame.reserve(4 + batch.writes.size() * 3);
+            frame.push_back("REPL");
+            frame.push_back(std::to_string(position));
+            frame.push_back(std::to_string(tailer->get_resume_lsn()));
+            frame.push_back(std::to_string(engine_->get_last_lsn()));
+            for (auto& write : batch.writes) {
+                frame.push_back(write.is_delete ? "DEL" : "SET");
+                frame.push_back(std::move(write.key));
+                frame.push_back(std::move(write.value));
+            }
+            std::string data = RespBuilder::array(frame);
+            ok = client.send_all(data.c_str(), data.size());
+            sent_position = position;
+            last_frame = now;
+        }
+        if (!has_batch) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(REPLICATION_POLL_MS));
+        }
+    }
+
+    tailer.reset();
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex_);
+        streams_--;
+    }
+    streams_cv_.notify_all();
+}
+
 } // namespace network
 } // namespace kvengine
@@ -0,0 +1,199 @@
+#include "kvengine/network/replica_client.h"
+#include "kvengine/network/resp_builder.h"
+#include "kvengine/network/resp_parser.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace kvengine {
+namespace network {
+
+// 連接失敗或斷開後的重連間隔
+static const uint32_t REPLICA_RETRY_MS = 200;
+static const size_t REPLICA_BUFFER_SIZE = 64 * 1024;
+
+ReplicaClient::ReplicaClient(KvEngine* engine, const std::string& host, uint16_t port)
+    : engine_(engine),
+      host_(host == "localhost" ? "127.0.0.1" : host),
+      port_(port),
+      stop_(false),
+      state_(State::CONNECT),
+      applied_lsn_(0),
+      resume_lsn_(0),
+      master_lsn_(0) {
+}
+
+ReplicaClient::~ReplicaClient() {
+    stop();
+}
+
+void ReplicaClient::start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = false;
+    }
+    thread_ = std::thread(&ReplicaClient::run, this);
+}
+
+void ReplicaClient::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        // 喚醒阻塞在 connect / recv 上的複製線程
+        socket_.shutdown();
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    state_ = State::CONNECT;
+}
+
+std::string ReplicaClient::get_state_name() const {
+    switch (state_.load()) {
+        case State::CONNECTING: return "connecting";
+        case State::SYNC: return "sync";
+        case State::CONNECTED: return "connected";
+        default: return "connect";
+    }
+}
+
+uint64_t ReplicaClient::get_lag() const {
+    uint64_t master = master_lsn_;
+    uint64_t applied = applied_lsn_;
+    return master > applied ? master - applied : 0;
+}
+
+void ReplicaClient::run() {
+    for (;;) {
+        stream();
+        state_ = State::CONNECT;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (cv_.wait_for(lock, std::chrono::milliseconds(REPLICA_RETRY_MS), [this]() { return stop_; })) {
+            break;
+        }
+    }
+}
+
+void ReplicaClient::stream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_ || !socket_.create()) {
+            return;
+        }
+    }
+
+    state_ = State::CONNECTING;
+    if (socket_.connect(host_, port_)) {
+        state_ = State::SYNC;
+        std::vector<std::string> request;
+        request.push_back("PSYNC");
+        request.push_back(std::to_string(resume_lsn_.load()));
+        request.push_back(std::to_string(applied_lsn_.load()));
+        std::string data = RespBuilder::array(request);
+
+        if (socket_.send_all(data.c_str(), data.size())) {
+            std::vector<char> buffer(REPLICA_BUFFER_SIZE);
+            std::string parsing_buffer;
+            RespParser parser;
+            bool open = true;
+
+            while (open) {
+                int bytes_read = socket_.recv(buffer.data(), buffer.size());
+                if (bytes_read <= 0) break;
+                parsing_buffer.append(buffer.data(), bytes_read);
+
+                size_t total_consumed = 0;
+                while (open && total_consumed < parsing_buffer.size()) {
+                    std::vector<std::string> frame;
+                    size_t consumed = 0;
+                    auto status = parser.parse(parsing_buffer.c_str() + total_consumed,
+                                               parsing_buffer.size() - total_consumed,
+                                               frame, consumed);
+                    if (status == RespParser::Status::INCOMPLETE) {
+                        break;
+                    }
+                    if (status != RespParser::Status::OK) {
+                        std::cerr << "Replication: protocol error from " << host_ << ":" << port_ << std::endl;
+                        open = false;
+                        break;
+                    }
+                    total_consumed += consumed;
+                    open = handle_frame(frame);
+                }
+
+                if (total_consumed > 0) {
+                    parsing_buffer.erase(0, total_consumed);
+                }
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    socket_.close();
+}
+
+bool ReplicaClient::handle_frame(const std::vector<std::string>& frame) {
+    if (frame.empty()) {
+        return false;
+    }
+
+    if (frame[0] == "REPL" && frame.size() >= 4 && (frame.size() - 4) % 3 == 0) {
+        ReplicationBatch batch;
+        for (size_t i = 4; i < frame.size(); i += 3) {
+            ReplicationWrite write;
+            write.key = frame[i + 1];
+            write.is_delete = frame[i] == "DEL";
+            if (!write.is_delete) {
+                write.value = frame[i + 2];
+            }
+            batch.writes.push_back(std::move(write));
+        }
+        if (!batch.writes.empty() && !engine_->apply_replicated(batch)) {
+            std::cerr << "Replication: failed to apply writes" << std::endl;
+            return false;
+        }
+        applied_lsn_ = std::strtoull(frame[1].c_str(), nullptr, 10);
+        resume_lsn_ = std::strtoull(frame[2].c_str(), nullptr, 10);
+        master_lsn_ = std::strtoull(frame[3].c_str(), nullptr, 10);
+        return true;
+    }
+
+    if (frame[0] == "FULLRESYNC" && frame.size() == 2) {
+        uint64_t snapshot_lsn = 0;
+        if (!engine_->load_snapshot(frame[1], snapshot_lsn)) {
+            std::cerr << "Replication: failed to load snapshot from " << host_ << ":" << port_ << std::endl;
+            return false;
+        }
+        // 快照包含 LSN 小於快照 LSN 的所有記錄的效果
+        applied_lsn_ = snapshot_lsn > 0 ? snapshot_lsn - 1 : 0;
+        resume_lsn_ = snapshot_lsn;
+        std::cout << "Replication: full resync from " << host_ << ":" << port_
+                  << " at LSN " << snapshot_lsn << std::endl;
+        state_ = State::CONNECTED;
+        return true;
+    }
+
+    if (frame[0] == "CONTINUE" && frame.size() == 1) {
+        std::cout << "Replication: continuing from LSN " << resume_lsn_.load() << std::endl;
+        state_ = State::CONNECTED;
+        return true;
+    }
+
+    if (frame[0] == "LOST") {
+        // 主節點已截斷所需的日誌：下次連接時重新全量同步
+        std::cerr << "Replication: master no longer has the log from LSN " << resume_lsn_.load() << std::endl;
+        resume_lsn_ = 0;
+        return false;
+    }
+
+    std::cerr << "Replication: unexpected frame '" << frame[0] << "'" << std::endl;
+    return false;
+}
+
+} // namespace network
+} // namespace kvengine
@@ -112,11 +112,38 @@ int Socket::send(const char* data, size_t len) {
     return ::send(handle_, data, static_cast<int>(len), 0);
 }
 
+bool Socket::send_all(const char* data, size_t len) {
+    if (!is_valid()) return false;
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    while (len > 0) {
+        int sent = ::send(handle_, data, static_cast<int>(len), flags);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
 int Socket::recv(char* buffer, size_t len) {
     if (!is_valid()) return -1;
     return ::recv(handle_, buffer, static_cast<int>(len), 0);
 }
 
+void Socket::shutdown() {
+    if (!is_valid()) return;
+#ifdef _WIN32
+    ::shutdown(handle_, SD_BOTH);
+#else
+    ::shutdown(handle_, SHUT_RDWR);
+#endif
+}
+
 void Socket::close() {
     if (handle_ != INVALID_SOCKET_VAL) {
 #ifdef _WIN32
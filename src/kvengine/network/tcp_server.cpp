@@ -50,6 +50,8 @@ void TcpServer::stop() {
     if (!running_) return;
     
     running_ = false;
+    // 先 shutdown 喚醒阻塞在 accept 上的 run()，僅 close 不會使 accept 返回
+    listen_socket_.shutdown();
     listen_socket_.close();
     // TODO: 管理活躍連接並優雅關閉
 }
@@ -6,11 +6,87 @@
 #include "recovery_manager.h"
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 namespace kvengine {
 
-RecoveryManager::RecoveryManager(WAL* wal, StorageEngine* storage)
-    : wal_(wal), storage_(storage) {
+const size_t RecoveryManager::REDO_BATCH_SIZE;
+const size_t RecoveryManager::REDO_BATCH_BYTES;
+
+// 每個分區最多排隊的批數（超過則讀取線程等待）
+static const size_t REDO_MAX_QUEUED_BATCHES = 16;
+
+/**
+ * @brief 一個重做分區：讀取線程生產批次，一個工作線程消費
+ * @details 工作線程按日誌順序把每一批應用到存儲；不同分區的鍵互不相交，分區之間的應用順序無關，
+ *          存儲可以並發應用它們。每個分區同時存在的批次不超過 REDO_MAX_QUEUED_BATCHES + 2 個
+ */
+struct RedoPartition {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<WriteOp>> batches;
+    bool done = false;
+    std::vector<WriteOp> pending;                        // 讀取線程尚未提交的批次
+    size_t pending_bytes = 0;                            // pending 中鍵和值的總字節數
+    
+    void submit() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() { return batches.size() < REDO_MAX_QUEUED_BATCHES; });
+        batches.push_back(std::move(pending));
+        pending.clear();
+        pending.reserve(RecoveryManager::REDO_BATCH_SIZE);
+        pending_bytes = 0;
+        cv.notify_all();
+    }
+    
+    void finish() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!pending.empty()) {
+            batches.push_back(std::move(pending));
+            pending.clear();
+        }
+        done = true;
+        cv.notify_all();
+    }
+    
+    void run(StorageBackend* storage) {
+        for (;;) {
+            std::vector<WriteOp> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this]() { return !batches.empty() || done; });
+                if (batches.empty()) {
+                    break;
+                }
+                batch = std::move(batches.front());
+                batches.pop_front();
+                cv.notify_all();
+            }
+            storage->apply_batch(batch);
+        }
+    }
+};
+
+RecoveryManager::RecoveryManager(WAL* wal, StorageBackend* storage, const Options& options)
+    : wal_(wal), storage_(storage), redo_threads_(options.recovery_threads),
+      phase_(LazyPhase::DONE), resolving_(0), scan_next_lsn_(0), lazy_end_lsn_(0), recovering_(false),
+      scanned_records_(0), pending_keys_(0), replayed_keys_(0) {
+    if (redo_threads_ == 0) {
+        redo_threads_ = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+RecoveryManager::~RecoveryManager() {
+    if (lazy_thread_.joinable()) {
+        lazy_thread_.join();
+    }
 }
 
 bool RecoveryManager::recover() {
@@ -18,21 +94,21 @@ bool RecoveryManager::recover() {
     
     if (!wal_ || !storage_) return false;
     
-    // 1. 讀取所有日誌記錄
-    auto records = wal_->read_from(0);
-    if (records.empty()) {
-        std::cout << "No logs found, recovery skipped." << std::endl;
-        return true;
-    }
-    
-    std::cout << "Read " << records.size() << " log records." << std::endl;
+    // 數據文件已包含快照 LSN 之前所有日誌的效果，只需重放其後的日誌
+    uint64_t start_lsn = storage_->get_snapshot_lsn();
     
-    // 2. 分析階段：確定 Winners (已提交) 和 Losers (未提交)
+    // 日誌以游標流式讀取兩遍，不把所有記錄讀入內存
+    // 1. 分析階段：確定 Winners (已提交) 和 Losers (未提交)
     std::set<uint64_t> active_txns;
     std::set<uint64_t> committed_txns;
     std::set<uint64_t> aborted_txns;
+    size_t record_count = 0;
+    size_t autocommit_count = 0;
     
-    for (const auto& record : records) {
+    auto reader = wal_->new_reader(start_lsn);
+    LogRecord record;
+    while (reader->next(record)) {
+        record_count++;
         if (record.type == LogRecordType::BEGIN) {
             active_txns.insert(record.txn_id);
         } else if (record.type == LogRecordType::COMMIT) {
@@ -41,43 +117,494 @@ bool RecoveryManager::recover() {
         } else if (record.type == LogRecordType::ROLLBACK) {
             active_txns.erase(record.txn_id);
             aborted_txns.insert(record.txn_id);
+        } else if (record.type == LogRecordType::AUTOCOMMIT_PUT ||
+                   record.type == LogRecordType::AUTOCOMMIT_DELETE) {
+            // 自動提交記錄本身即已提交，不會成為 loser
+            autocommit_count++;
+        } else if (record.type == LogRecordType::CHECKPOINT && !record.value.empty()) {
+            // 檢查點記錄的快照 LSN 比數據文件新：數據文件不是該檢查點寫出的
+            uint64_t checkpoint_lsn = std::strtoull(record.value.c_str(), nullptr, 10);
+            if (checkpoint_lsn > start_lsn) {
+                std::cerr << "Warning: data file snapshot LSN " << start_lsn
+                          << " is older than checkpoint snapshot LSN " << checkpoint_lsn << std::endl;
+            }
         }
     }
     
+    if (record_count == 0) {
+        std::cout << "No logs after snapshot LSN " << start_lsn << ", recovery skipped." << std::endl;
+        return true;
+    }
+    
+    std::cout << "Read " << record_count << " log records from snapshot LSN " << start_lsn << "." << std::endl;
     std::cout << "Analysis complete: " << active_txns.size() << " active, " 
               << committed_txns.size() << " committed, " 
-              << aborted_txns.size() << " aborted." << std::endl;
+              << aborted_txns.size() << " aborted, "
+              << autocommit_count << " autocommit operations." << std::endl;
     
-    // 3. 重做階段 (Redo)：重放所有操作以恢復狀態
-    // 注意：這裡採取簡單的 "Repeat History" 策略
-    redo(records);
+    // 2. 重做階段 (Redo)：只重放已提交的寫操作
+    std::vector<LogRecord> loser_records;
+    redo(start_lsn, committed_txns, active_txns, loser_records);
     
-    // 4. 撤銷階段 (Undo)：回滾未提交的事務
+    // 3. 撤銷階段 (Undo)：快照可能包含未提交事務的寫入，回滾它們
     if (!active_txns.empty()) {
-        undo(records, active_txns);
+        undo(loser_records, active_txns);
     }
     
     std::cout << "Recovery completed." << std::endl;
     return true;
 }
 
-void RecoveryManager::redo(const std::vector<LogRecord>& records) {
-    std::cout << "Redoing operations..." << std::endl;
-    int redo_count = 0;
+void RecoveryManager::redo(uint64_t start_lsn, const std::set<uint64_t>& committed_txns,
+                           const std::set<uint64_t>& loser_txns, std::vector<LogRecord>& loser_records) {
+    std::cout << "Redoing operations with " << redo_threads_ << " partitions..." << std::endl;
+    size_t redo_count = 0;
+    
+    std::vector<std::unique_ptr<RedoPartition>> partitions;
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < redo_threads_; ++i) {
+        partitions.emplace_back(new RedoPartition());
+        partitions.back()->pending.reserve(REDO_BATCH_SIZE);
+    }
+    for (size_t i = 0; i < redo_threads_; ++i) {
+        workers.emplace_back(&RedoPartition::run, partitions[i].get(), storage_);
+    }
+    
+    std::hash<std::string> hasher;
+    auto dispatch = [&](const std::string& key, const std::string& value, bool is_delete) {
+        RedoPartition& partition = *partitions[hasher(key) % partitions.size()];
+        partition.pending.emplace_back();
+        WriteOp& op = partition.pending.back();
+        op.key = key;
+        op.is_delete = is_delete;
+        if (!is_delete) {
+            op.value = value;
+        }
+        partition.pending_bytes += op.key.size() + op.value.size();
+        if (partition.pending.size() >= REDO_BATCH_SIZE || partition.pending_bytes >= REDO_BATCH_BYTES) {
+            partition.submit();
+        }
+        redo_count++;
+    };
+    
+    // 已回滾事務寫過的鍵：快照可能包含它們的寫入，在 ROLLBACK 記錄處按運行時的回滾語義刪除
+    std::map<uint64_t, std::vector<std::string>> rolled_back_keys;
     
-    for (const auto& record : records) {
-        if (record.type == LogRecordType::PUT) {
-            storage_->put(record.key, record.value);
-            redo_count++;
-        } else if (record.type == LogRecordType::DELETE) {
-            storage_->remove(record.key);
-            redo_count++;
+    auto reader = wal_->new_reader(start_lsn);
+    LogRecord record;
+    while (reader->next(record)) {
+        if (record.type == LogRecordType::AUTOCOMMIT_PUT) {
+            dispatch(record.key, record.value, false);
+            continue;
         }
+        if (record.type == LogRecordType::AUTOCOMMIT_DELETE) {
+            dispatch(record.key, "", true);
+            continue;
+        }
+        if (record.type == LogRecordType::ROLLBACK) {
+            auto it = rolled_back_keys.find(record.txn_id);
+            if (it != rolled_back_keys.end()) {
+                for (const auto& key : it->second) {
+                    dispatch(key, "", true);
+                }
+                rolled_back_keys.erase(it);
+            }
+            continue;
+        }
+        if (record.type != LogRecordType::PUT && record.type != LogRecordType::DELETE) {
+            continue;
+        }
+        
+        if (committed_txns.count(record.txn_id)) {
+            dispatch(record.key, record.value, record.type == LogRecordType::DELETE);
+        } else if (loser_txns.count(record.txn_id)) {
+            // 撤銷只需要 loser 事務寫過的鍵，不保留值
+            loser_records.push_back(LogRecord(record.type, record.txn_id, record.key));
+            loser_records.back().lsn = record.lsn;
+        } else {
+            rolled_back_keys[record.txn_id].push_back(record.key);
+        }
+    }
+    
+    for (auto& partition : partitions) {
+        partition->finish();
+    }
+    for (auto& worker : workers) {
+        worker.join();
     }
     
     std::cout << "Redone " << redo_count << " operations." << std::endl;
 }
 
+void RecoveryManager::start_lazy(uint64_t end_lsn, const std::function<void()>& before_scan,
+                                 const std::function<void(const std::vector<WriteOp>&)>& on_apply) {
+    if (lazy_thread_.joinable()) {
+        lazy_thread_.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(lazy_mutex_);
+        phase_ = LazyPhase::SCANNING;
+        pending_.clear();
+        txn_writes_.clear();
+        resolved_.clear();
+        resolving_ = 0;
+        scan_next_lsn_ = storage_->get_snapshot_lsn();
+        lazy_end_lsn_ = end_lsn;
+        before_scan_ = before_scan;
+        on_apply_ = on_apply;
+    }
+    scanned_records_ = 0;
+    pending_keys_ = 0;
+    replayed_keys_ = 0;
+    recovering_ = true;
+    lazy_thread_ = std::thread(&RecoveryManager::lazy_loop, this, end_lsn);
+}
+
+void RecoveryManager::ensure_key(const std::string& key) {
+    if (!recovering_) {
+        return;
+    }
+    
+    std::unique_lock<std::mutex> lock(lazy_mutex_);
+    // 掃描期間已按需解析的鍵不在待重放表中，等待進行中的解析應用完成即可
+    if (resolved_.count(key) != 0) {
+        lazy_cv_.wait(lock, [this, &key]() {
+            auto it = resolved_.find(key);
+            return it == resolved_.end() || it->second;
+        });
+        return;
+    }
+    if (phase_ == LazyPhase::SCANNING) {
+        resolve_key(key, lock);
+        return;
+    }
+    
+    auto it = pending_.find(key);
+    if (it == pending_.end()) {
+        return;
+    }
+    PendingRef ref = it->second;
+    std::string value;
+    if (!ref.is_delete) {
+        // 讀取日誌時不持有恢復鎖
+        lock.unlock();
+        LogRecord record;
+        bool found = read_record_at(ref.lsn, record);
+        lock.lock();
+        if (!found) {
+            std::cerr << "Failed to read log record " << ref.lsn << " for key " << key << std::endl;
+            return;
+        }
+        // 讀取期間該鍵可能已由後台重放或另一個請求應用
+        it = pending_.find(key);
+        if (it == pending_.end()) {
+            return;
+        }
+        value = std::move(record.value);
+    }
+    pending_.erase(it);
+    apply_ref(key, ref, std::move(value));
+    pending_keys_ = pending_.size();
+}
+
+void RecoveryManager::resolve_key(const std::string& key, std::unique_lock<std::mutex>& lock) {
+    // 掃描跳過該鍵之後的記錄，由本次解析讀完剩餘日誌
+    resolved_[key] = false;
+    resolving_++;
+    
+    // 起點：已掃描部分的最終操作和未結束事務對該鍵的寫入
+    bool has_final = false;
+    PendingRef final_ref = {0, false};
+    auto it = pending_.find(key);
+    if (it != pending_.end()) {
+        has_final = true;
+        final_ref = it->second;
+        pending_.erase(it);
+        pending_keys_ = pending_.size();
+    }
+    std::unordered_map<uint64_t, std::vector<PendingRef>> txns;
+    for (const auto& pair : txn_writes_) {
+        for (const auto& write : pair.second) {
+            if (write.key == key) {
+                txns[pair.first].push_back(write.ref);
+            }
+        }
+    }
+    uint64_t start_lsn = scan_next_lsn_;
+    uint64_t end_lsn = lazy_end_lsn_;
+    lock.unlock();
+    
+    // 與 scan_pending 相同的語義，只跟蹤這一個鍵
+    auto reader = wal_->new_reader(start_lsn);
+    LogRecord record;
+    while (reader->next(record) && record.lsn <= end_lsn) {
+        switch (record.type) {
+        case LogRecordType::AUTOCOMMIT_PUT:
+        case LogRecordType::AUTOCOMMIT_DELETE:
+            if (record.key == key) {
+                has_final = true;
+                final_ref.lsn = record.lsn;
+                final_ref.is_delete = record.type == LogRecordType::AUTOCOMMIT_DELETE;
+            }
+            break;
+        case LogRecordType::PUT:
+        case LogRecordType::DELETE:
+            if (record.key == key) {
+                PendingRef ref = {record.lsn, record.type == LogRecordType::DELETE};
+                txns[record.txn_id].push_back(ref);
+            }
+            break;
+        case LogRecordType::COMMIT:
+        case LogRecordType::ROLLBACK: {
+            auto txn = txns.find(record.txn_id);
+            if (txn == txns.end()) {
+                break;
+            }
+            has_final = true;
+            final_ref = txn->second.back();
+            if (record.type == LogRecordType::ROLLBACK) {
+                final_ref.is_delete = true;
+            }
+            txns.erase(txn);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    for (const auto& pair : txns) {
+        for (const auto& ref : pair.second) {
+            if (!ref.is_delete) {
+                has_final = true;
+                final_ref.lsn = ref.lsn;
+                final_ref.is_delete = true;
+            }
+        }
+    }
+    
+    LogRecord value_record;
+    bool found = !has_final || final_ref.is_delete || read_record_at(final_ref.lsn, value_record);
+    
+    lock.lock();
+    if (!found) {
+        std::cerr << "Failed to read log record " << final_ref.lsn << " for key " << key << std::endl;
+    } else if (has_final) {
+        apply_ref(key, final_ref, std::move(value_record.value));
+    }
+    resolved_[key] = true;
+    resolving_--;
+    lazy_cv_.notify_all();
+}
+
+void RecoveryManager::apply_ref(const std::string& key, const PendingRef& ref, std::string&& value) {
+    std::vector<WriteOp> ops(1);
+    ops[0].key = key;
+    ops[0].is_delete = ref.is_delete;
+    if (!ref.is_delete) {
+        ops[0].value = std::move(value);
+    }
+    storage_->apply_batch(ops);
+    if (on_apply_) {
+        on_apply_(ops);
+    }
+    replayed_keys_++;
+}
+
+bool RecoveryManager::read_record_at(uint64_t lsn, LogRecord& record) {
+    auto reader = wal_->new_reader(lsn);
+    return reader->next(record) && record.lsn == lsn;
+}
+
+void RecoveryManager::wait() {
+    std::unique_lock<std::mutex> lock(lazy_mutex_);
+    lazy_cv_.wait(lock, [this]() { return phase_ == LazyPhase::DONE; });
+}
+
+void RecoveryManager::lazy_loop(uint64_t end_lsn) {
+    std::cout << "Starting background recovery..." << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    
+    if (before_scan_) {
+        before_scan_();
+    }
+    scan_pending(end_lsn);
+    
+    {
+        std::lock_guard<std::mutex> lock(lazy_mutex_);
+        phase_ = LazyPhase::REPLAYING;
+        pending_keys_ = pending_.size();
+    }
+    lazy_cv_.notify_all();
+    std::cout << "Scanned " << scanned_records_.load() << " log records, "
+              << pending_keys_.load() << " keys to replay." << std::endl;
+    
+    replay_pending(end_lsn);
+    
+    {
+        // 掃描期間開始的按需解析在讀完剩餘日誌之後才應用，等它們結束
+        std::unique_lock<std::mutex> lock(lazy_mutex_);
+        lazy_cv_.wait(lock, [this]() { return resolving_ == 0; });
+        resolved_.clear();
+        phase_ = LazyPhase::DONE;
+        recovering_ = false;
+    }
+    lazy_cv_.notify_all();
+    
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cout << "Background recovery completed in " << elapsed.count() << " ms, "
+              << replayed_keys_.load() << " keys replayed." << std::endl;
+}
+
+void RecoveryManager::scan_pending(uint64_t end_lsn) {
+    // 與 recover() 的結果相同：已提交事務在 COMMIT 處生效，已回滾事務在 ROLLBACK 處刪除寫過的鍵，
+    // 日誌末尾仍未結束的事務按撤銷階段的語義刪除它插入過的鍵。
+    // 每條記錄在恢復鎖內更新待重放表，ensure_key 隨時可以從已掃描的部分開始解析一個鍵
+    auto set_pending = [this](const std::string& key, const PendingRef& ref) {
+        // 按需解析過的鍵已經讀過整段剩餘日誌
+        if (resolved_.count(key) == 0) {
+            pending_[key] = ref;
+        }
+    };
+    
+    auto reader = wal_->new_reader(scan_next_lsn_);
+    LogRecord record;
+    while (reader->next(record) && record.lsn <= end_lsn) {
+        scanned_records_++;
+        std::lock_guard<std::mutex> lock(lazy_mutex_);
+        switch (record.type) {
+        case LogRecordType::AUTOCOMMIT_PUT:
+        case LogRecordType::AUTOCOMMIT_DELETE: {
+            PendingRef ref = {record.lsn, record.type == LogRecordType::AUTOCOMMIT_DELETE};
+            set_pending(record.key, ref);
+            break;
+        }
+        case LogRecordType::BEGIN:
+            txn_writes_[record.txn_id];
+            break;
+        case LogRecordType::PUT:
+        case LogRecordType::DELETE: {
+            std::vector<TxnWrite>& writes = txn_writes_[record.txn_id];
+            writes.emplace_back();
+            writes.back().key = record.key;
+            writes.back().ref.lsn = record.lsn;
+            writes.back().ref.is_delete = record.type == LogRecordType::DELETE;
+            break;
+        }
+        case LogRecordType::COMMIT:
+        case LogRecordType::ROLLBACK: {
+            auto it = txn_writes_.find(record.txn_id);
+            if (it == txn_writes_.end()) {
+                break;
+            }
+            for (auto& write : it->second) {
+                if (record.type == LogRecordType::ROLLBACK) {
+                    write.ref.is_delete = true;
+                }
+                set_pending(write.key, write.ref);
+            }
+            txn_writes_.erase(it);
+            break;
+        }
+        default:
+            break;
+        }
+        scan_next_lsn_ = record.lsn + 1;
+        pending_keys_ = pending_.size();
+    }
+    
+    std::lock_guard<std::mutex> lock(lazy_mutex_);
+    for (auto& pair : txn_writes_) {
+        for (auto& write : pair.second) {
+            if (write.ref.is_delete) {
+                std::cerr << "Warning: Cannot undo DELETE for txn " << pair.first
+                          << ", key " << write.key << " (missing old value)" << std::endl;
+                continue;
+            }
+            write.ref.is_delete = true;
+            set_pending(write.key, write.ref);
+        }
+    }
+    txn_writes_.clear();
+    pending_keys_ = pending_.size();
+}
+
+void RecoveryManager::replay_pending(uint64_t end_lsn) {
+    // 待重放表只有 LSN：按 LSN 排序後用一個讀取器順序讀出這些記錄，批次達到
+    // REDO_BATCH_SIZE 條或 REDO_BATCH_BYTES 字節即應用
+    std::vector<uint64_t> lsns;
+    {
+        std::lock_guard<std::mutex> lock(lazy_mutex_);
+        lsns.reserve(pending_.size());
+        for (const auto& pair : pending_) {
+            lsns.push_back(pair.second.lsn);
+        }
+    }
+    std::sort(lsns.begin(), lsns.end());
+    
+    std::vector<LogRecord> batch;
+    size_t batch_bytes = 0;
+    std::vector<WriteOp> ops;
+    ops.reserve(REDO_BATCH_SIZE);
+    // 每批之間釋放鎖，按需重放的請求不會等待整個重放
+    auto apply = [&]() {
+        std::lock_guard<std::mutex> lock(lazy_mutex_);
+        ops.clear();
+        for (auto& record : batch) {
+            // 已經按需重放的鍵不在表中
+            auto it = pending_.find(record.key);
+            if (it == pending_.end() || it->second.lsn != record.lsn) {
+                continue;
+            }
+            ops.emplace_back();
+            ops.back().is_delete = it->second.is_delete;
+            ops.back().key = std::move(record.key);
+            if (!ops.back().is_delete) {
+                ops.back().value = std::move(record.value);
+            }
+            pending_.erase(it);
+        }
+        if (!ops.empty()) {
+            storage_->apply_batch(ops);
+            if (on_apply_) {
+                on_apply_(ops);
+            }
+            replayed_keys_ += ops.size();
+        }
+        pending_keys_ = pending_.size();
+        batch.clear();
+        batch_bytes = 0;
+    };
+    
+    if (!lsns.empty()) {
+        auto reader = wal_->new_reader(lsns.front());
+        size_t next = 0;
+        LogRecord record;
+        while (next < lsns.size() && reader->next(record) && record.lsn <= end_lsn) {
+            while (next < lsns.size() && lsns[next] < record.lsn) {
+                ++next;
+            }
+            if (next == lsns.size() || lsns[next] != record.lsn) {
+                continue;
+            }
+            ++next;
+            batch_bytes += record.key.size() + record.value.size();
+            batch.push_back(std::move(record));
+            if (batch.size() >= REDO_BATCH_SIZE || batch_bytes >= REDO_BATCH_BYTES) {
+                apply();
+            }
+        }
+    }
+    apply();
+    
+    std::lock_guard<std::mutex> lock(lazy_mutex_);
+    if (!pending_.empty()) {
+        std::cerr << "Warning: " << pending_.size() << " keys could not be replayed (log records missing)" << std::endl;
+        pending_.clear();
+        pending_keys_ = 0;
+    }
+}
+
 void RecoveryManager::undo(const std::vector<LogRecord>& records, const std::set<uint64_t>& loser_txns) {
     std::cout << "Undoing " << loser_txns.size() << " loser transactions..." << std::endl;
     int undo_count = 0;
@@ -10,8 +10,14 @@
 #include <vector>
 #include <set>
 #include <map>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include "wal.h"
-#include "storage_engine.h"
+#include "storage_backend.h"
 
 namespace kvengine {
 
@@ -21,36 +27,181 @@ namespace kvengine {
  */
 class RecoveryManager {
 public:
+    // 重做時每個分區每批最多的操作數與字節數：批次寫滿即應用到存儲，
+    // 恢復佔用的內存與日誌長度和鍵數無關
+    static const size_t REDO_BATCH_SIZE = 256;
+    static const size_t REDO_BATCH_BYTES = 1024 * 1024;
+
     /**
      * @brief 構造函數
      * @param wal WAL 指針
      * @param storage 存儲引擎指針
+     * @param options 引擎配置（recovery_threads 決定重做的並行度）
+     */
+    RecoveryManager(WAL* wal, StorageBackend* storage, const Options& options = Options());
+    
+    /**
+     * @brief 析構函數
+     * @details 等待後台恢復線程結束
      */
-    RecoveryManager(WAL* wal, StorageEngine* storage);
+    ~RecoveryManager();
     
     /**
      * @brief 執行恢復
-     * @details 分析日誌，重做已提交事務，回滾未提交事務
+     * @details 從數據文件的快照 LSN 開始分析日誌，重做已提交事務，回滾未提交事務
      * @return 成功返回 true
      */
     bool recover();
+    
+    /**
+     * @brief 在後台線程中恢復（即時打開）
+     * @details 後台線程先調用 before_scan，再單遍掃描日誌，把快照之後生效的寫入折疊為每個鍵的
+     *          最終操作（待重放表，只記錄操作所在記錄的 LSN，不保存值），最後按 LSN 順序重讀日誌、
+     *          分批應用到存儲。請求訪問的鍵由 ensure_key 按需提前重放，不等待掃描結束
+     * @param end_lsn 只處理 LSN 不大於它的記錄（打開時日誌的末尾）
+     * @param before_scan 掃描日誌之前在後台線程上調用（可為空）
+     * @param on_apply 每應用一批寫入之後調用，持有恢復鎖（可為空）
+     */
+    void start_lazy(uint64_t end_lsn, const std::function<void()>& before_scan,
+                    const std::function<void(const std::vector<WriteOp>&)>& on_apply);
+    
+    /**
+     * @brief 保證鍵的待重放寫入已經應用
+     * @details 後台恢復完成後立即返回；調用者隨後對該鍵的讀寫不會被恢復覆蓋。
+     *          掃描期間從已掃描部分得到該鍵的狀態，只讀取剩餘的日誌解析這一個鍵；
+     *          掃描結束後按待重放表中的 LSN 讀取一條記錄
+     */
+    void ensure_key(const std::string& key);
+    
+    /**
+     * @brief 等待後台恢復完成（沒有後台恢復時立即返回）
+     */
+    void wait();
+    
+    /**
+     * @brief 後台恢復是否仍在進行
+     */
+    bool is_recovering() const { return recovering_; }
+    
+    /**
+     * @brief 後台恢復已掃描的日誌記錄數
+     */
+    uint64_t get_scanned_records() const { return scanned_records_; }
+    
+    /**
+     * @brief 尚待重放的鍵數（掃描結束之前為已發現的鍵數）
+     */
+    uint64_t get_pending_keys() const { return pending_keys_; }
+    
+    /**
+     * @brief 已重放的鍵數（含按需重放）
+     */
+    uint64_t get_replayed_keys() const { return replayed_keys_; }
 
 private:
+    /**
+     * @struct PendingRef
+     * @brief 待重放表的一項：鍵的最終操作及其值所在記錄的 LSN
+     */
+    struct PendingRef {
+        uint64_t lsn;        // 寫入該鍵的日誌記錄（刪除時值無關）
+        bool is_delete;
+    };
+    
+    /**
+     * @struct TxnWrite
+     * @brief 掃描中尚未結束的事務的一次寫入
+     */
+    struct TxnWrite {
+        std::string key;
+        PendingRef ref;
+    };
+    
+    /**
+     * @enum LazyPhase
+     * @brief 後台恢復階段
+     */
+    enum class LazyPhase {
+        SCANNING,    // 掃描日誌，建立待重放表
+        REPLAYING,   // 分批應用待重放表
+        DONE         // 完成
+    };
+    
+    /**
+     * @brief 後台恢復線程
+     */
+    void lazy_loop(uint64_t end_lsn);
+    
+    /**
+     * @brief 單遍掃描日誌，建立待重放表
+     */
+    void scan_pending(uint64_t end_lsn);
+    
+    /**
+     * @brief 按待重放表中的 LSN 順序重讀日誌，分批應用到存儲
+     */
+    void replay_pending(uint64_t end_lsn);
+    
+    /**
+     * @brief 掃描期間按需解析一個鍵：以已掃描部分的狀態為起點讀取剩餘日誌
+     * @param lock 持有的 lazy_mutex_，讀取日誌期間釋放
+     */
+    void resolve_key(const std::string& key, std::unique_lock<std::mutex>& lock);
+    
+    /**
+     * @brief 把一個鍵的最終操作應用到存儲（調用者持有 lazy_mutex_）
+     * @param value 最終操作為寫入時的值
+     */
+    void apply_ref(const std::string& key, const PendingRef& ref, std::string&& value);
+    
+    /**
+     * @brief 讀取指定 LSN 的日誌記錄
+     * @return 找到返回 true
+     */
+    bool read_record_at(uint64_t lsn, LogRecord& record);
+
     /**
      * @brief 重做階段
-     * @param records 日誌記錄列表
+     * @details 從快照 LSN 開始流式讀取日誌，把已提交事務和自動提交操作的寫入按鍵哈希分發到
+     *          各分區，由工作線程並行重放；已回滾事務在其 ROLLBACK 記錄處刪除寫過的鍵。
+     *          同一個鍵總是落在同一個分區，分區內保持日誌順序。每個分區的批次達到
+     *          REDO_BATCH_SIZE 條或 REDO_BATCH_BYTES 字節即交給工作線程應用到存儲
+     * @param start_lsn 數據文件的快照 LSN
+     * @param committed_txns 已提交的事務 ID 集合
+     * @param loser_txns 未提交的事務 ID 集合
+     * @param loser_records 輸出：未提交事務的寫記錄（只保留鍵，按日誌順序）
      */
-    void redo(const std::vector<LogRecord>& records);
+    void redo(uint64_t start_lsn, const std::set<uint64_t>& committed_txns,
+              const std::set<uint64_t>& loser_txns, std::vector<LogRecord>& loser_records);
     
     /**
      * @brief 撤銷階段
-     * @param records 日誌記錄列表
+     * @param records 未提交事務的寫記錄
      * @param loser_txns 未提交的事務 ID 集合
      */
     void undo(const std::vector<LogRecord>& records, const std::set<uint64_t>& loser_txns);
 
     WAL* wal_;
-    StorageEngine* storage_;
+    StorageBackend* storage_;
+    size_t redo_threads_;     // 重做分區（工作線程）數
+    
+    // 後台恢復
+    std::thread lazy_thread_;                              // 後台恢復線程
+    std::mutex lazy_mutex_;                                // 保護待重放表與階段，應用寫入時持有
+    std::condition_variable lazy_cv_;                      // 等待階段推進
+    LazyPhase phase_;                                      // 當前階段（由 lazy_mutex_ 保護）
+    std::unordered_map<std::string, PendingRef> pending_;  // 每個鍵待重放的最終操作
+    std::unordered_map<uint64_t, std::vector<TxnWrite>> txn_writes_;  // 掃描到的未結束事務的寫入
+    std::unordered_map<std::string, bool> resolved_;       // 掃描期間按需解析的鍵 -> 是否已應用
+    size_t resolving_;                                     // 正在按需解析的鍵數
+    uint64_t scan_next_lsn_;                               // 掃描下一條要處理的 LSN
+    uint64_t lazy_end_lsn_;                                // 後台恢復處理的最後一條 LSN
+    std::function<void()> before_scan_;
+    std::function<void(const std::vector<WriteOp>&)> on_apply_;
+    std::atomic<bool> recovering_;                         // 後台恢復是否在進行（快速路徑）
+    std::atomic<uint64_t> scanned_records_;
+    std::atomic<uint64_t> pending_keys_;
+    std::atomic<uint64_t> replayed_keys_;
 };
 
 } // namespace kvengine
@@ -1,4 +1,6 @@
 #include "kvengine/storage/buffer_pool_manager.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 namespace kvengine {
@@ -64,7 +66,7 @@ Page* BufferPoolManager::fetch_page(page_id_t page_id) {
         // Write back victim page if dirty
         Page* victim_page = pages_[frame_id];
         if (victim_page->is_dirty()) {
-            page_manager_->write_page(victim_page->get_page_id(), victim_page->get_data());
+            write_back(victim_page);
         }
         page_table_.erase(victim_page->get_page_id());
     }
@@ -76,7 +78,7 @@ Page* BufferPoolManager::fetch_page(page_id_t page_id) {
     page->set_dirty(false);
     page->pin_count_ = 1; // Pinned immediately
     
-    page_manager_->read_page(page_id, page->get_data());
+    load_page(page);
     
     page_table_[page_id] = frame_id;
 
@@ -114,6 +116,7 @@ bool BufferPoolManager::unpin_page(page_id_t page_id, bool is_dirty) {
 
 bool BufferPoolManager::flush_page(page_id_t page_id) {
     std::lock_guard<std::mutex> lock(latch_);
+    if (checkpointing_) return false;
     if (page_table_.find(page_id) == page_table_.end()) return false;
     
     frame_id_t frame_id = page_table_[page_id];
@@ -136,7 +139,7 @@ Page* BufferPoolManager::new_page(page_id_t* page_id) {
         
         Page* victim = pages_[frame_id];
         if (victim->is_dirty()) {
-            page_manager_->write_page(victim->get_page_id(), victim->get_data());
+            write_back(victim);
         }
         page_table_.erase(victim->get_page_id());
     }
@@ -154,7 +157,11 @@ Page* BufferPoolManager::new_page(page_id_t* page_id) {
 
 bool BufferPoolManager::delete_page(page_id_t page_id) {
     std::lock_guard<std::mutex> lock(latch_);
-    if (page_table_.find(page_id) == page_table_.end()) return true;
+    if (page_table_.find(page_id) == page_table_.end()) {
+        // Not cached: only the on-disk page has to be freed
+        free_page(page_id);
+        return true;
+    }
     
     frame_id_t frame_id = page_table_[page_id];
     Page* page = pages_[frame_id];
@@ -173,19 +180,115 @@ bool BufferPoolManager::delete_page(page_id_t page_id) {
     page->set_dirty(false);
     
     free_list_.push_back(frame_id);
-    page_manager_->deallocate_page(page_id);
+    free_page(page_id);
     return true;
 }
 
 void BufferPoolManager::flush_all_pages() {
     std::lock_guard<std::mutex> lock(latch_);
+    if (checkpointing_) return;
+    // Collect dirty pages and write them as one batch (a single submission with io_uring)
+    std::vector<page_id_t> page_ids;
+    std::vector<const char*> data;
     for (auto& pair : page_table_) {
         Page* page = pages_[pair.second];
         if (page->is_dirty()) {
-            page_manager_->write_page(page->get_page_id(), page->get_data());
+            page_ids.push_back(page->get_page_id());
+            data.push_back(page->get_data());
             page->set_dirty(false);
         }
     }
+    if (!page_ids.empty()) {
+        page_manager_->write_pages(page_ids.data(), data.data(), page_ids.size());
+    }
+}
+
+size_t BufferPoolManager::begin_checkpoint() {
+    std::lock_guard<std::mutex> lock(latch_);
+    checkpointing_ = true;
+    for (auto& pair : page_table_) {
+        Page* page = pages_[pair.second];
+        if (page->is_dirty()) {
+            checkpoint_pages_[pair.first].assign(page->get_data(), page->get_data() + PAGE_SIZE);
+            page->set_dirty(false);
+        }
+    }
+    return checkpoint_pages_.size();
+}
+
+void BufferPoolManager::write_checkpoint() {
+    // In page order, as one batch (a single submission with io_uring)
+    std::vector<page_id_t> page_ids;
+    page_ids.reserve(checkpoint_pages_.size());
+    for (auto& pair : checkpoint_pages_) {
+        page_ids.push_back(pair.first);
+    }
+    std::sort(page_ids.begin(), page_ids.end());
+    std::vector<const char*> data;
+    data.reserve(page_ids.size());
+    for (page_id_t page_id : page_ids) {
+        data.push_back(checkpoint_pages_.find(page_id)->second.data());
+    }
+    if (!page_ids.empty()) {
+        page_manager_->write_pages(page_ids.data(), data.data(), page_ids.size());
+    }
+}
+
+void BufferPoolManager::end_checkpoint() {
+    std::lock_guard<std::mutex> lock(latch_);
+    std::vector<page_id_t> page_ids;
+    std::vector<const char*> data;
+    for (auto& pair : parked_pages_) {
+        page_ids.push_back(pair.first);
+        data.push_back(pair.second.data());
+    }
+    if (!page_ids.empty()) {
+        page_manager_->write_pages(page_ids.data(), data.data(), page_ids.size());
+    }
+    for (page_id_t page_id : deferred_frees_) {
+        page_manager_->deallocate_page(page_id);
+    }
+    checkpoint_pages_.clear();
+    parked_pages_.clear();
+    deferred_frees_.clear();
+    checkpointing_ = false;
+}
+
+void BufferPoolManager::write_back(Page* page) {
+    if (checkpointing_) {
+        parked_pages_[page->get_page_id()].assign(page->get_data(), page->get_data() + PAGE_SIZE);
+    } else {
+        page_manager_->write_page(page->get_page_id(), page->get_data());
+    }
+}
+
+void BufferPoolManager::load_page(Page* page) {
+    page_id_t page_id = page->get_page_id();
+    auto parked = parked_pages_.find(page_id);
+    if (parked != parked_pages_.end()) {
+        // Still newer than the file: the frame takes over the dirty image
+        memcpy(page->get_data(), parked->second.data(), PAGE_SIZE);
+        page->set_dirty(true);
+        parked_pages_.erase(parked);
+        return;
+    }
+    auto snapshot = checkpoint_pages_.find(page_id);
+    if (snapshot != checkpoint_pages_.end()) {
+        // May not have reached the file yet
+        memcpy(page->get_data(), snapshot->second.data(), PAGE_SIZE);
+        return;
+    }
+    page_manager_->read_page(page_id, page->get_data());
+}
+
+void BufferPoolManager::free_page(page_id_t page_id) {
+    if (checkpointing_) {
+        // Freeing writes the free-list link into the page on disk
+        parked_pages_.erase(page_id);
+        deferred_frees_.push_back(page_id);
+    } else {
+        page_manager_->deallocate_page(page_id);
+    }
 }
 
 } // namespace kvengine
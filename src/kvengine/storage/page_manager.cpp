@@ -1,12 +1,70 @@
 #include "kvengine/storage/page_manager.h"
+#include "../io_ring.h"
+#include "../crc32c.h"
 #include <iostream>
 #include <sys/stat.h>
 #include <cstdio>
+#include <vector>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace kvengine {
 
-PageManager::PageManager(const std::string& db_file) 
-    : file_name_(db_file), next_page_id_(0) {}
+// Queue depth of the page I/O ring
+static const unsigned PAGE_RING_DEPTH = 128;
+
+// Journal header: Magic(4) + BasePages(4); each record: PageId(4) + CRC32C(4) + original page
+static const uint32_t JOURNAL_MAGIC = 0x4A50564B;  // "KVPJ"
+static const size_t JOURNAL_HEADER_SIZE = 8;
+static const size_t JOURNAL_RECORD_HEADER_SIZE = 8;
+
+static bool sync_stream(FILE* file) {
+    if (fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+static bool truncate_stream(FILE* file, long size) {
+    fflush(file);
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), size) == 0;
+#else
+    return ftruncate(fileno(file), size) == 0;
+#endif
+}
+
+// Make a create/unlink in the file's directory durable
+static void sync_parent_directory(const std::string& path) {
+#ifndef _WIN32
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+static uint32_t journal_checksum(page_id_t page_id, const char* data) {
+    uint32_t crc = crc32c_value(reinterpret_cast<const uint8_t*>(&page_id), sizeof(page_id));
+    return crc32c_extend(crc, reinterpret_cast<const uint8_t*>(data), PAGE_SIZE);
+}
+
+PageManager::PageManager(const std::string& db_file, bool use_io_uring) 
+    : file_name_(db_file), use_io_uring_(use_io_uring), next_page_id_(0) {}
 
 PageManager::~PageManager() {
     close();
@@ -34,20 +92,170 @@ bool PageManager::open() {
     }
     next_page_id_ = static_cast<page_id_t>(file_size / PAGE_SIZE);
 
+    if (!journal_name_.empty() && !rollback()) {
+        close();
+        return false;
+    }
+
+    if (use_io_uring_) {
+        ring_.reset(new IoRing());
+        if (!ring_->initialize(PAGE_RING_DEPTH)) {
+            std::cerr << "PageManager: io_uring unavailable, using stdio for " << file_name_ << std::endl;
+            ring_.reset();
+        }
+    }
+
     return true;
 }
 
 void PageManager::close() {
+    ring_.reset();
+    if (journal_file_) {
+        fclose(journal_file_);
+        journal_file_ = nullptr;
+    }
     if (db_file_) {
         fclose(db_file_);
         db_file_ = nullptr;
     }
 }
 
-void PageManager::write_page(page_id_t page_id, const char* data) {
-    if (!db_file_) return;
+bool PageManager::sync() {
     std::lock_guard<std::mutex> lock(io_mutex_);
-    
+    if (!db_file_) return false;
+    return sync_stream(db_file_);
+}
+
+bool PageManager::commit() {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    if (!db_file_) return false;
+    if (!sync_stream(db_file_)) {
+        std::cerr << "PageManager: fsync failed for " << file_name_ << std::endl;
+        return false;
+    }
+    if (journal_name_.empty()) {
+        return true;
+    }
+    // Removing the journal is the commit point: from here on a crash keeps the new contents
+    if (journal_file_) {
+        fclose(journal_file_);
+        journal_file_ = nullptr;
+    }
+    if (std::remove(journal_name_.c_str()) != 0) {
+        std::cerr << "PageManager: Failed to remove journal " << journal_name_ << std::endl;
+        return false;
+    }
+    sync_parent_directory(journal_name_);
+    return start_journal();
+}
+
+bool PageManager::start_journal() {
+    fseek(db_file_, 0, SEEK_END);
+    long file_size = ftell(db_file_);
+    journal_base_pages_ = static_cast<page_id_t>(file_size / PAGE_SIZE);
+    journaled_.assign(journal_base_pages_, false);
+
+    journal_file_ = fopen(journal_name_.c_str(), "wb");
+    if (journal_file_ == nullptr) {
+        std::cerr << "PageManager: Failed to create journal " << journal_name_ << std::endl;
+        return false;
+    }
+    char header[JOURNAL_HEADER_SIZE];
+    memcpy(header, &JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    memcpy(header + 4, &journal_base_pages_, sizeof(journal_base_pages_));
+    if (fwrite(header, 1, sizeof(header), journal_file_) != sizeof(header) || !sync_stream(journal_file_)) {
+        std::cerr << "PageManager: Failed to write journal " << journal_name_ << std::endl;
+        fclose(journal_file_);
+        journal_file_ = nullptr;
+        return false;
+    }
+    sync_parent_directory(journal_name_);
+    return true;
+}
+
+bool PageManager::rollback() {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    FILE* journal = fopen(journal_name_.c_str(), "rb");
+    if (journal != nullptr) {
+        // A torn header means the journal was being created: nothing was written after it
+        char header[JOURNAL_HEADER_SIZE];
+        uint32_t magic = 0;
+        page_id_t base_pages = 0;
+        if (fread(header, 1, sizeof(header), journal) == sizeof(header)) {
+            memcpy(&magic, header, sizeof(magic));
+            memcpy(&base_pages, header + 4, sizeof(base_pages));
+        }
+        if (magic == JOURNAL_MAGIC) {
+            // Records are synced before the page they protect is overwritten; stop at a torn tail
+            std::vector<char> original(PAGE_SIZE);
+            char record_header[JOURNAL_RECORD_HEADER_SIZE];
+            size_t restored = 0;
+            while (fread(record_header, 1, sizeof(record_header), journal) == sizeof(record_header) &&
+                   fread(original.data(), 1, PAGE_SIZE, journal) == PAGE_SIZE) {
+                page_id_t page_id;
+                uint32_t crc;
+                memcpy(&page_id, record_header, sizeof(page_id));
+                memcpy(&crc, record_header + 4, sizeof(crc));
+                if (crc != journal_checksum(page_id, original.data())) {
+                    break;
+                }
+                write_raw(page_id, original.data());
+                restored++;
+            }
+            if (!truncate_stream(db_file_, static_cast<long>(base_pages) * PAGE_SIZE) || !sync_stream(db_file_)) {
+                std::cerr << "PageManager: Failed to roll back " << file_name_ << std::endl;
+                fclose(journal);
+                return false;
+            }
+            if (restored > 0 || next_page_id_ != base_pages) {
+                std::cerr << "PageManager: Rolled back " << file_name_ << " to its last commit ("
+                          << restored << " pages restored)" << std::endl;
+            }
+            next_page_id_ = base_pages;
+        }
+        fclose(journal);
+        std::remove(journal_name_.c_str());
+        sync_parent_directory(journal_name_);
+    }
+    return start_journal();
+}
+
+bool PageManager::journal_pages(const page_id_t* page_ids, size_t count) {
+    if (journal_file_ == nullptr) {
+        return journal_name_.empty();
+    }
+    std::vector<char> original(PAGE_SIZE);
+    bool appended = false;
+    for (size_t i = 0; i < count; ++i) {
+        page_id_t page_id = page_ids[i];
+        if (page_id >= journal_base_pages_ || journaled_[page_id]) {
+            continue;
+        }
+        read_raw(page_id, original.data());
+        char record_header[JOURNAL_RECORD_HEADER_SIZE];
+        uint32_t crc = journal_checksum(page_id, original.data());
+        memcpy(record_header, &page_id, sizeof(page_id));
+        memcpy(record_header + 4, &crc, sizeof(crc));
+        if (fwrite(record_header, 1, sizeof(record_header), journal_file_) != sizeof(record_header) ||
+            fwrite(original.data(), 1, PAGE_SIZE, journal_file_) != PAGE_SIZE) {
+            std::cerr << "PageManager: Failed to append to journal " << journal_name_ << std::endl;
+            return false;
+        }
+        journaled_[page_id] = true;
+        appended = true;
+    }
+    if (appended && !sync_stream(journal_file_)) {
+        std::cerr << "PageManager: Failed to sync journal " << journal_name_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void PageManager::write_page(page_id_t page_id, const char* data) {
+    write_pages(&page_id, &data, 1);
+}
+
+void PageManager::write_raw(page_id_t page_id, const char* data) {
     long offset = static_cast<long>(page_id) * PAGE_SIZE;
     
     if (fseek(db_file_, offset, SEEK_SET) != 0) {
@@ -64,8 +272,15 @@ void PageManager::write_page(page_id_t page_id, const char* data) {
 
 void PageManager::read_page(page_id_t page_id, char* data) {
     if (!db_file_) return;
+    if (ring_) {
+        read_pages(&page_id, &data, 1);
+        return;
+    }
     std::lock_guard<std::mutex> lock(io_mutex_);
+    read_raw(page_id, data);
+}
 
+void PageManager::read_raw(page_id_t page_id, char* data) {
     long offset = static_cast<long>(page_id) * PAGE_SIZE;
 
     if (fseek(db_file_, offset, SEEK_SET) != 0) {
@@ -82,14 +297,101 @@ void PageManager::read_page(page_id_t page_id, char* data) {
     }
 }
 
+void PageManager::write_pages(const page_id_t* page_ids, const char* const* data, size_t count) {
+    if (!db_file_) return;
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    if (!journal_pages(page_ids, count)) {
+        // Without the original images a crash could not be rolled back: keep the file as is
+        std::cerr << "PageManager: Skipping write of " << count << " pages" << std::endl;
+        return;
+    }
+    if (!ring_) {
+        for (size_t i = 0; i < count; ++i) {
+            write_raw(page_ids[i], data[i]);
+        }
+        return;
+    }
+    run_ring(true, page_ids, const_cast<char* const*>(data), count);
+}
+
+void PageManager::read_pages(const page_id_t* page_ids, char* const* data, size_t count) {
+    if (!db_file_) return;
+    if (!ring_) {
+        for (size_t i = 0; i < count; ++i) {
+            read_page(page_ids[i], data[i]);
+        }
+        return;
+    }
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    run_ring(false, page_ids, data, count);
+}
+
+void PageManager::run_ring(bool write, const page_id_t* page_ids, char* const* data, size_t count) {
+    std::vector<IoRing::Request> requests(count);
+    for (size_t i = 0; i < count; ++i) {
+        IoRing::Request& request = requests[i];
+        request.op = write ? IoRing::Op::WRITE : IoRing::Op::READ;
+        request.fd = fileno(db_file_);
+        request.buffer = data[i];
+        request.length = PAGE_SIZE;
+        request.offset = static_cast<uint64_t>(page_ids[i]) * PAGE_SIZE;
+    }
+    if (!ring_->run(requests.data(), count)) {
+        std::cerr << "PageManager: io_uring " << (write ? "write" : "read") << " failed for "
+                  << count << " pages" << std::endl;
+        if (!write) {
+            for (size_t i = 0; i < count; ++i) {
+                if (requests[i].result != PAGE_SIZE) {
+                    memset(data[i], 0, PAGE_SIZE);
+                }
+            }
+        }
+    }
+}
+
 page_id_t PageManager::allocate_page() {
+    {
+        std::lock_guard<std::mutex> lock(io_mutex_);
+        if (free_list_head_ != INVALID_PAGE_ID) {
+            // A free page holds the next free page ID in its first bytes
+            page_id_t page_id = free_list_head_;
+            std::vector<char> data(PAGE_SIZE);
+            if (ring_) {
+                char* buffer = data.data();
+                run_ring(false, &page_id, &buffer, 1);
+            } else {
+                read_raw(page_id, data.data());
+            }
+            memcpy(&free_list_head_, data.data(), sizeof(free_list_head_));
+            return page_id;
+        }
+    }
     return next_page_id_.fetch_add(1);
     // Note: We don't necessarily write to disk immediately, 
     // but the next write_page will potentially extend the file.
 }
 
 void PageManager::deallocate_page(page_id_t page_id) {
-    (void)page_id;
+    if (!db_file_) return;
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    std::vector<char> data(PAGE_SIZE, 0);
+    memcpy(data.data(), &free_list_head_, sizeof(free_list_head_));
+    if (!journal_pages(&page_id, 1)) {
+        std::cerr << "PageManager: Leaking page " << page_id << std::endl;
+        return;
+    }
+    write_raw(page_id, data.data());
+    free_list_head_ = page_id;
+}
+
+page_id_t PageManager::get_free_list_head() const {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    return free_list_head_;
+}
+
+void PageManager::set_free_list_head(page_id_t page_id) {
+    std::lock_guard<std::mutex> lock(io_mutex_);
+    free_list_head_ = page_id;
 }
 
 int PageManager::get_num_pages() const {
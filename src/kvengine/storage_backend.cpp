@@ -0,0 +1,274 @@
+#include "storage_backend.h"
+#include "storage_engine.h"
+#include "b_plus_tree_storage.h"
+#include "lsm/lsm_tree.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace kvengine {
+
+namespace {
+
+/**
+ * 快照內容中一個條目的鍵和值（指向 contents，不複製）
+ */
+struct EntryView {
+    const char* key;
+    size_t key_len;
+    const char* value;
+    size_t value_len;
+};
+
+uint32_t read_u32(const char* p) {
+    uint32_t v = 0;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+EntryView entry_at(const std::string& contents, uint64_t offset) {
+    EntryView entry;
+    const char* p = contents.data() + offset;
+    entry.key_len = read_u32(p);
+    entry.key = p + sizeof(uint32_t);
+    entry.value_len = read_u32(entry.key + entry.key_len);
+    entry.value = entry.key + entry.key_len + sizeof(uint32_t);
+    return entry;
+}
+
+// 與 std::string::compare 相同的字節序
+int compare_keys(const char* a, size_t a_len, const char* b, size_t b_len) {
+    int c = std::memcmp(a, b, std::min(a_len, b_len));
+    if (c != 0) {
+        return c;
+    }
+    return a_len < b_len ? -1 : (a_len > b_len ? 1 : 0);
+}
+
+/**
+ * 校驗數據文件格式的內容，輸出按鍵排序的條目偏移；相同的鍵只保留最後一個
+ */
+bool index_snapshot(const std::string& contents, uint64_t& snapshot_lsn, std::vector<uint64_t>& offsets) {
+    // 舊格式沒有文件頭，快照 LSN 視為 0
+    uint64_t pos = 0;
+    snapshot_lsn = 0;
+    if (contents.size() >= sizeof(uint32_t) && read_u32(contents.data()) == DATA_FILE_MAGIC) {
+        if (contents.size() < static_cast<size_t>(DATA_FILE_HEADER_SIZE) ||
+            read_u32(contents.data() + sizeof(uint32_t)) != DATA_FILE_VERSION) {
+            std::cerr << "Unsupported data file header in replicated snapshot" << std::endl;
+            return false;
+        }
+        std::memcpy(&snapshot_lsn, contents.data() + 2 * sizeof(uint32_t), sizeof(snapshot_lsn));
+        pos = DATA_FILE_HEADER_SIZE;
+    }
+
+    uint64_t num_entries = 0;
+    if (contents.size() - pos < sizeof(num_entries)) {
+        std::cerr << "Failed to read number of entries" << std::endl;
+        return false;
+    }
+    std::memcpy(&num_entries, contents.data() + pos, sizeof(num_entries));
+    pos += sizeof(num_entries);
+
+    // 每個條目至少 8 字節，條目數不可能超過剩餘字節數的八分之一
+    offsets.clear();
+    offsets.reserve(static_cast<size_t>(std::min<uint64_t>(num_entries, (contents.size() - pos) / 8)));
+    for (uint64_t i = 0; i < num_entries; ++i) {
+        uint64_t remaining = contents.size() - pos;
+        uint64_t key_len = remaining >= sizeof(uint32_t) ? read_u32(contents.data() + pos) : 0;
+        uint64_t value_at = sizeof(uint32_t) + key_len;
+        if (remaining < value_at + sizeof(uint32_t) ||
+            remaining < value_at + sizeof(uint32_t) + read_u32(contents.data() + pos + value_at)) {
+            std::cerr << "Failed to read entry " << i << std::endl;
+            return false;
+        }
+        offsets.push_back(pos);
+        pos += value_at + sizeof(uint32_t) + read_u32(contents.data() + pos + value_at);
+    }
+
+    auto less = [&contents](uint64_t a, uint64_t b) {
+        EntryView x = entry_at(contents, a);
+        EntryView y = entry_at(contents, b);
+        return compare_keys(x.key, x.key_len, y.key, y.key_len) < 0;
+    };
+    // 有序後端寫出的快照已經按鍵排序
+    if (!std::is_sorted(offsets.begin(), offsets.end(), less)) {
+        std::stable_sort(offsets.begin(), offsets.end(), less);
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        if (i + 1 < offsets.size() && !less(offsets[i], offsets[i + 1])) {
+            continue;
+        }
+        offsets[kept++] = offsets[i];
+    }
+    offsets.resize(kept);
+    return true;
+}
+
+} // namespace
+
+bool StorageBackend::read_data_file(std::string& contents, uint64_t& snapshot_lsn) {
+    // 先取快照 LSN 再遍歷：遍歷看到的數據不早於快照，從快照 LSN 重放日誌即可追上
+    snapshot_lsn = get_snapshot_lsn();
+    auto iter = new_iterator();
+    serialize(*iter, snapshot_lsn, 0, contents);
+    return true;
+}
+
+bool StorageBackend::load_snapshot(const std::string& contents, uint64_t& snapshot_lsn) {
+    return load_snapshot_batched(contents, snapshot_lsn, SNAPSHOT_BATCH_SIZE, SNAPSHOT_BATCH_BYTES);
+}
+
+void StorageBackend::serialize(Iterator& iter, uint64_t snapshot_lsn, size_t reserve_bytes, std::string& contents) {
+    uint64_t num_entries = 0;
+    contents.clear();
+    contents.reserve(reserve_bytes);
+    contents.append(reinterpret_cast<const char*>(&DATA_FILE_MAGIC), sizeof(DATA_FILE_MAGIC));
+    contents.append(reinterpret_cast<const char*>(&DATA_FILE_VERSION), sizeof(DATA_FILE_VERSION));
+    contents.append(reinterpret_cast<const char*>(&snapshot_lsn), sizeof(snapshot_lsn));
+    contents.append(reinterpret_cast<const char*>(&num_entries), sizeof(num_entries));
+
+    for (; iter.valid(); iter.next()) {
+        std::string key = iter.key();
+        std::string value = iter.value();
+        uint32_t key_len = static_cast<uint32_t>(key.size());
+        uint32_t value_len = static_cast<uint32_t>(value.size());
+        contents.append(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+        contents.append(key);
+        contents.append(reinterpret_cast<const char*>(&value_len), sizeof(value_len));
+        contents.append(value);
+        num_entries++;
+    }
+    // 遍歷結束才知道條目數，回填文件頭之後的計數
+    std::memcpy(&contents[DATA_FILE_HEADER_SIZE], &num_entries, sizeof(num_entries));
+}
+
+bool StorageBackend::load_snapshot_batched(const std::string& contents, uint64_t& snapshot_lsn,
+                                           size_t batch_ops, size_t batch_bytes) {
+    std::vector<uint64_t> offsets;
+    if (!index_snapshot(contents, snapshot_lsn, offsets)) {
+        return false;
+    }
+
+    std::vector<WriteOp> batch;
+    size_t pending_bytes = 0;
+    auto push = [&](WriteOp& op) {
+        pending_bytes += op.key.size() + op.value.size();
+        batch.push_back(std::move(op));
+        if (batch.size() >= batch_ops || pending_bytes >= batch_bytes) {
+            apply_batch(batch);
+            batch.clear();
+            pending_bytes = 0;
+        }
+    };
+
+    // 按鍵歸併：寫入的鍵都不大於迭代器當前的鍵，分批取數的迭代器不會再看到它們
+    auto iter = new_iterator();
+    size_t index = 0;
+    while (iter->valid() || index < offsets.size()) {
+        std::string key = iter->valid() ? iter->key() : std::string();
+        EntryView entry = {nullptr, 0, nullptr, 0};
+        int order = -1;
+        if (index < offsets.size()) {
+            entry = entry_at(contents, offsets[index]);
+            order = iter->valid() ? compare_keys(key.data(), key.size(), entry.key, entry.key_len) : 1;
+        }
+
+        WriteOp op;
+        if (order < 0) {
+            // 快照中沒有的鍵
+            op.key = std::move(key);
+            op.is_delete = true;
+            iter->next();
+            push(op);
+            continue;
+        }
+        bool same = false;
+        if (order == 0) {
+            std::string value = iter->value();
+            same = value.size() == entry.value_len && std::memcmp(value.data(), entry.value, entry.value_len) == 0;
+            iter->next();
+        }
+        ++index;
+        if (!same) {
+            op.key.assign(entry.key, entry.key_len);
+            op.value.assign(entry.value, entry.value_len);
+            push(op);
+        }
+    }
+    if (!batch.empty()) {
+        apply_batch(batch);
+    }
+    return true;
+}
+
+bool StorageBackend::deserialize(std::istream& in, const std::string& source,
+                                 std::map<std::string, std::string>& data, uint64_t& snapshot_lsn) {
+    // 讀取文件頭；舊格式文件沒有文件頭，快照 LSN 視為 0（恢復時重放全部日誌）
+    uint32_t magic = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    snapshot_lsn = 0;
+    if (in.good() && magic == DATA_FILE_MAGIC) {
+        uint32_t version = 0;
+        in.read(reinterpret_cast<char*>(&version), sizeof(version));
+        in.read(reinterpret_cast<char*>(&snapshot_lsn), sizeof(snapshot_lsn));
+        if (in.fail() || version != DATA_FILE_VERSION) {
+            std::cerr << "Unsupported data file header in " << source << std::endl;
+            return false;
+        }
+    } else {
+        in.clear();
+        in.seekg(0);
+    }
+
+    // Read number of entries
+    uint64_t num_entries = 0;
+    in.read(reinterpret_cast<char*>(&num_entries), sizeof(num_entries));
+
+    if (in.fail()) {
+        std::cerr << "Failed to read number of entries" << std::endl;
+        return false;
+    }
+
+    // Read each key-value pair
+    for (uint64_t i = 0; i < num_entries; ++i) {
+        // Read key
+        uint32_t key_len = 0;
+        in.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
+
+        std::string key(key_len, '\0');
+        in.read(&key[0], key_len);
+
+        // Read value
+        uint32_t value_len = 0;
+        in.read(reinterpret_cast<char*>(&value_len), sizeof(value_len));
+
+        std::string value(value_len, '\0');
+        in.read(&value[0], value_len);
+
+        if (in.fail()) {
+            std::cerr << "Failed to read entry " << i << std::endl;
+            return false;
+        }
+
+        data[key] = value;
+    }
+
+    return true;
+}
+
+std::unique_ptr<StorageBackend> create_storage_backend(const std::string& data_dir, const Options& options) {
+    switch (options.storage_backend) {
+    case StorageBackendType::LSM:
+        return std::unique_ptr<StorageBackend>(new lsm::LSMTree(data_dir, options));
+    case StorageBackendType::BPLUS_TREE:
+        return std::unique_ptr<StorageBackend>(new BPlusTreeStorage(data_dir, options));
+    case StorageBackendType::MEMORY:
+    default:
+        return std::unique_ptr<StorageBackend>(new StorageEngine(data_dir));
+    }
+}
+
+} // namespace kvengine
@@ -0,0 +1,199 @@
+/**
+ * @file storage_backend.h
+ * @brief 存儲後端接口
+ * @details 引擎通過該接口訪問數據的實際存儲；具體實現在打開時按 Options::storage_backend 選擇
+ */
+
+#ifndef KVENGINE_STORAGE_BACKEND_H
+#define KVENGINE_STORAGE_BACKEND_H
+
+#include "../include/kvengine/iterator.h"
+#include "../include/kvengine/options.h"
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kvengine {
+
+// 數據文件（以及複製快照）格式：Magic(4) + Version(4) + SnapshotLSN(8) + 條目數(8)，
+// 其後為 KeyLen(4) + Key + ValueLen(4) + Value；沒有文件頭的舊格式文件直接以條目數開頭
+static const uint32_t DATA_FILE_MAGIC = 0x5444564B;  // "KVDT"
+static const uint32_t DATA_FILE_VERSION = 1;
+static const std::streamoff DATA_FILE_HEADER_SIZE = 16;
+
+// 導入全量快照時每批寫操作的默認上限（條數與鍵值字節數）
+static const size_t SNAPSHOT_BATCH_SIZE = 1024;
+static const size_t SNAPSHOT_BATCH_BYTES = 4 * 1024 * 1024;
+
+/**
+ * @struct WriteOp
+ * @brief 批量寫入中的一個操作
+ */
+struct WriteOp {
+    std::string key;         // 鍵
+    std::string value;       // 值（刪除時為空）
+    bool is_delete;          // 是否為刪除
+
+    WriteOp() : is_delete(false) {}
+};
+
+/**
+ * @class StorageBackend
+ * @brief 存儲後端抽象基類
+ * @details 實現必須線程安全。寫入的持久性由 WAL 保證：後端只需要在 write_snapshot
+ *          成功之後保證快照 LSN 之前的寫入都已落盤，其餘的由恢復時重放日誌補齊
+ */
+class StorageBackend {
+public:
+    virtual ~StorageBackend() {}
+
+    /**
+     * @brief 初始化：創建數據目錄並加載已有數據
+     * @return 成功返回 true
+     */
+    virtual bool initialize() = 0;
+
+    /**
+     * @brief 插入或更新鍵值對
+     * @return 成功返回 true
+     */
+    virtual bool put(const std::string& key, const std::string& value) = 0;
+
+    /**
+     * @brief 獲取鍵對應的值
+     * @return 找到返回 true
+     */
+    virtual bool get(const std::string& key, std::string& value) const = 0;
+
+    /**
+     * @brief 刪除鍵值對
+     * @return 鍵存在並已刪除返回 true
+     */
+    virtual bool remove(const std::string& key) = 0;
+
+    /**
+     * @brief 按順序應用一批寫操作
+     * @details 供恢復重做與複製使用；刪除不存在的鍵不是錯誤
+     */
+    virtual void apply_batch(const std::vector<WriteOp>& ops) = 0;
+
+    /**
+     * @brief 檢查鍵是否存在
+     */
+    virtual bool exists(const std::string& key) const = 0;
+
+    /**
+     * @brief 創建按鍵升序的迭代器
+     * @param prefix 可選的前綴過濾
+     * @details 迭代器是否看到之後的寫入由實現決定（快照式或分批讀取）
+     */
+    virtual std::unique_ptr<Iterator> new_iterator(const std::string& prefix = "") const = 0;
+
+    /**
+     * @brief 把數據寫到磁盤（關閉前調用）
+     * @return 成功返回 true
+     */
+    virtual bool flush() = 0;
+
+    /**
+     * @brief 寫出快照（檢查點）
+     * @param snapshot_lsn 快照 LSN：LSN 小於它的日誌記錄的效果都已包含在存儲中
+     * @param before_install 數據落盤之後、記錄新的快照 LSN 之前調用；返回 false 時放棄
+     * @return 成功返回 true
+     */
+    virtual bool write_snapshot(uint64_t snapshot_lsn,
+                                const std::function<bool()>& before_install = nullptr) = 0;
+
+    /**
+     * @brief 最近一次快照的 LSN，恢復時從它開始重放日誌；沒有快照時為 0
+     */
+    virtual uint64_t get_snapshot_lsn() const = 0;
+
+    /**
+     * @brief 設置後端自行把寫入落盤之前調用的回調
+     * @details 例如後台刷寫或換出髒頁之前先持久化 WAL，保證磁盤上的數據在日誌中都有記錄。
+     *          只在快照時寫盤的後端忽略它
+     */
+    virtual void set_before_install(const std::function<bool()>& before_install) {
+        (void)before_install;
+    }
+
+    /**
+     * @brief 導出全部數據（數據文件格式），用於向複製從節點發送全量快照
+     * @param contents 輸出數據
+     * @param snapshot_lsn 輸出快照 LSN：從它開始重放日誌即可追上
+     * @return 成功返回 true
+     * @details 默認實現遍歷 new_iterator，把條目直接寫入 contents，不另建數據副本
+     */
+    virtual bool read_data_file(std::string& contents, uint64_t& snapshot_lsn);
+
+    /**
+     * @brief 以數據文件格式的內容替換全部數據
+     * @param contents read_data_file 的輸出
+     * @param snapshot_lsn 輸出其中的快照 LSN
+     * @return 成功返回 true，格式錯誤時數據保持不變
+     * @details 不改變本地的快照 LSN；默認實現以 SNAPSHOT_BATCH_SIZE / SNAPSHOT_BATCH_BYTES
+     *          為上限調用 load_snapshot_batched
+     */
+    virtual bool load_snapshot(const std::string& contents, uint64_t& snapshot_lsn);
+
+    /**
+     * @brief 鍵值對數量
+     */
+    virtual size_t size() const = 0;
+
+    /**
+     * @brief 佔用的內存（字節）
+     */
+    virtual size_t memory_usage() const = 0;
+
+protected:
+    /**
+     * @brief 從輸入流解析數據文件格式
+     * @param in 輸入流
+     * @param source 錯誤信息中使用的來源名稱
+     * @param data 輸出鍵值對
+     * @param snapshot_lsn 輸出快照 LSN
+     * @return 成功返回 true
+     */
+    static bool deserialize(std::istream& in, const std::string& source,
+                            std::map<std::string, std::string>& data, uint64_t& snapshot_lsn);
+
+    /**
+     * @brief 把迭代器剩餘的條目按數據文件格式寫入 contents
+     * @param iter 迭代器
+     * @param snapshot_lsn 寫入文件頭的快照 LSN
+     * @param reserve_bytes 預計的輸出大小（0 表示不預留）
+     * @param contents 輸出數據
+     */
+    static void serialize(Iterator& iter, uint64_t snapshot_lsn, size_t reserve_bytes, std::string& contents);
+
+    /**
+     * @brief 以數據文件格式的內容替換全部數據，分批應用
+     * @param contents 數據文件格式的內容
+     * @param snapshot_lsn 輸出其中的快照 LSN
+     * @param batch_ops 每批最多的寫操作數
+     * @param batch_bytes 每批最多的鍵值字節數
+     * @return 成功返回 true，格式錯誤時數據保持不變
+     * @details 先校驗格式並建立按鍵排序的條目偏移（不複製鍵值），再與 new_iterator 歸併：
+     *          快照中沒有的鍵刪除，缺少或值不同的鍵寫入，值相同的鍵不改寫。
+     *          寫操作每攢滿一批即交給 apply_batch
+     */
+    bool load_snapshot_batched(const std::string& contents, uint64_t& snapshot_lsn,
+                               size_t batch_ops, size_t batch_bytes);
+};
+
+/**
+ * @brief 按配置創建存儲後端
+ * @param data_dir 數據目錄
+ * @param options 引擎配置（storage_backend 選擇實現）
+ */
+std::unique_ptr<StorageBackend> create_storage_backend(const std::string& data_dir, const Options& options);
+
+} // namespace kvengine
+
+#endif // KVENGINE_STORAGE_BACKEND_H
@@ -5,22 +5,67 @@
 #include <iostream>
 #include <vector>
 
+#include <cstdio>
+#include <fcntl.h>
+
 #ifdef _WIN32
 #include <direct.h>
+#include <io.h>
 #define mkdir(path, mode) _mkdir(path)
 #else
 #include <sys/types.h>
+#include <unistd.h>
 #endif
 
 namespace kvengine {
 
+// 模糊快照每次在鎖內複製的條目數與字節數上限
+static const size_t SNAPSHOT_CHUNK_ENTRIES = 1024;
+static const size_t SNAPSHOT_CHUNK_BYTES = 1024 * 1024;
+
+const size_t StorageEngine::NUM_SHARDS;
+
+// 將文件落盤
+static bool sync_file_path(const std::string& path) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = _commit(fd) == 0;
+    _close(fd);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+#endif
+    return ok;
+}
+
+// 將目錄項落盤，使重命名持久化
+static void sync_directory(const std::string& dir) {
+#ifndef _WIN32
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
 StorageEngine::StorageEngine(const std::string& data_dir)
-    : data_dir_(data_dir) {
+    : data_dir_(data_dir), snapshot_lsn_(0) {
     data_file_ = get_data_file_path();
 }
 
 StorageEngine::~StorageEngine() {
-    flush();
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
+    if (!before_install_) {
+        write_data_file(get_snapshot_lsn(), nullptr);
+    }
 }
 
 bool StorageEngine::initialize() {
@@ -38,16 +83,49 @@ bool StorageEngine::initialize() {
     return load();
 }
 
+StorageEngine::Shard& StorageEngine::shard_for(const std::string& key) {
+    return shards_[std::hash<std::string>()(key) % NUM_SHARDS];
+}
+
+const StorageEngine::Shard& StorageEngine::shard_for(const std::string& key) const {
+    return shards_[std::hash<std::string>()(key) % NUM_SHARDS];
+}
+
+std::vector<std::unique_lock<std::mutex>> StorageEngine::lock_all_shards() const {
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(NUM_SHARDS);
+    for (const auto& shard : shards_) {
+        locks.emplace_back(shard.mutex);
+    }
+    return locks;
+}
+
+void StorageEngine::replace_data(std::map<std::string, std::string>& data) {
+    std::map<std::string, std::string> parts[NUM_SHARDS];
+    for (auto& pair : data) {
+        // data 有序，每個分片收到的也是有序子序列，在末尾插入
+        auto& part = parts[std::hash<std::string>()(pair.first) % NUM_SHARDS];
+        part.emplace_hint(part.end(), pair.first, std::move(pair.second));
+    }
+    data.clear();
+    auto locks = lock_all_shards();
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        shards_[i].data.swap(parts[i]);
+    }
+}
+
 bool StorageEngine::put(const std::string& key, const std::string& value) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    data_[key] = value;
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.data[key] = value;
     return true;
 }
 
 bool StorageEngine::get(const std::string& key, std::string& value) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    auto it = data_.find(key);
-    if (it != data_.end()) {
+    const Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.data.find(key);
+    if (it != shard.data.end()) {
         value = it->second;
         return true;
     }
@@ -55,27 +133,89 @@ bool StorageEngine::get(const std::string& key, std::string& value) const {
 }
 
 bool StorageEngine::remove(const std::string& key) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return data_.erase(key) > 0;
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.data.erase(key) > 0;
+}
+
+void StorageEngine::apply_batch(const std::vector<WriteOp>& ops) {
+    // 按分片分組，組內保持批次中的順序；同一個鍵總在同一個分片，順序不變
+    std::vector<const WriteOp*> groups[NUM_SHARDS];
+    for (const auto& op : ops) {
+        groups[std::hash<std::string>()(op.key) % NUM_SHARDS].push_back(&op);
+    }
+    for (size_t i = 0; i < NUM_SHARDS; ++i) {
+        if (groups[i].empty()) {
+            continue;
+        }
+        Shard& shard = shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const WriteOp* op : groups[i]) {
+            if (op->is_delete) {
+                shard.data.erase(op->key);
+            } else {
+                shard.data[op->key] = op->value;
+            }
+        }
+    }
 }
 
 bool StorageEngine::exists(const std::string& key) const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return data_.find(key) != data_.end();
+    const Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.data.find(key) != shard.data.end();
+}
+
+std::map<std::string, std::string> StorageEngine::get_all_data() const {
+    std::map<std::string, std::string> data;
+    auto locks = lock_all_shards();
+    for (const auto& shard : shards_) {
+        data.insert(shard.data.begin(), shard.data.end());
+    }
+    return data;
 }
 
-const std::map<std::string, std::string>& StorageEngine::get_all_data() const {
-    return data_;
+std::unique_ptr<Iterator> StorageEngine::new_iterator(const std::string& prefix) const {
+    std::map<std::string, std::string> data;
+    {
+        auto locks = lock_all_shards();
+        for (const auto& shard : shards_) {
+            for (auto it = shard.data.lower_bound(prefix);
+                 it != shard.data.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+                data.insert(*it);
+            }
+        }
+    }
+    return std::unique_ptr<Iterator>(new MapIterator(data, prefix));
 }
 
 bool StorageEngine::flush() {
+    // 沿用快照 LSN：其後的日誌在檢查點截斷之前都保留，重放它們得到一致狀態
+    std::function<bool()> before_install;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        before_install = before_install_;
+    }
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
+    return write_data_file(get_snapshot_lsn(), before_install);
+}
+
+bool StorageEngine::write_snapshot(uint64_t snapshot_lsn, const std::function<bool()>& before_install) {
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
+    return write_data_file(snapshot_lsn, before_install);
+}
+
+void StorageEngine::set_before_install(const std::function<bool()>& before_install) {
     std::lock_guard<std::mutex> lock(mutex_);
-    return serialize_to_file(data_file_);
+    before_install_ = before_install;
 }
 
-bool StorageEngine::load() {
+uint64_t StorageEngine::get_snapshot_lsn() const {
     std::lock_guard<std::mutex> lock(mutex_);
-    
+    return snapshot_lsn_;
+}
+
+bool StorageEngine::load() {
     // Check if file exists
     std::ifstream test(data_file_);
     if (!test.good()) {
@@ -88,23 +228,31 @@ bool StorageEngine::load() {
 }
 
 size_t StorageEngine::size() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return data_.size();
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.data.size();
+    }
+    return total;
 }
 
 size_t StorageEngine::memory_usage() const {
-    std::lock_guard<std::mutex> lock(mutex_);
     size_t total = 0;
-    for (const auto& pair : data_) {
-        total += pair.first.size() + pair.second.size();
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& pair : shard.data) {
+            total += pair.first.size() + pair.second.size();
+        }
     }
     return total;
 }
 
-bool StorageEngine::serialize_to_file(const std::string& filename) {
-    std::ofstream ofs(filename, std::ios::binary);
+bool StorageEngine::write_data_file(uint64_t snapshot_lsn, const std::function<bool()>& before_install) {
+    // 先寫臨時文件，落盤後重命名替換：崩潰時數據文件要麼是舊快照，要麼是完整的新快照
+    std::string temp_file = data_file_ + ".tmp";
+    std::ofstream ofs(temp_file, std::ios::binary | std::ios::trunc);
     if (!ofs.is_open()) {
-        std::cerr << "Failed to open file for writing: " << filename << std::endl;
+        std::cerr << "Failed to open file for writing: " << temp_file << std::endl;
         return false;
     }
     
@@ -128,29 +276,84 @@ bool StorageEngine::serialize_to_file(const std::string& filename) {
         }
     };
     
-    // Write number of entries
-    uint64_t num_entries = data_.size();
-    write_to_buffer(reinterpret_cast<const char*>(&num_entries), sizeof(num_entries));
-    
-    // Write each key-value pair
-    for (const auto& pair : data_) {
+    auto write_entry = [&](const std::string& key, const std::string& value) {
         // Write key length and key
-        uint32_t key_len = static_cast<uint32_t>(pair.first.size());
+        uint32_t key_len = static_cast<uint32_t>(key.size());
         write_to_buffer(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
-        write_to_buffer(pair.first.data(), key_len);
+        write_to_buffer(key.data(), key_len);
         
         // Write value length and value
-        uint32_t value_len = static_cast<uint32_t>(pair.second.size());
+        uint32_t value_len = static_cast<uint32_t>(value.size());
         write_to_buffer(reinterpret_cast<const char*>(&value_len), sizeof(value_len));
-        write_to_buffer(pair.second.data(), value_len);
+        write_to_buffer(value.data(), value_len);
+    };
+    
+    // 文件頭；條目數寫完後回填
+    write_to_buffer(reinterpret_cast<const char*>(&DATA_FILE_MAGIC), sizeof(DATA_FILE_MAGIC));
+    write_to_buffer(reinterpret_cast<const char*>(&DATA_FILE_VERSION), sizeof(DATA_FILE_VERSION));
+    write_to_buffer(reinterpret_cast<const char*>(&snapshot_lsn), sizeof(snapshot_lsn));
+    uint64_t num_entries = 0;
+    write_to_buffer(reinterpret_cast<const char*>(&num_entries), sizeof(num_entries));
+    
+    // 模糊快照：逐個分片，每次在分片鎖內複製一小段有序的鍵值對，在鎖外寫入，
+    // 寫操作只在複製期間等待。各個鍵的值取自不同時刻，恢復時從快照 LSN 開始重放日誌得到一致狀態
+    std::vector<std::pair<std::string, std::string>> chunk;
+    for (const auto& shard : shards_) {
+        std::string last_key;
+        bool has_last = false;
+        for (;;) {
+            chunk.clear();
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                auto it = has_last ? shard.data.upper_bound(last_key) : shard.data.begin();
+                size_t chunk_bytes = 0;
+                for (; it != shard.data.end() && chunk.size() < SNAPSHOT_CHUNK_ENTRIES &&
+                       chunk_bytes < SNAPSHOT_CHUNK_BYTES; ++it) {
+                    chunk.push_back(*it);
+                    chunk_bytes += it->first.size() + it->second.size();
+                }
+            }
+            if (chunk.empty()) {
+                break;
+            }
+            for (const auto& pair : chunk) {
+                write_entry(pair.first, pair.second);
+            }
+            num_entries += chunk.size();
+            last_key = chunk.back().first;
+            has_last = true;
+        }
     }
     
     // 寫入剩餘緩衝區
     if (!buffer.empty()) {
         ofs.write(buffer.data(), buffer.size());
     }
-    
+    ofs.seekp(DATA_FILE_HEADER_SIZE);
+    ofs.write(reinterpret_cast<const char*>(&num_entries), sizeof(num_entries));
     ofs.close();
+    if (ofs.fail() || !sync_file_path(temp_file)) {
+        std::cerr << "Failed to write data file: " << temp_file << std::endl;
+        std::remove(temp_file.c_str());
+        return false;
+    }
+    
+    if (before_install && !before_install()) {
+        std::remove(temp_file.c_str());
+        return false;
+    }
+    
+#ifdef _WIN32
+    std::remove(data_file_.c_str());
+#endif
+    if (std::rename(temp_file.c_str(), data_file_.c_str()) != 0) {
+        std::cerr << "Failed to replace data file: " << data_file_ << std::endl;
+        return false;
+    }
+    sync_directory(data_dir_);
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot_lsn_ = snapshot_lsn;
     return true;
 }
 
@@ -161,43 +364,44 @@ bool StorageEngine::deserialize_from_file(const std::string& filename) {
         return false;
     }
     
-    // Read number of entries
-    uint64_t num_entries = 0;
-    ifs.read(reinterpret_cast<char*>(&num_entries), sizeof(num_entries));
-    
-    if (ifs.fail()) {
-        std::cerr << "Failed to read number of entries" << std::endl;
+    std::map<std::string, std::string> data;
+    uint64_t snapshot_lsn = 0;
+    if (!deserialize(ifs, filename, data, snapshot_lsn)) {
         return false;
     }
-    
-    // Clear existing data
-    data_.clear();
-    
-    // Read each key-value pair
-    for (uint64_t i = 0; i < num_entries; ++i) {
-        // Read key
-        uint32_t key_len = 0;
-        ifs.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
-        
-        std::string key(key_len, '\0');
-        ifs.read(&key[0], key_len);
-        
-        // Read value
-        uint32_t value_len = 0;
-        ifs.read(reinterpret_cast<char*>(&value_len), sizeof(value_len));
-        
-        std::string value(value_len, '\0');
-        ifs.read(&value[0], value_len);
-        
-        if (ifs.fail()) {
-            std::cerr << "Failed to read entry " << i << std::endl;
-            return false;
-        }
-        
-        data_[key] = value;
+    replace_data(data);
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot_lsn_ = snapshot_lsn;
+    return true;
+}
+
+bool StorageEngine::read_data_file(std::string& contents, uint64_t& snapshot_lsn) {
+    // 持有寫出鎖：文件內容與快照 LSN 屬於同一次寫出
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
+    std::ifstream ifs(data_file_, std::ios::binary);
+    if (!ifs.is_open()) {
+        std::cerr << "Failed to open file for reading: " << data_file_ << std::endl;
+        return false;
+    }
+    std::ostringstream oss;
+    oss << ifs.rdbuf();
+    if (ifs.bad()) {
+        std::cerr << "Failed to read data file: " << data_file_ << std::endl;
+        return false;
+    }
+    contents = oss.str();
+    snapshot_lsn = get_snapshot_lsn();
+    return true;
+}
+
+bool StorageEngine::load_snapshot(const std::string& contents, uint64_t& snapshot_lsn) {
+    std::istringstream iss(contents);
+    std::map<std::string, std::string> data;
+    if (!deserialize(iss, "replicated snapshot", data, snapshot_lsn)) {
+        return false;
     }
     
-    ifs.close();
+    replace_data(data);
     return true;
 }
 
@@ -8,8 +8,11 @@
 #define KVENGINE_STORAGE_ENGINE_H
 
 #include "../include/kvengine/types.h"
+#include "storage_backend.h"
 #include <string>
 #include <map>
+#include <vector>
+#include <functional>
 #include <fstream>
 #include <mutex>
 
@@ -17,13 +20,14 @@ namespace kvengine {
 
 /**
  * @class StorageEngine
- * @brief 數據存儲引擎
+ * @brief 數據存儲引擎（內存後端）
  * @details 提供數據的內存存儲和磁盤持久化功能
- *          - 使用 std::map 作為內存存儲
+ *          - 鍵按哈希分到 NUM_SHARDS 個分片，每個分片是一個 std::map 和一把鎖，
+ *            不同分片的寫入（包括並行重做的各個分區）互不阻塞
  *          - 支持二進制序列化
  *          - 線程安全
  */
-class StorageEngine {
+class StorageEngine : public StorageBackend {
 public:
     /**
      * @brief 構造函數
@@ -33,16 +37,17 @@ public:
     
     /**
      * @brief 析構函數
-     * @details 自動刷新數據到磁盤
+     * @details 沒有設置 before_install 時自動刷新數據到磁盤；由引擎管理時數據已由關閉前的
+     *          檢查點寫出，回調引用的 WAL 可能已經關閉，不再寫盤
      */
-    ~StorageEngine();
+    ~StorageEngine() override;
     
     /**
      * @brief 初始化存儲引擎
      * @return 成功返回 true，失敗返回 false
      * @details 創建數據目錄，加載已有數據
      */
-    bool initialize();
+    bool initialize() override;
     
     /**
      * @brief 插入或更新鍵值對
@@ -50,7 +55,7 @@ public:
      * @param value 值
      * @return 成功返回 true
      */
-    bool put(const std::string& key, const std::string& value);
+    bool put(const std::string& key, const std::string& value) override;
     
     /**
      * @brief 獲取鍵對應的值
@@ -58,33 +63,90 @@ public:
      * @param value 輸出參數，存儲獲取的值
      * @return 找到返回 true，未找到返回 false
      */
-    bool get(const std::string& key, std::string& value) const;
+    bool get(const std::string& key, std::string& value) const override;
     
     /**
      * @brief 刪除鍵值對
      * @param key 要刪除的鍵
      * @return 成功返回 true，鍵不存在返回 false
      */
-    bool remove(const std::string& key);
+    bool remove(const std::string& key) override;
+    
+    /**
+     * @brief 按順序應用一批寫操作
+     * @param ops 寫操作
+     * @details 按分片分組，每個分片只獲取一次鎖；多個線程可以並發應用鍵不相交的批次
+     */
+    void apply_batch(const std::vector<WriteOp>& ops) override;
     
     /**
      * @brief 檢查鍵是否存在
      * @param key 要檢查的鍵
      * @return 存在返回 true，不存在返回 false
      */
-    bool exists(const std::string& key) const;
+    bool exists(const std::string& key) const override;
     
     /**
-     * @brief 獲取所有數據（用於迭代）
-     * @return 數據 map 的常量引用
+     * @brief 獲取所有數據
+     * @return 鎖住全部分片時合併出的一份副本
+     */
+    std::map<std::string, std::string> get_all_data() const;
+
+    /**
+     * @brief 創建迭代器
+     * @param prefix 可選的前綴過濾
+     * @details 鎖住全部分片複製一份數據，之後的寫入不可見
      */
-    const std::map<std::string, std::string>& get_all_data() const;
+    std::unique_ptr<Iterator> new_iterator(const std::string& prefix = "") const override;
     
     /**
      * @brief 刷新數據到磁盤
      * @return 成功返回 true，失敗返回 false
+     * @details 以當前的快照 LSN 走 write_snapshot 的路徑：模糊寫出，替換數據文件之前調用
+     *          set_before_install 設置的回調持久化日誌，數據文件不會領先於已落盤的日誌
+     */
+    bool flush() override;
+    
+    /**
+     * @brief 寫出模糊快照
+     * @param snapshot_lsn 快照 LSN：LSN 小於它的日誌記錄的效果都已包含在存儲中
+     * @param before_install 臨時文件落盤之後、替換數據文件之前調用（用於先持久化日誌）；
+     *                       返回 false 時放棄本次快照
+     * @return 成功返回 true，失敗時原數據文件保持不變
+     * @details 分段在鎖內複製鍵值對、在鎖外寫入，寫操作不會被整個轉儲阻塞；
+     *          快照中各鍵的值取自不同時刻，需要從快照 LSN 開始重放日誌。
+     *          快照 LSN 寫入數據文件頭，之後的 flush() 沿用它
+     */
+    bool write_snapshot(uint64_t snapshot_lsn, const std::function<bool()>& before_install = nullptr) override;
+    
+    /**
+     * @brief 設置 flush 替換數據文件之前調用的回調（例如持久化 WAL）
+     */
+    void set_before_install(const std::function<bool()>& before_install) override;
+
+    /**
+     * @brief 獲取數據文件的快照 LSN
+     * @return 恢復時從該 LSN 開始重放日誌；沒有檢查點（或舊格式文件）時為 0
+     */
+    uint64_t get_snapshot_lsn() const override;
+    
+    /**
+     * @brief 讀取整個數據文件
+     * @param contents 輸出文件內容
+     * @param snapshot_lsn 輸出文件頭中的快照 LSN
+     * @return 成功返回 true
+     * @details 與快照寫出串行，讀到的總是一個完整的數據文件；用於向複製從節點發送全量快照
      */
-    bool flush();
+    bool read_data_file(std::string& contents, uint64_t& snapshot_lsn) override;
+    
+    /**
+     * @brief 以另一個引擎的數據文件內容替換全部數據
+     * @param contents 數據文件內容（read_data_file 的輸出）
+     * @param snapshot_lsn 輸出其中的快照 LSN
+     * @return 成功返回 true，格式錯誤時數據保持不變
+     * @details 不改變本地數據文件及其快照 LSN
+     */
+    bool load_snapshot(const std::string& contents, uint64_t& snapshot_lsn) override;
     
     /**
      * @brief 從磁盤加載數據
@@ -96,27 +158,58 @@ public:
      * @brief 獲取存儲的鍵值對數量
      * @return 鍵值對數量
      */
-    size_t size() const;
+    size_t size() const override;
     
     /**
      * @brief 獲取內存使用量
      * @return 內存使用量（字節）
      */
-    size_t memory_usage() const;
+    size_t memory_usage() const override;
     
+    static const size_t NUM_SHARDS = 16;             // 分片數
+
 private:
+    /**
+     * @struct Shard
+     * @brief 一個分片：哈希落在該分片的鍵值對及保護它們的鎖
+     */
+    struct Shard {
+        std::map<std::string, std::string> data;
+        mutable std::mutex mutex;
+    };
+
     std::string data_dir_;                           // 數據目錄
     std::string data_file_;                          // 數據文件路徑
-    std::map<std::string, std::string> data_;        // 內存中的數據
-    mutable std::mutex mutex_;                       // 線程安全鎖
-    
+    Shard shards_[NUM_SHARDS];                       // 內存中的數據
+    uint64_t snapshot_lsn_;                          // 數據文件的快照 LSN
+    std::function<bool()> before_install_;           // flush 替換數據文件之前調用
+    mutable std::mutex mutex_;                       // 保護 snapshot_lsn_ 和 before_install_
+    std::mutex file_mutex_;                          // 串行化數據文件的寫出
+
+    /**
+     * @brief 鍵所在的分片
+     */
+    Shard& shard_for(const std::string& key);
+    const Shard& shard_for(const std::string& key) const;
+
+    /**
+     * @brief 按分片順序鎖住全部分片，得到一致的視圖
+     */
+    std::vector<std::unique_lock<std::mutex>> lock_all_shards() const;
+
+    /**
+     * @brief 以新數據替換全部分片（調用者不持有分片鎖）
+     */
+    void replace_data(std::map<std::string, std::string>& data);
+
     // 序列化相關
     /**
-     * @brief 將數據序列化到文件
-     * @param filename 文件名
+     * @brief 將數據分段寫入臨時文件，落盤後原子替換數據文件
+     * @param snapshot_lsn 寫入文件頭的快照 LSN
+     * @param before_install 替換數據文件之前調用的回調（可為空）
      * @return 成功返回 true
      */
-    bool serialize_to_file(const std::string& filename);
+    bool write_data_file(uint64_t snapshot_lsn, const std::function<bool()>& before_install);
     
     /**
      * @brief 從文件反序列化數據
@@ -4,12 +4,12 @@
  */
 
 #include "transaction_manager.h"
-#include "storage_engine.h"
+#include "storage_backend.h"
 #include <iostream>
 
 namespace kvengine {
 
-TransactionManager::TransactionManager(WAL* wal, LockManager* lock_mgr, StorageEngine* storage)
+TransactionManager::TransactionManager(WAL* wal, LockManager* lock_mgr, StorageBackend* storage)
     : wal_(wal),
       lock_mgr_(lock_mgr),
       storage_(storage),
@@ -52,16 +52,22 @@ bool TransactionManager::commit(Transaction* txn) {
         return false;
     }
     
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    // 寫入 COMMIT 日誌
+    // 寫入 COMMIT 日誌並等待組提交完成
+    // 不持有 mutex_，使並發提交者可以共享同一次日誌刷新
     if (wal_) {
         LogRecord record(LogRecordType::COMMIT, txn->get_id(), "");
-        wal_->append(record);
-        wal_->flush();  // 確保日誌持久化
+        uint64_t commit_lsn = wal_->append(record);
+        if (!wal_->group_commit(commit_lsn)) {
+            // COMMIT 記錄沒有持久化：撤銷寫入並回滾，不能向調用者報告成功
+            std::cerr << "WAL sync failed for commit of txn " << txn->get_id() << std::endl;
+            rollback(txn);
+            return false;
+        }
     }
     
-    // 釋放所有鎖
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    // 釋放所有鎖（日誌已持久化之後）
     if (lock_mgr_) {
         lock_mgr_->unlock_all(txn->get_id());
     }
@@ -136,8 +142,7 @@ bool TransactionManager::put(Transaction* txn, const std::string& key, const std
     
     // 寫入 WAL
     if (wal_) {
-        LogRecord record(LogRecordType::PUT, txn->get_id(), key, value);
-        wal_->append(record);
+        wal_->append(LogRecordType::PUT, txn->get_id(), key, value);
     }
     
     // 更新存儲
@@ -163,8 +168,7 @@ bool TransactionManager::remove(Transaction* txn, const std::string& key) {
     
     // 寫入 WAL
     if (wal_) {
-        LogRecord record(LogRecordType::DELETE, txn->get_id(), key);
-        wal_->append(record);
+        wal_->append(LogRecordType::DELETE, txn->get_id(), key);
     }
     
     // 更新存儲
@@ -178,4 +182,65 @@ bool TransactionManager::remove(Transaction* txn, const std::string& key) {
     return true;
 }
 
+bool TransactionManager::put_autocommit(const std::string& key, const std::string& value) {
+    return autocommit(LogRecordType::AUTOCOMMIT_PUT, key, value);
+}
+
+bool TransactionManager::remove_autocommit(const std::string& key) {
+    return autocommit(LogRecordType::AUTOCOMMIT_DELETE, key, "");
+}
+
+bool TransactionManager::autocommit(LogRecordType type, const std::string& key, const std::string& value) {
+    uint64_t txn_id = next_txn_id_++;
+    
+    // 登記 LSN 下界：日誌寫入之後、存儲更新之前的檢查點不能截斷這條日誌
+    std::multiset<uint64_t>::iterator pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending = autocommit_lsns_.insert(wal_ ? wal_->get_last_lsn() + 1 : 0);
+    }
+    
+    // 與顯式事務一樣持有排他鎖直到提交完成
+    bool ok = !lock_mgr_ || lock_mgr_->lock_exclusive(txn_id, key);
+    if (ok) {
+        uint64_t lsn = 0;
+        if (wal_) {
+            lsn = wal_->append(type, txn_id, key, value);
+        }
+        
+        // 日誌持久化之後才更新存儲：同步失敗的寫入不會被讀到，也不需要撤銷
+        if (wal_ && !wal_->group_commit(lsn)) {
+            std::cerr << "WAL sync failed for autocommit txn " << txn_id << std::endl;
+            ok = false;
+        } else if (storage_) {
+            ok = type == LogRecordType::AUTOCOMMIT_PUT ? storage_->put(key, value)
+                                                       : storage_->remove(key);
+        }
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (lock_mgr_) {
+        lock_mgr_->unlock_all(txn_id);
+    }
+    autocommit_lsns_.erase(pending);
+    
+    return ok;
+}
+
+uint64_t TransactionManager::get_min_active_lsn() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    uint64_t min_lsn = wal_ ? wal_->get_last_lsn() + 1 : 0;
+    for (const auto& pair : active_txns_) {
+        uint64_t start_lsn = pair.second->get_start_lsn();
+        if (start_lsn > 0 && start_lsn < min_lsn) {
+            min_lsn = start_lsn;
+        }
+    }
+    if (!autocommit_lsns_.empty() && *autocommit_lsns_.begin() < min_lsn) {
+        min_lsn = *autocommit_lsns_.begin();
+    }
+    return min_lsn;
+}
+
 } // namespace kvengine
@@ -11,6 +11,7 @@
 #include "wal.h"
 #include "lock_manager.h"
 #include <map>
+#include <set>
 #include <mutex>
 #include <atomic>
 #include <memory>
@@ -18,7 +19,7 @@
 namespace kvengine {
 
 // 前向聲明
-class StorageEngine;
+class StorageBackend;
 
 /**
  * @class TransactionManager
@@ -33,7 +34,7 @@ public:
      * @param lock_mgr 鎖管理器指針
      * @param storage 存儲引擎指針
      */
-    TransactionManager(WAL* wal, LockManager* lock_mgr, StorageEngine* storage);
+    TransactionManager(WAL* wal, LockManager* lock_mgr, StorageBackend* storage);
     
     /**
      * @brief 析構函數
@@ -49,7 +50,7 @@ public:
     /**
      * @brief 提交事務
      * @param txn 事務指針
-     * @return 成功返回 true
+     * @return 成功返回 true；COMMIT 日誌未能持久化時事務被回滾並返回 false
      */
     bool commit(Transaction* txn);
     
@@ -83,12 +84,50 @@ public:
      */
     bool remove(Transaction* txn, const std::string& key);
     
+    /**
+     * @brief 自動提交地插入鍵值對
+     * @details 只寫一條 AUTOCOMMIT_PUT 日誌，不產生 BEGIN/COMMIT；
+     *          按持久化策略等待提交完成後才更新存儲
+     * @param key 鍵
+     * @param value 值
+     * @return 成功返回 true；日誌未能按持久化策略寫出或同步時返回 false，存儲保持不變
+     */
+    bool put_autocommit(const std::string& key, const std::string& value);
+    
+    /**
+     * @brief 自動提交地刪除鍵
+     * @details 只寫一條 AUTOCOMMIT_DELETE 日誌，日誌寫出後才從存儲中刪除
+     * @param key 鍵
+     * @return 鍵存在並被刪除、且日誌已按持久化策略寫出返回 true；
+     *         日誌寫出失敗時鍵保持不變
+     */
+    bool remove_autocommit(const std::string& key);
+    
+    /**
+     * @brief 獲取仍可能需要重做的最小 LSN
+     * @details 活躍事務的起始 LSN、進行中的自動提交操作可能使用的 LSN
+     *          以及下一個 LSN 中的最小值；小於它的日誌的效果都已寫入存儲
+     * @return 最小 LSN
+     */
+    uint64_t get_min_active_lsn();
+    
 private:
+    /**
+     * @brief 執行一次自動提交操作
+     * @param type AUTOCOMMIT_PUT 或 AUTOCOMMIT_DELETE
+     * @param key 鍵
+     * @param value 值（刪除時為空）
+     * @return 成功返回 true
+     */
+    bool autocommit(LogRecordType type, const std::string& key, const std::string& value);
+    
+
     WAL* wal_;                                      // WAL 指針
     LockManager* lock_mgr_;                         // 鎖管理器指針
-    StorageEngine* storage_;                        // 存儲引擎指針
+    StorageBackend* storage_;                        // 存儲引擎指針
     std::atomic<uint64_t> next_txn_id_;             // 下一個事務 ID
     std::map<uint64_t, Transaction*> active_txns_;  // 活躍事務表
+    std::multiset<uint64_t> autocommit_lsns_;       // 進行中的自動提交操作的 LSN 下界
     std::mutex mutex_;                              // 線程安全鎖
 };
 
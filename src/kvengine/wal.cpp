@@ -4,20 +4,236 @@
  */
 
 #include "wal.h"
+#include "crc32c.h"
+#include "io_ring.h"
 #include <iostream>
 #include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <fcntl.h>
 #include <sys/stat.h>
 
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+
 #ifdef _WIN32
 #include <direct.h>
+#include <io.h>
+#include <malloc.h>
 #define mkdir(path, mode) _mkdir(path)
 #else
 #include <sys/types.h>
+#include <unistd.h>
+#include <dirent.h>
 #endif
 
 namespace kvengine {
 
-// 簡單的 CRC32 實現
+// ===== 平台相關的文件操作 =====
+
+static int open_read_fd(const std::string& path) {
+#ifdef _WIN32
+    return _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    return ::open(path.c_str(), O_RDONLY);
+#endif
+}
+
+// 段文件按偏移寫入（預分配後文件大小不再等於寫入位置，不能使用 O_APPEND）
+static int open_fd(const std::string& path, bool truncate, bool direct) {
+#ifdef _WIN32
+    (void)direct;
+    int flags = _O_RDWR | _O_CREAT | _O_BINARY | (truncate ? _O_TRUNC : 0);
+    return _open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+#else
+    int flags = O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0);
+#ifdef O_DIRECT
+    if (direct) {
+        flags |= O_DIRECT | O_DSYNC;
+    }
+#else
+    (void)direct;
+#endif
+    return ::open(path.c_str(), flags, 0644);
+#endif
+}
+
+static int open_rw_fd(const std::string& path) {
+#ifdef _WIN32
+    return _open(path.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+#endif
+}
+
+static void close_fd(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+static bool write_at(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+#ifdef _WIN32
+        if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+        int n = _write(fd, data, static_cast<unsigned int>(size));
+#else
+        ssize_t n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+static bool read_fully(int fd, uint8_t* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+#ifdef _WIN32
+        if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+        int n = _read(fd, data, static_cast<unsigned int>(size));
+#else
+        ssize_t n = ::pread(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+static uint64_t file_size_of(int fd) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_fstat64(fd, &st) != 0) return 0;
+#else
+    struct stat st;
+    if (fstat(fd, &st) != 0) return 0;
+#endif
+    return static_cast<uint64_t>(st.st_size);
+}
+
+static bool datasync_fd(int fd) {
+#if defined(_WIN32)
+    return _commit(fd) == 0;
+#elif defined(__APPLE__)
+    return fsync(fd) == 0;
+#else
+    return fdatasync(fd) == 0;
+#endif
+}
+
+// 為文件分配 [0, size) 的磁盤空間並把文件大小擴展到 size，新分配的部分讀出為零
+static bool preallocate_fd(int fd, uint64_t size) {
+#if defined(__linux__)
+    int rc;
+    do {
+        rc = fallocate(fd, 0, 0, static_cast<off_t>(size));
+    } while (rc != 0 && errno == EINTR);
+    return rc == 0;
+#else
+    (void)fd;
+    (void)size;
+    return false;
+#endif
+}
+
+static bool truncate_fd(int fd, uint64_t size) {
+#ifdef _WIN32
+    return _chsize_s(fd, static_cast<__int64>(size)) == 0;
+#else
+    return ftruncate(fd, static_cast<off_t>(size)) == 0;
+#endif
+}
+
+// 列出目錄中的文件名
+static std::vector<std::string> list_directory(const std::string& dir) {
+    std::vector<std::string> names;
+#ifdef _WIN32
+    struct _finddata_t info;
+    intptr_t handle = _findfirst((dir + "\\*").c_str(), &info);
+    if (handle == -1) return names;
+    do {
+        names.push_back(info.name);
+    } while (_findnext(handle, &info) == 0);
+    _findclose(handle);
+#else
+    DIR* d = opendir(dir.c_str());
+    if (!d) return names;
+    while (struct dirent* entry = readdir(d)) {
+        names.push_back(entry->d_name);
+    }
+    closedir(d);
+#endif
+    return names;
+}
+
+// ===== 段文件格式 =====
+// 段頭: | Magic (4) | Version (4) | FirstLSN (8) |
+// 段版本決定段內的物理格式與校驗和算法，舊版本的段仍可讀取
+static const uint32_t SEGMENT_MAGIC = 0x4C57564B;  // "KVWL"
+static const uint32_t SEGMENT_VERSION_CRC32 = 1;   // 記錄流，校驗和為 CRC32（舊格式）
+static const uint32_t SEGMENT_VERSION_CRC32C = 2;  // 記錄流，校驗和為 CRC32C
+static const uint32_t SEGMENT_VERSION_BLOCK = 3;   // 32KB 塊 + 片段，每個片段帶 CRC32C，定長記錄
+static const uint32_t SEGMENT_VERSION_VARINT = 4;  // 塊格式，varint 記錄（LSN 為相對段首的增量）
+static const uint32_t SEGMENT_VERSION = SEGMENT_VERSION_VARINT;
+static const size_t SEGMENT_HEADER_SIZE = 16;
+static const char* SEGMENT_PREFIX = "wal.";
+static const size_t SEGMENT_DIGITS = 6;
+
+// ===== 元數據文件（wal.meta）=====
+// | Magic (4) | Version (4) | SegmentSeq (8) | Offset (8) | LastLSN (8) | CRC32C (4) |
+// 記錄某次 fdatasync 之後活躍段的持久化位置；打開時只需掃描該位置之後的尾部。
+// 文件本身不同步：丟失或損壞時退回從段頭掃描。
+static const uint32_t META_MAGIC = 0x4D57564B;  // "KVWM"
+static const uint32_t META_VERSION = 1;
+static const size_t META_SIZE = 36;
+static const char* META_FILE_NAME = "wal.meta";
+
+static void put_fixed32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>(v >> (i * 8));
+}
+
+static void put_fixed64(uint8_t* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = static_cast<uint8_t>(v >> (i * 8));
+}
+
+static uint32_t get_fixed32(const uint8_t* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<uint32_t>(p[i]) << (i * 8);
+    return v;
+}
+
+static uint64_t get_fixed64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= static_cast<uint64_t>(p[i]) << (i * 8);
+    return v;
+}
+
+// 解析段文件名 "wal.NNNNNN"，返回段序號
+static bool parse_segment_name(const std::string& name, uint64_t* seq) {
+    size_t prefix_len = strlen(SEGMENT_PREFIX);
+    if (name.size() < prefix_len + SEGMENT_DIGITS || name.compare(0, prefix_len, SEGMENT_PREFIX) != 0) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (size_t i = prefix_len; i < name.size(); ++i) {
+        if (name[i] < '0' || name[i] > '9') return false;
+        value = value * 10 + static_cast<uint64_t>(name[i] - '0');
+    }
+    *seq = value;
+    return true;
+}
+
+// 舊格式（段版本 1 與 wal.log）使用的 CRC32 實現，只用於校驗已有日誌
 static const uint32_t CRC32_TABLE[256] = {
     0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
     0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
@@ -64,18 +280,211 @@ static const uint32_t CRC32_TABLE[256] = {
     0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
-static uint32_t crc32(const uint8_t* data, size_t length) {
-    uint32_t crc = 0xFFFFFFFF;
+static uint32_t crc32_legacy(uint32_t crc, const uint8_t* data, size_t length) {
+    crc = ~crc;
     for (size_t i = 0; i < length; ++i) {
         crc = CRC32_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
     }
-    return crc ^ 0xFFFFFFFF;
+    return ~crc;
 }
 
-WAL::WAL(const std::string& log_dir)
+// ===== 記錄格式 =====
+// 定長記錄（段版本 1-3）: | Type (1) | TxnID (8) | LSN (8) | KeyLen (4) | Key | ValueLen (4) | Value |
+// 記錄流格式（段版本 1、2）在定長記錄後跟 Checksum (4)，覆蓋 Type、TxnID、LSN、Key 和 Value
+static const size_t RECORD_PREFIX_SIZE = 1 + 8 + 8;
+static const size_t PAYLOAD_OVERHEAD = RECORD_PREFIX_SIZE + 4 + 4;
+static const size_t RECORD_OVERHEAD = PAYLOAD_OVERHEAD + 4;
+
+// varint 記錄（段版本 4）:
+// | Type (1) | TxnID (varint) | KeyLen (varint) | Key | ValueLen (varint) | Value | LSNDelta (varint) |
+// LSNDelta = LSN - 段首 LSN。段歸屬由寫線程在輪轉時決定，因此 LSN 增量由寫線程追加在末尾，
+// 記錄校驗和為 LSNDelta 之前部分的 CRC32C（生產者計算），片段校驗和在其上擴展 LSNDelta。
+// 增量相對段首而非前一條記錄，跳過損壞的塊之後仍能解碼後續記錄
+static const size_t MAX_VARINT64_LENGTH = 10;
+static const size_t MAX_VARINT32_LENGTH = 5;
+
+static uint8_t* put_varint64(uint8_t* p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = static_cast<uint8_t>(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = static_cast<uint8_t>(v);
+    return p;
+}
+
+// 解碼 varint，越界或過長時返回 nullptr
+static const uint8_t* get_varint64(const uint8_t* p, const uint8_t* limit, uint64_t* v) {
+    uint64_t result = 0;
+    for (int shift = 0; shift <= 63 && p < limit; shift += 7) {
+        uint64_t byte = *p++;
+        result |= (byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *v = result;
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+// ===== 塊格式（段版本 3）=====
+// 段文件由 32KB 塊組成（段頭位於第 0 塊開頭），記錄切分為片段寫入：
+// 片段: | Checksum (4) | Length (2) | Type (1) | Data |
+// 校驗和為 CRC32C(Data) 再擴展 Type 字節；FULL 片段的 CRC32C(Data) 即生產者算好的記錄校驗和。
+// 塊剩餘空間放不下片段頭時以零填充，記錄從下一個塊開始
+static const uint64_t BLOCK_SIZE = 32 * 1024;
+static const size_t FRAGMENT_HEADER_SIZE = 4 + 2 + 1;
+
+enum FragmentType : uint8_t {
+    FRAGMENT_ZERO = 0,     // 零填充（預分配或塊尾）
+    FRAGMENT_FULL = 1,     // 完整記錄
+    FRAGMENT_FIRST = 2,    // 記錄的第一個片段
+    FRAGMENT_MIDDLE = 3,   // 中間片段
+    FRAGMENT_LAST = 4      // 最後一個片段
+};
+
+static uint32_t fragment_checksum(uint32_t data_crc, uint8_t type) {
+    return crc32c_extend(data_crc, &type, 1);
+}
+
+// 追加緩衝區：初始預分配大小；超過上限時寫出，寫出後容量過大則收縮
+// 寫緩衝區的地址、寫入偏移與長度都按此粒度對齊（O_DIRECT 的要求）
+static const size_t IO_ALIGNMENT = 4096;
+static const size_t APPEND_BUFFER_INITIAL = 64 * 1024;
+static const unsigned WAL_RING_DEPTH = 16;
+static const size_t APPEND_BUFFER_FLUSH_SIZE = 1024 * 1024;
+static const size_t APPEND_BUFFER_MAX_RETAINED = 4 * 1024 * 1024;
+
+// 校驗和對 Type/TxnID/LSN 前綴、鍵和值分段累計，不拼接數據
+static uint32_t record_checksum(uint32_t version, LogRecordType type, uint64_t txn_id, uint64_t lsn,
+                                const std::string& key, const std::string& value) {
+    uint32_t (*extend)(uint32_t, const uint8_t*, size_t) =
+        version == SEGMENT_VERSION_CRC32 ? crc32_legacy : crc32c_extend;
+    uint8_t prefix[RECORD_PREFIX_SIZE];
+    prefix[0] = static_cast<uint8_t>(type);
+    put_fixed64(prefix + 1, txn_id);
+    put_fixed64(prefix + 9, lsn);
+    uint32_t crc = extend(0, prefix, sizeof(prefix));
+    crc = extend(crc, reinterpret_cast<const uint8_t*>(key.data()), key.size());
+    return extend(crc, reinterpret_cast<const uint8_t*>(value.data()), value.size());
+}
+
+// varint 記錄（不含 LSNDelta）的最大長度
+static size_t max_encoded_record_size(const std::string& key, const std::string& value) {
+    return 1 + MAX_VARINT64_LENGTH + 2 * MAX_VARINT32_LENGTH + key.size() + value.size();
+}
+
+// 把記錄編碼到 out（至少 max_encoded_record_size 字節），返回編碼長度；
+// crc 輸出編碼數據的 CRC32C
+static size_t encode_record(uint8_t* out, LogRecordType type, uint64_t txn_id,
+                            const std::string& key, const std::string& value, uint32_t* crc) {
+    uint8_t* p = out;
+    *p++ = static_cast<uint8_t>(type);
+    p = put_varint64(p, txn_id);
+    p = put_varint64(p, key.size());
+    memcpy(p, key.data(), key.size());
+    p += key.size();
+    p = put_varint64(p, value.size());
+    memcpy(p, value.data(), value.size());
+    p += value.size();
+    size_t size = static_cast<size_t>(p - out);
+    *crc = crc32c_value(out, size);
+    return size;
+}
+
+// 解碼一條 varint 記錄；record 為空時只定位 LSNDelta。
+// lsn_offset 輸出 LSNDelta 的偏移（即記錄校驗和覆蓋的長度）；格式不符時返回 false
+static bool decode_varint_record(const uint8_t* p, size_t size, uint64_t first_lsn,
+                                 LogRecord* record, size_t* lsn_offset) {
+    const uint8_t* begin = p;
+    const uint8_t* limit = p + size;
+    if (size < 1) {
+        return false;
+    }
+    uint8_t type = *p++;
+    uint64_t txn_id = 0;
+    uint64_t key_len = 0;
+    uint64_t value_len = 0;
+    uint64_t lsn_delta = 0;
+    if (!(p = get_varint64(p, limit, &txn_id)) || !(p = get_varint64(p, limit, &key_len)) ||
+        key_len > static_cast<uint64_t>(limit - p)) {
+        return false;
+    }
+    const uint8_t* key = p;
+    p += key_len;
+    if (!(p = get_varint64(p, limit, &value_len)) || value_len > static_cast<uint64_t>(limit - p)) {
+        return false;
+    }
+    const uint8_t* value = p;
+    p += value_len;
+    *lsn_offset = static_cast<size_t>(p - begin);
+    if (!(p = get_varint64(p, limit, &lsn_delta)) || p != limit) {
+        return false;
+    }
+    
+    if (record) {
+        record->type = static_cast<LogRecordType>(type);
+        record->txn_id = txn_id;
+        record->lsn = first_lsn + lsn_delta;
+        record->key.assign(reinterpret_cast<const char*>(key), static_cast<size_t>(key_len));
+        record->value.assign(reinterpret_cast<const char*>(value), static_cast<size_t>(value_len));
+    }
+    return true;
+}
+
+// 解碼一條定長記錄（段版本 3），長度字段與數據長度不符時返回 false
+static bool decode_fixed_record(const uint8_t* p, size_t size, LogRecord& record) {
+    if (size < PAYLOAD_OVERHEAD) {
+        return false;
+    }
+    uint32_t key_len = get_fixed32(p + RECORD_PREFIX_SIZE);
+    if (key_len > size - PAYLOAD_OVERHEAD) {
+        return false;
+    }
+    size_t value_len_offset = RECORD_PREFIX_SIZE + 4 + static_cast<size_t>(key_len);
+    uint32_t value_len = get_fixed32(p + value_len_offset);
+    if (PAYLOAD_OVERHEAD + static_cast<size_t>(key_len) + value_len != size) {
+        return false;
+    }
+    record.type = static_cast<LogRecordType>(p[0]);
+    record.txn_id = get_fixed64(p + 1);
+    record.lsn = get_fixed64(p + 9);
+    record.key.assign(reinterpret_cast<const char*>(p + RECORD_PREFIX_SIZE + 4), key_len);
+    record.value.assign(reinterpret_cast<const char*>(p + value_len_offset + 4), value_len);
+    return true;
+}
+
+WAL::WAL(const std::string& log_dir, const Options& options)
     : log_dir_(log_dir),
+      log_fd_(-1),
+      active_size_(0),
+      segment_size_(options.wal_segment_size),
+      truncated_lsn_(0),
       current_lsn_(0),
-      is_open_(false) {
+      buffer_offset_(0),
+      write_offset_(0),
+      preallocate_(options.wal_preallocate),
+      direct_io_(options.wal_direct_io),
+      use_io_uring_(options.wal_io_uring),
+      is_open_(false),
+      queue_head_(nullptr),
+      active_appenders_(0),
+      writer_idle_(false),
+      stop_writer_(false),
+      next_write_lsn_(1),
+      sync_request_lsn_(0),
+      sync_mode_(options.wal_sync_mode),
+      sync_interval_ms_(options.wal_sync_interval_ms),
+      sync_count_(0),
+      sync_time_us_(0),
+      written_lsn_(0),
+      flushed_lsn_(0),
+      io_error_(false),
+      group_commits_(0),
+      group_flushes_(0),
+      bytes_written_(0),
+      meta_fd_(-1),
+      open_scan_bytes_(0) {
+    append_buffer_.reserve(APPEND_BUFFER_INITIAL);
 }
 
 WAL::~WAL() {
@@ -96,310 +505,1271 @@ bool WAL::initialize() {
         }
     }
     
-    log_file_path_ = get_log_file_path();
+    current_lsn_ = 0;
+    truncated_lsn_ = 0;
+    if (!load_segments()) {
+        return false;
+    }
     
-    // 打開日誌文件（追加模式）
-    log_stream_.open(log_file_path_, 
-                     std::ios::binary | std::ios::in | std::ios::out | std::ios::app);
+    // 舊版單文件日誌：一次性遷移到段文件
+    if (segments_.empty() && stat(get_log_file_path().c_str(), &info) == 0) {
+        if (!migrate_legacy_log()) {
+            std::cerr << "Failed to migrate legacy log: " << get_log_file_path() << std::endl;
+            return false;
+        }
+    }
     
-    if (!log_stream_.is_open()) {
-        // 如果文件不存在，創建新文件
-        log_stream_.open(log_file_path_, 
-                        std::ios::binary | std::ios::out | std::ios::trunc);
-        log_stream_.close();
-        log_stream_.open(log_file_path_, 
-                        std::ios::binary | std::ios::in | std::ios::out | std::ios::app);
+    if (segments_.empty()) {
+        if (!create_segment(1)) {
+            return false;
+        }
+    } else {
+        // 只有最後一個段可能未寫滿：從元數據記錄的持久化位置開始掃描尾部，
+        // 確定當前 LSN 並截掉不完整的尾部記錄
+        const Segment& last = segments_.back();
+        uint64_t meta_seq = 0;
+        uint64_t meta_offset = 0;
+        uint64_t meta_lsn = 0;
+        bool meta_valid = load_meta(&meta_seq, &meta_offset, &meta_lsn) && meta_seq == last.seq &&
+                          meta_offset >= SEGMENT_HEADER_SIZE && meta_lsn + 1 >= last.first_lsn;
+        
+        uint64_t scan_start = meta_valid ? meta_offset : SEGMENT_HEADER_SIZE;
+        uint64_t valid_end = 0;
+        uint64_t data_end = 0;
+        if (!scan_tail(last, scan_start, meta_valid ? meta_lsn : last.first_lsn - 1, &valid_end, &data_end)) {
+            // 元數據與段內容不符：從段頭重新掃描
+            std::cerr << "Stale WAL meta for " << last.path << ", scanning whole segment" << std::endl;
+            meta_valid = false;
+            scan_start = SEGMENT_HEADER_SIZE;
+            scan_tail(last, scan_start, last.first_lsn - 1, &valid_end, &data_end);
+        }
+        open_scan_bytes_ = valid_end - scan_start;
+        
+        // 最後一個不完整的 4KB 頁載入寫緩衝區，下一次對齊寫入時連同新數據重寫
+        buffer_offset_ = valid_end - valid_end % IO_ALIGNMENT;
+        append_buffer_.clear();
+        int tail_fd = open_read_fd(last.path);
+        bool tail_ok = tail_fd >= 0;
+        if (tail_ok) {
+            append_buffer_.append_zeros(static_cast<size_t>(valid_end - buffer_offset_));
+            tail_ok = read_fully(tail_fd, append_buffer_.data(), append_buffer_.size(), buffer_offset_);
+            close_fd(tail_fd);
+        }
+        if (!tail_ok) {
+            std::cerr << "Failed to read WAL tail: " << last.path << std::endl;
+            return false;
+        }
+        
+        if (log_fd_ >= 0) {
+            close_fd(log_fd_);
+        }
+        log_fd_ = open_segment_fd(last.path, false);
+        if (log_fd_ < 0) {
+            std::cerr << "Failed to open log file: " << last.path << std::endl;
+            return false;
+        }
+        // 有效記錄之後的內容一律截掉（預分配的段隨後重新分配為零），
+        // 以免之後的寫入與殘留的舊片段拼接
+        if (file_size_of(log_fd_) > valid_end) {
+            if (data_end > valid_end) {
+                std::cerr << "Discarding torn WAL tail in " << last.path << " at offset " << valid_end << std::endl;
+            }
+            truncate_fd(log_fd_, valid_end);
+        }
+        active_size_ = valid_end;
+        write_offset_ = valid_end;
+        if (last.version == SEGMENT_VERSION) {
+            preallocate_segment();
+        }
+        
+        // 尾部有元數據未覆蓋的記錄：先落盤，之後寫入的元數據才不會指向未持久化的位置
+        if ((!meta_valid || valid_end != meta_offset) && sync_mode_ != WALSyncMode::OS) {
+            sync_file(log_fd_);
+        }
+        
+        // 舊版本段只讀：新記錄寫入使用當前校驗和算法的新段
+        if (segments_.back().version != SEGMENT_VERSION && !create_segment(current_lsn_ + 1)) {
+            return false;
+        }
     }
     
-    if (!log_stream_.is_open()) {
-        std::cerr << "Failed to open log file: " << log_file_path_ << std::endl;
+    meta_fd_ = open_rw_fd(get_meta_path());
+    if (meta_fd_ < 0) {
+        std::cerr << "Failed to open WAL meta: " << get_meta_path() << std::endl;
         return false;
     }
-    std::cout << "WAL opened file: " << log_file_path_ << std::endl;
-    
-    // 讀取現有日誌以確定當前 LSN
-    log_stream_.seekg(0, std::ios::end);
-    size_t file_size = log_stream_.tellg();
+    store_meta(segments_.back().seq, active_size_, current_lsn_);
+    truncated_lsn_ = segments_.front().first_lsn;
+    std::cout << "WAL opened segment: " << segments_.back().path << std::endl;
     
-    if (file_size > 0) {
-        // 讀取所有記錄以找到最大 LSN
-        auto records = read_all_internal();
-        for (const auto& record : records) {
-            if (record.lsn > current_lsn_) {
-                current_lsn_ = record.lsn;
-            }
+    {
+        // 已存在於文件中的日誌視為已持久化
+        std::lock_guard<std::mutex> sync_lock(sync_mutex_);
+        written_lsn_ = current_lsn_;
+        flushed_lsn_ = current_lsn_;
+        io_error_ = false;
+    }
+    if (use_io_uring_) {
+        io_ring_.reset(new IoRing());
+        if (!io_ring_->initialize(WAL_RING_DEPTH)) {
+            std::cerr << "io_uring unavailable, using synchronous WAL writes in " << log_dir_ << std::endl;
+            io_ring_.reset();
         }
     }
     
+    next_write_lsn_ = current_lsn_ + 1;
+    sync_request_lsn_ = 0;
+    stop_writer_ = false;
+    writer_thread_ = std::thread(&WAL::writer_loop, this);
+    
     is_open_ = true;
     return true;
 }
 
-uint64_t WAL::append(LogRecord& record) {
-    std::lock_guard<std::mutex> lock(mutex_);
+bool WAL::load_segments() {
+    segments_.clear();
     
-    if (!is_open_) {
-        return 0;
+    std::vector<Segment> found;
+    for (const auto& name : list_directory(log_dir_)) {
+        Segment segment;
+        if (parse_segment_name(name, &segment.seq)) {
+            segment.first_lsn = 0;
+            segment.version = 0;
+            segment.path = get_segment_path(segment.seq);
+            found.push_back(segment);
+        }
     }
+    std::sort(found.begin(), found.end(),
+              [](const Segment& a, const Segment& b) { return a.seq < b.seq; });
     
-    // 分配 LSN
-    record.lsn = ++current_lsn_;
+    for (size_t i = 0; i < found.size(); ++i) {
+        Segment& segment = found[i];
+        uint8_t header[SEGMENT_HEADER_SIZE];
+        int fd = open_read_fd(segment.path);
+        bool ok = fd >= 0 && read_fully(fd, header, SEGMENT_HEADER_SIZE, 0) &&
+                  get_fixed32(header) == SEGMENT_MAGIC;
+        if (fd >= 0) {
+            close_fd(fd);
+        }
+        
+        if (!ok) {
+            if (i + 1 == found.size()) {
+                // 段頭未寫完就崩潰：丟棄這個空段
+                std::cerr << "Removing WAL segment with torn header: " << segment.path << std::endl;
+                std::remove(segment.path.c_str());
+                continue;
+            }
+            std::cerr << "Corrupted WAL segment header: " << segment.path << std::endl;
+            return false;
+        }
+        segment.version = get_fixed32(header + 4);
+        if (segment.version < SEGMENT_VERSION_CRC32 || segment.version > SEGMENT_VERSION) {
+            std::cerr << "Unsupported WAL segment version " << segment.version
+                      << ": " << segment.path << std::endl;
+            return false;
+        }
+        segment.first_lsn = get_fixed64(header + 8);
+        segments_.push_back(segment);
+    }
+    return true;
+}
+
+bool WAL::create_segment(uint64_t first_lsn) {
+    // 緩衝區中的記錄屬於舊的活躍段，先寫出
+    if (!write_append_buffer()) {
+        return false;
+    }
     
-    // 計算校驗和
-    record.checksum = calculate_checksum(record);
+    Segment segment;
+    segment.seq = segments_.empty() ? 1 : segments_.back().seq + 1;
+    segment.first_lsn = first_lsn;
+    segment.version = SEGMENT_VERSION;
+    segment.path = get_segment_path(segment.seq);
     
-    // 序列化記錄
-    auto data = serialize_record(record);
+    int fd = open_segment_fd(segment.path, true);
+    if (fd < 0) {
+        std::cerr << "Failed to create WAL segment: " << segment.path << std::endl;
+        return false;
+    }
     
-    // 寫入文件
-    log_stream_.write(reinterpret_cast<const char*>(data.data()), data.size());
-    if (!log_stream_) {
-        std::cerr << "WAL write failed for LSN " << record.lsn << std::endl;
-        log_stream_.clear();
+    // 舊的活躍段交給下一次同步處理，以免關閉領導者正在同步的描述符
+    if (log_fd_ >= 0) {
+        retired_fds_.push_back(log_fd_);
     }
+    log_fd_ = fd;
+    segments_.push_back(segment);
+    preallocate_segment();
     
-    // 添加到緩衝區
-    buffer_.push_back(record);
+    // 段頭經寫緩衝區以對齊寫入落到文件
+    uint8_t header[SEGMENT_HEADER_SIZE];
+    put_fixed32(header, SEGMENT_MAGIC);
+    put_fixed32(header + 4, SEGMENT_VERSION);
+    put_fixed64(header + 8, first_lsn);
+    append_buffer_.clear();
+    append_buffer_.append(header, SEGMENT_HEADER_SIZE);
+    buffer_offset_ = 0;
+    write_offset_ = 0;
+    active_size_ = SEGMENT_HEADER_SIZE;
+    if (!write_append_buffer()) {
+        std::cerr << "Failed to write WAL segment header: " << segment.path << std::endl;
+        return false;
+    }
+    
+    if (sync_mode_ != WALSyncMode::OS) {
+        sync_directory();
+    }
+    return true;
+}
+
+bool WAL::migrate_legacy_log() {
+    std::string legacy_path = get_log_file_path();
+    Reader::Source source;
+    source.path = legacy_path;
+    source.data_offset = 0;
+    source.limit = UINT64_MAX;
+    source.version = SEGMENT_VERSION_CRC32;
+    source.first_lsn = 0;
+    Reader reader(std::vector<Reader::Source>(1, source), 0);
     
-    // 如果緩衝區滿了，自動刷新
-    if (buffer_.size() >= BUFFER_SIZE) {
-        flush();
+    LogRecord record;
+    bool has_record = reader.next(record);
+    if (!create_segment(has_record ? record.lsn : 1)) {
+        return false;
     }
     
-    return record.lsn;
+    // 逐條轉寫為當前格式，緩衝區滿了就寫出
+    size_t count = 0;
+    std::vector<uint8_t> payload;
+    for (; has_record; has_record = reader.next(record)) {
+        payload.resize(max_encoded_record_size(record.key, record.value) + MAX_VARINT64_LENGTH);
+        uint32_t crc = 0;
+        size_t size = encode_record(payload.data(), record.type, record.txn_id,
+                                    record.key, record.value, &crc);
+        append_fragments(payload.data(), size, crc, record.lsn);
+        current_lsn_ = record.lsn;
+        ++count;
+        if (append_buffer_.size() >= APPEND_BUFFER_FLUSH_SIZE && !write_append_buffer()) {
+            return false;
+        }
+    }
+    if (!write_append_buffer() || !sync_file(log_fd_)) {
+        return false;
+    }
+    
+    std::cout << "Migrated " << count << " records from " << legacy_path << std::endl;
+    std::remove(legacy_path.c_str());
+    sync_directory();
+    return true;
 }
 
-bool WAL::flush() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (!is_open_) {
+WAL::Reader::Source WAL::segment_source(const Segment& segment) const {
+    Reader::Source source;
+    source.path = segment.path;
+    source.data_offset = SEGMENT_HEADER_SIZE;
+    source.limit = UINT64_MAX;
+    source.version = segment.version;
+    source.first_lsn = segment.first_lsn;
+    return source;
+}
+
+bool WAL::scan_tail(const Segment& segment, uint64_t start_offset, uint64_t start_lsn,
+                    uint64_t* valid_end, uint64_t* data_end) {
+    current_lsn_ = start_lsn;
+    *valid_end = start_offset;
+    *data_end = start_offset;
+    
+    struct stat info;
+    if (stat(segment.path.c_str(), &info) != 0 || static_cast<uint64_t>(info.st_size) < start_offset) {
         return false;
     }
-    flush_internal();
+    
+    Reader::Source source = segment_source(segment);
+    source.data_offset = start_offset;
+    Reader reader(std::vector<Reader::Source>(1, source), 0);
+    LogRecord record;
+    bool contiguous = true;
+    while (reader.next(record)) {
+        // 段內 LSN 連續，不連續說明起點不在記錄邊界上，或中間有被跳過的損壞塊：
+        // 活躍段只保留到最後一條連續記錄
+        if (record.lsn != current_lsn_ + 1) {
+            contiguous = false;
+            break;
+        }
+        current_lsn_ = record.lsn;
+        *valid_end = reader.valid_end();
+    }
+    // 記錄流格式沒有零填充，有效記錄之後的任何內容都是殘缺的尾部
+    *data_end = segment.version >= SEGMENT_VERSION_BLOCK ? std::max(*valid_end, reader.data_end())
+                                                         : static_cast<uint64_t>(info.st_size);
+    return contiguous;
+}
+
+bool WAL::load_meta(uint64_t* seq, uint64_t* offset, uint64_t* lsn) {
+    int fd = open_read_fd(get_meta_path());
+    if (fd < 0) {
+        return false;
+    }
+    uint8_t buf[META_SIZE];
+    bool ok = read_fully(fd, buf, META_SIZE, 0);
+    close_fd(fd);
+    if (!ok || get_fixed32(buf) != META_MAGIC || get_fixed32(buf + 4) != META_VERSION ||
+        get_fixed32(buf + 32) != crc32c_value(buf, 32)) {
+        return false;
+    }
+    *seq = get_fixed64(buf + 8);
+    *offset = get_fixed64(buf + 16);
+    *lsn = get_fixed64(buf + 24);
     return true;
 }
 
-void WAL::flush_internal() {
-    log_stream_.flush();
-    buffer_.clear();
+void WAL::store_meta(uint64_t seq, uint64_t offset, uint64_t lsn) {
+    if (meta_fd_ < 0) {
+        return;
+    }
+    uint8_t buf[META_SIZE];
+    put_fixed32(buf, META_MAGIC);
+    put_fixed32(buf + 4, META_VERSION);
+    put_fixed64(buf + 8, seq);
+    put_fixed64(buf + 16, offset);
+    put_fixed64(buf + 24, lsn);
+    put_fixed32(buf + 32, crc32c_value(buf, 32));
+    if (!write_at(meta_fd_, buf, META_SIZE, 0)) {
+        std::cerr << "Failed to write WAL meta: " << get_meta_path() << std::endl;
+    }
 }
 
-uint64_t WAL::get_last_lsn() const {
-    return current_lsn_;
+// ===== 順序讀取游標 =====
+
+// 每次 pread 的最小塊大小，也是窗口的初始大小
+static const size_t READER_CHUNK_SIZE = 64 * 1024;
+
+WAL::Reader::Reader(std::vector<Source> sources, uint64_t start_lsn)
+    : sources_(std::move(sources)),
+      source_index_(0),
+      start_lsn_(start_lsn),
+      fd_(-1),
+      file_size_(0),
+      file_offset_(0),
+      valid_end_(0),
+      window_begin_(0),
+      window_end_(0),
+      window_offset_(0),
+      position_(0),
+      dropped_bytes_(0),
+      data_end_(0),
+      zero_block_(UINT64_MAX) {
 }
 
-std::vector<LogRecord> WAL::read_from(uint64_t start_lsn) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    std::vector<LogRecord> records;
-    if (!is_open_) {
-        return records;
+WAL::Reader::~Reader() {
+    if (fd_ >= 0) {
+        close_fd(fd_);
     }
-    
-    auto all = read_all_internal();
-    for (const auto& record : all) {
-        if (record.lsn >= start_lsn) {
-            records.push_back(record);
+}
+
+bool WAL::Reader::next(LogRecord& record) {
+    while (source_index_ < sources_.size()) {
+        if (fd_ < 0 && !open_source()) {
+            std::cerr << "Failed to read log segment: " << sources_[source_index_].path << std::endl;
+            ++source_index_;
+            continue;
         }
+        bool ok = sources_[source_index_].version >= SEGMENT_VERSION_BLOCK ? read_block_record(record)
+                                                                          : read_record(record);
+        if (ok) {
+            if (record.lsn >= start_lsn_) {
+                return true;
+            }
+            continue;
+        }
+        // 讀完、不完整的尾部或校驗失敗：該段到此為止
+        close_source();
     }
-    
-    return records;
+    return false;
 }
 
-std::vector<LogRecord> WAL::read_all_internal() {
-    std::vector<LogRecord> records;
-    
-    // 清除流狀態（重要：EOF 可能導致 seek 失敗）
-    log_stream_.clear();
+bool WAL::Reader::open_source() {
+    const Source& source = sources_[source_index_];
+    valid_end_ = source.data_offset;
+    fd_ = open_read_fd(source.path);
+    if (fd_ < 0) {
+        return false;
+    }
+    file_size_ = std::min(file_size_of(fd_), source.limit);
+    if (file_size_ < source.data_offset) {
+        close_fd(fd_);
+        fd_ = -1;
+        return false;
+    }
+    file_offset_ = source.data_offset;
+    window_begin_ = 0;
+    window_end_ = 0;
+    window_offset_ = 0;
+    position_ = source.data_offset;
+    payload_.clear();
+    data_end_ = source.data_offset;
+    zero_block_ = UINT64_MAX;
+    return true;
+}
+
+void WAL::Reader::close_source() {
+    if (fd_ >= 0) {
+        close_fd(fd_);
+        fd_ = -1;
+    }
+    ++source_index_;
+}
+
+bool WAL::Reader::ensure(size_t n) {
+    size_t buffered = window_end_ - window_begin_;
+    if (buffered >= n) {
+        return true;
+    }
+    if (buffered + (file_size_ - file_offset_) < n) {
+        return false;
+    }
     
-    // 讀取整個文件
-    log_stream_.seekg(0, std::ios::end);
-    std::streamsize file_size = log_stream_.tellg();
-    log_stream_.seekg(0, std::ios::beg);
+    // 把未消費的數據移到窗口開頭，窗口只在單條記錄比它大時增長
+    if (window_begin_ > 0) {
+        memmove(window_.data(), window_.data() + window_begin_, buffered);
+        window_begin_ = 0;
+        window_end_ = buffered;
+    }
+    if (window_.size() < std::max(n, READER_CHUNK_SIZE)) {
+        window_.resize(std::max(n, READER_CHUNK_SIZE));
+    }
     
-    if (file_size <= 0) {
-        return records;
+    size_t amount = static_cast<size_t>(std::min<uint64_t>(window_.size() - window_end_,
+                                                           file_size_ - file_offset_));
+    if (!read_fully(fd_, window_.data() + window_end_, amount, file_offset_)) {
+        return false;
+    }
+    file_offset_ += amount;
+    window_end_ += amount;
+    return true;
+}
+
+bool WAL::Reader::read_record(LogRecord& record) {
+    // 先讀定長前綴和鍵長，再按長度讀取其餘部分；長度超出文件剩餘數據即為不完整記錄
+    if (!ensure(RECORD_PREFIX_SIZE + 4)) {
+        return false;
+    }
+    uint32_t key_len = get_fixed32(window_.data() + window_begin_ + RECORD_PREFIX_SIZE);
+    size_t value_len_offset = RECORD_PREFIX_SIZE + 4 + static_cast<size_t>(key_len);
+    if (!ensure(value_len_offset + 4)) {
+        return false;
+    }
+    uint32_t value_len = get_fixed32(window_.data() + window_begin_ + value_len_offset);
+    size_t total = RECORD_OVERHEAD + static_cast<size_t>(key_len) + value_len;
+    if (!ensure(total)) {
+        return false;
     }
     
-    std::vector<uint8_t> data(static_cast<size_t>(file_size));
-    log_stream_.read(reinterpret_cast<char*>(data.data()), file_size);
+    const uint8_t* p = window_.data() + window_begin_;
+    record.type = static_cast<LogRecordType>(p[0]);
+    record.txn_id = get_fixed64(p + 1);
+    record.lsn = get_fixed64(p + 9);
+    record.key.assign(reinterpret_cast<const char*>(p + RECORD_PREFIX_SIZE + 4), key_len);
+    record.value.assign(reinterpret_cast<const char*>(p + value_len_offset + 4), value_len);
+    record.checksum = get_fixed32(p + total - 4);
     
-    // 反序列化所有記錄
-    size_t offset = 0;
-    while (offset < data.size()) {
-        try {
-            LogRecord record = deserialize_record(data, offset);
-            
-            // 驗證校驗和
-            uint32_t expected_checksum = calculate_checksum(record);
-            if (record.checksum != expected_checksum) {
-                std::cerr << "Checksum mismatch for LSN " << record.lsn << std::endl;
-                break;
+    uint32_t expected_checksum = record_checksum(sources_[source_index_].version, record.type,
+                                                 record.txn_id, record.lsn, record.key, record.value);
+    if (record.checksum != expected_checksum) {
+        std::cerr << "Checksum mismatch for LSN " << record.lsn << std::endl;
+        return false;
+    }
+    
+    window_begin_ += total;
+    valid_end_ += total;
+    return true;
+}
+
+bool WAL::Reader::read_fragment(uint8_t* type, const uint8_t** data, size_t* length, uint32_t* data_crc) {
+    for (;;) {
+        uint64_t block_start = position_ - position_ % BLOCK_SIZE;
+        uint64_t block_end = std::min(block_start + BLOCK_SIZE, file_size_);
+        if (position_ + FRAGMENT_HEADER_SIZE > block_end) {
+            // 塊尾填充或文件末尾
+            if (block_end >= file_size_) {
+                return false;
             }
-            
-            records.push_back(record);
-        } catch (...) {
-            break;
+            position_ = block_end;
+            continue;
         }
+        
+        // 窗口不包含當前塊時，從塊邊界開始預讀若干整塊
+        if (block_start < window_offset_ || block_end > window_offset_ + window_end_) {
+            uint64_t amount = std::min<uint64_t>(std::max<uint64_t>(READER_CHUNK_SIZE, BLOCK_SIZE),
+                                                 file_size_ - block_start);
+            if (window_.size() < amount) {
+                window_.resize(static_cast<size_t>(amount));
+            }
+            if (!read_fully(fd_, window_.data(), static_cast<size_t>(amount), block_start)) {
+                return false;
+            }
+            window_offset_ = block_start;
+            window_end_ = static_cast<size_t>(amount);
+        }
+        
+        const uint8_t* header = window_.data() + (position_ - window_offset_);
+        uint32_t expected = get_fixed32(header);
+        size_t fragment_length = static_cast<size_t>(header[4]) | (static_cast<size_t>(header[5]) << 8);
+        uint8_t fragment_type = header[6];
+        
+        if (fragment_type == FRAGMENT_ZERO && fragment_length == 0 && expected == 0) {
+            // 零填充：塊的剩餘部分沒有數據。寫入是順序的，連續兩個塊都以零填充結束說明
+            // 已經到達預分配區域，不再逐塊掃描到文件末尾；單個被清零的損壞塊之後仍會重新同步
+            if (zero_block_ != UINT64_MAX && zero_block_ + BLOCK_SIZE == block_start) {
+                return false;
+            }
+            zero_block_ = block_start;
+            position_ = block_end;
+            continue;
+        }
+        bool valid = position_ + FRAGMENT_HEADER_SIZE + fragment_length <= block_end &&
+                     fragment_type <= FRAGMENT_LAST;
+        const uint8_t* fragment = header + FRAGMENT_HEADER_SIZE;
+        uint32_t crc = 0;
+        uint32_t fragment_crc = 0;
+        size_t lsn_offset = 0;
+        if (valid && fragment_type == FRAGMENT_FULL && sources_[source_index_].version >= SEGMENT_VERSION_VARINT) {
+            // 完整的 varint 記錄：先算 LSNDelta 之前部分的校驗和（即記錄校驗和），再擴展 LSNDelta
+            valid = decode_varint_record(fragment, fragment_length, 0, nullptr, &lsn_offset);
+            if (valid) {
+                crc = crc32c_value(fragment, lsn_offset);
+                fragment_crc = crc32c_extend(crc, fragment + lsn_offset, fragment_length - lsn_offset);
+            }
+        } else if (valid) {
+            crc = crc32c_value(fragment, fragment_length);
+            fragment_crc = crc;
+        }
+        if (!valid || fragment_checksum(fragment_crc, fragment_type) != expected) {
+            // 損壞或寫了一半的片段：丟棄整個塊的剩餘部分，從下一個塊重新同步
+            dropped_bytes_ += block_end - position_;
+            position_ = block_end;
+            data_end_ = block_end;
+            payload_.clear();
+            if (block_end >= file_size_) {
+                return false;
+            }
+            std::cerr << "Skipping corrupted WAL block at offset " << block_start
+                      << " in " << sources_[source_index_].path << std::endl;
+            continue;
+        }
+        
+        *type = fragment_type;
+        *data = header + FRAGMENT_HEADER_SIZE;
+        *length = fragment_length;
+        *data_crc = crc;
+        position_ += FRAGMENT_HEADER_SIZE + fragment_length;
+        data_end_ = position_;
+        return true;
     }
-    
-    return records;
 }
 
-bool WAL::truncate(uint64_t lsn) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
+bool WAL::Reader::decode_payload(const uint8_t* data, size_t length, LogRecord& record) {
+    const Source& source = sources_[source_index_];
+    if (source.version >= SEGMENT_VERSION_VARINT) {
+        size_t lsn_offset = 0;
+        return decode_varint_record(data, length, source.first_lsn, &record, &lsn_offset);
+    }
+    return decode_fixed_record(data, length, record);
+}
+
+bool WAL::Reader::read_block_record(LogRecord& record) {
+    bool in_record = false;
+    uint8_t type = 0;
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+    uint32_t crc = 0;
+    while (read_fragment(&type, &data, &length, &crc)) {
+        if (type == FRAGMENT_FULL || type == FRAGMENT_FIRST) {
+            if (in_record) {
+                // 上一條記錄缺少 LAST 片段
+                dropped_bytes_ += payload_.size();
+            }
+            payload_.clear();
+        } else if (!in_record) {
+            // 沒有 FIRST 的 MIDDLE/LAST：所屬記錄的開頭在損壞的塊中
+            dropped_bytes_ += length;
+            continue;
+        }
+        
+        if (type == FRAGMENT_FULL) {
+            if (!decode_payload(data, length, record)) {
+                dropped_bytes_ += length;
+                in_record = false;
+                continue;
+            }
+            record.checksum = crc;
+            valid_end_ = position_;
+            return true;
+        }
+        
+        payload_.insert(payload_.end(), data, data + length);
+        in_record = true;
+        if (type == FRAGMENT_LAST) {
+            in_record = false;
+            if (!decode_payload(payload_.data(), payload_.size(), record)) {
+                dropped_bytes_ += payload_.size();
+                continue;
+            }
+            size_t checksum_length = payload_.size();
+            if (sources_[source_index_].version >= SEGMENT_VERSION_VARINT) {
+                decode_varint_record(payload_.data(), payload_.size(), 0, nullptr, &checksum_length);
+            }
+            record.checksum = crc32c_value(payload_.data(), checksum_length);
+            valid_end_ = position_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WAL::sync_directory() {
+#ifndef _WIN32
+    int fd = ::open(log_dir_.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+uint64_t WAL::append(LogRecord& record) {
+    record.lsn = append_record(record.type, record.txn_id, record.key, record.value, &record.checksum);
+    return record.lsn;
+}
+
+uint64_t WAL::append(LogRecordType type, uint64_t txn_id,
+                     const std::string& key, const std::string& value) {
+    return append_record(type, txn_id, key, value, nullptr);
+}
+
+uint64_t WAL::append_record(LogRecordType type, uint64_t txn_id,
+                            const std::string& key, const std::string& value,
+                            uint32_t* checksum) {
+    // 先登記再檢查狀態：close() 等待所有已登記的生產者入隊完成
+    active_appenders_.fetch_add(1);
     if (!is_open_) {
-        return false;
+        active_appenders_.fetch_sub(1);
+        return 0;
     }
     
-    // 讀取所有記錄
-    auto all_records = read_all_internal();
+    // 分配 LSN 並在調用線程上編碼，寫線程只負責拷貝和寫入
+    // 節點末尾預留 LSNDelta 的空間，由寫線程填寫
+    uint64_t lsn = current_lsn_.fetch_add(1) + 1;
+    size_t capacity = max_encoded_record_size(key, value) + MAX_VARINT64_LENGTH;
+    AppendNode* node = static_cast<AppendNode*>(::operator new(sizeof(AppendNode) + capacity));
+    node->lsn = lsn;
+    uint32_t crc = 0;
+    node->size = encode_record(node->data(), type, txn_id, key, value, &crc);
+    node->crc = crc;
+    if (checksum) {
+        *checksum = crc;
+    }
     
-    // 關閉當前文件
-    log_stream_.close();
+    // 無鎖入隊（Treiber 棧）：寫線程一次取走整個鏈表，不存在單節點出隊的 ABA 問題
+    AppendNode* head = queue_head_.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!queue_head_.compare_exchange_weak(head, node));
     
-    // 重新創建文件
-    log_stream_.open(log_file_path_, 
-                     std::ios::binary | std::ios::out | std::ios::trunc);
+    wake_writer();
+    active_appenders_.fetch_sub(1);
+    return lsn;
+}
+
+void WAL::wake_writer() {
+    // 寫線程先置 writer_idle_ 再檢查隊列，生產者先入隊再讀 writer_idle_（均為順序一致），
+    // 因此不會錯過喚醒；寫線程忙時不需要加鎖
+    if (writer_idle_.load()) {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        writer_cv_.notify_one();
+    }
+}
+
+void WAL::append_fragments(uint8_t* payload, size_t size, uint32_t crc, uint64_t lsn) {
+    // 追加相對活躍段段首的 LSN 增量，記錄校驗和擴展為片段數據的校驗和
+    uint8_t* end = put_varint64(payload + size, lsn - segments_.back().first_lsn);
+    crc = crc32c_extend(crc, payload + size, static_cast<size_t>(end - (payload + size)));
+    size = static_cast<size_t>(end - payload);
     
-    // 寫入 LSN >= lsn 的記錄
-    for (const auto& record : all_records) {
-        if (record.lsn >= lsn) {
-            auto data = serialize_record(record);
-            log_stream_.write(reinterpret_cast<const char*>(data.data()), data.size());
+    bool first = true;
+    do {
+        uint64_t leftover = BLOCK_SIZE - active_size_ % BLOCK_SIZE;
+        if (leftover < FRAGMENT_HEADER_SIZE) {
+            // 塊尾放不下片段頭：零填充，從下一個塊開始
+            append_buffer_.append_zeros(static_cast<size_t>(leftover));
+            active_size_ += leftover;
+            leftover = BLOCK_SIZE;
         }
+        
+        size_t available = static_cast<size_t>(leftover) - FRAGMENT_HEADER_SIZE;
+        size_t fragment_length = std::min(size, available);
+        bool last = fragment_length == size;
+        uint8_t type = first && last ? FRAGMENT_FULL
+                     : first ? FRAGMENT_FIRST
+                     : last ? FRAGMENT_LAST : FRAGMENT_MIDDLE;
+        uint32_t data_crc = type == FRAGMENT_FULL ? crc : crc32c_value(payload, fragment_length);
+        
+        uint8_t header[FRAGMENT_HEADER_SIZE];
+        put_fixed32(header, fragment_checksum(data_crc, type));
+        header[4] = static_cast<uint8_t>(fragment_length & 0xFF);
+        header[5] = static_cast<uint8_t>(fragment_length >> 8);
+        header[6] = type;
+        append_buffer_.append(header, FRAGMENT_HEADER_SIZE);
+        append_buffer_.append(payload, fragment_length);
+        active_size_ += FRAGMENT_HEADER_SIZE + fragment_length;
+        
+        payload += fragment_length;
+        size -= fragment_length;
+        first = false;
+    } while (size > 0);
+}
+
+bool WAL::write_append_buffer() {
+    if (write_offset_ == active_size_) {
+        return true;
     }
-    
-    log_stream_.close();
-    
-    // 重新打開
-    log_stream_.open(log_file_path_, 
-                     std::ios::binary | std::ios::in | std::ios::out | std::ios::app);
-    
-    return log_stream_.is_open();
+    // 寫到頁邊界（補零部分與預分配區域的內容相同），下一次寫入會覆蓋補零部分
+    size_t length = append_buffer_.pad();
+    bool ok = log_fd_ >= 0 && write_at(log_fd_, append_buffer_.data(), length, buffer_offset_);
+    finish_append_write(ok);
+    return ok;
 }
 
-void WAL::close() {
-    std::lock_guard<std::mutex> lock(mutex_);
+void WAL::finish_append_write(bool ok) {
+    if (ok) {
+        bytes_written_ += active_size_ - write_offset_;
+        write_offset_ = active_size_;
+    } else {
+        std::cerr << "WAL write failed at LSN " << current_lsn_ << std::endl;
+    }
     
-    if (is_open_) {
-        flush_internal();
-        log_stream_.close();
-        is_open_ = false;
+    // 只保留最後一個不完整的頁；偶發的超大記錄不應讓緩衝區一直佔用內存
+    uint64_t tail_offset = active_size_ - active_size_ % IO_ALIGNMENT;
+    size_t tail = static_cast<size_t>(active_size_ - tail_offset);
+    if (append_buffer_.capacity() > APPEND_BUFFER_MAX_RETAINED) {
+        uint8_t page[IO_ALIGNMENT];
+        memcpy(page, append_buffer_.data() + (tail_offset - buffer_offset_), tail);
+        append_buffer_.clear(APPEND_BUFFER_INITIAL);
+        append_buffer_.reserve(APPEND_BUFFER_INITIAL);
+        append_buffer_.append(page, tail);
+    } else {
+        append_buffer_.consume(static_cast<size_t>(tail_offset - buffer_offset_));
     }
+    buffer_offset_ = tail_offset;
 }
 
-uint32_t WAL::calculate_checksum(const LogRecord& record) {
-    std::vector<uint8_t> data;
-    
-    // 包含類型、事務 ID、LSN、鍵和值
-    data.push_back(static_cast<uint8_t>(record.type));
-    
-    for (int i = 0; i < 8; ++i) {
-        data.push_back((record.txn_id >> (i * 8)) & 0xFF);
+bool WAL::write_and_sync() {
+    std::vector<IoRing::Request> requests;
+    requests.reserve(retired_fds_.size() + 2);
+    if (!direct_io_) {
+        for (int fd : retired_fds_) {
+            IoRing::Request request;
+            request.op = IoRing::Op::FSYNC;
+            request.fd = fd;
+            requests.push_back(request);
+        }
     }
-    
-    for (int i = 0; i < 8; ++i) {
-        data.push_back((record.lsn >> (i * 8)) & 0xFF);
+    bool has_write = write_offset_ != active_size_;
+    if (has_write) {
+        IoRing::Request request;
+        request.op = IoRing::Op::WRITE;
+        request.fd = log_fd_;
+        request.buffer = append_buffer_.data();
+        request.length = append_buffer_.pad();
+        request.offset = buffer_offset_;
+        request.link = !direct_io_;   // 寫入成功後才執行 fdatasync
+        requests.push_back(request);
+    }
+    if (!direct_io_) {
+        IoRing::Request request;
+        request.op = IoRing::Op::FSYNC;
+        request.fd = log_fd_;
+        requests.push_back(request);
     }
     
-    data.insert(data.end(), record.key.begin(), record.key.end());
-    data.insert(data.end(), record.value.begin(), record.value.end());
+    auto start = std::chrono::steady_clock::now();
+    bool ok = io_ring_->run(requests.data(), requests.size());
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    if (!direct_io_) {
+        sync_count_ += retired_fds_.size() + 1;
+        sync_time_us_ += static_cast<uint64_t>(elapsed.count());
+    }
     
-    return crc32(data.data(), data.size());
+    for (int fd : retired_fds_) {
+        close_fd(fd);
+    }
+    retired_fds_.clear();
+    if (has_write) {
+        finish_append_write(ok);
+    } else if (!ok) {
+        std::cerr << "WAL fdatasync failed in " << log_dir_ << std::endl;
+    }
+    return ok;
 }
 
-std::vector<uint8_t> WAL::serialize_record(const LogRecord& record) {
-    std::vector<uint8_t> data;
-    
-    // Type (1 byte)
-    data.push_back(static_cast<uint8_t>(record.type));
-    
-    // TxnID (8 bytes)
-    for (int i = 0; i < 8; ++i) {
-        data.push_back((record.txn_id >> (i * 8)) & 0xFF);
+int WAL::open_segment_fd(const std::string& path, bool truncate) {
+    int fd = open_fd(path, truncate, direct_io_);
+    if (fd < 0 && direct_io_) {
+        // 文件系統不支持 O_DIRECT（如 tmpfs）：回退到經過頁緩存的寫入
+        std::cerr << "O_DIRECT not supported for " << path << ", using buffered WAL writes" << std::endl;
+        direct_io_ = false;
+        fd = open_fd(path, truncate, false);
     }
-    
-    // LSN (8 bytes)
-    for (int i = 0; i < 8; ++i) {
-        data.push_back((record.lsn >> (i * 8)) & 0xFF);
+    return fd;
+}
+
+void WAL::preallocate_segment() {
+    if (!preallocate_ || log_fd_ < 0 || file_size_of(log_fd_) >= segment_size_) {
+        return;
     }
-    
-    // KeyLen (4 bytes)
-    uint32_t key_len = static_cast<uint32_t>(record.key.size());
-    for (int i = 0; i < 4; ++i) {
-        data.push_back((key_len >> (i * 8)) & 0xFF);
+    if (!preallocate_fd(log_fd_, segment_size_)) {
+        std::cerr << "WAL preallocation not supported in " << log_dir_ << ", segments grow on append" << std::endl;
+        preallocate_ = false;
+    }
+}
+
+// ===== 對齊寫緩衝區 =====
+
+static uint8_t* aligned_allocate(size_t size) {
+#ifdef _WIN32
+    void* p = _aligned_malloc(size, IO_ALIGNMENT);
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, IO_ALIGNMENT, size) != 0) {
+        p = nullptr;
+    }
+#endif
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return static_cast<uint8_t*>(p);
+}
+
+static void aligned_free(uint8_t* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+WAL::AlignedBuffer::AlignedBuffer() : data_(nullptr), size_(0), capacity_(0) {
+}
+
+WAL::AlignedBuffer::~AlignedBuffer() {
+    if (data_) {
+        aligned_free(data_);
+    }
+}
+
+void WAL::AlignedBuffer::reserve(size_t capacity) {
+    if (capacity <= capacity_) {
+        return;
+    }
+    // 按倍數增長，並向上取整到對齊粒度，保證 pad 之後的長度不超過容量
+    capacity = std::max(capacity, capacity_ * 2);
+    capacity = (capacity + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+    uint8_t* data = aligned_allocate(capacity);
+    if (data_) {
+        memcpy(data, data_, size_);
+        aligned_free(data_);
+    }
+    data_ = data;
+    capacity_ = capacity;
+}
+
+void WAL::AlignedBuffer::append(const uint8_t* data, size_t size) {
+    reserve(size_ + size);
+    memcpy(data_ + size_, data, size);
+    size_ += size;
+}
+
+void WAL::AlignedBuffer::append_zeros(size_t size) {
+    reserve(size_ + size);
+    memset(data_ + size_, 0, size);
+    size_ += size;
+}
+
+size_t WAL::AlignedBuffer::pad() {
+    size_t padded = (size_ + IO_ALIGNMENT - 1) / IO_ALIGNMENT * IO_ALIGNMENT;
+    memset(data_ + size_, 0, padded - size_);
+    return padded;
+}
+
+void WAL::AlignedBuffer::consume(size_t size) {
+    memmove(data_, data_ + size, size_ - size);
+    size_ -= size;
+}
+
+void WAL::AlignedBuffer::clear(size_t max_retained) {
+    size_ = 0;
+    if (capacity_ > max_retained) {
+        aligned_free(data_);
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+}
+
+bool WAL::flush() {
+    if (!is_open_) {
+        return false;
+    }
+    return wait_for_lsn(current_lsn_, true);
+}
+
+bool WAL::group_commit(uint64_t lsn) {
+    // INTERVAL/OS 模式：等待記錄寫入內核，不等待落盤
+    if (!wait_for_lsn(lsn, sync_mode_ == WALSyncMode::ALWAYS)) {
+        return false;
+    }
+    group_commits_++;
+    return true;
+}
+
+void WAL::request_sync(uint64_t lsn) {
+    uint64_t requested = sync_request_lsn_.load();
+    while (requested < lsn && !sync_request_lsn_.compare_exchange_weak(requested, lsn)) {
+    }
+    wake_writer();
+}
+
+bool WAL::wait_for_lsn(uint64_t lsn, bool durable) {
+    if (durable) {
+        request_sync(lsn);
+    } else {
+        wake_writer();
     }
     
-    // Key
-    data.insert(data.end(), record.key.begin(), record.key.end());
+    std::unique_lock<std::mutex> lock(sync_mutex_);
+    const uint64_t& watermark = durable ? flushed_lsn_ : written_lsn_;
+    sync_cv_.wait(lock, [&]() {
+        return watermark >= lsn || io_error_;
+    });
+    // 寫入失敗後日誌中可能有缺口，之後的同步也不能保證記錄可以重放
+    return watermark >= lsn && !io_error_;
+}
+
+uint64_t WAL::get_flushed_lsn() {
+    std::lock_guard<std::mutex> lock(sync_mutex_);
+    return flushed_lsn_;
+}
+
+void WAL::writer_loop() {
+    auto last_sync = std::chrono::steady_clock::now();
+    const auto interval = std::chrono::milliseconds(sync_interval_ms_);
     
-    // ValueLen (4 bytes)
-    uint32_t value_len = static_cast<uint32_t>(record.value.size());
-    for (int i = 0; i < 4; ++i) {
-        data.push_back((value_len >> (i * 8)) & 0xFF);
+    for (;;) {
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(writer_mutex_);
+            writer_idle_.store(true);
+            auto has_work = [&]() {
+                return stop_writer_ || queue_head_.load() != nullptr ||
+                       (sync_request_lsn_.load() > flushed_lsn_ && written_lsn_ > flushed_lsn_);
+            };
+            while (!has_work()) {
+                if (sync_mode_ == WALSyncMode::INTERVAL && written_lsn_ > flushed_lsn_) {
+                    // 有未同步的數據：最多睡到下一次定時同步
+                    if (writer_cv_.wait_until(lock, last_sync + interval) == std::cv_status::timeout) {
+                        break;
+                    }
+                } else {
+                    writer_cv_.wait(lock);
+                }
+            }
+            writer_idle_.store(false);
+            stopping = stop_writer_;
+        }
+        
+        // 取走隊列中的所有節點。入隊順序與 LSN 順序不一定相同，
+        // 按 LSN 降序排列後只寫出從 next_write_lsn_ 開始的連續部分
+        AppendNode* list = queue_head_.exchange(nullptr);
+        if (list) {
+            for (AppendNode* node = list; node; node = node->next) {
+                pending_.push_back(node);
+            }
+            std::sort(pending_.begin(), pending_.end(),
+                      [](const AppendNode* a, const AppendNode* b) { return a->lsn > b->lsn; });
+        }
+        
+        bool ok = true;
+        bool need_sync = false;
+        bool ring_synced = false;
+        bool commit_sync = false;
+        uint64_t written = 0;
+        uint64_t seq = 0;
+        uint64_t offset = 0;
+        int fd = -1;
+        std::vector<int> retired;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (!pending_.empty() && pending_.back()->lsn == next_write_lsn_) {
+                AppendNode* node = pending_.back();
+                pending_.pop_back();
+                
+                // 活躍段寫滿則輪轉到新段（create_segment 會先寫出緩衝區）
+                if (active_size_ > SEGMENT_HEADER_SIZE && active_size_ + node->size > segment_size_) {
+                    if (!create_segment(node->lsn)) {
+                        std::cerr << "WAL segment rotation failed at LSN " << node->lsn << std::endl;
+                        ok = false;
+                    }
+                }
+                append_fragments(node->data(), node->size, node->crc, node->lsn);
+                next_write_lsn_++;
+                ::operator delete(node);
+                
+                if (append_buffer_.size() >= APPEND_BUFFER_FLUSH_SIZE) {
+                    ok = write_append_buffer() && ok;
+                }
+            }
+            written = next_write_lsn_ - 1;
+            
+            bool interval_due = sync_mode_ == WALSyncMode::INTERVAL &&
+                                std::chrono::steady_clock::now() - last_sync >= interval;
+            commit_sync = sync_request_lsn_.load() > flushed_lsn_;
+            bool sync_due = written > flushed_lsn_ && (commit_sync || interval_due || stopping);
+            if (ok && sync_due && io_ring_) {
+                // 最後一次寫入與 fdatasync 鏈接為一次提交；期間持有 mutex_，只阻塞讀取游標與截斷
+                ok = write_and_sync();
+                ring_synced = ok;
+                seq = segments_.back().seq;
+                offset = active_size_;
+            } else {
+                ok = write_append_buffer() && ok;
+                need_sync = ok && sync_due;
+            }
+            if (need_sync) {
+                seq = segments_.back().seq;
+                offset = active_size_;
+                fd = log_fd_;
+                retired.swap(retired_fds_);
+            }
+        }
+        
+        if (ring_synced) {
+            last_sync = std::chrono::steady_clock::now();
+            store_meta(seq, offset, written);
+        }
+        {
+            std::lock_guard<std::mutex> lock(sync_mutex_);
+            written_lsn_ = written;
+            if (!ok) {
+                io_error_ = true;
+            }
+            if (ring_synced) {
+                flushed_lsn_ = written;
+                if (commit_sync) {
+                    group_flushes_++;
+                }
+            }
+            sync_cv_.notify_all();
+        }
+        
+        // fdatasync 期間不持有任何鎖：生產者繼續入隊，組成下一批
+        if (need_sync) {
+            // 先同步已輪轉的舊段，再同步活躍段
+            bool synced = sync_retired(retired);
+            synced = sync_file(fd) && synced;
+            last_sync = std::chrono::steady_clock::now();
+            if (synced) {
+                store_meta(seq, offset, written);
+            }
+            
+            std::lock_guard<std::mutex> lock(sync_mutex_);
+            if (synced) {
+                flushed_lsn_ = written;
+                if (commit_sync) {
+                    group_flushes_++;
+                }
+            } else {
+                io_error_ = true;
+            }
+            sync_cv_.notify_all();
+        }
+        
+        if (stopping && queue_head_.load() == nullptr && pending_.empty()) {
+            break;
+        }
     }
+}
+
+bool WAL::sync_file(int fd) {
+    if (direct_io_) {
+        // O_DSYNC：寫入返回時數據已落盤
+        return true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool ok = datasync_fd(fd);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    sync_count_++;
+    sync_time_us_ += static_cast<uint64_t>(elapsed.count());
+    if (!ok) {
+        std::cerr << "WAL fdatasync failed in " << log_dir_ << std::endl;
+    }
+    return ok;
+}
+
+bool WAL::sync_retired(std::vector<int>& fds) {
+    bool ok = true;
+    for (int fd : fds) {
+        ok = sync_file(fd) && ok;
+        close_fd(fd);
+    }
+    fds.clear();
+    return ok;
+}
+
+uint64_t WAL::get_last_lsn() const {
+    return current_lsn_;
+}
+
+std::unique_ptr<WAL::Reader> WAL::new_reader(uint64_t start_lsn) {
+    // 等待已追加的記錄寫入文件
+    if (is_open_) {
+        wait_for_lsn(current_lsn_, false);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
     
-    // Value
-    data.insert(data.end(), record.value.begin(), record.value.end());
-    
-    // Checksum (4 bytes)
-    for (int i = 0; i < 4; ++i) {
-        data.push_back((record.checksum >> (i * 8)) & 0xFF);
+    std::vector<Reader::Source> sources;
+    if (is_open_) {
+        start_lsn = std::max(start_lsn, truncated_lsn_);
+        
+        // 跳過所有記錄都小於 start_lsn 的段
+        size_t first = 0;
+        while (first + 1 < segments_.size() && segments_[first + 1].first_lsn <= start_lsn) {
+            ++first;
+        }
+        for (size_t i = first; i < segments_.size(); ++i) {
+            sources.push_back(segment_source(segments_[i]));
+        }
+        // 活躍段只讀到創建游標時的大小，不讀之後並發寫入的記錄
+        if (!sources.empty()) {
+            sources.back().limit = active_size_;
+        }
     }
     
-    return data;
+    return std::unique_ptr<Reader>(new Reader(std::move(sources), start_lsn));
 }
 
-LogRecord WAL::deserialize_record(const std::vector<uint8_t>& data, size_t& offset) {
+bool WAL::follow(Reader& reader) {
+    if (is_open_) {
+        wait_for_lsn(current_lsn_, false);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!is_open_ || reader.sources_.empty() || reader.source_index_ < reader.sources_.size()) {
+        return false;
+    }
+
+    size_t index = 0;
+    while (index < segments_.size() && segments_[index].path != reader.sources_.back().path) {
+        ++index;
+    }
+    if (index == segments_.size()) {
+        return false;
+    }
+
+    // 從最後一條有效記錄之後繼續；valid_end 總是落在記錄邊界上
+    std::vector<Reader::Source> sources;
+    for (size_t i = index; i < segments_.size(); ++i) {
+        sources.push_back(segment_source(segments_[i]));
+    }
+    sources.front().data_offset = std::max(sources.front().data_offset, reader.valid_end_);
+    sources.back().limit = active_size_;
+
+    reader.sources_ = std::move(sources);
+    reader.source_index_ = 0;
+    return true;
+}
+
+std::vector<LogRecord> WAL::read_from(uint64_t start_lsn) {
+    std::vector<LogRecord> records;
+    auto reader = new_reader(start_lsn);
     LogRecord record;
-    
-    if (offset >= data.size()) {
-        throw std::runtime_error("Offset out of range");
+    while (reader->next(record)) {
+        records.push_back(record);
     }
+    return records;
+}
+
+bool WAL::truncate(uint64_t lsn) {
+    std::lock_guard<std::mutex> lock(mutex_);
     
-    // Type
-    record.type = static_cast<LogRecordType>(data[offset++]);
-    
-    // TxnID
-    record.txn_id = 0;
-    for (int i = 0; i < 8; ++i) {
-        record.txn_id |= (static_cast<uint64_t>(data[offset++]) << (i * 8));
+    if (!is_open_) {
+        return false;
     }
     
-    // LSN
-    record.lsn = 0;
-    for (int i = 0; i < 8; ++i) {
-        record.lsn |= (static_cast<uint64_t>(data[offset++]) << (i * 8));
-    }
+    // 刪除段文件之前，先同步並關閉已輪轉的描述符（Windows 不能刪除已打開的文件）；
+    // 寫線程只同步它在 mutex_ 下取走的描述符，兩者不會重疊
+    bool ok = sync_retired(retired_fds_);
     
-    // KeyLen
-    uint32_t key_len = 0;
-    for (int i = 0; i < 4; ++i) {
-        key_len |= (static_cast<uint32_t>(data[offset++]) << (i * 8));
+    // 只刪除下一個段的起始 LSN 也不超過 lsn 的整段，活躍段永不刪除
+    size_t removed = 0;
+    while (removed + 1 < segments_.size() && segments_[removed + 1].first_lsn <= lsn) {
+        if (std::remove(segments_[removed].path.c_str()) != 0) {
+            std::cerr << "Failed to remove WAL segment: " << segments_[removed].path << std::endl;
+            ok = false;
+            break;
+        }
+        ++removed;
+    }
+    segments_.erase(segments_.begin(), segments_.begin() + removed);
+    if (removed > 0) {
+        sync_directory();
     }
     
-    // Key
-    record.key.assign(data.begin() + offset, data.begin() + offset + key_len);
-    offset += key_len;
+    truncated_lsn_ = std::max(truncated_lsn_, lsn);
     
-    // ValueLen
-    uint32_t value_len = 0;
-    for (int i = 0; i < 4; ++i) {
-        value_len |= (static_cast<uint32_t>(data[offset++]) << (i * 8));
+    return ok;
+}
+
+size_t WAL::get_segment_count() {
+    // 段輪轉由寫線程完成，先等待已追加的記錄寫出
+    if (is_open_) {
+        wait_for_lsn(current_lsn_, false);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_.size();
+}
+
+void WAL::close() {
+    if (!is_open_.exchange(false)) {
+        return;
     }
     
-    // Value
-    record.value.assign(data.begin() + offset, data.begin() + offset + value_len);
-    offset += value_len;
+    // 等待已登記的生產者完成入隊，之後隊列不再增長
+    while (active_appenders_.load() != 0) {
+        std::this_thread::yield();
+    }
     
-    // Checksum
-    record.checksum = 0;
-    for (int i = 0; i < 4; ++i) {
-        record.checksum |= (static_cast<uint32_t>(data[offset++]) << (i * 8));
+    // 寫線程寫完隊列中的所有記錄並做最後一次同步後退出
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        stop_writer_ = true;
+        writer_cv_.notify_one();
+    }
+    if (writer_thread_.joinable()) {
+        writer_thread_.join();
     }
     
-    return record;
+    std::lock_guard<std::mutex> lock(mutex_);
+    io_ring_.reset();
+    sync_retired(retired_fds_);
+    close_fd(log_fd_);
+    log_fd_ = -1;
+    close_fd(meta_fd_);
+    meta_fd_ = -1;
+    segments_.clear();
+    
+    // 喚醒仍在等待水位線的調用者
+    std::lock_guard<std::mutex> sync_lock(sync_mutex_);
+    sync_cv_.notify_all();
 }
 
 std::string WAL::get_log_file_path() const {
@@ -410,4 +1780,22 @@ std::string WAL::get_log_file_path() const {
 #endif
 }
 
+std::string WAL::get_meta_path() const {
+#ifdef _WIN32
+    return log_dir_ + "\\" + META_FILE_NAME;
+#else
+    return log_dir_ + "/" + META_FILE_NAME;
+#endif
+}
+
+std::string WAL::get_segment_path(uint64_t seq) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%s%06llu", SEGMENT_PREFIX, static_cast<unsigned long long>(seq));
+#ifdef _WIN32
+    return log_dir_ + "\\" + name;
+#else
+    return log_dir_ + "/" + name;
+#endif
+}
+
 } // namespace kvengine
@@ -8,15 +8,20 @@
 #define KVENGINE_WAL_H
 
 #include "../include/kvengine/types.h"
+#include "../include/kvengine/options.h"
 #include <string>
 #include <vector>
-#include <fstream>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <cstdint>
 #include <atomic>
+#include <memory>
 
 namespace kvengine {
 
+class IoRing;
+
 /**
  * @enum LogRecordType
  * @brief 日誌記錄類型
@@ -27,7 +32,10 @@ enum class LogRecordType : uint8_t {
     BEGIN = 3,         // 開始事務
     COMMIT = 4,        // 提交事務
     ROLLBACK = 5,      // 回滾事務
-    CHECKPOINT = 6     // 檢查點
+    CHECKPOINT = 6,    // 檢查點結束（鍵為活躍事務列表，值為 "快照LSN-開始記錄LSN"）
+    AUTOCOMMIT_PUT = 7,    // 自動提交的單鍵插入/更新（無 BEGIN/COMMIT，本身即已提交）
+    AUTOCOMMIT_DELETE = 8, // 自動提交的單鍵刪除
+    CHECKPOINT_BEGIN = 9   // 檢查點開始（值為快照 LSN）
 };
 
 /**
@@ -40,7 +48,7 @@ struct LogRecord {
     uint64_t lsn;            // 日誌序列號 (Log Sequence Number)
     std::string key;         // 鍵
     std::string value;       // 值（DELETE 時為空）
-    uint32_t checksum;       // CRC32 校驗和
+    uint32_t checksum;       // 校驗和（CRC32C；varint 段中覆蓋 LSN 增量之前的編碼記錄，舊版本段為 CRC32）
     
     LogRecord() 
         : type(LogRecordType::PUT), txn_id(0), lsn(0), checksum(0) {}
@@ -52,15 +60,142 @@ struct LogRecord {
 /**
  * @class WAL
  * @brief 預寫日誌管理器
- * @details 負責日誌的寫入、刷新和讀取
+ * @details 負責日誌的寫入、刷新和讀取。
+ *          append 在調用線程上分配 LSN 並編碼記錄，然後壓入無鎖的多生產者隊列立即返回；
+ *          專用寫線程把隊列按 LSN 順序合併為大塊順序寫入，並發布「已寫入」與「已持久化」
+ *          兩個水位線，需要持久性的調用者等待水位線。
+ *          日誌按固定大小切分為段文件（wal.000001, wal.000002, ...），
+ *          每個段以段頭開始，段頭記錄該段第一條記錄的 LSN。
+ *          段內由 32KB 定長塊組成，記錄按塊邊界切分為 FULL/FIRST/MIDDLE/LAST 片段，
+ *          每個片段帶有自己的校驗和，損壞只影響所在的塊。
+ *          記錄長度與事務 ID 以 varint 編碼，LSN 以相對段首的增量編碼，以減少每條記錄的開銷。
+ *          新段以 fallocate 預分配到段大小，寫線程從 4KB 對齊的緩衝區按整頁寫入，
+ *          可選以 O_DIRECT | O_DSYNC 打開段文件；讀取時連續兩個塊以零填充結束即視為數據末尾。
+ *          可選通過 io_uring 把需要持久化的最後一次寫入與 fdatasync 鏈接為一次提交。
+ *          截斷只刪除整個段文件，讀取只打開需要的段。
  */
 class WAL {
 public:
+    /**
+     * @class Reader
+     * @brief 日誌的順序讀取游標
+     * @details 以有界窗口分塊 pread 段文件，每次產出一條記錄，不把整個日誌讀入內存。
+     *          塊格式段按塊對齊預讀整塊，片段校驗失敗時丟棄該塊的剩餘部分，從下一個塊重新同步；
+     *          舊格式段為連續的記錄流，窗口只在遇到比它大的記錄時增長，
+     *          遇到不完整或校驗失敗的記錄時停止讀取該段，繼續下一個段。
+     */
+    class Reader {
+    public:
+        ~Reader();
+        
+        /**
+         * @brief 讀取下一條記錄
+         * @param record 輸出記錄（重用其中字符串的容量）
+         * @return 有記錄返回 true，讀完返回 false
+         */
+        bool next(LogRecord& record);
+        
+        /**
+         * @brief 當前段中最後一條有效記錄之後的文件偏移
+         */
+        uint64_t valid_end() const { return valid_end_; }
+        
+        /**
+         * @brief 因校驗失敗或格式錯誤而跳過的字節數
+         */
+        uint64_t dropped_bytes() const { return dropped_bytes_; }
+        
+        /**
+         * @brief 當前段中最後一個非零片段之後的文件偏移（含無效片段）
+         */
+        uint64_t data_end() const { return data_end_; }
+        
+    private:
+        friend class WAL;
+        
+        /**
+         * @struct Source
+         * @brief 待讀取的文件
+         */
+        struct Source {
+            std::string path;          // 文件路徑
+            uint64_t data_offset;      // 第一條記錄的偏移（跳過段頭）
+            uint64_t limit;            // 最多讀到的偏移（活躍段取創建游標時的大小）
+            uint32_t version;          // 段版本（決定校驗和算法與記錄格式）
+            uint64_t first_lsn;        // 段首 LSN（varint 段中記錄的 LSN 相對於它編碼）
+        };
+        
+        Reader(std::vector<Source> sources, uint64_t start_lsn);
+        
+        /**
+         * @brief 打開當前文件
+         */
+        bool open_source();
+        
+        /**
+         * @brief 關閉當前文件並前進到下一個
+         */
+        void close_source();
+        
+        /**
+         * @brief 保證窗口中至少有 n 個未消費字節
+         * @return 文件剩餘數據不足時返回 false
+         */
+        bool ensure(size_t n);
+        
+        /**
+         * @brief 從窗口解碼一條記錄並校驗（舊格式段）
+         * @return 記錄不完整或校驗失敗時返回 false
+         */
+        bool read_record(LogRecord& record);
+        
+        /**
+         * @brief 讀取下一個片段（塊格式段）
+         * @details 跳過塊尾填充；校驗失敗時丟棄所在塊的剩餘部分
+         * @param type 輸出片段類型
+         * @param data 輸出片段數據（指向窗口，下次讀取前有效）
+         * @param length 輸出片段長度
+         * @param data_crc 輸出片段數據的 CRC32C（varint 段的 FULL 片段不含 LSN 增量）
+         * @return 讀到文件末尾返回 false
+         */
+        bool read_fragment(uint8_t* type, const uint8_t** data, size_t* length, uint32_t* data_crc);
+        
+        /**
+         * @brief 按當前段的記錄格式解碼一條完整記錄
+         * @return 格式不符時返回 false
+         */
+        bool decode_payload(const uint8_t* data, size_t length, LogRecord& record);
+        
+        /**
+         * @brief 組裝片段並解碼一條記錄（塊格式段）
+         * @return 讀到文件末尾返回 false
+         */
+        bool read_block_record(LogRecord& record);
+        
+        std::vector<Source> sources_;  // 按順序讀取的文件
+        size_t source_index_;          // 當前文件下標
+        uint64_t start_lsn_;           // 只產出 LSN >= start_lsn_ 的記錄
+        int fd_;                       // 當前文件描述符
+        uint64_t file_size_;           // 當前文件可讀大小
+        uint64_t file_offset_;         // 下一次 pread 的文件偏移
+        uint64_t valid_end_;           // 最後一條有效記錄之後的偏移
+        std::vector<uint8_t> window_;  // 讀取窗口
+        size_t window_begin_;          // 窗口中未消費數據的起點
+        size_t window_end_;            // 窗口中有效數據的終點
+        uint64_t window_offset_;       // 塊格式：窗口起點的文件偏移（塊對齊）
+        uint64_t position_;            // 塊格式：下一個片段的文件偏移
+        std::vector<uint8_t> payload_; // 塊格式：跨塊記錄的組裝緩衝區
+        uint64_t dropped_bytes_;       // 跳過的損壞字節數
+        uint64_t data_end_;            // 塊格式：最後一個非零片段之後的偏移
+        uint64_t zero_block_;          // 塊格式：最近一個以零填充結束的塊的起點
+    };
+    
     /**
      * @brief 構造函數
      * @param log_dir 日誌目錄路徑
+     * @param options 引擎配置（使用其中的 WAL 持久化策略與段大小）
      */
-    explicit WAL(const std::string& log_dir);
+    explicit WAL(const std::string& log_dir, const Options& options = Options());
     
     /**
      * @brief 析構函數
@@ -76,25 +211,124 @@ public:
     
     /**
      * @brief 追加日誌記錄
+     * @details 不等待寫入文件；需要持久性時對返回的 LSN 調用 group_commit
      * @param record 日誌記錄
      * @return 分配的 LSN
      */
     uint64_t append(LogRecord& record);
     
+    /**
+     * @brief 追加日誌記錄（不構造 LogRecord）
+     * @details 鍵和值直接編碼進隊列節點，避免先拷貝到 LogRecord
+     * @param type 記錄類型
+     * @param txn_id 事務 ID
+     * @param key 鍵
+     * @param value 值（DELETE 時為空）
+     * @return 分配的 LSN
+     */
+    uint64_t append(LogRecordType type, uint64_t txn_id,
+                    const std::string& key, const std::string& value = std::string());
+    
     /**
      * @brief 刷新日誌到磁盤
+     * @details 無論持久化策略為何，都等待當前最後 LSN 之前的日誌 fdatasync 完成，
+     *          但不計入提交統計
      * @return 成功返回 true
      */
     bool flush();
     
+    /**
+     * @brief 組提交：等待指定 LSN 之前的日誌全部持久化
+     * @details ALWAYS 模式下向寫線程登記持久化請求並等待持久化水位線：
+     *          寫線程一次 fdatasync 覆蓋所有已寫入的日誌，同時喚醒所有被覆蓋的提交者。
+     *          INTERVAL 與 OS 模式下等待日誌寫入內核（已寫入水位線）即返回。
+     * @param lsn 提交記錄的 LSN
+     * @return 成功返回 true；寫入、同步或段輪轉失敗之後直到重新打開都返回 false
+     */
+    bool group_commit(uint64_t lsn);
+    
+    /**
+     * @brief 獲取已持久化的最大 LSN
+     * @return 已刷新的 LSN
+     */
+    uint64_t get_flushed_lsn();
+    
+    /**
+     * @brief 請求寫線程把日誌同步到指定 LSN，不等待完成
+     * @details 用於只讀取已持久化日誌的游標（複製）在追上持久化水位線之後推進它
+     * @param lsn 目標 LSN
+     */
+    void request_sync(uint64_t lsn);
+    
+    /**
+     * @brief 獲取組提交次數（經由 group_commit 等待持久化的提交數）
+     */
+    uint64_t get_group_commit_count() const { return group_commits_; }
+    
+    /**
+     * @brief 獲取組提交實際執行的刷新次數
+     * @details 提交數 / 刷新數 即每次刷新平均覆蓋的提交數
+     */
+    uint64_t get_group_flush_count() const { return group_flushes_; }
+    
+    /**
+     * @brief 獲取 fdatasync 次數（包括 INTERVAL 模式的定時同步）
+     */
+    uint64_t get_sync_count() const { return sync_count_; }
+    
+    /**
+     * @brief 獲取 fdatasync 累計耗時（微秒）
+     */
+    uint64_t get_sync_time_us() const { return sync_time_us_; }
+    
+    /**
+     * @brief 獲取打開以來寫入日誌文件的字節數
+     */
+    uint64_t get_bytes_written() const { return bytes_written_; }
+    
+    /**
+     * @brief 獲取打開時掃描的日誌字節數
+     * @details 打開只掃描元數據記錄的持久化位置之後的尾部，正常關閉後為 0
+     */
+    uint64_t get_open_scan_bytes() const { return open_scan_bytes_; }
+    
+    /**
+     * @brief 寫入是否通過 io_uring 提交
+     */
+    bool is_io_uring_enabled() const { return io_ring_ != nullptr; }
+    
+    /**
+     * @brief 獲取持久化策略
+     */
+    WALSyncMode get_sync_mode() const { return sync_mode_; }
+    
     /**
      * @brief 獲取最後的 LSN
      * @return 最後的 LSN
      */
     uint64_t get_last_lsn() const;
     
+    /**
+     * @brief 創建從指定 LSN 開始的順序讀取游標
+     * @details 等待創建前已追加的記錄寫入文件，游標覆蓋這些記錄；讀取時不持有 WAL 的鎖
+     * @param start_lsn 起始 LSN
+     * @return 讀取游標
+     */
+    std::unique_ptr<Reader> new_reader(uint64_t start_lsn);
+
+    /**
+     * @brief 讓已讀完的游標繼續讀取之後追加的記錄
+     * @details 游標從它讀過的最後一個段中最後一條有效記錄之後繼續，並覆蓋之後輪轉出的新段，
+     *          不重新掃描已讀過的部分；用於複製時持續跟隨日誌尾部。
+     *          調用前 reader.next() 必須已返回 false
+     * @param reader 由 new_reader 創建的游標
+     * @return 游標所在的段已被截斷時返回 false（調用者需要重新創建游標）
+     */
+    bool follow(Reader& reader);
+
     /**
      * @brief 從指定 LSN 開始讀取日誌
+     * @details 把游標產出的所有記錄收集到列表；大日誌請直接使用 new_reader
      * @param start_lsn 起始 LSN
      * @return 日誌記錄列表
      */
@@ -102,65 +336,317 @@ public:
     
     /**
      * @brief 截斷日誌（刪除指定 LSN 之前的日誌）
+     * @details 只刪除所有記錄都小於 lsn 的整段文件，不重寫任何數據；
+     *          保留段中小於 lsn 的記錄不會再被 read_from 返回
      * @param lsn 截斷點 LSN
      * @return 成功返回 true
      */
     bool truncate(uint64_t lsn);
     
+    /**
+     * @brief 獲取當前段文件數量
+     * @details 先等待已追加的記錄寫入文件，結果包含它們觸發的段輪轉
+     */
+    size_t get_segment_count();
+    
     /**
      * @brief 關閉 WAL
      */
     void close();
     
 private:
+    /**
+     * @struct Segment
+     * @brief 段文件描述
+     */
+    struct Segment {
+        uint64_t seq;                  // 段序號（文件名後綴）
+        uint64_t first_lsn;            // 段內第一條記錄的 LSN
+        uint32_t version;              // 段格式版本（決定記錄校驗和算法）
+        std::string path;              // 文件路徑
+    };
+    
+    /**
+     * @class AlignedBuffer
+     * @brief 按 I/O 對齊粒度分配的寫緩衝區（O_DIRECT 要求地址、長度與偏移均對齊）
+     */
+    class AlignedBuffer {
+    public:
+        AlignedBuffer();
+        ~AlignedBuffer();
+        
+        uint8_t* data() { return data_; }
+        size_t size() const { return size_; }
+        size_t capacity() const { return capacity_; }
+        
+        /**
+         * @brief 追加數據，容量不足時按對齊粒度擴容
+         */
+        void append(const uint8_t* data, size_t size);
+        
+        /**
+         * @brief 追加 size 個零字節
+         */
+        void append_zeros(size_t size);
+        
+        /**
+         * @brief 把大小補零到對齊粒度的整數倍，返回補齊後的大小（不改變 size()）
+         */
+        size_t pad();
+        
+        /**
+         * @brief 丟棄開頭的 size 個字節，其餘數據移到緩衝區開頭
+         */
+        void consume(size_t size);
+        
+        /**
+         * @brief 清空數據；容量超過 max_retained 時釋放內存
+         */
+        void clear(size_t max_retained = SIZE_MAX);
+        
+        /**
+         * @brief 保證容量至少為 capacity
+         */
+        void reserve(size_t capacity);
+        
+    private:
+        AlignedBuffer(const AlignedBuffer&);
+        AlignedBuffer& operator=(const AlignedBuffer&);
+        
+        uint8_t* data_;                // 對齊的內存
+        size_t size_;                  // 數據長度
+        size_t capacity_;              // 已分配長度（對齊粒度的整數倍）
+    };
+    
+    /**
+     * @struct AppendNode
+     * @brief 追加隊列節點：一條已編碼的記錄，編碼數據緊跟在節點之後
+     * @details 編碼數據之後預留 LSN 增量的空間，由寫線程在確定所屬段後填寫
+     */
+    struct AppendNode {
+        AppendNode* next;              // 隊列鏈接
+        uint64_t lsn;                  // 記錄 LSN
+        size_t size;                   // 編碼長度（不含 LSN 增量）
+        uint32_t crc;                  // 編碼數據的 CRC32C（寫線程據此計算片段校驗和）
+        
+        uint8_t* data() { return reinterpret_cast<uint8_t*>(this + 1); }
+    };
+    
     std::string log_dir_;              // 日誌目錄
-    std::string log_file_path_;        // 日誌文件路徑
-    std::fstream log_stream_;          // 日誌文件流
-    std::atomic<uint64_t> current_lsn_;// 當前 LSN（原子操作）
-    std::mutex mutex_;                 // 線程安全鎖
-    bool is_open_;                     // 是否已打開
+    int log_fd_;                       // 活躍段的文件描述符（直接寫入內核，以便真正 fdatasync）
+    uint64_t active_size_;             // 活躍段當前大小（字節）
+    uint64_t segment_size_;            // 段大小上限
+    std::vector<Segment> segments_;    // 按序號排列的段，最後一個為活躍段
+    std::vector<int> retired_fds_;     // 已輪轉、尚待同步和關閉的段描述符
+    uint64_t truncated_lsn_;           // 截斷點，小於它的記錄不再返回
+    std::atomic<uint64_t> current_lsn_;// 已分配的最大 LSN（原子操作）
+    AlignedBuffer append_buffer_;      // 寫緩衝區：從 buffer_offset_ 到 active_size_ 的段數據（由 mutex_ 保護）
+    uint64_t buffer_offset_;           // 寫緩衝區起點的段內偏移（4KB 對齊）
+    uint64_t write_offset_;            // 已寫入文件的段內偏移
+    bool preallocate_;                 // 創建段時預分配整個段
+    bool direct_io_;                   // 段文件以 O_DIRECT | O_DSYNC 打開，寫入即持久化
+    bool use_io_uring_;                // 配置要求使用 io_uring
+    std::unique_ptr<IoRing> io_ring_;  // io_uring 實例（內核不支持時為空，只由寫線程使用）
+    std::mutex mutex_;                 // 文件鎖（保護段列表、文件描述符與寫緩衝區）
+    std::atomic<bool> is_open_;        // 是否已打開
+    
+    // 追加隊列：生產者以 CAS 壓棧，寫線程一次取走整個鏈表
+    std::atomic<AppendNode*> queue_head_;      // 隊列頭
+    std::atomic<uint32_t> active_appenders_;   // 正在入隊的生產者數（關閉時等待歸零）
+    
+    // 寫線程
+    std::thread writer_thread_;        // 寫線程
+    std::mutex writer_mutex_;          // 寫線程休眠鎖
+    std::condition_variable writer_cv_;    // 喚醒寫線程
+    std::atomic<bool> writer_idle_;    // 寫線程是否準備休眠（生產者據此決定是否喚醒）
+    bool stop_writer_;                 // 通知寫線程退出（由 writer_mutex_ 保護）
+    std::vector<AppendNode*> pending_; // 等待前序 LSN 的節點，按 LSN 降序（僅寫線程訪問）
+    uint64_t next_write_lsn_;          // 下一個要寫入文件的 LSN（僅寫線程訪問）
+    std::atomic<uint64_t> sync_request_lsn_;   // 請求持久化的最大 LSN
+    
+    // 持久化策略
+    WALSyncMode sync_mode_;            // 同步模式
+    uint32_t sync_interval_ms_;        // INTERVAL 模式同步間隔
+    std::atomic<uint64_t> sync_count_;     // fdatasync 次數
+    std::atomic<uint64_t> sync_time_us_;   // fdatasync 累計耗時
     
-    // 日誌緩衝
-    std::vector<LogRecord> buffer_;    // 緩衝區
-    static const size_t BUFFER_SIZE = 100;  // 緩衝區大小
+    // 水位線（由 sync_mutex_ 保護，只由寫線程推進）
+    std::mutex sync_mutex_;            // 水位線鎖
+    std::condition_variable sync_cv_;  // 等待水位線推進
+    uint64_t written_lsn_;             // 已寫入內核的最大 LSN
+    uint64_t flushed_lsn_;             // 已持久化的最大 LSN
+    bool io_error_;                    // 寫入或同步失敗
+    std::atomic<uint64_t> group_commits_;  // 組提交次數
+    std::atomic<uint64_t> group_flushes_;  // 應提交請求執行的刷新次數
+    std::atomic<uint64_t> bytes_written_;  // 打開以來寫入的日誌字節數
+    
+    // 元數據（持久化位置）：只由寫線程寫入
+    int meta_fd_;                      // wal.meta 文件描述符
+    uint64_t open_scan_bytes_;         // 打開時掃描的尾部字節數
     
     /**
-     * @brief 計算 CRC32 校驗和
-     * @param record 日誌記錄
-     * @return 校驗和
+     * @brief 分配 LSN、編碼記錄並壓入追加隊列
+     * @param type 記錄類型
+     * @param txn_id 事務 ID
+     * @param key 鍵
+     * @param value 值
+     * @param checksum 輸出：記錄的校驗和（可為空）
+     * @return 分配的 LSN，WAL 未打開時返回 0
      */
-    uint32_t calculate_checksum(const LogRecord& record);
+    uint64_t append_record(LogRecordType type, uint64_t txn_id,
+                           const std::string& key, const std::string& value,
+                           uint32_t* checksum);
     
     /**
-     * @brief 序列化日誌記錄
-     * @param record 日誌記錄
-     * @return 序列化後的字節數據
+     * @brief 喚醒正在休眠的寫線程
+     */
+    void wake_writer();
+    
+    /**
+     * @brief 等待水位線達到指定 LSN
+     * @param lsn 目標 LSN
+     * @param durable true 等待持久化水位線（並請求寫線程同步），false 等待已寫入水位線
+     * @return 達到返回 true；發生 I/O 錯誤或 WAL 已關閉返回 false
+     */
+    bool wait_for_lsn(uint64_t lsn, bool durable);
+    
+    /**
+     * @brief 寫線程主循環
+     */
+    void writer_loop();
+    
+    /**
+     * @brief 追加相對活躍段段首的 LSN 增量，再把記錄按塊邊界切分為片段追加到寫緩衝區（不加鎖）
+     * @param payload 編碼數據，末尾至少預留 10 字節
+     * @param size 編碼長度（不含 LSN 增量）
+     * @param crc 編碼數據的 CRC32C
+     * @param lsn 記錄 LSN
+     */
+    void append_fragments(uint8_t* payload, size_t size, uint32_t crc, uint64_t lsn);
+    
+    /**
+     * @brief 以一次對齊寫入把寫緩衝區寫到活躍段（不加鎖）
+     * @details 從緩衝區起點寫到 active_size_ 向上取整的 4KB 邊界，末尾補零；
+     *          寫完後保留最後一個不完整的 4KB 頁，下一次寫入連同新數據重寫該頁
+     * @return 成功返回 true
      */
-    std::vector<uint8_t> serialize_record(const LogRecord& record);
+    bool write_append_buffer();
     
     /**
-     * @brief 反序列化日誌記錄
-     * @param data 字節數據
-     * @param offset 偏移量（輸入輸出參數）
-     * @return 日誌記錄
+     * @brief 寫入完成後更新寫入位置並只保留最後一個不完整的頁（不加鎖）
+     * @param ok 寫入是否成功
      */
-    LogRecord deserialize_record(const std::vector<uint8_t>& data, size_t& offset);
+    void finish_append_write(bool ok);
     
     /**
-     * @brief 獲取日誌文件路徑
+     * @brief 通過 io_uring 一次提交：已輪轉段的 fdatasync、寫緩衝區的寫入及鏈接其後的活躍段 fdatasync（不加鎖）
+     * @details 已輪轉的段描述符同步後關閉
+     * @return 全部成功返回 true
+     */
+    bool write_and_sync();
+    
+    /**
+     * @brief 獲取舊版單文件日誌路徑（wal.log，打開時遷移為段文件）
      * @return 文件路徑
      */
     std::string get_log_file_path() const;
-
+    
+    /**
+     * @brief 獲取元數據文件路徑（wal.meta）
+     * @return 文件路徑
+     */
+    std::string get_meta_path() const;
+    
+    /**
+     * @brief 讀取元數據
+     * @param seq 輸出：活躍段序號
+     * @param offset 輸出：已持久化的段內偏移
+     * @param lsn 輸出：該偏移之前最後一條記錄的 LSN
+     * @return 文件存在且校驗通過返回 true
+     */
+    bool load_meta(uint64_t* seq, uint64_t* offset, uint64_t* lsn);
+    
     /**
-     * @brief 內部刷新邏輯（不加鎖）
+     * @brief 寫入元數據（只由寫線程或關閉時調用；不執行 fdatasync）
+     * @details 只能寫入已經落盤的位置，因此丟失或過舊的元數據只會讓打開時多掃描一些
      */
-    void flush_internal();
+    void store_meta(uint64_t seq, uint64_t offset, uint64_t lsn);
+    
+    /**
+     * @brief 從指定偏移掃描段尾，設置 current_lsn_（不加鎖）
+     * @param segment 段描述
+     * @param start_offset 起始偏移（須位於記錄邊界）
+     * @param start_lsn 起始偏移之前最後一條記錄的 LSN
+     * @param valid_end 輸出：最後一條有效記錄之後的偏移
+     * @param data_end 輸出：最後一個非零片段之後的偏移（大於 valid_end 說明有殘缺的尾部）
+     * @return 起點與段內容一致返回 true
+     */
+    bool scan_tail(const Segment& segment, uint64_t start_offset, uint64_t start_lsn,
+                   uint64_t* valid_end, uint64_t* data_end);
+    
+    /**
+     * @brief 打開段文件用於寫入（按配置使用 O_DIRECT | O_DSYNC，不支持時回退）
+     * @param path 段文件路徑
+     * @param truncate 是否清空文件
+     * @return 文件描述符，失敗返回 -1
+     */
+    int open_segment_fd(const std::string& path, bool truncate);
+    
+    /**
+     * @brief 把活躍段預分配到段大小上限（不加鎖；文件系統不支持時關閉預分配）
+     */
+    void preallocate_segment();
+    
+    /**
+     * @brief 獲取段文件路徑
+     * @param seq 段序號
+     * @return 文件路徑
+     */
+    std::string get_segment_path(uint64_t seq) const;
+    
+    /**
+     * @brief 掃描日誌目錄，加載已有段的段頭（不加鎖）
+     * @return 成功返回 true
+     */
+    bool load_segments();
+    
+    /**
+     * @brief 創建新段並設為活躍段（不加鎖）
+     * @param first_lsn 新段的第一個 LSN
+     * @return 成功返回 true
+     */
+    bool create_segment(uint64_t first_lsn);
+    
+    /**
+     * @brief 將舊版 wal.log 的記錄遷移到第一個段（不加鎖）
+     * @return 成功返回 true
+     */
+    bool migrate_legacy_log();
+    
+    /**
+     * @brief 段對應的游標輸入（不加鎖）
+     * @param segment 段描述
+     */
+    Reader::Source segment_source(const Segment& segment) const;
+    
+    /**
+     * @brief 同步目錄項，使新建或刪除的段文件持久化
+     */
+    void sync_directory();
 
     /**
-     * @brief 內部讀取邏輯（不加鎖）
+     * @brief 對日誌文件執行 fdatasync 並記錄耗時（不加鎖）
+     * @param fd 文件描述符
+     * @return 成功返回 true
+     */
+    bool sync_file(int fd);
+    
+    /**
+     * @brief 同步並關閉已輪轉的段描述符
+     * @param fds 描述符列表
+     * @return 全部同步成功返回 true
      */
-    std::vector<LogRecord> read_all_internal();
+    bool sync_retired(std::vector<int>& fds);
 };
 
 } // namespace kvengine
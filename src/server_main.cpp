@@ -9,19 +9,68 @@ int main(int argc, char* argv[]) {
     std::string data_dir = "./data";
     uint16_t port = 6379;
     std::string host = "0.0.0.0";
+    kvengine::Options options;
 
     if (argc > 1) port = static_cast<uint16_t>(std::stoi(argv[1]));
     if (argc > 2) data_dir = argv[2];
+    if (argc > 3) {
+        // WAL 持久化策略: always | interval | os
+        std::string mode = argv[3];
+        if (mode == "always") {
+            options.wal_sync_mode = kvengine::WALSyncMode::ALWAYS;
+        } else if (mode == "interval") {
+            options.wal_sync_mode = kvengine::WALSyncMode::INTERVAL;
+        } else if (mode == "os") {
+            options.wal_sync_mode = kvengine::WALSyncMode::OS;
+        } else {
+            std::cerr << "Unknown WAL sync mode: " << mode << " (expected always|interval|os)" << std::endl;
+            return 1;
+        }
+    }
+    if (argc > 4) options.wal_sync_interval_ms = static_cast<uint32_t>(std::stoul(argv[4]));
+
+    // 只讀從節點: 第 5 個參數為主節點地址 host:port（"-" 表示不複製）
+    std::string master_host;
+    uint16_t master_port = 0;
+    if (argc > 5 && std::string(argv[5]) != "-") {
+        std::string master = argv[5];
+        size_t colon = master.rfind(':');
+        if (colon == std::string::npos) {
+            std::cerr << "Invalid master address: " << master << " (expected host:port)" << std::endl;
+            return 1;
+        }
+        master_host = master.substr(0, colon);
+        master_port = static_cast<uint16_t>(std::stoi(master.substr(colon + 1)));
+    }
+
+    if (argc > 6) {
+        // 存儲後端: memory | lsm | btree
+        std::string backend = argv[6];
+        if (backend == "memory") {
+            options.storage_backend = kvengine::StorageBackendType::MEMORY;
+        } else if (backend == "lsm") {
+            options.storage_backend = kvengine::StorageBackendType::LSM;
+        } else if (backend == "btree") {
+            options.storage_backend = kvengine::StorageBackendType::BPLUS_TREE;
+        } else {
+            std::cerr << "Unknown storage backend: " << backend << " (expected memory|lsm|btree)" << std::endl;
+            return 1;
+        }
+    }
 
     if (!Socket::initialize_network()) {
         std::cerr << "Failed to initialize network" << std::endl;
         return 1;
     }
 
-    KvServer server(data_dir, port, host);
+    KvServer server(data_dir, port, host, options);
     
     if (server.start()) {
         std::cout << "KvServer is running on " << host << ":" << port << "..." << std::endl;
+        if (master_port != 0) {
+            std::cout << "Replicating from " << master_host << ":" << master_port << std::endl;
+            server.replicaof(master_host, master_port);
+        }
         server.run();
     } else {
         std::cerr << "Failed to start server." << std::endl;
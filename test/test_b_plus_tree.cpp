@@ -5,7 +5,12 @@
 #include <cassert>
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
 #include <vector>
+#include <algorithm>
+#include <random>
+#include <atomic>
+#include <thread>
 
 using namespace kvengine;
 
@@ -102,6 +107,7 @@ void test_simple_tree() {
         }
         std::cout << "Total keys: " << count << std::endl;
         assert(count == 5); // Only 5 keys inserted
+        (void)last_key;
     }
 
     delete bpm;
@@ -110,7 +116,342 @@ void test_simple_tree() {
     std::cout << "test_simple_tree passed! (Iterator works, internal split has known issues)" << std::endl;
 }
 
+void test_large_tree() {
+    std::string db_file = "test_tree_large.db";
+    std::remove(db_file.c_str());
+
+    auto *pm = new PageManager(db_file);
+    bool opened = pm->open();
+    assert(opened);
+    (void)opened;
+    // A pool much smaller than the tree forces pages to be evicted and re-read
+    auto *bpm = new BufferPoolManager(16, pm);
+
+    IntComparator cmp;
+    BPlusTree<int64_t, int64_t, IntComparator> tree("large_idx", bpm, cmp, 4, 4);
+
+    const int64_t count = 2000;
+    std::vector<int64_t> keys;
+    for (int64_t i = 0; i < count; ++i) {
+        keys.push_back(i);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    for (int64_t key : keys) {
+        bool inserted = tree.insert(key, key * 10);
+        assert(inserted);
+        (void)inserted;
+    }
+
+    // Duplicates are rejected without splitting or changing the value
+    bool duplicate = tree.insert(keys[0], -1);
+    assert(!duplicate);
+    (void)duplicate;
+
+    for (int64_t i = 0; i < count; ++i) {
+        std::vector<int64_t> res;
+        bool found = tree.get_value(i, res);
+        assert(found && res[0] == i * 10);
+        (void)found;
+    }
+
+    int64_t expected = 0;
+    for (auto it = tree.begin(); !it.is_end(); ++it) {
+        assert(it.key() == expected);
+        expected++;
+    }
+    assert(expected == count);
+
+    // Update and remove
+    for (int64_t i = 0; i < count; i += 2) {
+        bool updated = tree.update(i, i * 100);
+        assert(updated);
+        (void)updated;
+    }
+    bool updated_missing = tree.update(count + 1, 0);
+    assert(!updated_missing);
+    (void)updated_missing;
+
+    for (int64_t i = 0; i < count; ++i) {
+        if (i % 3 == 0 || (i >= 100 && i < 400)) {
+            bool removed = tree.remove(i);
+            assert(removed);
+            (void)removed;
+        }
+    }
+    bool removed_again = tree.remove(0);
+    assert(!removed_again);
+    (void)removed_again;
+
+    // Iteration across leaves that were merged or borrowed from by the removals
+    int64_t remaining = 0;
+    int64_t last_key = -1;
+    for (auto it = tree.begin(); !it.is_end(); ++it) {
+        int64_t key = it.key();
+        assert(key > last_key && key % 3 != 0 && (key < 100 || key >= 400));
+        assert(it.value() == (key % 2 == 0 ? key * 100 : key * 10));
+        last_key = key;
+        remaining++;
+    }
+    (void)last_key;
+    int64_t expected_remaining = 0;
+    for (int64_t i = 0; i < count; ++i) {
+        if (i % 3 != 0 && (i < 100 || i >= 400)) expected_remaining++;
+    }
+    assert(remaining == expected_remaining);
+
+    // Seek into the removed range lands on the next live key
+    {
+        auto it = tree.begin(150);
+        assert(!it.is_end() && it.key() == 400);
+    }
+
+    delete bpm;
+    delete pm;
+    std::remove(db_file.c_str());
+    std::cout << "test_large_tree passed" << std::endl;
+}
+
+void test_string_tree() {
+    std::string db_file = "test_tree_string.db";
+    std::remove(db_file.c_str());
+
+    auto *pm = new PageManager(db_file);
+    bool opened = pm->open();
+    assert(opened);
+    (void)opened;
+    auto *bpm = new BufferPoolManager(16, pm);
+
+    StringComparator cmp;
+    BPlusTree<std::string, std::string, StringComparator> tree("string_idx", bpm, cmp);
+
+    // Keys from 1 to about 300 bytes share pages without padding
+    const int count = 5000;
+    std::vector<std::string> keys;
+    for (int i = 0; i < count; ++i) {
+        keys.push_back(std::to_string(i) + std::string(i % 300, 'k'));
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+    for (const std::string &key : keys) {
+        bool inserted = tree.insert(key, key.substr(0, 8));
+        assert(inserted);
+        (void)inserted;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    size_t index = 0;
+    for (auto it = tree.begin(); !it.is_end(); ++it) {
+        assert(it.key() == keys[index] && it.value() == keys[index].substr(0, 8));
+        index++;
+    }
+    assert(index == keys.size());
+
+    // Growing values move to another leaf through a split when they no longer fit
+    for (size_t i = 0; i < keys.size(); i += 3) {
+        bool updated = tree.update(keys[i], std::string(500, 'u'));
+        assert(updated);
+        (void)updated;
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        std::vector<std::string> res;
+        bool found = tree.get_value(keys[i], res);
+        assert(found && res[0] == (i % 3 == 0 ? std::string(500, 'u') : keys[i].substr(0, 8)));
+        (void)found;
+    }
+
+    // Records that could not be split around are rejected
+    bool oversized = tree.insert("huge", std::string(PAGE_SIZE, 'h'));
+    assert(!oversized);
+    (void)oversized;
+
+    delete bpm;
+    delete pm;
+    std::remove(db_file.c_str());
+    std::cout << "test_string_tree passed" << std::endl;
+}
+
+void test_concurrent_tree() {
+    std::string db_file = "test_tree_concurrent.db";
+    std::remove(db_file.c_str());
+
+    auto *pm = new PageManager(db_file);
+    bool opened = pm->open();
+    assert(opened);
+    (void)opened;
+    // Small pages make a deep tree with frequent splits; the pool still evicts pages
+    auto *bpm = new BufferPoolManager(256, pm);
+
+    IntComparator cmp;
+    BPlusTree<int64_t, int64_t, IntComparator> tree("concurrent_idx", bpm, cmp, 4, 4);
+
+    // Even keys exist before the threads start, writers add and remove the odd keys
+    const int64_t count = 8000;
+    for (int64_t i = 0; i < count; i += 2) {
+        bool inserted = tree.insert(i, i);
+        assert(inserted);
+        (void)inserted;
+    }
+
+    const int writers = 4;
+    const int readers = 4;
+    std::atomic<int> writers_done(0);
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w]() {
+            for (int64_t i = 1 + 2 * w; i < count; i += 2 * writers) {
+                if (!tree.insert(i, i)) failures++;
+            }
+            // Updates of the even keys race with the readers below
+            for (int64_t i = 2 * w; i < count; i += 2 * writers) {
+                if (!tree.update(i, i)) failures++;
+            }
+            // Removing the odd keys again merges pages under the readers
+            for (int64_t i = 1 + 2 * w; i < count; i += 2 * writers) {
+                if (!tree.remove(i)) failures++;
+            }
+            writers_done++;
+        });
+    }
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            std::mt19937 rng(r);
+            while (writers_done.load() < writers) {
+                int64_t key = static_cast<int64_t>(rng() % (count / 2)) * 2;
+                std::vector<int64_t> res;
+                if (!tree.get_value(key, res) || res[0] != key) failures++;
+
+                // Scans see keys in order while leaves split under them
+                int64_t last_key = -1;
+                int seen = 0;
+                for (auto it = tree.begin(key); !it.is_end() && seen < 50; ++it, ++seen) {
+                    if (it.key() <= last_key || it.value() != it.key()) failures++;
+                    last_key = it.key();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    assert(failures.load() == 0);
+
+    int64_t expected = 0;
+    for (auto it = tree.begin(); !it.is_end(); ++it) {
+        assert(it.key() == expected && it.value() == expected);
+        expected += 2;
+    }
+    assert(expected == count);
+
+    delete bpm;
+    delete pm;
+    std::remove(db_file.c_str());
+    std::cout << "test_concurrent_tree passed" << std::endl;
+}
+
+void test_remove_rebalance() {
+    std::string db_file = "test_tree_remove.db";
+    std::remove(db_file.c_str());
+
+    auto *pm = new PageManager(db_file);
+    bool opened = pm->open();
+    assert(opened);
+    (void)opened;
+    auto *bpm = new BufferPoolManager(16, pm);
+
+    IntComparator cmp;
+    BPlusTree<int64_t, int64_t, IntComparator> tree("remove_idx", bpm, cmp, 4, 4);
+
+    const int64_t count = 2000;
+    std::vector<int64_t> keys;
+    for (int64_t i = 0; i < count; ++i) {
+        keys.push_back(i);
+    }
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+    for (int64_t key : keys) {
+        tree.insert(key, key);
+    }
+    int full_pages = pm->get_num_pages();
+
+    // Remove in another order, checking the remaining keys as pages merge and borrow
+    std::vector<int64_t> order = keys;
+    std::shuffle(order.begin(), order.end(), std::mt19937(4));
+    std::vector<bool> present(count, true);
+    for (size_t n = 0; n < order.size(); ++n) {
+        bool removed = tree.remove(order[n]);
+        assert(removed);
+        (void)removed;
+        present[order[n]] = false;
+        if (n % 250 == 0) {
+            int64_t expected = 0;
+            for (auto it = tree.begin(); !it.is_end(); ++it) {
+                while (!present[expected]) expected++;
+                assert(it.key() == expected && it.value() == expected);
+                expected++;
+            }
+            while (expected < count && !present[expected]) expected++;
+            assert(expected == count);
+        }
+    }
+    assert(tree.is_empty());
+    assert(tree.begin().is_end());
+    bool removed_again = tree.remove(keys[0]);
+    assert(!removed_again);
+    (void)removed_again;
+
+    // Every page went back to the free list, so refilling the tree reuses them
+    for (int64_t key : keys) {
+        tree.insert(key, key);
+    }
+    // Checked without assert so that Release builds verify the reclamation too
+    if (pm->get_num_pages() > full_pages) {
+        std::cerr << "File grew: " << pm->get_num_pages() << " > " << full_pages << std::endl;
+        abort();
+    }
+
+    // Rewriting keys under new names keeps the file from growing
+    StringComparator string_cmp;
+    BPlusTree<std::string, std::string, StringComparator> churn("churn_idx", bpm, string_cmp);
+    int churn_pages = 0;
+    for (int generation = 0; generation < 20; ++generation) {
+        for (int i = 0; i < 500; ++i) {
+            std::string key = "g" + std::to_string(generation) + "-" + std::to_string(i);
+            bool inserted = churn.insert(key, std::string(i % 200, 'v'));
+            assert(inserted);
+            (void)inserted;
+        }
+        if (generation > 0) {
+            for (int i = 0; i < 500; ++i) {
+                bool removed = churn.remove("g" + std::to_string(generation - 1) + "-" + std::to_string(i));
+                assert(removed);
+                (void)removed;
+            }
+        }
+        if (generation == 1) {
+            churn_pages = pm->get_num_pages();
+        }
+    }
+    if (pm->get_num_pages() > churn_pages + 8) {
+        std::cerr << "File grew: " << pm->get_num_pages() << " > " << churn_pages << std::endl;
+        abort();
+    }
+    int64_t remaining = 0;
+    for (auto it = churn.begin(); !it.is_end(); ++it) {
+        assert(it.key().compare(0, 4, "g19-") == 0);
+        remaining++;
+    }
+    assert(remaining == 500);
+
+    delete bpm;
+    delete pm;
+    std::remove(db_file.c_str());
+    std::cout << "test_remove_rebalance passed" << std::endl;
+}
+
 int main() {
     test_simple_tree();
+    test_large_tree();
+    test_string_tree();
+    test_concurrent_tree();
+    test_remove_rebalance();
     return 0;
 }
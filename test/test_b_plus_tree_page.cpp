@@ -3,6 +3,7 @@
 #include <iostream>
 #include <cassert>
 #include <cstring>
+#include <string>
 
 using namespace kvengine;
 
@@ -47,7 +48,163 @@ void test_leaf_page() {
     std::cout << "test_leaf_page passed" << std::endl;
 }
 
+void test_string_leaf_page() {
+    char buf[PAGE_SIZE];
+    memset(buf, 0, PAGE_SIZE);
+    auto *leaf = reinterpret_cast<BPlusTreeLeafPage<std::string, std::string, StringComparator>*>(buf);
+    leaf->init(1);
+    StringComparator cmp;
+
+    // Keys and values take only their own length: fill the page with mixed sizes
+    int count = 0;
+    while (true) {
+        std::string key = "key" + std::to_string(count * 7919 % 10007);
+        std::string value(count % 40, 'v');
+        if (!leaf->has_room(key, value)) break;
+        bool inserted = leaf->insert(key, value, cmp);
+        assert(inserted);
+        (void)inserted;
+        count++;
+    }
+    assert(count > 100);
+    assert(leaf->get_size() == count);
+    assert(!leaf->insert("key0", "dup", cmp));
+    for (int i = 1; i < leaf->get_size(); ++i) {
+        assert(leaf->key_at(i - 1) < leaf->key_at(i));
+    }
+
+    // Removed records leave holes that an insert reclaims by compacting the page
+    size_t free_before = leaf->free_bytes();
+    for (int i = 0; i < count; i += 2) {
+        bool removed = leaf->remove("key" + std::to_string(i * 7919 % 10007), cmp);
+        assert(removed);
+        (void)removed;
+    }
+    assert(leaf->free_bytes() > free_before + 1000);
+    (void)free_before;
+    std::string big(600, 'b');
+    bool inserted = leaf->insert("big", big, cmp);
+    assert(inserted);
+    (void)inserted;
+    std::string value;
+    assert(leaf->lookup("big", value, cmp) && value == big);
+    assert(leaf->lookup("key" + std::to_string(7919 % 10007), value, cmp) && value == std::string(1, 'v'));
+
+    // Values grow and shrink in place or by moving the record
+    bool updated = leaf->update("big", "small", cmp);
+    assert(updated);
+    updated = leaf->update("big", std::string(700, 'c'), cmp);
+    assert(updated);
+    (void)updated;
+    assert(leaf->lookup("big", value, cmp) && value == std::string(700, 'c'));
+    assert(!leaf->update("missing", "x", cmp));
+    assert(!leaf->update("big", std::string(PAGE_SIZE, 'x'), cmp));
+
+    // A split moves about half of the bytes
+    char buf2[PAGE_SIZE];
+    memset(buf2, 0, PAGE_SIZE);
+    auto *right = reinterpret_cast<BPlusTreeLeafPage<std::string, std::string, StringComparator>*>(buf2);
+    right->init(2);
+    int total = leaf->get_size();
+    size_t used = leaf->used_bytes();
+    std::string last = leaf->key_at(total - 1);
+    leaf->move_half_to(right);
+    assert(leaf->get_size() + right->get_size() == total);
+    assert(right->key_at(right->get_size() - 1) == last);
+    assert(leaf->key_at(leaf->get_size() - 1) < right->key_at(0));
+    assert(leaf->used_bytes() < used && right->used_bytes() < used);
+    (void)used;
+    assert(leaf->free_bytes() >= BPlusTreeSlottedPage::max_record_size());
+    assert(right->free_bytes() >= BPlusTreeSlottedPage::max_record_size());
+
+    std::cout << "test_string_leaf_page passed" << std::endl;
+}
+
+void test_string_internal_page() {
+    char buf[PAGE_SIZE];
+    memset(buf, 0, PAGE_SIZE);
+    auto *internal = reinterpret_cast<BPlusTreeInternalPage<std::string, page_id_t, StringComparator>*>(buf);
+    internal->init(1);
+    StringComparator cmp;
+    (void)cmp;
+
+    internal->populate_new_root(10, "m", 20);
+    bool inserted = internal->insert_node_after(20, "t", 30);
+    assert(inserted);
+    inserted = internal->insert_node_after(10, "d", 15);
+    assert(inserted);
+    (void)inserted;
+    assert(internal->get_size() == 4);
+    assert(internal->lookup("a", cmp) == 10);
+    assert(internal->lookup("d", cmp) == 15);
+    assert(internal->lookup("p", cmp) == 20);
+    assert(internal->lookup("z", cmp) == 30);
+    assert(internal->value_index(20) == 2);
+
+    // A longer separator moves the record; lookups are unaffected
+    bool replaced = internal->set_key_at(2, "mmmmmmmmmmmmmmmmmmmm");
+    assert(replaced);
+    (void)replaced;
+    assert(internal->key_at(2) == "mmmmmmmmmmmmmmmmmmmm");
+    assert(internal->lookup("n", cmp) == 20);
+    assert(internal->lookup("m", cmp) == 15);
+
+    std::cout << "test_string_internal_page passed" << std::endl;
+}
+
+void test_string_leaf_merge() {
+    char left_buf[PAGE_SIZE];
+    char right_buf[PAGE_SIZE];
+    memset(left_buf, 0, PAGE_SIZE);
+    memset(right_buf, 0, PAGE_SIZE);
+    auto *left = reinterpret_cast<BPlusTreeLeafPage<std::string, std::string, StringComparator>*>(left_buf);
+    auto *right = reinterpret_cast<BPlusTreeLeafPage<std::string, std::string, StringComparator>*>(right_buf);
+    left->init(1);
+    right->init(2);
+    right->set_next_page_id(3);
+    left->set_next_page_id(2);
+    StringComparator cmp;
+
+    // Underflow and spare records are measured in bytes
+    assert(left->is_underflow() && !left->has_spare_record());
+    std::string value(200, 'v');
+    for (int i = 0; i < 10; ++i) {
+        right->insert("k" + std::to_string(10 + i), value, cmp);
+    }
+    assert(!right->is_underflow() && right->has_spare_record());
+    left->insert("k00", "small", cmp);
+    assert(left->is_underflow());
+
+    // Borrowing keeps the keys ordered across the two leaves
+    bool moved = right->move_first_to_end_of(left);
+    assert(moved);
+    assert(left->get_size() == 2 && left->key_at(1) == "k10");
+    assert(right->get_size() == 9 && right->key_at(0) == "k11");
+    moved = left->move_last_to_front_of(right);
+    assert(moved);
+    (void)moved;
+    assert(right->key_at(0) == "k10");
+
+    // Merging appends every record and unlinks the right leaf
+    assert(left->can_absorb(*right, 0));
+    right->move_all_to(left);
+    assert(right->get_size() == 0 && left->get_size() == 11);
+    assert(left->get_next_page_id() == 3);
+    std::string result;
+    bool found = left->lookup("k19", result, cmp);
+    assert(found && result == value);
+    (void)found;
+
+    // A full page cannot absorb another one
+    assert(!left->can_absorb(*left, 0));
+
+    std::cout << "test_string_leaf_merge passed" << std::endl;
+}
+
 int main() {
     test_leaf_page();
+    test_string_leaf_page();
+    test_string_internal_page();
+    test_string_leaf_merge();
     return 0;
 }
@@ -0,0 +1,517 @@
+/**
+ * @file test_b_plus_tree_storage.cpp
+ * @brief B+ 樹存儲後端單元測試
+ */
+
+#include "../src/kvengine/b_plus_tree_storage.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <future>
+#include <chrono>
+
+using namespace kvengine;
+
+// 緩衝池只有 32 頁，數據是它的許多倍
+static Options small_options() {
+    Options options;
+    options.btree_buffer_pool_pages = 32;
+    return options;
+}
+
+static std::string make_key(int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "key%06d", i);
+    return buf;
+}
+
+// 每 50 個鍵有一個值超過一頁，存放在溢出頁鏈中
+static std::string make_value(int i, int round) {
+    std::string value = "value-" + std::to_string(round) + "-" + std::to_string(i);
+    if (i % 50 == 0) {
+        value.append(10000, static_cast<char>('a' + i % 26));
+    }
+    return value;
+}
+
+// 逐鍵比較並檢查迭代順序
+static void verify(const BPlusTreeStorage& storage, const std::map<std::string, std::string>& expected, int key_space) {
+    for (int i = 0; i < key_space; ++i) {
+        std::string key = make_key(i);
+        std::string value;
+        auto it = expected.find(key);
+        bool found = storage.get(key, value);
+        if (found != (it != expected.end())) {
+            std::cerr << "Existence mismatch for " << key << std::endl;
+            abort();
+        }
+        if (found && value != it->second) {
+            std::cerr << "Value mismatch for " << key << std::endl;
+            abort();
+        }
+    }
+
+    auto expected_it = expected.begin();
+    for (auto iter = storage.new_iterator(); iter->valid(); iter->next()) {
+        if (expected_it == expected.end() || iter->key() != expected_it->first ||
+            iter->value() != expected_it->second) {
+            std::cerr << "Iterator mismatch at " << iter->key() << std::endl;
+            abort();
+        }
+        ++expected_it;
+    }
+    if (expected_it != expected.end()) abort();
+    if (storage.size() != expected.size()) abort();
+}
+
+// 測試數據遠大於緩衝池時的讀寫、覆蓋、刪除與重新打開
+void test_btree_basic() {
+    std::cout << "Testing B+ tree storage larger than the buffer pool..." << std::endl;
+
+    std::string dir = "./test_btree_basic";
+    std::filesystem::remove_all(dir);
+
+    const int key_space = 20000;
+    std::map<std::string, std::string> expected;
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+
+        for (int i = 0; i < key_space; ++i) {
+            std::string key = make_key((i * 7919) % key_space);
+            std::string value = make_value((i * 7919) % key_space, 0);
+            if (!storage.put(key, value)) abort();
+            expected[key] = value;
+        }
+        // 覆蓋：短值換長值、長值換短值
+        for (int i = 0; i < key_space; i += 3) {
+            std::string value = make_value(i + 1, 1);
+            if (!storage.put(make_key(i), value)) abort();
+            expected[make_key(i)] = value;
+        }
+        for (int i = 0; i < key_space; i += 5) {
+            bool existed = expected.erase(make_key(i)) > 0;
+            if (storage.remove(make_key(i)) != existed) abort();
+        }
+        if (storage.remove("missing")) abort();
+
+        verify(storage, expected, key_space);
+        if (storage.memory_usage() != 32 * static_cast<size_t>(PAGE_SIZE)) abort();
+        if (storage.get_num_pages() < 320) abort();
+
+        if (!storage.write_snapshot(7)) abort();
+    }
+
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+        if (storage.get_snapshot_lsn() != 7) abort();
+        verify(storage, expected, key_space);
+    }
+
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ B+ tree storage basic test passed" << std::endl;
+}
+
+// 測試前綴迭代、seek 與分批取數
+void test_btree_iterator() {
+    std::cout << "Testing B+ tree storage iterator..." << std::endl;
+
+    std::string dir = "./test_btree_iterator";
+    std::filesystem::remove_all(dir);
+
+    BPlusTreeStorage storage(dir, small_options());
+    if (!storage.initialize()) abort();
+
+    for (int i = 0; i < 3000; ++i) {
+        std::string prefix = (i % 3 == 0) ? "user:" : (i % 3 == 1 ? "order:" : "item:");
+        storage.put(prefix + make_key(i), std::to_string(i));
+    }
+    storage.remove("user:" + make_key(0));
+    storage.remove("user:" + make_key(3));
+    storage.put("user:" + make_key(6), "updated");
+
+    auto iter = storage.new_iterator("user:");
+    int count = 0;
+    std::string last;
+    for (; iter->valid(); iter->next()) {
+        if (iter->key().compare(0, 5, "user:") != 0) abort();
+        if (!last.empty() && iter->key() <= last) abort();
+        last = iter->key();
+        count++;
+    }
+    if (count != 998) abort();
+
+    iter = storage.new_iterator("user:");
+    if (!iter->valid() || iter->key() != "user:" + make_key(6) || iter->value() != "updated") abort();
+    iter->seek("user:" + make_key(1500));
+    if (!iter->valid() || iter->key() != "user:" + make_key(1500)) abort();
+    // 比最大鍵長還長的目標截斷後定位，結果仍然按完整的目標比較
+    iter->seek("user:" + make_key(1500) + std::string(100, 'z'));
+    if (!iter->valid() || iter->key() != "user:" + make_key(1503)) abort();
+    iter->seek("zzz");
+    if (iter->valid()) abort();
+
+    // 鍵的長度有上限
+    if (storage.put(std::string(BPlusTreeStorage::MAX_KEY_SIZE + 1, 'k'), "v")) abort();
+    if (!storage.put(std::string(BPlusTreeStorage::MAX_KEY_SIZE, 'k'), "v")) abort();
+    if (storage.exists(std::string(BPlusTreeStorage::MAX_KEY_SIZE + 1, 'k'))) abort();
+
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ B+ tree storage iterator test passed" << std::endl;
+}
+
+// 測試檢查點寫出和提交期間讀寫照常進行，且這些修改不進入本次檢查點
+void test_btree_checkpoint_concurrent_writes() {
+    std::cout << "Testing B+ tree storage checkpoint with concurrent writes..." << std::endl;
+
+    std::string dir = "./test_btree_checkpoint_writes";
+    std::string crash_dir = dir + "_crashed";
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove_all(crash_dir);
+
+    const int key_space = 3000;
+    std::map<std::string, std::string> committed;
+    std::map<std::string, std::string> latest;
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+        for (int i = 0; i < key_space; ++i) {
+            storage.put(make_key(i), make_value(i, 0));
+            committed[make_key(i)] = make_value(i, 0);
+        }
+        latest = committed;
+
+        // 提交之前由另一個線程修改：檢查點持有獨佔鎖時這些寫入會一直等待
+        auto writes = [&]() {
+            for (int i = 0; i < key_space; ++i) {
+                if (i % 3 == 0) {
+                    if (!storage.remove(make_key(i))) abort();
+                    latest.erase(make_key(i));
+                } else {
+                    storage.put(make_key(i), make_value(i, 1));
+                    latest[make_key(i)] = make_value(i, 1);
+                }
+            }
+            for (int i = key_space; i < key_space * 2; ++i) {
+                storage.put(make_key(i), make_value(i, 1));
+                latest[make_key(i)] = make_value(i, 1);
+            }
+            std::string value;
+            if (!storage.get(make_key(1), value) || value != make_value(1, 1)) abort();
+        };
+        bool called = false;
+        bool ok = storage.write_snapshot(10, [&]() {
+            called = true;
+            auto done = std::async(std::launch::async, writes);
+            if (done.wait_for(std::chrono::seconds(30)) != std::future_status::ready) {
+                std::cerr << "Writes blocked by checkpoint" << std::endl;
+                abort();
+            }
+            return true;
+        });
+        if (!ok || !called || storage.get_snapshot_lsn() != 10) abort();
+        verify(storage, latest, key_space * 2);
+
+        // 檢查點期間換出的頁面和釋放的頁面在提交之後才寫入，不屬於這次檢查點
+        std::filesystem::copy(dir, crash_dir);
+
+        if (!storage.flush()) abort();
+    }
+
+    {
+        BPlusTreeStorage storage(crash_dir, small_options());
+        if (!storage.initialize()) abort();
+        if (storage.get_snapshot_lsn() != 10) abort();
+        verify(storage, committed, key_space * 2);
+    }
+
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+        if (storage.get_snapshot_lsn() != 10) abort();
+        verify(storage, latest, key_space * 2);
+    }
+
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove_all(crash_dir);
+    std::cout << "  ✓ B+ tree storage checkpoint with concurrent writes test passed" << std::endl;
+}
+
+// 測試崩潰後回滾到最近一次檢查點
+void test_btree_crash_rollback() {
+    std::cout << "Testing B+ tree storage crash rollback..." << std::endl;
+
+    std::string dir = "./test_btree_crash";
+    std::string crash_dir = dir + "_crashed";
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove_all(crash_dir);
+
+    const int key_space = 5000;
+    std::map<std::string, std::string> committed;
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+        for (int i = 0; i < key_space; ++i) {
+            storage.put(make_key(i), make_value(i, 0));
+            committed[make_key(i)] = make_value(i, 0);
+        }
+
+        // 回調失敗時放棄，快照 LSN 不變
+        if (storage.write_snapshot(5, []() { return false; })) abort();
+        if (storage.get_snapshot_lsn() != 0) abort();
+
+        bool called = false;
+        if (!storage.write_snapshot(10, [&]() { called = true; return true; })) abort();
+        if (!called || storage.get_snapshot_lsn() != 10) abort();
+
+        // 檢查點之後的修改換出到磁盤，但沒有提交
+        for (int i = 0; i < key_space; ++i) {
+            if (i % 2 == 0) {
+                storage.remove(make_key(i));
+            } else {
+                storage.put(make_key(i), make_value(i, 1));
+            }
+        }
+        for (int i = key_space; i < key_space * 2; ++i) {
+            storage.put(make_key(i), make_value(i, 1));
+        }
+
+        // 運行中複製數據目錄，相當於此刻斷電
+        std::filesystem::copy(dir, crash_dir);
+    }
+
+    {
+        BPlusTreeStorage storage(crash_dir, small_options());
+        if (!storage.initialize()) abort();
+        if (storage.get_snapshot_lsn() != 10) abort();
+        verify(storage, committed, key_space * 2);
+    }
+
+    // 析構不提交，正常關閉同樣回到檢查點
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+        verify(storage, committed, key_space * 2);
+    }
+
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove_all(crash_dir);
+    std::cout << "  ✓ B+ tree storage crash rollback test passed" << std::endl;
+}
+
+// 測試刪除或覆蓋釋放的溢出頁被重用
+void test_btree_page_reuse() {
+    std::cout << "Testing B+ tree storage page reuse..." << std::endl;
+
+    std::string dir = "./test_btree_reuse";
+    std::filesystem::remove_all(dir);
+
+    std::string big(3 * PAGE_SIZE, 'x');
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+        for (int i = 0; i < 200; ++i) {
+            storage.put(make_key(i), big);
+        }
+        if (!storage.flush()) abort();
+        int pages = storage.get_num_pages();
+
+        for (int round = 0; round < 5; ++round) {
+            for (int i = 0; i < 200; ++i) {
+                if (!storage.put(make_key(i), big + std::to_string(round))) abort();
+            }
+            for (int i = 0; i < 200; i += 2) {
+                if (!storage.remove(make_key(i))) abort();
+            }
+            for (int i = 0; i < 200; i += 2) {
+                if (!storage.put(make_key(i), big)) abort();
+            }
+        }
+        // 釋放的頁面經空閒鏈表重用，文件不隨覆蓋次數增長
+        if (storage.get_num_pages() > pages + 8) {
+            std::cerr << "File grew: " << storage.get_num_pages() << " > " << pages << std::endl;
+            abort();
+        }
+        if (!storage.flush()) abort();
+    }
+
+    // 空閒鏈表頭隨元數據頁提交，重新打開後繼續重用
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+        int pages = storage.get_num_pages();
+        for (int i = 0; i < 200; ++i) {
+            if (!storage.put(make_key(i), big + "!")) abort();
+        }
+        if (storage.get_num_pages() > pages + 8) abort();
+        std::string value;
+        if (!storage.get(make_key(199), value) || value != big + "!") abort();
+    }
+
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ B+ tree storage page reuse test passed" << std::endl;
+}
+
+void test_btree_churn() {
+    std::cout << "Testing B+ tree storage key churn..." << std::endl;
+
+    std::string dir = "./test_btree_churn";
+    std::filesystem::remove_all(dir);
+
+    auto churn_key = [](int generation, int i) {
+        return "gen" + std::to_string(generation) + "-" + make_key(i);
+    };
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+        int pages = 0;
+        for (int generation = 0; generation < 20; ++generation) {
+            for (int i = 0; i < 1000; ++i) {
+                if (!storage.put(churn_key(generation, i), std::string(100, 'v'))) abort();
+            }
+            if (generation > 0) {
+                for (int i = 0; i < 1000; ++i) {
+                    if (!storage.remove(churn_key(generation - 1, i))) abort();
+                }
+            }
+            if (!storage.flush()) abort();
+            if (generation == 1) {
+                pages = storage.get_num_pages();
+            }
+        }
+        // 刪除時合併的葉子頁回到空閒鏈表，鍵換名重寫時文件不再增長
+        if (storage.get_num_pages() > pages + 8) {
+            std::cerr << "File grew: " << storage.get_num_pages() << " > " << pages << std::endl;
+            abort();
+        }
+        if (storage.size() != 1000) abort();
+    }
+
+    {
+        BPlusTreeStorage storage(dir, small_options());
+        if (!storage.initialize()) abort();
+        std::string value;
+        if (!storage.get(churn_key(19, 999), value) || value != std::string(100, 'v')) abort();
+        if (storage.exists(churn_key(18, 0))) abort();
+        size_t count = 0;
+        for (auto it = storage.new_iterator(); it->valid(); it->next()) {
+            count++;
+        }
+        if (count != 1000) abort();
+    }
+
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ B+ tree storage key churn test passed" << std::endl;
+}
+
+// 記錄每批寫操作的大小
+class BatchCountingStorage : public BPlusTreeStorage {
+public:
+    BatchCountingStorage(const std::string& data_dir, const Options& options)
+        : BPlusTreeStorage(data_dir, options), ops(0), max_ops(0) {}
+
+    void apply_batch(const std::vector<WriteOp>& batch) override {
+        ops += batch.size();
+        max_ops = std::max(max_ops, batch.size());
+        BPlusTreeStorage::apply_batch(batch);
+    }
+
+    size_t ops;
+    size_t max_ops;
+};
+
+// 測試全量快照的導出與分批導入
+void test_btree_snapshot_transfer() {
+    std::cout << "Testing B+ tree storage snapshot transfer..." << std::endl;
+
+    std::string source_dir = "./test_btree_snapshot_source";
+    std::string target_dir = "./test_btree_snapshot_target";
+    std::filesystem::remove_all(source_dir);
+    std::filesystem::remove_all(target_dir);
+
+    const int key_space = 3000;
+    std::map<std::string, std::string> expected;
+    std::string contents;
+    uint64_t snapshot_lsn = 0;
+    {
+        BPlusTreeStorage source(source_dir, small_options());
+        if (!source.initialize()) abort();
+        for (int i = 0; i < key_space; ++i) {
+            source.put(make_key(i), make_value(i, 0));
+            expected[make_key(i)] = make_value(i, 0);
+        }
+        if (!source.write_snapshot(77)) abort();
+        if (!source.read_data_file(contents, snapshot_lsn) || snapshot_lsn != 77) abort();
+    }
+
+    {
+        BatchCountingStorage target(target_dir, small_options());
+        if (!target.initialize()) abort();
+        // 三分之一的鍵相同、三分之一的值不同、三分之一缺少，另有快照中沒有的鍵
+        for (int i = 0; i < key_space; ++i) {
+            if (i % 3 == 0) {
+                target.put(make_key(i), make_value(i, 0));
+            } else if (i % 3 == 1) {
+                target.put(make_key(i), make_value(i, 1));
+            }
+        }
+        for (int i = 0; i < 500; ++i) {
+            target.put("stale" + std::to_string(i), "x");
+        }
+
+        // 格式錯誤時數據保持不變
+        uint64_t loaded_lsn = 0;
+        if (target.load_snapshot(contents.substr(0, contents.size() - 1), loaded_lsn)) abort();
+        if (target.ops != 0 || !target.exists("stale0")) abort();
+
+        if (!target.load_snapshot(contents, loaded_lsn) || loaded_lsn != 77) abort();
+        verify(target, expected, key_space);
+        // 只寫入變化的鍵，每批不超過上限
+        if (target.ops != 500 + (key_space - (key_space + 2) / 3)) abort();
+        if (target.max_ops > SNAPSHOT_BATCH_SIZE) abort();
+        if (target.get_snapshot_lsn() == 77) abort();
+
+        // 沒有文件頭、未排序且有重複鍵的舊格式：相同的鍵以最後一個為準
+        std::string legacy;
+        auto append = [&legacy](const std::string& bytes) { legacy.append(bytes); };
+        auto append_u32 = [&legacy](uint32_t v) { legacy.append(reinterpret_cast<const char*>(&v), sizeof(v)); };
+        uint64_t count = 3;
+        legacy.append(reinterpret_cast<const char*>(&count), sizeof(count));
+        const char* entries[][2] = {{"b", "1"}, {"a", "2"}, {"b", "3"}};
+        for (const auto& entry : entries) {
+            append_u32(static_cast<uint32_t>(std::strlen(entry[0])));
+            append(entry[0]);
+            append_u32(static_cast<uint32_t>(std::strlen(entry[1])));
+            append(entry[1]);
+        }
+        if (!target.load_snapshot(legacy, loaded_lsn) || loaded_lsn != 0) abort();
+        std::string value;
+        if (target.size() != 2) abort();
+        if (!target.get("a", value) || value != "2") abort();
+        if (!target.get("b", value) || value != "3") abort();
+    }
+
+    std::filesystem::remove_all(source_dir);
+    std::filesystem::remove_all(target_dir);
+    std::cout << "  ✓ B+ tree storage snapshot transfer test passed" << std::endl;
+}
+
+int main() {
+    std::cout << "=== B+ Tree Storage Test Suite ===" << std::endl << std::endl;
+
+    test_btree_basic();
+    test_btree_iterator();
+    test_btree_crash_rollback();
+    test_btree_checkpoint_concurrent_writes();
+    test_btree_page_reuse();
+    test_btree_churn();
+    test_btree_snapshot_transfer();
+
+    std::cout << std::endl << "=== All B+ tree storage tests passed! ===" << std::endl;
+    return 0;
+}
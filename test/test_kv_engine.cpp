@@ -8,6 +8,10 @@
 #include <iostream>
 #include <cassert>
 #include <string>
+#include <thread>
+#include <chrono>
+#include <map>
+#include <filesystem>
 
 using namespace kvengine;
 
@@ -197,6 +201,130 @@ void test_edge_cases() {
 }
 
 // 主測試函數
+// 測試自動檢查點
+void test_auto_checkpoint() {
+    std::cout << "Testing automatic checkpoints..." << std::endl;
+    
+    auto wait_for_checkpoint = [](KvEngine& engine) {
+        for (int i = 0; i < 200 && engine.get_statistics().checkpoints == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return engine.get_statistics();
+    };
+    
+    // WAL 字節數觸發
+    {
+        Options options;
+        options.checkpoint_wal_bytes = 64 * 1024;
+        options.checkpoint_min_interval_ms = 10;
+        KvEngine engine("./test_auto_checkpoint_size", options);
+        if (!engine.open()) abort();
+        if (engine.get_statistics().checkpoints != 0) abort();
+        
+        std::string value(100, 'v');
+        for (int i = 0; i < 1000; ++i) {
+            if (!engine.put("key" + std::to_string(i), value)) abort();
+        }
+        Statistics stats = wait_for_checkpoint(engine);
+        if (stats.checkpoints == 0) abort();
+        if (stats.last_checkpoint_time_ms == 0) abort();
+        engine.close();
+    }
+    
+    // 時間觸發
+    {
+        Options options;
+        options.checkpoint_wal_bytes = 0;
+        options.checkpoint_interval_ms = 50;
+        options.checkpoint_jitter_ms = 20;
+        options.checkpoint_min_interval_ms = 10;
+        KvEngine engine("./test_auto_checkpoint_time", options);
+        if (!engine.open()) abort();
+        engine.put("key", "value");
+        if (wait_for_checkpoint(engine).checkpoints == 0) abort();
+        engine.close();
+    }
+    
+    std::cout << "  ✓ Automatic checkpoint test passed" << std::endl;
+}
+
+// 測試各個存儲後端提供相同的語義
+void test_storage_backends() {
+    std::cout << "Testing storage backends..." << std::endl;
+    
+    const StorageBackendType backends[] = {StorageBackendType::MEMORY, StorageBackendType::LSM,
+                                           StorageBackendType::BPLUS_TREE};
+    const char* const dirs[] = {"./test_backend_memory", "./test_backend_lsm", "./test_backend_btree"};
+    for (int b = 0; b < 3; ++b) {
+        StorageBackendType backend = backends[b];
+        Options options;
+        options.storage_backend = backend;
+        options.lsm_memtable_bytes = 16 * 1024;  // 少量數據即可刷寫出表文件
+        options.btree_buffer_pool_pages = 32;    // 緩衝池遠小於數據，頁面反復換出
+        std::string dir = dirs[b];
+        std::filesystem::remove_all(dir);
+        std::filesystem::remove_all(dir + "_copy");
+        
+        {
+            KvEngine engine(dir, options);
+            if (!engine.open()) abort();
+            for (int i = 0; i < 2000; ++i) {
+                if (!engine.put("key" + std::to_string(i), "value" + std::to_string(i))) abort();
+            }
+            for (int i = 0; i < 2000; i += 2) {
+                if (!engine.remove("key" + std::to_string(i))) abort();
+            }
+            std::map<std::string, std::string> batch;
+            batch["batch:a"] = "1";
+            batch["batch:b"] = "2";
+            if (!engine.batch_put(batch)) abort();
+            if (!engine.exists("batch:a") || engine.exists("key0")) abort();
+            if (engine.get_statistics().total_keys != 1002) abort();
+            
+            auto iter = engine.scan("batch:");
+            if (!iter->valid() || iter->key() != "batch:a") abort();
+            iter->next();
+            if (!iter->valid() || iter->value() != "2") abort();
+            iter->next();
+            if (iter->valid()) abort();
+            
+            if (!engine.flush()) abort();
+            engine.put("after_flush", "x");
+            engine.remove("key1");
+            engine.close();
+        }
+        
+        {
+            KvEngine engine(dir, options);
+            if (!engine.open()) abort();
+            if (engine.get("key3") != "value3") abort();
+            if (engine.exists("key1") || engine.exists("key2")) abort();
+            if (engine.get("after_flush") != "x") abort();
+            if (engine.get_statistics().total_keys != 1002) abort();
+            if (!engine.verify_integrity()) abort();
+            
+            // 全量快照導入同類後端：替換原有數據
+            std::string contents;
+            uint64_t snapshot_lsn = 0;
+            if (!engine.read_snapshot(contents, snapshot_lsn) || snapshot_lsn == 0) abort();
+            KvEngine copy(dir + "_copy", options);
+            if (!copy.open()) abort();
+            copy.put("stale", "x");
+            uint64_t loaded_lsn = 0;
+            if (!copy.load_snapshot(contents, loaded_lsn) || loaded_lsn != snapshot_lsn) abort();
+            if (copy.exists("stale") || copy.get("key3") != "value3") abort();
+            if (copy.get_statistics().total_keys != 1002) abort();
+            copy.close();
+            engine.close();
+        }
+        
+        std::filesystem::remove_all(dir);
+        std::filesystem::remove_all(dir + "_copy");
+    }
+    
+    std::cout << "  ✓ Storage backends test passed" << std::endl;
+}
+
 int main() {
     std::cout << "=== KvEngine Test Suite ===" << std::endl << std::endl;
     
@@ -207,6 +335,8 @@ int main() {
         test_batch_operations();
         test_iterator();
         test_edge_cases();
+        test_auto_checkpoint();
+        test_storage_backends();
         
         std::cout << std::endl << "=== All tests passed! ===" << std::endl;
         return 0;
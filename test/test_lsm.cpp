@@ -0,0 +1,443 @@
+/**
+ * @file test_lsm.cpp
+ * @brief LSM 樹單元測試
+ */
+
+#include "../src/kvengine/lsm/lsm_tree.h"
+#include <iostream>
+#include <map>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <filesystem>
+
+using namespace kvengine;
+using namespace kvengine::lsm;
+
+// 小內存表與小層上限，少量數據即可觸發刷寫和多層合併
+static Options small_options() {
+    Options options;
+    options.lsm_memtable_bytes = 32 * 1024;
+    options.lsm_level0_compaction_trigger = 2;
+    options.lsm_level1_bytes = 64 * 1024;
+    options.lsm_level_multiplier = 4;
+    options.lsm_table_bytes = 32 * 1024;
+    options.lsm_block_bytes = 1024;
+    return options;
+}
+
+static std::string make_key(int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "key%06d", i);
+    return buf;
+}
+
+// 逐鍵比較並檢查迭代順序
+static void verify(const LSMTree& tree, const std::map<std::string, std::string>& expected, int key_space) {
+    for (int i = 0; i < key_space; ++i) {
+        std::string key = make_key(i);
+        std::string value;
+        auto it = expected.find(key);
+        bool found = tree.get(key, value);
+        if (found != (it != expected.end())) {
+            std::cerr << "Existence mismatch for " << key << std::endl;
+            abort();
+        }
+        if (found && value != it->second) {
+            std::cerr << "Value mismatch for " << key << std::endl;
+            abort();
+        }
+    }
+
+    auto expected_it = expected.begin();
+    for (auto iter = tree.new_iterator(); iter->valid(); iter->next()) {
+        if (expected_it == expected.end() || iter->key() != expected_it->first ||
+            iter->value() != expected_it->second) {
+            std::cerr << "Iterator mismatch at " << iter->key() << std::endl;
+            abort();
+        }
+        ++expected_it;
+    }
+    if (expected_it != expected.end()) abort();
+}
+
+// 測試寫入、覆蓋、刪除跨越刷寫與合併
+void test_lsm_basic() {
+    std::cout << "Testing LSM reads across flushes and compactions..." << std::endl;
+
+    std::string dir = "./test_lsm_basic";
+    std::filesystem::remove_all(dir);
+
+    const int key_space = 5000;
+    std::map<std::string, std::string> expected;
+    {
+        LSMTree tree(dir, small_options());
+        if (!tree.initialize()) abort();
+
+        for (int round = 0; round < 4; ++round) {
+            for (int i = 0; i < key_space; ++i) {
+                std::string key = make_key((i * 7 + round) % key_space);
+                if ((i + round) % 5 == 0) {
+                    bool existed = expected.erase(key) > 0;
+                    if (tree.remove(key) != existed) abort();
+                } else {
+                    std::string value = "value-" + std::to_string(round) + "-" + std::to_string(i);
+                    if (!tree.put(key, value)) abort();
+                    expected[key] = value;
+                }
+            }
+        }
+
+        verify(tree, expected, key_space);
+        tree.wait_for_background();
+        if (tree.get_compaction_count() == 0) abort();
+        if (tree.get_level_files(0) >= small_options().lsm_level0_compaction_trigger) abort();
+        size_t deeper = 0;
+        for (int level = 1; level < LSMTree::NUM_LEVELS; ++level) {
+            deeper += tree.get_level_files(level);
+        }
+        if (deeper == 0) abort();
+        if (tree.size() != expected.size()) abort();
+        verify(tree, expected, key_space);
+    }
+
+    // 重新打開後數據來自表文件
+    {
+        LSMTree tree(dir, small_options());
+        if (!tree.initialize()) abort();
+        verify(tree, expected, key_space);
+    }
+
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ LSM basic test passed" << std::endl;
+}
+
+// 測試鍵數隨刷寫、合併和重新打開保持準確
+void test_lsm_size() {
+    std::cout << "Testing LSM key count..." << std::endl;
+
+    std::string dir = "./test_lsm_size";
+    std::filesystem::remove_all(dir);
+
+    const int key_space = 3000;
+    std::map<std::string, std::string> expected;
+    {
+        LSMTree tree(dir, small_options());
+        if (!tree.initialize()) abort();
+        if (tree.size() != 0) abort();
+
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < key_space; ++i) {
+                std::string key = make_key((i * 11 + round) % key_space);
+                if ((i + round) % 4 == 0) {
+                    expected.erase(key);
+                    tree.remove(key);
+                } else {
+                    std::string value = "value-" + std::to_string(round) + "-" + std::to_string(i);
+                    tree.put(key, value);
+                    expected[key] = value;
+                }
+            }
+            // 部分寫入仍在內存表中
+            if (tree.size() != expected.size()) abort();
+        }
+
+        // 批量刪除無條件寫墓碑：不存在的鍵不影響鍵數
+        std::vector<WriteOp> ops(2);
+        ops[0].key = "missing";
+        ops[0].is_delete = true;
+        ops[1].key = expected.begin()->first;
+        ops[1].is_delete = true;
+        tree.apply_batch(ops);
+        expected.erase(expected.begin());
+        if (tree.size() != expected.size()) abort();
+
+        tree.wait_for_background();
+        if (tree.get_compaction_count() == 0) abort();
+        if (tree.size() != expected.size()) abort();
+    }
+
+    // 鍵數記錄在 MANIFEST 中
+    {
+        LSMTree tree(dir, small_options());
+        if (!tree.initialize()) abort();
+        if (tree.size() != expected.size()) abort();
+    }
+
+    // 沒有鍵數的舊 MANIFEST 打開時重新計算
+    std::string manifest;
+    {
+        std::ifstream in(dir + "/MANIFEST");
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, 10, "live_keys ") != 0) {
+                manifest += line + "\n";
+            }
+        }
+    }
+    { std::ofstream out(dir + "/MANIFEST", std::ios::trunc); out << manifest; }
+    {
+        LSMTree tree(dir, small_options());
+        if (!tree.initialize()) abort();
+        if (tree.size() != expected.size()) abort();
+        verify(tree, expected, key_space);
+    }
+
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ LSM key count test passed" << std::endl;
+}
+
+// 測試全量快照的導出與導入：導入按內存表大小分批，寫滿的內存表由刷寫線程寫出
+void test_lsm_snapshot_transfer() {
+    std::cout << "Testing LSM snapshot transfer..." << std::endl;
+
+    std::string source_dir = "./test_lsm_transfer_source";
+    std::string target_dir = "./test_lsm_transfer_target";
+    std::filesystem::remove_all(source_dir);
+    std::filesystem::remove_all(target_dir);
+
+    const int key_space = 3000;
+    std::map<std::string, std::string> expected;
+    std::string contents;
+    uint64_t snapshot_lsn = 0;
+    {
+        LSMTree source(source_dir, small_options());
+        if (!source.initialize()) abort();
+        for (int i = 0; i < key_space; ++i) {
+            std::string value = std::string(100, 'v') + std::to_string(i);
+            source.put(make_key(i), value);
+            expected[make_key(i)] = value;
+        }
+        source.remove(make_key(0));
+        expected.erase(make_key(0));
+        if (!source.write_snapshot(9)) abort();
+        source.put(make_key(0), "after");
+        expected[make_key(0)] = "after";
+        if (!source.read_data_file(contents, snapshot_lsn) || snapshot_lsn != 9) abort();
+    }
+
+    {
+        LSMTree target(target_dir, small_options());
+        if (!target.initialize()) abort();
+        target.put("stale", "x");
+        target.put(make_key(1), "old");
+
+        uint64_t loaded_lsn = 0;
+        if (!target.load_snapshot(contents, loaded_lsn) || loaded_lsn != 9) abort();
+        // 數據是內存表上限的許多倍，沒有調用 flush 也已經寫出了表文件
+        target.wait_for_background();
+        size_t files = 0;
+        for (int level = 0; level < LSMTree::NUM_LEVELS; ++level) {
+            files += target.get_level_files(level);
+        }
+        if (files == 0) abort();
+        if (target.get_snapshot_lsn() == 9) abort();
+        verify(target, expected, key_space);
+        if (target.exists("stale")) abort();
+        if (target.size() != expected.size()) abort();
+    }
+
+    std::filesystem::remove_all(source_dir);
+    std::filesystem::remove_all(target_dir);
+    std::cout << "  ✓ LSM snapshot transfer test passed" << std::endl;
+}
+
+// 測試前綴迭代與 seek
+void test_lsm_iterator() {
+    std::cout << "Testing LSM iterator..." << std::endl;
+
+    std::string dir = "./test_lsm_iterator";
+    std::filesystem::remove_all(dir);
+
+    LSMTree tree(dir, small_options());
+    if (!tree.initialize()) abort();
+
+    for (int i = 0; i < 3000; ++i) {
+        std::string prefix = (i % 3 == 0) ? "user:" : (i % 3 == 1 ? "order:" : "item:");
+        tree.put(prefix + make_key(i), std::to_string(i));
+    }
+    tree.flush();
+    // 內存表中的刪除遮蔽表文件中的值
+    tree.remove("user:" + make_key(0));
+    tree.remove("user:" + make_key(3));
+    tree.put("user:" + make_key(6), "updated");
+
+    auto iter = tree.new_iterator("user:");
+    int count = 0;
+    std::string last;
+    for (; iter->valid(); iter->next()) {
+        if (iter->key().compare(0, 5, "user:") != 0) abort();
+        if (!last.empty() && iter->key() <= last) abort();
+        last = iter->key();
+        count++;
+    }
+    if (count != 998) abort();
+
+    iter = tree.new_iterator("user:");
+    if (!iter->valid() || iter->key() != "user:" + make_key(6) || iter->value() != "updated") abort();
+    iter->seek("user:" + make_key(1500));
+    if (!iter->valid() || iter->key() != "user:" + make_key(1500)) abort();
+    iter->seek("zzz");
+    if (iter->valid()) abort();
+
+    // 創建之後的寫入對迭代器不可見
+    auto all = tree.new_iterator();
+    tree.put("aaa", "new");
+    if (!all->valid() || all->key() == "aaa") abort();
+
+    tree.close();
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ LSM iterator test passed" << std::endl;
+}
+
+// 測試快照 LSN 與殘留文件清理
+void test_lsm_snapshot() {
+    std::cout << "Testing LSM snapshot LSN and orphan cleanup..." << std::endl;
+
+    std::string dir = "./test_lsm_snapshot";
+    std::filesystem::remove_all(dir);
+
+    {
+        LSMTree tree(dir, small_options());
+        if (!tree.initialize()) abort();
+        if (tree.get_snapshot_lsn() != 0) abort();
+        tree.put("a", "1");
+
+        bool called = false;
+        if (!tree.write_snapshot(42, [&]() { called = true; return true; })) abort();
+        if (!called || tree.get_snapshot_lsn() != 42) abort();
+        if (tree.get_level_files(0) != 1) abort();
+
+        // 回調失敗時放棄，快照 LSN 不變
+        tree.put("b", "2");
+        if (tree.write_snapshot(50, []() { return false; })) abort();
+        if (tree.get_snapshot_lsn() != 42) abort();
+    }
+
+    // 模擬刷寫中途崩潰留下的表文件
+    { std::ofstream orphan(dir + "/999999.sst"); orphan << "partial"; }
+
+    {
+        LSMTree tree(dir, small_options());
+        if (!tree.initialize()) abort();
+        if (tree.get_snapshot_lsn() != 42) abort();
+        std::string value;
+        if (!tree.get("a", value) || value != "1") abort();
+        if (!tree.get("b", value) || value != "2") abort();
+        if (std::filesystem::exists(dir + "/999999.sst")) abort();
+    }
+
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ LSM snapshot test passed" << std::endl;
+}
+
+// 測試刪除後合併回收空間
+void test_lsm_space_reclaim() {
+    std::cout << "Testing LSM space reclamation..." << std::endl;
+
+    std::string dir = "./test_lsm_reclaim";
+    std::filesystem::remove_all(dir);
+
+    LSMTree tree(dir, small_options());
+    if (!tree.initialize()) abort();
+
+    // 數據只落在 L1 和 L2，墓碑合併到 L2 時沒有更深的層需要遮蔽
+    std::string value(20, 'v');
+    for (int i = 0; i < 4000; ++i) {
+        tree.put(make_key(i), value);
+    }
+    tree.flush();
+    tree.wait_for_background();
+    uint64_t full = tree.get_total_table_bytes();
+
+    for (int i = 0; i < 4000; ++i) {
+        if (i % 10 != 0 && !tree.remove(make_key(i))) abort();
+    }
+    // 寫入新數據推動刪除墓碑逐層下沉
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 400; ++i) {
+            tree.put(make_key(i * 10), value);
+        }
+        tree.flush();
+    }
+    tree.wait_for_background();
+
+    if (tree.size() != 400) abort();
+    if (tree.get_total_table_bytes() >= full) {
+        std::cerr << "Tables did not shrink: " << tree.get_total_table_bytes() << " >= " << full << std::endl;
+        abort();
+    }
+
+    tree.close();
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ LSM space reclamation test passed" << std::endl;
+}
+
+// 測試讀寫並發
+void test_lsm_concurrent() {
+    std::cout << "Testing LSM concurrent readers..." << std::endl;
+
+    std::string dir = "./test_lsm_concurrent";
+    std::filesystem::remove_all(dir);
+
+    LSMTree tree(dir, small_options());
+    if (!tree.initialize()) abort();
+
+    const int key_space = 2000;
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (int i = 0; i < 20000; ++i) {
+            int k = i % key_space;
+            tree.put(make_key(k), make_key(k) + ":" + std::to_string(i));
+        }
+        done = true;
+    });
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; ++t) {
+        readers.emplace_back([&, t]() {
+            int k = t;
+            while (!done) {
+                std::string key = make_key(k % key_space);
+                std::string value;
+                if (tree.get(key, value) && value.compare(0, key.size() + 1, key + ":") != 0) {
+                    std::cerr << "Wrong value for " << key << ": " << value << std::endl;
+                    abort();
+                }
+                k += 7;
+            }
+        });
+    }
+    writer.join();
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    tree.wait_for_background();
+    for (int k = 0; k < key_space; ++k) {
+        std::string value;
+        int last = 20000 - key_space + k;
+        if (!tree.get(make_key(k), value) || value != make_key(k) + ":" + std::to_string(last)) abort();
+    }
+
+    tree.close();
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ LSM concurrency test passed" << std::endl;
+}
+
+int main() {
+    std::cout << "=== LSM Tree Test Suite ===" << std::endl << std::endl;
+
+    test_lsm_basic();
+    test_lsm_size();
+    test_lsm_iterator();
+    test_lsm_snapshot();
+    test_lsm_snapshot_transfer();
+    test_lsm_space_reclaim();
+    test_lsm_concurrent();
+
+    std::cout << std::endl << "=== All LSM tests passed! ===" << std::endl;
+    return 0;
+}
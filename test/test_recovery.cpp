@@ -6,9 +6,17 @@
 #include "../src/kvengine/recovery_manager.h"
 #include "../src/kvengine/storage_engine.h"
 #include "../src/kvengine/transaction_manager.h"
+#include "../src/kvengine/checkpoint_manager.h"
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 #include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <filesystem>
 
 using namespace kvengine;
 
@@ -119,12 +127,572 @@ void test_recovery_undo() {
     std::cout << "  ✓ Recovery undo test passed" << std::endl;
 }
 
+// 測試自動提交記錄
+void test_recovery_autocommit() {
+    std::cout << "Testing recovery of autocommit records..." << std::endl;
+    
+    std::string data_dir = "./test_recovery_autocommit";
+    std::filesystem::remove_all(data_dir);
+    
+    // 1. 每個自動提交操作只寫一條日誌
+    {
+        StorageEngine storage(data_dir);
+        if (!storage.initialize()) abort();
+        
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        
+        LockManager lock_mgr;
+        TransactionManager txn_mgr(&wal, &lock_mgr, &storage);
+        
+        if (!txn_mgr.put_autocommit("a", "1")) abort();
+        if (!txn_mgr.put_autocommit("b", "2")) abort();
+        if (!txn_mgr.remove_autocommit("a")) abort();
+        if (txn_mgr.remove_autocommit("missing")) abort();
+        
+        // 未提交事務與自動提交交錯
+        Transaction* txn = txn_mgr.begin();
+        txn_mgr.put(txn, "uncommitted", "x");
+        if (txn_mgr.get_min_active_lsn() != txn->get_start_lsn()) abort();
+        if (!txn_mgr.put_autocommit("c", "3")) abort();
+        
+        auto records = wal.read_from(0);
+        if (records.size() != 7) abort();
+        if (records[0].type != LogRecordType::AUTOCOMMIT_PUT || records[0].key != "a") abort();
+        if (records[2].type != LogRecordType::AUTOCOMMIT_DELETE) abort();
+        if (records[6].type != LogRecordType::AUTOCOMMIT_PUT || records[6].value != "3") abort();
+    }
+    
+    // 2. 自動提交記錄視為已提交
+    {
+        StorageEngine storage(data_dir);
+        if (!storage.initialize()) abort();
+        
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        
+        RecoveryManager recovery(&wal, &storage);
+        if (!recovery.recover()) abort();
+        
+        std::string val;
+        if (storage.get("a", val)) abort();
+        if (!storage.get("b", val) || val != "2") abort();
+        if (!storage.get("c", val) || val != "3") abort();
+        if (storage.get("uncommitted", val)) abort();
+    }
+    
+    std::cout << "  ✓ Recovery autocommit test passed" << std::endl;
+}
+
+// 測試從檢查點的快照 LSN 開始恢復
+void test_recovery_from_checkpoint() {
+    std::cout << "Testing recovery from checkpoint snapshot LSN..." << std::endl;
+    
+    std::string data_dir = "./test_recovery_checkpoint";
+    std::filesystem::remove_all(data_dir);
+    
+    uint64_t snapshot_lsn = 0;
+    {
+        StorageEngine storage(data_dir);
+        if (!storage.initialize()) abort();
+        
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        
+        LockManager lock_mgr;
+        TransactionManager txn_mgr(&wal, &lock_mgr, &storage);
+        CheckpointManager checkpoint(&wal, &txn_mgr, &storage);
+        
+        if (!txn_mgr.put_autocommit("before", "1")) abort();
+        Transaction* txn = txn_mgr.begin();
+        txn_mgr.put(txn, "committed_before", "1");
+        txn_mgr.commit(txn);
+        delete txn;
+        
+        if (!checkpoint.create_checkpoint()) abort();
+        // 沒有活躍事務時快照 LSN 就是 CHECKPOINT_BEGIN 記錄的 LSN
+        snapshot_lsn = storage.get_snapshot_lsn();
+        if (snapshot_lsn != wal.get_last_lsn() - 1) abort();
+        
+        // 繞過日誌直接修改存儲：若恢復重放檢查點之前的日誌，"before" 會被重新寫入
+        storage.remove("before");
+        
+        // 檢查點之後：已提交、已回滾和未提交的事務
+        txn = txn_mgr.begin();
+        txn_mgr.put(txn, "committed_after", "2");
+        txn_mgr.commit(txn);
+        delete txn;
+        
+        txn = txn_mgr.begin();
+        txn_mgr.put(txn, "rolled_back", "x");
+        txn_mgr.rollback(txn);
+        delete txn;
+        
+        // 未提交的事務由 TransactionManager 析構時釋放
+        Transaction* loser = txn_mgr.begin();
+        txn_mgr.put(loser, "uncommitted", "y");
+        
+        // 數據文件包含未提交的寫入，快照 LSN 仍為檢查點時的值
+        if (!storage.flush()) abort();
+        if (!storage.put("rolled_back", "x")) abort();
+        if (!storage.flush()) abort();
+    }
+    
+    // 檢查點開始與結束記錄攜帶快照 LSN
+    {
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        bool found = false;
+        for (const auto& record : wal.read_from(0)) {
+            if (record.type == LogRecordType::CHECKPOINT_BEGIN) {
+                if (record.lsn != snapshot_lsn || record.value != std::to_string(snapshot_lsn)) abort();
+            } else if (record.type == LogRecordType::CHECKPOINT) {
+                if (record.value != std::to_string(snapshot_lsn) + "-" + std::to_string(snapshot_lsn)) abort();
+                found = true;
+            }
+        }
+        if (!found) abort();
+    }
+    
+    {
+        StorageEngine storage(data_dir);
+        if (!storage.initialize()) abort();
+        if (storage.get_snapshot_lsn() != snapshot_lsn) abort();
+        
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        
+        RecoveryManager recovery(&wal, &storage);
+        if (!recovery.recover()) abort();
+        
+        std::string val;
+        if (storage.get("before", val)) abort();
+        if (!storage.get("committed_before", val) || val != "1") abort();
+        if (!storage.get("committed_after", val) || val != "2") abort();
+        if (storage.get("rolled_back", val)) abort();
+        if (storage.get("uncommitted", val)) abort();
+    }
+    
+    std::cout << "  ✓ Recovery from checkpoint test passed" << std::endl;
+}
+
+// 測試按鍵哈希分區的並行重做
+void test_recovery_parallel_redo() {
+    std::cout << "Testing parallel redo..." << std::endl;
+    
+    std::string data_dir = "./test_recovery_parallel";
+    std::filesystem::remove_all(data_dir);
+    
+    // 同一個鍵被多次覆蓋和刪除，最終狀態取決於日誌順序
+    const int key_count = 2000;
+    std::map<std::string, std::string> expected;
+    {
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        for (int round = 0; round < 5; ++round) {
+            for (int i = 0; i < key_count; ++i) {
+                std::string key = "key" + std::to_string(i);
+                if ((i + round) % 7 == 0) {
+                    wal.append(LogRecordType::AUTOCOMMIT_DELETE, 1, key);
+                    expected.erase(key);
+                } else {
+                    std::string value = "v" + std::to_string(round);
+                    wal.append(LogRecordType::AUTOCOMMIT_PUT, 1, key, value);
+                    expected[key] = value;
+                }
+            }
+        }
+        wal.close();
+    }
+    
+    Options options;
+    options.recovery_threads = 4;
+    StorageEngine storage(data_dir);
+    if (!storage.initialize()) abort();
+    WAL wal(data_dir);
+    if (!wal.initialize()) abort();
+    RecoveryManager recovery(&wal, &storage, options);
+    if (!recovery.recover()) abort();
+    
+    if (storage.get_all_data() != expected) abort();
+    
+    std::cout << "  ✓ Parallel redo test passed" << std::endl;
+}
+
+// 記錄每次 apply_batch 的批次大小
+class BatchCountingStorage : public StorageEngine {
+public:
+    explicit BatchCountingStorage(const std::string& data_dir) : StorageEngine(data_dir) {}
+
+    void apply_batch(const std::vector<WriteOp>& ops) override {
+        size_t bytes = 0;
+        for (const auto& op : ops) {
+            bytes += op.key.size() + op.value.size();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batches++;
+            max_ops = std::max(max_ops, ops.size());
+            max_bytes = std::max(max_bytes, bytes);
+        }
+        StorageEngine::apply_batch(ops);
+    }
+
+    std::mutex mutex;
+    size_t batches = 0;
+    size_t max_ops = 0;
+    size_t max_bytes = 0;
+};
+
+// 測試重做在日誌遠大於批次上限時分批應用
+void test_recovery_bounded_redo_batches() {
+    std::cout << "Testing bounded redo batches..." << std::endl;
+
+    std::string data_dir = "./test_recovery_bounded";
+    std::filesystem::remove_all(data_dir);
+
+    // 許多小記錄覆蓋少量鍵（條數上限），之後是一批大值（字節上限）
+    const size_t large_value_size = 64 * 1024;
+    std::map<std::string, std::string> expected;
+    size_t record_count = 0;
+    {
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        for (int i = 0; i < 20000; ++i) {
+            std::string key = "key" + std::to_string(i % 500);
+            std::string value = "v" + std::to_string(i);
+            wal.append(LogRecordType::AUTOCOMMIT_PUT, 1, key, value);
+            expected[key] = value;
+            record_count++;
+        }
+        for (int i = 0; i < 100; ++i) {
+            std::string key = "large" + std::to_string(i);
+            std::string value(large_value_size, static_cast<char>('a' + i % 26));
+            wal.append(LogRecordType::AUTOCOMMIT_PUT, 1, key, value);
+            expected[key] = value;
+            record_count++;
+        }
+        wal.close();
+    }
+
+    {
+        Options options;
+        options.recovery_threads = 2;
+        BatchCountingStorage storage(data_dir);
+        if (!storage.initialize()) abort();
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        RecoveryManager recovery(&wal, &storage, options);
+        if (!recovery.recover()) abort();
+
+        if (storage.get_all_data() != expected) abort();
+        if (storage.batches < record_count / RecoveryManager::REDO_BATCH_SIZE) abort();
+        if (storage.max_ops > RecoveryManager::REDO_BATCH_SIZE) abort();
+        if (storage.max_bytes > RecoveryManager::REDO_BATCH_BYTES + large_value_size) abort();
+    }
+
+    std::filesystem::remove_all(data_dir);
+    std::cout << "  ✓ Bounded redo batches test passed" << std::endl;
+}
+
+// 測試 flush 在替換數據文件之前先持久化日誌
+void test_storage_flush_before_install() {
+    std::cout << "Testing storage flush before_install hook..." << std::endl;
+
+    std::string data_dir = "./test_storage_flush_hook";
+    std::filesystem::remove_all(data_dir);
+    {
+        StorageEngine storage(data_dir);
+        if (!storage.initialize()) abort();
+        if (!storage.put("a", "1")) abort();
+
+        // 回調失敗（日誌沒有落盤）時不替換數據文件
+        storage.set_before_install([]() { return false; });
+        if (storage.flush()) abort();
+        {
+            StorageEngine reader(data_dir);
+            if (!reader.initialize()) abort();
+            std::string val;
+            if (reader.get("a", val)) abort();
+        }
+
+        bool called = false;
+        storage.set_before_install([&]() { called = true; return true; });
+        if (!storage.flush()) abort();
+        if (!called) abort();
+    }
+    {
+        StorageEngine storage(data_dir);
+        if (!storage.initialize()) abort();
+        std::string val;
+        if (!storage.get("a", val) || val != "1") abort();
+    }
+
+    std::filesystem::remove_all(data_dir);
+    std::cout << "  ✓ Storage flush before_install test passed" << std::endl;
+}
+
+// 測試寫操作並發進行時的模糊檢查點
+void test_recovery_fuzzy_checkpoint() {
+    std::cout << "Testing fuzzy checkpoint..." << std::endl;
+    
+    std::string data_dir = "./test_recovery_fuzzy";
+    std::string copy_dir = "./test_recovery_fuzzy_copy";
+    std::filesystem::remove_all(data_dir);
+    std::filesystem::remove_all(copy_dir);
+    
+    std::map<std::string, std::string> expected;
+    {
+        StorageEngine storage(data_dir);
+        if (!storage.initialize()) abort();
+        
+        Options options;
+        options.wal_sync_mode = WALSyncMode::OS;
+        WAL wal(data_dir, options);
+        if (!wal.initialize()) abort();
+        
+        LockManager lock_mgr;
+        TransactionManager txn_mgr(&wal, &lock_mgr, &storage);
+        CheckpointManager checkpoint(&wal, &txn_mgr, &storage);
+        
+        std::atomic<bool> done(false);
+        std::thread writer([&]() {
+            for (int i = 0; i < 20000; ++i) {
+                std::string key = "key" + std::to_string(i % 5000);
+                if (i % 11 == 0) {
+                    txn_mgr.remove_autocommit(key);
+                } else {
+                    txn_mgr.put_autocommit(key, std::to_string(i));
+                }
+            }
+            done = true;
+        });
+        
+        // 快照期間寫線程持續寫入
+        int checkpoints = 0;
+        while (!done) {
+            if (!checkpoint.create_checkpoint()) abort();
+            checkpoints++;
+        }
+        writer.join();
+        if (checkpoints == 0) abort();
+        
+        expected = storage.get_all_data();
+        
+        // 數據文件是最後一次模糊快照，複製目錄模擬崩潰
+        wal.flush();
+        std::filesystem::copy(data_dir, copy_dir);
+        
+        bool found_begin = false;
+        for (const auto& record : wal.read_from(0)) {
+            if (record.type == LogRecordType::CHECKPOINT_BEGIN) {
+                found_begin = true;
+            }
+        }
+        if (!found_begin) abort();
+    }
+    
+    StorageEngine storage(copy_dir);
+    if (!storage.initialize()) abort();
+    if (storage.get_snapshot_lsn() == 0) abort();
+    WAL wal(copy_dir);
+    if (!wal.initialize()) abort();
+    RecoveryManager recovery(&wal, &storage);
+    if (!recovery.recover()) abort();
+    if (storage.get_all_data() != expected) abort();
+    
+    std::cout << "  ✓ Fuzzy checkpoint test passed" << std::endl;
+}
+
+// 測試後台恢復：按需重放請求的鍵
+void test_recovery_lazy() {
+    std::cout << "Testing lazy recovery..." << std::endl;
+    
+    std::string data_dir = "./test_recovery_lazy";
+    std::filesystem::remove_all(data_dir);
+    
+    std::map<std::string, std::string> expected;
+    {
+        StorageEngine storage(data_dir);
+        if (!storage.initialize()) abort();
+        
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        
+        LockManager lock_mgr;
+        TransactionManager txn_mgr(&wal, &lock_mgr, &storage);
+        
+        for (int i = 0; i < 3000; ++i) {
+            std::string key = "key" + std::to_string(i % 1000);
+            if (i % 13 == 0) {
+                txn_mgr.remove_autocommit(key);
+            } else {
+                txn_mgr.put_autocommit(key, std::to_string(i));
+            }
+        }
+        
+        Transaction* txn = txn_mgr.begin();
+        txn_mgr.put(txn, "committed", "1");
+        txn_mgr.commit(txn);
+        delete txn;
+        
+        txn = txn_mgr.begin();
+        txn_mgr.put(txn, "rolled_back", "x");
+        txn_mgr.rollback(txn);
+        delete txn;
+        
+        Transaction* loser = txn_mgr.begin();
+        txn_mgr.put(loser, "uncommitted", "y");
+        
+        expected = storage.get_all_data();
+        expected.erase("uncommitted");
+    }
+    
+    StorageEngine storage(data_dir);
+    if (!storage.initialize()) abort();
+    WAL wal(data_dir);
+    if (!wal.initialize()) abort();
+    
+    RecoveryManager recovery(&wal, &storage);
+    std::atomic<bool> scanned(false);
+    std::atomic<size_t> applied(0);
+    recovery.start_lazy(wal.get_last_lsn(),
+                        [&]() { scanned = true; },
+                        [&](const std::vector<WriteOp>& ops) { applied += ops.size(); });
+    
+    // 請求的鍵在後台恢復完成之前就可見
+    recovery.ensure_key("key500");
+    std::string val;
+    if (!storage.get("key500", val) || val != expected["key500"]) abort();
+    recovery.ensure_key("committed");
+    if (!storage.get("committed", val) || val != "1") abort();
+    recovery.ensure_key("uncommitted");
+    if (storage.get("uncommitted", val)) abort();
+    
+    // 按需重放之後的寫入不會被後台恢復覆蓋
+    recovery.ensure_key("key1");
+    storage.put("key1", "newer");
+    expected["key1"] = "newer";
+    
+    recovery.wait();
+    if (recovery.is_recovering()) abort();
+    if (!scanned) abort();
+    if (recovery.get_scanned_records() == 0) abort();
+    if (recovery.get_pending_keys() != 0) abort();
+    if (recovery.get_replayed_keys() != applied) abort();
+    if (storage.get_all_data() != expected) abort();
+    
+    std::cout << "  ✓ Lazy recovery test passed" << std::endl;
+}
+
+// 測試後台掃描結束之前按需解析的鍵就可以訪問
+void test_recovery_lazy_during_scan() {
+    std::cout << "Testing lazy recovery during scan..." << std::endl;
+    
+    std::string data_dir = "./test_recovery_lazy_scan";
+    std::filesystem::remove_all(data_dir);
+    
+    std::map<std::string, std::string> expected;
+    {
+        StorageEngine storage(data_dir);
+        if (!storage.initialize()) abort();
+        
+        WAL wal(data_dir);
+        if (!wal.initialize()) abort();
+        
+        LockManager lock_mgr;
+        TransactionManager txn_mgr(&wal, &lock_mgr, &storage);
+        
+        for (int i = 0; i < 2000; ++i) {
+            std::string key = "key" + std::to_string(i % 500);
+            if (i % 11 == 0) {
+                txn_mgr.remove_autocommit(key);
+            } else {
+                txn_mgr.put_autocommit(key, std::to_string(i));
+            }
+        }
+        
+        // 事務在後續的自動提交之後才提交，同一事務對一個鍵寫兩次
+        Transaction* txn = txn_mgr.begin();
+        txn_mgr.put(txn, "committed", "1");
+        txn_mgr.put_autocommit("key7", "autocommit");
+        txn_mgr.put(txn, "committed", "2");
+        txn_mgr.commit(txn);
+        delete txn;
+        
+        txn = txn_mgr.begin();
+        txn_mgr.put(txn, "rolled_back", "x");
+        txn_mgr.rollback(txn);
+        delete txn;
+        
+        Transaction* loser = txn_mgr.begin();
+        txn_mgr.put(loser, "uncommitted", "y");
+        
+        expected = storage.get_all_data();
+        expected.erase("uncommitted");
+    }
+    
+    StorageEngine storage(data_dir);
+    if (!storage.initialize()) abort();
+    WAL wal(data_dir);
+    if (!wal.initialize()) abort();
+    
+    // 掃描開始之前阻塞後台線程，按需解析必須自己讀取日誌
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::atomic<size_t> applied(0);
+    RecoveryManager recovery(&wal, &storage);
+    recovery.start_lazy(wal.get_last_lsn(),
+                        [released]() { released.wait(); },
+                        [&](const std::vector<WriteOp>& ops) { applied += ops.size(); });
+    
+    std::string val;
+    recovery.ensure_key("key7");
+    if (!storage.get("key7", val) || val != expected["key7"]) abort();
+    recovery.ensure_key("key0");
+    if (storage.get("key0", val) != (expected.count("key0") != 0)) abort();
+    recovery.ensure_key("committed");
+    if (!storage.get("committed", val) || val != "2") abort();
+    recovery.ensure_key("rolled_back");
+    if (storage.get("rolled_back", val)) abort();
+    recovery.ensure_key("uncommitted");
+    if (storage.get("uncommitted", val)) abort();
+    recovery.ensure_key("missing");
+    if (storage.get("missing", val)) abort();
+    if (recovery.get_scanned_records() != 0) abort();
+    if (!recovery.is_recovering()) abort();
+    
+    // 已解析的鍵不再由掃描和重放寫入
+    storage.put("key7", "newer");
+    expected["key7"] = "newer";
+    recovery.ensure_key("key7");
+    if (!storage.get("key7", val) || val != "newer") abort();
+    
+    release.set_value();
+    recovery.wait();
+    if (recovery.is_recovering()) abort();
+    if (recovery.get_scanned_records() == 0) abort();
+    if (recovery.get_pending_keys() != 0) abort();
+    if (recovery.get_replayed_keys() != applied) abort();
+    if (storage.get_all_data() != expected) abort();
+    
+    std::cout << "  ✓ Lazy recovery during scan test passed" << std::endl;
+}
+
 int main() {
     std::cout << "=== Recovery Manager Test Suite ===" << std::endl << std::endl;
     
     try {
         test_recovery_redo();
         test_recovery_undo();
+        test_recovery_autocommit();
+        test_recovery_from_checkpoint();
+        test_recovery_parallel_redo();
+        test_recovery_bounded_redo_batches();
+        test_storage_flush_before_install();
+        test_recovery_fuzzy_checkpoint();
+        test_recovery_lazy();
+        test_recovery_lazy_during_scan();
         
         std::cout << std::endl << "=== All recovery tests passed! ===" << std::endl;
         return 0;
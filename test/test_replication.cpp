@@ -0,0 +1,229 @@
+#include <kvengine/network/kv_server.h>
+#include <kvengine/network/resp_parser.h>
+#include <kvengine/network/socket.h>
+#include "../src/kvengine/log_tailer.h"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace kvengine::network;
+
+static const uint16_t LEADER_PORT = 9981;
+static const uint16_t FOLLOWER_PORT = 9982;
+
+// 發送一條命令並讀取完整的回覆
+static std::string send_command(Socket& client, const std::vector<std::string>& args) {
+    std::string request = "*" + std::to_string(args.size()) + "\r\n";
+    for (const auto& arg : args) {
+        request += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+    if (!client.send_all(request.c_str(), request.size())) return "";
+
+    std::string response;
+    char buffer[4096];
+    for (;;) {
+        int bytes = client.recv(buffer, sizeof(buffer));
+        if (bytes <= 0) return response;
+        response.append(buffer, bytes);
+        // 數組回覆需要等到完整解析；其他回覆以 CRLF 結尾即完整
+        if (response[0] == '*') {
+            RespParser parser;
+            std::vector<std::string> fields;
+            size_t consumed = 0;
+            if (parser.parse(response.c_str(), response.size(), fields, consumed) != RespParser::Status::INCOMPLETE) {
+                return response;
+            }
+        } else if (response[0] == '$' && response != "$-1\r\n") {
+            size_t header = response.find("\r\n");
+            if (header != std::string::npos &&
+                response.size() >= header + 2 + std::stoul(response.substr(1, header - 1)) + 2) {
+                return response;
+            }
+        } else if (response.size() >= 2 && response.compare(response.size() - 2, 2, "\r\n") == 0) {
+            return response;
+        }
+    }
+}
+
+static std::vector<std::string> role(Socket& client) {
+    std::string response = send_command(client, {"ROLE"});
+    RespParser parser;
+    std::vector<std::string> fields;
+    size_t consumed = 0;
+    if (parser.parse(response.c_str(), response.size(), fields, consumed) != RespParser::Status::OK) {
+        std::abort();
+    }
+    return fields;
+}
+
+static void connect_client(Socket& client, uint16_t port) {
+    for (int i = 0; i < 50; ++i) {
+        if (client.create() && client.connect("127.0.0.1", port)) {
+            return;
+        }
+        client.close();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    std::cerr << "Failed to connect to port " << port << std::endl;
+    std::abort();
+}
+
+// 等待從節點讀到期望的值
+static bool wait_for_value(Socket& follower, const std::string& key, const std::string& expected) {
+    for (int i = 0; i < 250; ++i) {
+        if (send_command(follower, {"GET", key}) == expected) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    return false;
+}
+
+static std::string bulk(const std::string& value) {
+    return "$" + std::to_string(value.size()) + "\r\n" + value + "\r\n";
+}
+
+static void run_server(KvServer* server) {
+    server->run();
+}
+
+// 日誌游標只發送已持久化的記錄：OS 模式不主動同步，追上持久化水位線時由游標請求同步
+static void test_tailer_ships_durable_records() {
+    std::string data_dir = "./test_replication_tailer";
+    std::filesystem::remove_all(data_dir);
+    {
+        kvengine::Options options;
+        options.wal_sync_mode = kvengine::WALSyncMode::OS;
+        kvengine::WAL wal(data_dir, options);
+        if (!wal.initialize()) std::abort();
+        kvengine::WALTailer tailer(&wal, 1);
+
+        for (int i = 0; i < 10; ++i) {
+            uint64_t lsn = wal.append(kvengine::LogRecordType::AUTOCOMMIT_PUT, 0, "key" + std::to_string(i), "value");
+            if (!wal.group_commit(lsn)) std::abort();
+        }
+
+        int received = 0;
+        for (int i = 0; i < 250 && received < 10; ++i) {
+            kvengine::ReplicationBatch batch;
+            while (tailer.next(batch)) {
+                if (batch.lsn > wal.get_flushed_lsn()) std::abort();
+                received++;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (received != 10) std::abort();
+        wal.close();
+    }
+    std::filesystem::remove_all(data_dir);
+    std::cout << "Durable-only tailing passed." << std::endl;
+}
+
+int main() {
+    if (!Socket::initialize_network()) return 1;
+
+    test_tailer_ships_durable_records();
+
+    std::string leader_dir = "./test_replication_leader";
+    std::string follower_dir = "./test_replication_follower";
+    std::string crashed_dir = "./test_replication_crashed";
+    std::filesystem::remove_all(leader_dir);
+    std::filesystem::remove_all(follower_dir);
+    std::filesystem::remove_all(crashed_dir);
+
+    {
+        KvServer leader(leader_dir, LEADER_PORT, "127.0.0.1");
+        KvServer follower(follower_dir, FOLLOWER_PORT, "127.0.0.1");
+        if (!leader.start() || !follower.start()) std::abort();
+        std::thread leader_thread(run_server, &leader);
+        std::thread follower_thread(run_server, &follower);
+
+        Socket leader_client;
+        Socket follower_client;
+        connect_client(leader_client, LEADER_PORT);
+        connect_client(follower_client, FOLLOWER_PORT);
+
+        // 1. 快照之前的數據通過全量同步到達從節點
+        for (int i = 0; i < 100; ++i) {
+            if (send_command(leader_client, {"SET", "snap" + std::to_string(i), "value" + std::to_string(i)}) != "+OK\r\n") std::abort();
+        }
+        if (send_command(leader_client, {"DEL", "snap0"}) != ":1\r\n") std::abort();
+
+        if (send_command(follower_client, {"REPLICAOF", "127.0.0.1", std::to_string(LEADER_PORT)}) != "+OK\r\n") std::abort();
+        if (!wait_for_value(follower_client, "snap99", bulk("value99"))) std::abort();
+        if (send_command(follower_client, {"GET", "snap0"}) != "$-1\r\n") std::abort();
+        std::cout << "Full resync passed." << std::endl;
+
+        // 2. 之後的寫入通過日誌流到達從節點
+        for (int i = 0; i < 200; ++i) {
+            send_command(leader_client, {"SET", "tail" + std::to_string(i), std::string(100, 'a' + i % 26)});
+        }
+        send_command(leader_client, {"DEL", "snap1"});
+        send_command(leader_client, {"SET", "last", "done"});
+        if (!wait_for_value(follower_client, "last", bulk("done"))) std::abort();
+        if (send_command(follower_client, {"GET", "tail150"}) != bulk(std::string(100, 'a' + 150 % 26))) std::abort();
+        if (send_command(follower_client, {"GET", "snap1"}) != "$-1\r\n") std::abort();
+        std::cout << "WAL streaming passed." << std::endl;
+
+        // 3. 從節點只讀，並報告延遲
+        if (send_command(follower_client, {"SET", "x", "y"}).compare(0, 9, "-READONLY") != 0) std::abort();
+        std::vector<std::string> replica_role;
+        for (int i = 0; i < 250; ++i) {
+            replica_role = role(follower_client);
+            if (replica_role.size() == 7 && replica_role[3] == "connected" && replica_role[6] == "0") break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        if (replica_role.size() != 7 || replica_role[0] != "slave" || replica_role[6] != "0") std::abort();
+        std::vector<std::string> master_role = role(leader_client);
+        if (master_role.size() != 2 || master_role[0] != "master") std::abort();
+        if (std::stoull(replica_role[4]) == 0 || std::stoull(replica_role[5]) > std::stoull(master_role[1])) std::abort();
+        std::cout << "Role and lag passed: applied LSN " << replica_role[4] << ", master LSN " << master_role[1] << std::endl;
+
+        // 4. 主節點重啟後從節點重新連接並繼續同步
+        leader_client.close();
+        leader.stop();
+        leader_thread.join();
+        if (!leader.start()) std::abort();
+        leader_thread = std::thread(run_server, &leader);
+        connect_client(leader_client, LEADER_PORT);
+        send_command(leader_client, {"SET", "after_restart", "yes"});
+        if (!wait_for_value(follower_client, "after_restart", bulk("yes"))) std::abort();
+        if (send_command(follower_client, {"GET", "tail199"}) != bulk(std::string(100, 'a' + 199 % 26))) std::abort();
+        std::cout << "Reconnect passed." << std::endl;
+
+        // 5. REPLICAOF NO ONE 之後恢復可寫，保留已複製的數據
+        if (send_command(follower_client, {"REPLICAOF", "NO", "ONE"}) != "+OK\r\n") std::abort();
+        {
+            // 提升之後立即崩潰：複製來的數據已經持久化（複製數據目錄模擬崩潰時的磁盤狀態）
+            std::filesystem::copy(follower_dir, crashed_dir, std::filesystem::copy_options::recursive);
+            kvengine::KvEngine crashed(crashed_dir);
+            if (!crashed.open()) std::abort();
+            if (crashed.get("snap50") != "value50") std::abort();
+            if (crashed.get("tail199") != std::string(100, 'a' + 199 % 26)) std::abort();
+            if (crashed.get("after_restart") != "yes") std::abort();
+            crashed.close();
+        }
+        if (send_command(follower_client, {"SET", "x", "y"}) != "+OK\r\n") std::abort();
+        if (send_command(follower_client, {"GET", "snap50"}) != bulk("value50")) std::abort();
+        if (role(follower_client)[0] != "master") std::abort();
+        std::cout << "Promotion passed." << std::endl;
+
+        leader_client.close();
+        follower_client.close();
+        follower.stop();
+        follower_thread.join();
+        leader.stop();
+        leader_thread.join();
+    }
+
+    std::filesystem::remove_all(leader_dir);
+    std::filesystem::remove_all(follower_dir);
+    std::filesystem::remove_all(crashed_dir);
+    Socket::cleanup_network();
+    std::cout << "Replication tests passed!" << std::endl;
+    return 0;
+}
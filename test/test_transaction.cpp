@@ -2,6 +2,7 @@
 #include "../src/kvengine/storage_engine.h"
 #include <iostream>
 #include <cassert>
+#include <filesystem>
 
 using namespace kvengine;
 
@@ -105,6 +106,90 @@ void test_transaction_rollback() {
     std::cout << "  ✓ Transaction rollback test passed" << std::endl;
 }
 
+// 測試 COMMIT 日誌同步失敗時提交失敗並回滾
+void test_transaction_commit_sync_failure() {
+    std::cout << "Testing transaction commit sync failure..." << std::endl;
+    
+    std::string data_dir = "./test_txn_sync_failure";
+    std::filesystem::remove_all(data_dir);
+    StorageEngine storage(data_dir);
+    if (!storage.initialize()) abort();
+    
+    Options options;
+    options.wal_segment_size = 512;
+    WAL wal(data_dir, options);
+    if (!wal.initialize()) abort();
+    // 下一個 WAL 段的路徑被目錄佔用，段輪轉失敗，之後的組提交都報告錯誤
+    std::filesystem::create_directories(data_dir + "/wal.000002");
+    
+    LockManager lock_mgr;
+    TransactionManager txn_mgr(&wal, &lock_mgr, &storage);
+    
+    Transaction* txn = txn_mgr.begin();
+    for (int i = 0; i < 20; ++i) {
+        if (!txn_mgr.put(txn, "key" + std::to_string(i), std::string(40, 'v'))) abort();
+    }
+    if (txn_mgr.commit(txn)) abort();
+    if (txn->get_state() != TransactionState::ABORTED) abort();
+    
+    // 寫入被撤銷，鎖被釋放
+    std::string val;
+    if (storage.get("key0", val)) abort();
+    Transaction* other = txn_mgr.begin();
+    if (!lock_mgr.try_lock(other->get_id(), "key0", LockMode::EXCLUSIVE)) abort();
+    txn_mgr.rollback(other);
+    
+    delete txn;
+    delete other;
+    wal.close();
+    std::filesystem::remove_all(data_dir);
+    std::cout << "  ✓ Transaction commit sync failure test passed" << std::endl;
+}
+
+// 測試自動提交的日誌同步失敗時寫入報告失敗且存儲保持不變
+void test_autocommit_sync_failure() {
+    std::cout << "Testing autocommit sync failure..." << std::endl;
+    
+    std::string data_dir = "./test_autocommit_sync_failure";
+    std::filesystem::remove_all(data_dir);
+    StorageEngine storage(data_dir);
+    if (!storage.initialize()) abort();
+    
+    Options options;
+    options.wal_segment_size = 512;
+    WAL wal(data_dir, options);
+    if (!wal.initialize()) abort();
+    std::filesystem::create_directories(data_dir + "/wal.000002");
+    
+    LockManager lock_mgr;
+    TransactionManager txn_mgr(&wal, &lock_mgr, &storage);
+    
+    // 第一段寫滿之前的寫入成功；輪轉失敗之後每次寫入都報告失敗
+    int failed_at = -1;
+    for (int i = 0; i < 20 && failed_at < 0; ++i) {
+        if (!txn_mgr.put_autocommit("key" + std::to_string(i), std::string(40, 'v'))) {
+            failed_at = i;
+        }
+    }
+    if (failed_at <= 0) abort();
+
+    // 同步失敗的 AUTOCOMMIT_PUT 不更新存儲
+    std::string val;
+    if (storage.get("key" + std::to_string(failed_at), val)) abort();
+    if (txn_mgr.put_autocommit("after", "value")) abort();
+    if (storage.get("after", val)) abort();
+    if (txn_mgr.put_autocommit("key0", "overwritten")) abort();
+    if (!storage.get("key0", val) || val != std::string(40, 'v')) abort();
+
+    // 同步失敗的 AUTOCOMMIT_DELETE 不刪除鍵
+    if (txn_mgr.remove_autocommit("key0")) abort();
+    if (!storage.get("key0", val) || val != std::string(40, 'v')) abort();
+
+    wal.close();
+    std::filesystem::remove_all(data_dir);
+    std::cout << "  ✓ Autocommit sync failure test passed" << std::endl;
+}
+
 // 測試事務併發和鎖
 void test_transaction_concurrency() {
     std::cout << "Testing transaction concurrency..." << std::endl;
@@ -151,6 +236,14 @@ int main() {
         test_transaction_rollback();
         std::cout << "Rollback test finished." << std::endl;
         
+        std::cout << "Starting commit sync failure test..." << std::endl;
+        test_transaction_commit_sync_failure();
+        std::cout << "Commit sync failure test finished." << std::endl;
+        
+        std::cout << "Starting autocommit sync failure test..." << std::endl;
+        test_autocommit_sync_failure();
+        std::cout << "Autocommit sync failure test finished." << std::endl;
+        
         std::cout << "Starting concurrency test..." << std::endl;
         test_transaction_concurrency();
         std::cout << "Concurrency test finished." << std::endl;
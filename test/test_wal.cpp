@@ -4,9 +4,15 @@
  */
 
 #include "../src/kvengine/wal.h"
+#include "../src/kvengine/crc32c.h"
 #include <iostream>
 #include <cassert>
 #include <filesystem>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <fstream>
+#include <iterator>
 
 using namespace kvengine;
 
@@ -145,7 +151,779 @@ void test_wal_checksum() {
     std::cout << "  ✓ WAL checksum test passed" << std::endl;
 }
 
+// 測試組提交：並發提交者共享刷新
+void test_wal_group_commit() {
+    std::cout << "Testing WAL group commit..." << std::endl;
+    
+    std::filesystem::remove_all("./test_wal_group");
+    WAL wal("./test_wal_group");
+    if (!wal.initialize()) abort();
+    
+    const int num_threads = 8;
+    const int commits_per_thread = 50;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&wal, t]() {
+            for (int i = 0; i < commits_per_thread; ++i) {
+                LogRecord rec(LogRecordType::COMMIT, static_cast<uint64_t>(t * 1000 + i), "");
+                uint64_t lsn = wal.append(rec);
+                if (!wal.group_commit(lsn)) abort();
+                if (wal.get_flushed_lsn() < lsn) abort();
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    
+    const uint64_t total = num_threads * commits_per_thread;
+    if (wal.get_group_commit_count() != total) abort();
+    if (wal.get_group_flush_count() == 0 || wal.get_group_flush_count() > total) abort();
+    if (wal.read_from(0).size() != total) abort();
+    
+    std::cout << "  commits/flush = "
+              << static_cast<double>(total) / wal.get_group_flush_count() << std::endl;
+    
+    wal.close();
+    std::cout << "  ✓ WAL group commit test passed" << std::endl;
+}
+
+// 測試持久化策略：INTERVAL 由後台線程同步，OS 不主動同步
+void test_wal_sync_modes() {
+    std::cout << "Testing WAL sync modes..." << std::endl;
+    
+    {
+        std::filesystem::remove_all("./test_wal_interval");
+        Options options;
+        options.wal_sync_mode = WALSyncMode::INTERVAL;
+        options.wal_sync_interval_ms = 20;
+        WAL wal("./test_wal_interval", options);
+        if (!wal.initialize()) abort();
+        
+        LogRecord rec(LogRecordType::COMMIT, 1, "");
+        uint64_t lsn = wal.append(rec);
+        if (!wal.group_commit(lsn)) abort();
+        
+        // 後台線程應在若干個間隔內完成同步
+        for (int i = 0; i < 100 && wal.get_flushed_lsn() < lsn; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (wal.get_flushed_lsn() < lsn) abort();
+        if (wal.get_sync_count() == 0) abort();
+        wal.close();
+    }
+    
+    {
+        std::filesystem::remove_all("./test_wal_os");
+        Options options;
+        options.wal_sync_mode = WALSyncMode::OS;
+        WAL wal("./test_wal_os", options);
+        if (!wal.initialize()) abort();
+        
+        for (int i = 0; i < 10; ++i) {
+            LogRecord rec(LogRecordType::COMMIT, static_cast<uint64_t>(i), "");
+            if (!wal.group_commit(wal.append(rec))) abort();
+        }
+        if (wal.get_sync_count() != 0) abort();
+        if (wal.get_group_commit_count() != 10) abort();
+        
+        // 顯式 flush 總是執行 fdatasync
+        if (!wal.flush()) abort();
+        if (wal.get_sync_count() != 1) abort();
+        if (wal.get_flushed_lsn() != 10) abort();
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL sync modes test passed" << std::endl;
+}
+
+// 測試段文件：輪轉、按段截斷和重新打開
+void test_wal_segments() {
+    std::cout << "Testing WAL segments..." << std::endl;
+    
+    const std::string dir = "./test_wal_segments";
+    std::filesystem::remove_all(dir);
+    Options options;
+    options.wal_segment_size = 512;
+    
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        for (int i = 1; i <= 100; ++i) {
+            LogRecord rec(LogRecordType::PUT, 1, "key" + std::to_string(i), "value" + std::to_string(i));
+            wal.append(rec);
+        }
+        if (!wal.flush()) abort();
+        
+        size_t before = wal.get_segment_count();
+        if (before < 5) abort();
+        
+        // 截斷只刪除整段，但讀取不再返回截斷點之前的記錄
+        if (!wal.truncate(50)) abort();
+        if (wal.get_segment_count() >= before) abort();
+        auto records = wal.read_from(0);
+        if (records.size() != 51 || records.front().lsn != 50 || records.back().lsn != 100) abort();
+        
+        records = wal.read_from(90);
+        if (records.size() != 11 || records.front().lsn != 90) abort();
+        wal.close();
+    }
+    
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != 100) abort();
+        
+        auto records = wal.read_from(0);
+        if (records.empty() || records.front().lsn > 50 || records.back().lsn != 100) abort();
+        for (size_t i = 1; i < records.size(); ++i) {
+            if (records[i].lsn != records[i - 1].lsn + 1) abort();
+        }
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL segments test passed" << std::endl;
+}
+
+// 測試段輪轉失敗時組提交報告錯誤
+void test_wal_rotation_failure() {
+    std::cout << "Testing WAL rotation failure..." << std::endl;
+    
+    const std::string dir = "./test_wal_rotation_failure";
+    std::filesystem::remove_all(dir);
+    Options options;
+    options.wal_segment_size = 512;
+    
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        // 下一個段的路徑被目錄佔用，創建段文件失敗（root 也無法繞過）
+        std::filesystem::create_directories(dir + "/wal.000002");
+        
+        uint64_t lsn = 0;
+        for (int i = 1; i <= 20; ++i) {
+            LogRecord rec(LogRecordType::PUT, 1, "key" + std::to_string(i), std::string(40, 'v'));
+            lsn = wal.append(rec);
+        }
+        if (wal.group_commit(lsn)) abort();
+        if (wal.get_flushed_lsn() >= lsn) abort();
+        
+        // 錯誤一直保留到重新打開：之後的記錄也不會被報告為已持久化
+        LogRecord rec(LogRecordType::PUT, 1, "after", "value");
+        if (wal.group_commit(wal.append(rec))) abort();
+        if (wal.flush()) abort();
+        wal.close();
+    }
+    
+    std::filesystem::remove_all(dir);
+    std::cout << "  ✓ WAL rotation failure test passed" << std::endl;
+}
+
+// 測試不完整的尾部記錄在重新打開時被丟棄
+void test_wal_torn_tail() {
+    std::cout << "Testing WAL torn tail..." << std::endl;
+    
+    const std::string dir = "./test_wal_torn";
+    std::filesystem::remove_all(dir);
+    
+    {
+        WAL wal(dir);
+        if (!wal.initialize()) abort();
+        for (int i = 0; i < 3; ++i) {
+            LogRecord rec(LogRecordType::PUT, 1, "k" + std::to_string(i), "v");
+            wal.append(rec);
+        }
+        wal.close();
+    }
+    
+    // 模擬寫入一半時崩潰
+    {
+        std::ofstream out(dir + "/wal.000001", std::ios::binary | std::ios::app);
+        const char garbage[] = {1, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0};
+        out.write(garbage, sizeof(garbage));
+    }
+    
+    {
+        WAL wal(dir);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != 3) abort();
+        
+        LogRecord rec(LogRecordType::PUT, 1, "after", "crash");
+        if (wal.append(rec) != 4) abort();
+        wal.flush();
+        
+        auto records = wal.read_from(0);
+        if (records.size() != 4 || records.back().key != "after") abort();
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL torn tail test passed" << std::endl;
+}
+
 // 主測試函數
+void test_wal_append_buffer() {
+    std::cout << "Testing WAL append buffer..." << std::endl;
+    
+    const std::string dir = "./test_wal_buffer";
+    std::filesystem::remove_all(dir);
+    
+    std::string small_value(4096, 'v');
+    std::string large_value(3 * 1024 * 1024, 'x');  // 超過緩衝區寫出上限
+    {
+        WAL wal(dir, Options());
+        if (!wal.initialize()) abort();
+        
+        LogRecord rec(LogRecordType::PUT, 1, "small", small_value);
+        uint64_t lsn = wal.append(rec);
+        if (lsn != 1 || rec.lsn != 1 || rec.checksum == 0) abort();
+        if (wal.append(LogRecordType::PUT, 1, "large", large_value) != 2) abort();
+        if (wal.append(LogRecordType::DELETE, 1, "small") != 3) abort();
+        
+        // 尚未提交的記錄也能讀到
+        auto records = wal.read_from(0);
+        if (records.size() != 3) abort();
+        if (records[0].checksum != rec.checksum || records[0].value != small_value) abort();
+        if (records[1].value != large_value) abort();
+        if (records[2].type != LogRecordType::DELETE || !records[2].value.empty()) abort();
+        
+        if (!wal.group_commit(3)) abort();
+        if (wal.get_flushed_lsn() < 3) abort();
+        wal.close();
+    }
+    
+    {
+        WAL wal(dir);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != 3) abort();
+        auto records = wal.read_from(2);
+        if (records.size() != 2 || records[0].value != large_value) abort();
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL append buffer test passed" << std::endl;
+}
+
+void test_crc32c() {
+    std::cout << "Testing CRC32C..." << std::endl;
+    
+    // RFC 3720 B.4 測試向量
+    const std::string digits = "123456789";
+    const uint8_t* d = reinterpret_cast<const uint8_t*>(digits.data());
+    if (crc32c_value(d, digits.size()) != 0xE3069283) abort();
+    std::vector<uint8_t> zeros(32, 0);
+    if (crc32c_value(zeros.data(), zeros.size()) != 0x8A9136AA) abort();
+    std::vector<uint8_t> ones(32, 0xFF);
+    if (crc32c_value(ones.data(), ones.size()) != 0x62A8AB43) abort();
+    
+    // 分段計算與一次計算一致，硬件實現與可移植實現一致（覆蓋各種對齊和長度）
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t len = 0; len + offset <= data.size(); len += 37) {
+            uint32_t whole = crc32c_value(data.data() + offset, len);
+            if (whole != crc32c_extend_portable(0, data.data() + offset, len)) abort();
+            size_t half = len / 2;
+            uint32_t split = crc32c_extend(crc32c_value(data.data() + offset, half),
+                                           data.data() + offset + half, len - half);
+            if (whole != split) abort();
+        }
+    }
+    
+    std::cout << "  hardware: " << (crc32c_hardware_accelerated() ? "yes" : "no") << std::endl;
+    std::cout << "  ✓ CRC32C test passed" << std::endl;
+}
+
+// 舊格式的 CRC32（逐位計算），用於構造版本 1 的段文件
+static uint32_t legacy_crc32(const std::string& data) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (unsigned char c : data) {
+        crc ^= c;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+        }
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+static void append_fixed(std::string& out, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>((v >> (i * 8)) & 0xFF));
+    }
+}
+
+void test_wal_legacy_checksum() {
+    std::cout << "Testing WAL legacy checksum segments..." << std::endl;
+    
+    const std::string dir = "./test_wal_legacy_crc";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    
+    // 手工寫一個版本 1（CRC32）的段
+    {
+        std::string bytes;
+        append_fixed(bytes, 0x4C57564B, 4);
+        append_fixed(bytes, 1, 4);
+        append_fixed(bytes, 1, 8);
+        for (uint64_t lsn = 1; lsn <= 3; ++lsn) {
+            std::string key = "old" + std::to_string(lsn);
+            std::string value = "v" + std::to_string(lsn);
+            std::string covered;
+            covered.push_back(static_cast<char>(LogRecordType::PUT));
+            append_fixed(covered, 7, 8);
+            append_fixed(covered, lsn, 8);
+            
+            bytes += covered;
+            append_fixed(bytes, key.size(), 4);
+            bytes += key;
+            append_fixed(bytes, value.size(), 4);
+            bytes += value;
+            append_fixed(bytes, legacy_crc32(covered + key + value), 4);
+        }
+        std::ofstream out(dir + "/wal.000001", std::ios::binary);
+        out.write(bytes.data(), bytes.size());
+    }
+    
+    {
+        WAL wal(dir);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != 3) abort();
+        // 舊段保持只讀，新記錄寫入新段
+        if (wal.get_segment_count() != 2) abort();
+        
+        LogRecord rec(LogRecordType::PUT, 8, "new", "value");
+        if (wal.append(rec) != 4) abort();
+        wal.flush();
+        wal.close();
+    }
+    
+    {
+        WAL wal(dir);
+        if (!wal.initialize()) abort();
+        auto records = wal.read_from(0);
+        if (records.size() != 4) abort();
+        if (records[0].key != "old1" || records[2].value != "v3") abort();
+        if (records[3].key != "new" || records[3].lsn != 4) abort();
+        if (wal.get_segment_count() != 2) abort();
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL legacy checksum test passed" << std::endl;
+}
+
+void test_wal_reader() {
+    std::cout << "Testing WAL reader..." << std::endl;
+    
+    const std::string dir = "./test_wal_reader";
+    std::filesystem::remove_all(dir);
+    
+    Options options;
+    options.wal_segment_size = 256 * 1024;
+    WAL wal(dir, options);
+    if (!wal.initialize()) abort();
+    
+    // 小記錄跨越讀取塊邊界，中間夾一條比讀取窗口大的記錄
+    const uint64_t total = 3000;
+    std::string big(300 * 1024, 'b');
+    for (uint64_t i = 1; i <= total; ++i) {
+        std::string value = (i == 1500) ? big : "value" + std::to_string(i);
+        wal.append(LogRecordType::PUT, i, "key" + std::to_string(i), value);
+    }
+    if (wal.get_segment_count() < 3) abort();
+    
+    auto reader = wal.new_reader(0);
+    // 游標只覆蓋創建時已追加的記錄
+    wal.append(LogRecordType::PUT, 0, "later", "x");
+    
+    LogRecord record;
+    uint64_t expected = 1;
+    while (reader->next(record)) {
+        if (record.lsn != expected || record.txn_id != expected) abort();
+        if (record.key != "key" + std::to_string(expected)) abort();
+        if (expected == 1500 ? record.value != big : record.value != "value" + std::to_string(expected)) abort();
+        ++expected;
+    }
+    if (expected != total + 1) abort();
+    
+    // 從中間開始讀取
+    reader = wal.new_reader(2999);
+    if (!reader->next(record) || record.lsn != 2999) abort();
+    if (!reader->next(record) || record.lsn != 3000) abort();
+    if (!reader->next(record) || record.key != "later") abort();
+    if (reader->next(record)) abort();
+    
+    wal.close();
+    std::cout << "  ✓ WAL reader test passed" << std::endl;
+}
+
+void test_wal_open_meta() {
+    std::cout << "Testing WAL open from meta..." << std::endl;
+    
+    const std::string dir = "./test_wal_meta";
+    const std::string crashed = "./test_wal_meta_crashed";
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove_all(crashed);
+    
+    Options options;
+    options.wal_sync_mode = WALSyncMode::OS;
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        for (int i = 0; i < 100; ++i) {
+            wal.append(LogRecordType::PUT, 1, "key" + std::to_string(i), "value");
+        }
+        wal.flush();
+        
+        // 提交但未同步的尾部：在此時複製目錄模擬進程崩潰
+        for (int i = 100; i < 110; ++i) {
+            uint64_t lsn = wal.append(LogRecordType::PUT, 1, "key" + std::to_string(i), "value");
+            wal.group_commit(lsn);
+        }
+        std::filesystem::copy(dir, crashed);
+        wal.close();
+    }
+    
+    // 正常關閉後打開不掃描任何記錄
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != 110) abort();
+        if (wal.get_open_scan_bytes() != 0) abort();
+        wal.close();
+    }
+    
+    // 崩潰後只掃描最後一次同步之後的尾部
+    uint64_t tail_bytes = 0;
+    {
+        WAL wal(crashed, options);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != 110) abort();
+        tail_bytes = wal.get_open_scan_bytes();
+        if (tail_bytes == 0) abort();
+        wal.close();
+    }
+    
+    // 元數據損壞時退回整段掃描
+    {
+        std::ofstream out(dir + "/wal.meta", std::ios::binary | std::ios::trunc);
+        out << "garbage";
+    }
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != 110) abort();
+        if (wal.get_open_scan_bytes() <= tail_bytes) abort();
+        if (wal.append(LogRecordType::PUT, 1, "next", "value") != 111) abort();
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL open meta test passed" << std::endl;
+}
+
+void test_wal_concurrent_append() {
+    std::cout << "Testing WAL concurrent append..." << std::endl;
+    
+    const std::string dir = "./test_wal_concurrent";
+    std::filesystem::remove_all(dir);
+    
+    Options options;
+    options.wal_sync_mode = WALSyncMode::OS;
+    options.wal_segment_size = 128 * 1024;
+    const int thread_count = 8;
+    const int per_thread = 2000;
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        
+        std::vector<std::thread> threads;
+        for (int t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&wal, t]() {
+                for (int i = 0; i < per_thread; ++i) {
+                    wal.append(LogRecordType::PUT, t + 1, std::to_string(i), "value");
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        // close 寫出隊列中剩餘的記錄
+        wal.close();
+    }
+    
+    // 文件中的 LSN 連續遞增，每個線程的記錄保持其追加順序
+    WAL wal(dir, options);
+    if (!wal.initialize()) abort();
+    if (wal.get_last_lsn() != static_cast<uint64_t>(thread_count * per_thread)) abort();
+    
+    std::vector<int> next_index(thread_count + 1, 0);
+    auto reader = wal.new_reader(0);
+    LogRecord record;
+    uint64_t expected = 1;
+    while (reader->next(record)) {
+        if (record.lsn != expected++) abort();
+        if (record.key != std::to_string(next_index[record.txn_id]++)) abort();
+    }
+    if (expected != static_cast<uint64_t>(thread_count * per_thread) + 1) abort();
+    wal.close();
+    
+    std::cout << "  ✓ WAL concurrent append test passed" << std::endl;
+}
+
+void test_wal_block_format() {
+    std::cout << "Testing WAL block format..." << std::endl;
+    
+    const std::string dir = "./test_wal_blocks";
+    std::filesystem::remove_all(dir);
+    
+    Options options;
+    options.wal_segment_size = 256 * 1024;
+    const uint64_t total = 5000;
+    const uint64_t big_lsn = 100;
+    std::string big(100 * 1024, 'b');
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        for (uint64_t i = 1; i <= total; ++i) {
+            // 大記錄切分為跨越多個塊的 FIRST/MIDDLE/LAST 片段
+            wal.append(LogRecordType::PUT, i, "key" + std::to_string(i),
+                       i == big_lsn ? big : std::string(100, 'v'));
+        }
+        if (wal.get_segment_count() < 3) abort();
+        wal.close();
+    }
+    
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        auto records = wal.read_from(0);
+        if (records.size() != total) abort();
+        if (records[big_lsn - 1].value != big) abort();
+        wal.close();
+    }
+    
+    // 損壞第一個段中間的一個塊：只丟失該塊中的記錄，之後的塊重新同步
+    {
+        std::fstream file(dir + "/wal.000001", std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(5 * 32 * 1024 + 1000);
+        file.write("\xff\xff\xff\xff", 4);
+    }
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        auto records = wal.read_from(0);
+        if (records.size() >= total || records.size() < total - 300) abort();
+        for (size_t i = 1; i < records.size(); ++i) {
+            if (records[i].lsn <= records[i - 1].lsn) abort();
+        }
+        if (records[big_lsn - 1].value != big) abort();
+        if (records.back().lsn != total) abort();
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL block format test passed" << std::endl;
+}
+
+void test_wal_varint_format() {
+    std::cout << "Testing WAL varint record format..." << std::endl;
+    
+    const std::string dir = "./test_wal_varint";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    
+    // 手工寫一個版本 3（定長記錄的塊格式）的段
+    {
+        std::string bytes;
+        append_fixed(bytes, 0x4C57564B, 4);
+        append_fixed(bytes, 3, 4);
+        append_fixed(bytes, 1, 8);
+        for (uint64_t lsn = 1; lsn <= 3; ++lsn) {
+            std::string key = "old" + std::to_string(lsn);
+            std::string value = "v" + std::to_string(lsn);
+            std::string payload;
+            payload.push_back(static_cast<char>(LogRecordType::PUT));
+            append_fixed(payload, 7, 8);
+            append_fixed(payload, lsn, 8);
+            append_fixed(payload, key.size(), 4);
+            payload += key;
+            append_fixed(payload, value.size(), 4);
+            payload += value;
+            
+            const uint8_t full = 1;
+            uint32_t crc = crc32c_value(reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+            append_fixed(bytes, crc32c_extend(crc, &full, 1), 4);
+            append_fixed(bytes, payload.size(), 2);
+            bytes.push_back(static_cast<char>(full));
+            bytes += payload;
+        }
+        std::ofstream out(dir + "/wal.000001", std::ios::binary);
+        out.write(bytes.data(), bytes.size());
+    }
+    
+    const uint64_t total = 1000;
+    {
+        WAL wal(dir);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != 3) abort();
+        if (wal.get_segment_count() != 2) abort();
+        
+        // 短鍵值記錄：varint 格式每條記錄的開銷遠小於定長格式的 32 字節
+        uint64_t before = wal.get_bytes_written();
+        for (uint64_t i = 1; i <= total; ++i) {
+            wal.append(LogRecordType::PUT, 1000 + i, "k" + std::to_string(i), "v");
+        }
+        wal.flush();
+        uint64_t per_record = (wal.get_bytes_written() - before) / total;
+        if (per_record > 20) abort();
+        wal.close();
+    }
+    
+    {
+        WAL wal(dir);
+        if (!wal.initialize()) abort();
+        auto records = wal.read_from(0);
+        if (records.size() != total + 3) abort();
+        if (records[0].key != "old1" || records[2].value != "v3" || records[2].txn_id != 7) abort();
+        for (uint64_t i = 1; i <= total; ++i) {
+            const LogRecord& rec = records[i + 2];
+            if (rec.lsn != i + 3 || rec.txn_id != 1000 + i) abort();
+            if (rec.key != "k" + std::to_string(i) || rec.value != "v") abort();
+        }
+        
+        auto tail = wal.read_from(total);
+        if (tail.empty() || tail[0].lsn != total) abort();
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL varint record format test passed" << std::endl;
+}
+
+void test_wal_preallocate() {
+    std::cout << "Testing WAL preallocation and aligned writes..." << std::endl;
+    
+    const std::string dir = "./test_wal_prealloc";
+    std::filesystem::remove_all(dir);
+    
+    Options options;
+    options.wal_segment_size = 1024 * 1024;
+    const uint64_t batch = 4000;
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+#ifdef __linux__
+        // 新段預分配到段大小，追加不再擴展文件
+        if (std::filesystem::file_size(dir + "/wal.000001") < options.wal_segment_size) abort();
+#endif
+        for (uint64_t i = 1; i <= batch; ++i) {
+            wal.append(LogRecordType::PUT, i, "key" + std::to_string(i), std::string(400, 'a'));
+        }
+        wal.flush();
+        wal.close();
+    }
+    
+    // 在預分配區域中緊接有效數據留下一段殘缺的寫入：重新打開時丟棄，之後的寫入不會與它拼接
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != batch) abort();
+        if (wal.get_segment_count() < 2) abort();
+        auto records = wal.read_from(0);
+        if (records.size() != batch) abort();
+        wal.close();
+        
+        std::string last;
+        for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+            std::string name = entry.path().filename().string();
+            if (name.compare(0, 4, "wal.") == 0 && name != "wal.meta" && name > last) {
+                last = name;
+            }
+        }
+        std::fstream file(dir + "/" + last, std::ios::in | std::ios::out | std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        size_t data_end = bytes.find_last_not_of('\0') + 1;
+        file.clear();
+        file.seekp(static_cast<std::streamoff>(data_end));
+        std::string garbage(3000, '\x5a');
+        file.write(garbage.data(), garbage.size());
+    }
+    
+    // 每個段以 O_DIRECT | O_DSYNC 寫入（文件系統不支持時回退）
+    options.wal_direct_io = true;
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != batch) abort();
+        for (uint64_t i = batch + 1; i <= 2 * batch; ++i) {
+            wal.append(LogRecordType::PUT, i, "key" + std::to_string(i), std::string(400, 'b'));
+        }
+        if (!wal.flush()) abort();
+        wal.close();
+    }
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        auto records = wal.read_from(0);
+        if (records.size() != 2 * batch) abort();
+        for (uint64_t i = 0; i < records.size(); ++i) {
+            if (records[i].lsn != i + 1) abort();
+            if (records[i].value != std::string(400, i < batch ? 'a' : 'b')) abort();
+        }
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL preallocation test passed" << std::endl;
+}
+
+void test_wal_io_uring() {
+    std::cout << "Testing WAL io_uring writes..." << std::endl;
+    
+    const std::string dir = "./test_wal_uring";
+    std::filesystem::remove_all(dir);
+    
+    Options options;
+    options.wal_io_uring = true;
+    options.wal_segment_size = 256 * 1024;
+    const uint64_t total = 3000;
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        std::cout << "  io_uring: " << (wal.is_io_uring_enabled() ? "yes" : "no") << std::endl;
+        
+        // 多個線程組提交：寫入與 fdatasync 鏈接提交，輪轉的段在同一次提交中同步
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&wal, t, total]() {
+                for (uint64_t i = 0; i < total / 4; ++i) {
+                    uint64_t lsn = wal.append(LogRecordType::PUT, t + 1, "k" + std::to_string(i), std::string(200, 'u'));
+                    if (i % 50 == 0 && !wal.group_commit(lsn)) abort();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (!wal.flush()) abort();
+        if (wal.get_flushed_lsn() != total) abort();
+        if (wal.get_sync_count() == 0) abort();
+        if (wal.get_segment_count() < 2) abort();
+        wal.close();
+    }
+    
+    {
+        WAL wal(dir, options);
+        if (!wal.initialize()) abort();
+        if (wal.get_last_lsn() != total) abort();
+        auto records = wal.read_from(0);
+        if (records.size() != total) abort();
+        for (uint64_t i = 0; i < total; ++i) {
+            if (records[i].lsn != i + 1) abort();
+        }
+        wal.close();
+    }
+    
+    std::cout << "  ✓ WAL io_uring test passed" << std::endl;
+}
+
 int main() {
     std::cout << "=== WAL Test Suite ===" << std::endl << std::endl;
     
@@ -155,6 +933,21 @@ int main() {
         test_wal_persistence();
         test_wal_truncate();
         test_wal_checksum();
+        test_wal_group_commit();
+        test_wal_sync_modes();
+        test_wal_segments();
+        test_wal_rotation_failure();
+        test_wal_torn_tail();
+        test_wal_append_buffer();
+        test_crc32c();
+        test_wal_legacy_checksum();
+        test_wal_reader();
+        test_wal_open_meta();
+        test_wal_concurrent_append();
+        test_wal_block_format();
+        test_wal_varint_format();
+        test_wal_preallocate();
+        test_wal_io_uring();
         
         std::cout << std::endl << "=== All WAL tests passed! ===" << std::endl;
         return 0;